@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "message_types.h"
+
+namespace caffis {
+
+// Immutable per-room history segments for messages tiered out of Postgres.
+//
+//   <root>/<room id>/<first seq>-<last seq>.seg
+//
+// A segment holds one run of a room's messages in seq order, cut into
+// blocks of block_messages. Each block is columnar (all seqs, then all
+// timestamps, types, ids, senders, contents, ...) and compressed on its
+// own, so a page of history inflates one or two blocks. A sparse index
+// (seq range, time range, offset and size per block) and a fixed footer
+// close the file; readers mmap it and touch only the index and the blocks
+// they need.
+class ArchiveStore {
+public:
+    static constexpr uint8_t CODEC_NONE = 0;
+    static constexpr uint8_t CODEC_ZSTD = 1;
+    static constexpr size_t MAX_OPEN_SEGMENTS = 512;
+
+    bool configure(const config::ArchiveConfig& archive_config);
+    bool enabled() const { return !root_.empty(); }
+    const config::ArchiveConfig& settings() const { return settings_; }
+
+    // messages ascending by seq, all above the room's last archived seq
+    bool write_segment(const std::string& room_id, const std::vector<Message>& messages);
+
+    // Up to limit messages with seq < before_seq (0 = from the newest), newest first
+    std::vector<Message> read(const std::string& room_id, int64_t before_seq, size_t limit);
+
+    // Highest archived seq of a room (0 = nothing archived)
+    int64_t last_archived_seq(const std::string& room_id);
+    // Ids in the room's newest segment (re-deleted from the DB after a crash)
+    std::vector<std::string> last_segment_ids(const std::string& room_id);
+
+    static bool valid_room_id(const std::string& room_id);
+    static bool compression_available();
+
+private:
+    struct Segment;  // one mapped file
+
+    struct SegmentRef {
+        int64_t first_seq = 0;
+        int64_t last_seq = 0;
+        std::string path;
+    };
+
+    // A listing is reused while the room directory's mtime is unchanged, so
+    // segments written by another node on a shared ARCHIVE_PATH show up on
+    // the next read
+    struct Listing {
+        std::vector<SegmentRef> segments;
+        int64_t dir_mtime_ns = -1;  // -1 = directory missing
+        int64_t listed_at_ns = 0;   // wall clock, to spot changes within one mtime tick
+    };
+
+    std::vector<SegmentRef> list_segments(const std::string& room_id);  // ascending
+    std::shared_ptr<const Segment> open_segment(const std::string& path);
+
+    config::ArchiveConfig settings_;
+    std::string root_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Listing> listings_;                     // by room
+    std::unordered_map<std::string, std::shared_ptr<const Segment>> open_;  // by path
+};
+
+ArchiveStore& archive();
+
+} // namespace caffis
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "config.h"
+
+namespace caffis {
+
+struct AttachmentInfo {
+    std::string hash;          // lowercase hex SHA-256 of the content
+    uint64_t size = 0;
+    std::string content_type;
+    std::string file_name;     // as given by the first uploader
+};
+
+// One in-progress upload, owned by the uploading session's thread
+struct AttachmentUpload {
+    std::string upload_id;
+    std::string staging_path;
+    std::string file_name;
+    std::string content_type;
+    uint64_t expected_size = 0;
+    uint64_t offset = 0;       // bytes durably appended so far
+    int fd = -1;
+
+    AttachmentUpload() = default;
+    AttachmentUpload(const AttachmentUpload&) = delete;
+    AttachmentUpload& operator=(const AttachmentUpload&) = delete;
+    ~AttachmentUpload();
+};
+
+// Local content-addressed attachment store.
+//
+//   <root>/staging/<user>-<upload id>   partial uploads (resumable)
+//   <root>/objects/<h[0..1]>/<hash>     finished content, immutable
+//   <root>/objects/<h[0..1]>/<hash>.meta  content type + file name
+//
+// Chunks are appended to the staging file as they arrive, so no upload is
+// ever held in memory. On completion the file is hashed, fsynced and
+// renamed into objects/; identical content is stored once.
+class AttachmentStore {
+public:
+    bool configure(const config::AttachmentConfig& attachment_config);
+    bool enabled() const { return !root_.empty(); }
+    const config::AttachmentConfig& settings() const { return settings_; }
+
+    // Open (or resume) an upload; upload.offset says where the client continues
+    bool begin_upload(const std::string& user_id, const std::string& upload_id, uint64_t expected_size,
+                      const std::string& file_name, const std::string& content_type,
+                      AttachmentUpload& upload, std::string& error);
+    bool append(AttachmentUpload& upload, const void* data, size_t size, std::string& error);
+    bool finish(AttachmentUpload& upload, AttachmentInfo& info, std::string& error);
+    void cancel(AttachmentUpload& upload);
+
+    bool stat(const std::string& hash, AttachmentInfo& info) const;
+    std::string object_path(const std::string& hash) const;
+
+    // Remove staging files untouched for longer than the configured TTL
+    size_t sweep_staging();
+
+    static bool valid_hash(const std::string& hash);
+    static bool valid_upload_id(const std::string& upload_id);
+
+private:
+    config::AttachmentConfig settings_;
+    std::string root_;
+};
+
+AttachmentStore& attachments();
+
+} // namespace caffis
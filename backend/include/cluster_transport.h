@@ -0,0 +1,156 @@
+#pragma once
+
+#include <pqxx/pqxx>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "message_types.h"
+
+namespace caffis {
+
+// Cross-node fan-out. Each node subscribes to the rooms it has local sessions
+// in and hands messages that originated on other nodes to the local broadcast.
+class ClusterTransport {
+public:
+    using DeliveryCallback = std::function<void(const Message& message, const std::string& sender_name)>;
+    using DirectCallback = std::function<void(const std::string& user_id, const std::string& frame)>;
+    using RoomFrameCallback = std::function<void(const std::string& room_id, const std::string& author_id,
+                                                 const std::string& frame)>;
+
+    virtual ~ClusterTransport() = default;
+
+    virtual bool start(DeliveryCallback deliver, DirectCallback direct, RoomFrameCallback room_frame) = 0;
+    virtual void stop() = 0;
+
+    // Reference counted: the room stays subscribed while any local session is in it
+    virtual void subscribe_room(const std::string& room_id) = 0;
+    virtual void unsubscribe_room(const std::string& room_id) = 0;
+
+    // Announce a locally originated message to the other nodes
+    virtual void publish(const Message& message, const std::string& sender_name) = 0;
+
+    // Fan a ready-made frame (edit/delete deltas) out to the room's sessions on the other nodes.
+    // author_id is the user the frame is about, so receivers can apply blocks and mutes.
+    // fallback_frame goes out instead when frame is too large for the transport to carry.
+    virtual bool publish_room_frame(const std::string& room_id, const std::string& author_id,
+                                    const std::string& frame, const std::string& fallback_frame) = 0;
+
+    // Targeted delivery of a ready-made frame to one user's sessions on one node
+    virtual bool send_to_node(const std::string& node_id, const std::string& user_id,
+                              const std::string& frame) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Postgres LISTEN/NOTIFY transport. The persistence path NOTIFYs a compact
+// "room,seq,node,sent_us" payload inside the INSERT transaction (see
+// DatabaseManager::enable_cluster_notify), so a notification is only ever seen
+// for committed rows; receivers pull the bodies back in batches by sequence.
+// Room frames share the room channel as "F\n<node>\n<room>\n<author>\n<frame>"
+// and are delivered as-is.
+//
+// NOTIFYs sent while the LISTEN connection is down, or whose pull failed,
+// are gone for good, so the listener remembers the last seq it accounted
+// for in each subscribed room and pulls everything after it once it is
+// connected again. Messages this node published itself are skipped there;
+// they were broadcast locally.
+class PgNotifyTransport : public ClusterTransport {
+private:
+    class ChannelReceiver;
+
+    struct PendingNotice {
+        std::string room_id;
+        int64_t seq = 0;
+        int64_t sent_at_us = 0;
+    };
+
+    std::string connection_string_;
+    std::string node_id_;
+    std::unique_ptr<pqxx::connection> connection_;  // owned by listener thread
+    DeliveryCallback deliver_;
+    DirectCallback direct_;
+    RoomFrameCallback room_frame_;
+
+    // Separate connection for NOTIFYs sent outside a persistence transaction
+    std::unique_ptr<pqxx::connection> notify_connection_;
+    std::mutex notify_mutex_;
+
+    std::thread listener_;
+    std::atomic<bool> running_{false};
+
+    // Subscription changes are requested from session threads and applied by
+    // the listener thread, which is the only thread touching connection_
+    std::mutex subscriptions_mutex_;
+    std::map<std::string, int> room_refcounts_;
+    std::vector<std::string> pending_listen_;
+    std::vector<std::string> pending_unlisten_;
+
+    std::map<std::string, std::unique_ptr<ChannelReceiver>> receivers_;
+    std::unique_ptr<ChannelReceiver> node_receiver_;
+    std::vector<PendingNotice> pending_notices_;
+
+    // Catch-up state, listener thread only
+    std::unordered_map<std::string, int64_t> last_seen_seq_;  // per subscribed room
+    std::unordered_set<int64_t> caught_up_seqs_;  // delivered by the last catch-up; their NOTIFYs are dropped
+    // Seqs recently delivered from NOTIFYs, newest last. An error rewinds
+    // last_seen_seq_ below them, and the catch-up skips them.
+    std::unordered_set<int64_t> delivered_seqs_;
+    std::vector<int64_t> delivered_order_;
+    size_t delivered_next_ = 0;
+    bool catch_up_pending_ = false;
+
+    // Ids of messages published from this node, newest last (catch-up skips them)
+    std::mutex published_mutex_;
+    std::unordered_set<std::string> published_ids_;
+    std::vector<std::string> published_order_;
+    size_t published_next_ = 0;
+
+public:
+    static constexpr size_t MAX_PULL_BATCH = 256;
+    static constexpr size_t MAX_CATCH_UP_ROWS = 4096;  // per reconnect; older gaps are left to history fetches
+    static constexpr size_t MAX_NOTIFY_PAYLOAD = 7900;  // Postgres limit is 8000 bytes
+
+    PgNotifyTransport(const std::string& connection_string, const std::string& node_id);
+    ~PgNotifyTransport() override;
+
+    bool start(DeliveryCallback deliver, DirectCallback direct, RoomFrameCallback room_frame) override;
+    void stop() override;
+    void subscribe_room(const std::string& room_id) override;
+    void unsubscribe_room(const std::string& room_id) override;
+    void publish(const Message& message, const std::string& sender_name) override;
+    bool publish_room_frame(const std::string& room_id, const std::string& author_id,
+                            const std::string& frame, const std::string& fallback_frame) override;
+    bool send_to_node(const std::string& node_id, const std::string& user_id,
+                      const std::string& frame) override;
+    const char* name() const override { return "pg_notify"; }
+
+    // Channel name for a room; hyphens are stripped so it is a plain identifier
+    static std::string room_channel(const std::string& room_id);
+    static std::string node_channel(const std::string& node_id);
+    static std::string encode_payload(const std::string& room_id, int64_t seq,
+                                      const std::string& node_id, int64_t sent_at_us);
+
+private:
+    void run();
+    bool ensure_connected();
+    void apply_subscription_changes();
+    void on_notification(const std::string& payload);
+    void on_direct(const std::string& payload);
+    void on_room_frame(const std::string& payload);
+    bool notify(const std::string& channel, const std::string& payload);
+    void pull_and_deliver();
+    void record_baselines(const std::vector<std::string>& room_ids);
+    void catch_up();
+    int64_t deliver_row(const pqxx::row& row);  // returns the seq
+    void remember_delivered(int64_t seq);
+};
+
+} // namespace caffis
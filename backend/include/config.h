@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace caffis {
 namespace config {
@@ -16,6 +19,141 @@ struct DatabaseConfig {
     std::string connection_string;
 };
 
+struct ClusterConfig {
+    std::string transport = "none";  // "none" | "pg_notify"
+    std::string node_id;             // unique per chat node
+    std::string session_directory = "none";  // "none" | "memory" | "redis"
+    int session_lease_seconds = 60;
+};
+
+struct SnapshotConfig {
+    std::string path;              // empty = warm-restart snapshots disabled
+    int interval_seconds = 300;
+    int max_age_seconds = 900;     // older snapshots are discarded on load
+};
+
+struct PlacementConfig {
+    std::string cpu_pinning = "none";  // "none" | "core" | "node"
+    int acceptor_shards = 1;           // SO_REUSEPORT listeners, spread over NUMA nodes
+};
+
+struct OutboundConfig {
+    bool coalesce = true;              // false = one write per frame (A/B baseline)
+    int interactive_budget_us = 0;     // max batching delay per session class
+    int bulk_budget_us = 5000;
+    bool interactive_nodelay = true;   // TCP_NODELAY per session class
+    bool bulk_nodelay = false;
+    size_t max_batch_bytes = 256 * 1024;
+    size_t max_queued_bytes = 4 * 1024 * 1024;  // beyond this the session is dropped
+};
+
+struct AdminConfig {
+    std::string token;             // empty = admin routes only from loopback
+    double trace_sample_rate = 0;  // 0 = lifecycle tracing off
+    int trace_ring_capacity = 4096;  // spans kept per CPU
+};
+
+struct SearchConfig {
+    bool enabled = true;
+    std::string database_url;      // feed + result bodies; empty = chat DB (point at a replica to spare the primary)
+    int poll_interval_ms = 500;
+    int batch_size = 5000;         // rows per feed query (cold-start rebuild goes batch after batch)
+    int lag_ms = 2000;             // rows younger than this wait for the next poll (in-flight commits)
+};
+
+struct GeoConfig {
+    bool enabled = true;
+    int refresh_interval_ms = 2000;  // how often other nodes' location changes are picked up
+    int lag_ms = 2000;               // rows younger than this wait for the next poll (in-flight commits)
+};
+
+// Days to keep messages per room type; 0 = forever
+struct RetentionConfig {
+    bool enabled = false;
+    int private_days = 0;
+    int group_days = 0;
+    int meetup_days_after_event = 0;  // meetup rooms close this long after event_at once quiet
+    int interval_minutes = 60;
+    int batch_size = 1000;            // rows per delete transaction
+    int duty_percent = 10;            // share of wall time spent deleting; the rest is pauses
+};
+
+struct ArchiveConfig {
+    std::string path;              // empty = no archive; shared storage when several nodes serve history
+    int after_days = 180;          // messages older than this leave Postgres
+    int segment_messages = 4096;   // per segment file (a room's run may span several)
+    int block_messages = 256;      // per compressed block, the unit a history page inflates
+    int zstd_level = 3;            // 0 = store blocks uncompressed (also when built without zstd)
+    int interval_minutes = 60;
+    int rooms_per_pass = 200;
+    int duty_percent = 10;         // share of wall time spent tiering; the rest is pauses
+    // Room types with a retention limit. Retention deletes only in Postgres and
+    // segments are immutable, so these rooms are never tiered (set from RetentionConfig).
+    std::vector<std::string> skip_room_types;
+};
+
+struct DeliveryConfig {
+    bool enabled = true;
+    int status_interval_ms = 500;  // at most one delivery_status frame per sender per interval
+    int tracked_per_room = 128;    // recent messages per room that still count acks
+    int track_seconds = 300;       // acks for older messages are ignored
+};
+
+struct NotificationConfig {
+    bool enabled = false;
+    std::string provider = "file";   // file
+    std::string file_path = "/tmp/caffis-notifications.jsonl";
+    int window_ms = 10000;           // messages to one offline user within this become one notification
+    int batch_size = 100;            // notifications per provider call
+    size_t max_queued = 100000;      // messages waiting for recipient resolution; beyond this they are dropped
+    size_t max_pending_users = 100000;
+};
+
+struct HotRoomConfig {
+    bool enabled = true;
+    int hot_members = 200;                 // members present (this node) that make a room hot...
+    double hot_messages_per_minute = 120;  // ...or this message rate (last complete minute)
+    int cool_percent = 50;                 // back to direct once both are below this share of the thresholds
+    int min_hot_seconds = 60;              // no demotion sooner (no flapping)
+    int classify_seconds = 5;
+    int batch_ms = 5;                      // hot-room fan-out interval
+    int typing_interval_ms = 3000;         // hot rooms: one typing frame per user per interval...
+    int typing_per_second = 5;             // ...and at most this many per room per second
+};
+
+struct RoomStatsConfig {
+    bool enabled = true;
+    int flush_seconds = 30;        // last_activity + room_activity, one batch per interval
+    int export_top_rooms = 20;     // busiest rooms labelled in /admin/metrics
+};
+
+struct HistoryApiConfig {
+    bool enabled = true;
+    int max_page = 100;              // messages per /api/rooms/<id>/messages page
+    int token_cache_seconds = 60;    // verified bearer tokens skip the main-DB lookup this long
+};
+
+struct CaptureConfig {
+    std::string path;                           // empty = no capture
+    bool redact_content = true;                 // message text and search queries -> 'x' (shape kept)
+    uint64_t max_bytes = 1024ULL * 1024 * 1024; // recording stops here
+};
+
+struct ContentCodecConfig {
+    bool enabled = false;
+    size_t min_bytes = 512;        // shorter bodies are stored as is
+    int zstd_level = 3;
+    size_t dictionary_bytes = 64 * 1024;  // training tool: dictionary size
+    int training_samples = 50000;         // training tool: rows sampled (a tenth held out for the report)
+};
+
+struct AttachmentConfig {
+    std::string store_path;                 // empty = attachments disabled
+    uint64_t max_file_bytes = 25 * 1024 * 1024;
+    size_t max_chunk_bytes = 256 * 1024;    // per binary WebSocket frame
+    int staging_ttl_hours = 24;             // abandoned partial uploads are swept after this
+};
+
 struct RedisConfig {
     std::string host = "redis";
     int port = 6379;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+
+namespace caffis {
+
+// Storage codec for large message bodies.
+//
+// Bodies of at least min_bytes are zstd-compressed before they are saved
+// and land in messages.content_packed (content stays NULL); every reader
+// unpacks them when it turns the row into a Message. Chat lines are too
+// short for zstd to find much redundancy on its own, so compression uses a
+// shared dictionary trained from existing rows (content_dictionaries):
+//
+//   [format][dictionary id, u32 LE, FORMAT_ZSTD_DICT only][zstd frame]
+//
+// The newest dictionary encodes; any dictionary a row names can decode it,
+// fetched through the loader when another node trained it after we started.
+class ContentCodec {
+public:
+    static constexpr uint8_t FORMAT_ZSTD = 1;
+    static constexpr uint8_t FORMAT_ZSTD_DICT = 2;
+    static constexpr size_t MAX_CONTENT_BYTES = 16 * 1024 * 1024;
+
+    using DictionaryLoader = std::function<bool(uint32_t id, std::string& dictionary)>;
+
+    ContentCodec();
+    ~ContentCodec();
+
+    void configure(const config::ContentCodecConfig& codec_config);
+    bool enabled() const { return enabled_; }
+    void set_dictionary_loader(DictionaryLoader loader);
+    void add_dictionary(uint32_t id, const std::string& dictionary);
+    uint32_t encode_dictionary() const;  // 0 = plain zstd
+
+    // true when the body was packed; false = store it as is (small, or not worth it)
+    bool encode(const std::string& content, std::string& packed);
+    bool decode(const std::string& packed, std::string& content);
+
+    static bool available();
+    // Empty on failure (too few samples, or built without zstd)
+    static std::string train_dictionary(const std::vector<std::string>& samples, size_t dictionary_bytes);
+
+private:
+    struct Dictionary;
+
+    const Dictionary* find_dictionary(uint32_t id);
+
+    bool enabled_ = false;
+    config::ContentCodecConfig settings_;
+    DictionaryLoader loader_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<uint32_t, std::unique_ptr<Dictionary>> dictionaries_;  // append-only
+    uint32_t encode_id_ = 0;
+};
+
+ContentCodec& content_codec();
+
+} // namespace caffis
@@ -8,11 +8,20 @@
 
 namespace caffis {
 
+// One retention delete batch: counts for metrics, (room, seq) for cache/index cleanup
+struct RetentionBatch {
+    size_t messages = 0;
+    size_t receipts = 0;
+    uint64_t bytes = 0;  // row bytes removed (pg_column_size), before VACUUM returns them
+    std::vector<std::pair<std::string, int64_t>> removed;
+};
+
 class DatabaseManager {
 private:
     std::unique_ptr<pqxx::connection> connection_;
     std::string connection_string_;
     bool is_connected_;
+    std::string notify_node_id_;  // non-empty: NOTIFY room channels on save
 
 public:
     explicit DatabaseManager(const std::string& connection_string);
@@ -23,6 +32,10 @@ public:
     void disconnect();
     bool is_connected() const { return is_connected_; }
     bool test_connection();
+    const std::string& get_connection_string() const { return connection_string_; }
+    
+    // Cluster fan-out: announce saved messages via pg_notify (see PgNotifyTransport)
+    void enable_cluster_notify(const std::string& node_id) { notify_node_id_ = node_id; }
     
     // User operations
     bool sync_user(const std::string& user_id, const std::string& username, 
@@ -31,6 +44,7 @@ public:
     bool get_user(const std::string& user_id, std::string& username, 
                   std::string& display_name);
     bool update_user_status(const std::string& user_id, bool is_online);
+    std::vector<ChatUser> get_users(const std::vector<std::string>& user_ids);
     
     // Room operations
     std::string create_room(const std::string& name, const std::string& type, 
@@ -39,25 +53,53 @@ public:
                         const std::string& role = "member");
     bool remove_participant(const std::string& room_id, const std::string& user_id);
     std::vector<std::string> get_room_participants(const std::string& room_id);
+    // Participants to notify about sender_id's message: not the sender, room not muted, sender not blocked/muted
+    std::vector<std::string> get_notification_recipients(const std::string& room_id, const std::string& sender_id);
     
     // NEW: Room access and user rooms
     bool can_user_join_room(const std::string& user_id, const std::string& room_id);
+    bool is_active_participant(const std::string& room_id, const std::string& user_id);
     std::vector<ChatRoom> get_user_rooms(const std::string& user_id);
     std::vector<Message> get_room_messages(const std::string& room_id, int limit = 50);
+    std::vector<std::string> get_hot_room_ids(int limit);
+    
+    // Meetup room placement: creator or room admin/moderator only; name is set on success
+    bool set_room_location(const std::string& room_id, const std::string& user_id,
+                           double latitude, double longitude, std::string& name);
+    // Rooms whose row changed in (after_ms, horizon], lag_ms behind NOW(); after_ms < 0 = every located room
+    std::vector<RoomLocation> get_room_locations_changed(int64_t after_ms, int64_t& horizon_ms, int lag_ms);
     
     // Message operations
-    std::string save_message(const Message& message);
-    std::vector<Message> get_messages(const std::string& room_id, int limit = 50, 
-                                     const std::string& before_message_id = "");
+    // Fills in message.seq on success
+    std::string save_message(Message& message);
+    // Newest first, seq < before_seq (0 = from the newest); continues into the archive
+    std::vector<Message> get_messages(const std::string& room_id, int limit = 50, int64_t before_seq = 0);
+    int64_t get_max_message_seq();
+    // Rooms with messages after seq, or edited / deleted since since_us (epoch microseconds)
+    std::vector<std::string> get_rooms_changed_since(int64_t seq, int64_t since_us);
     bool mark_message_read(const std::string& message_id, const std::string& user_id);
-    bool delete_message(const std::string& message_id, const std::string& user_id);
+    
+    // Search index feed: messages by seq and edits/deletes by edited_at, both
+    // held back by lag_ms so rows still committing are not skipped
+    std::vector<Message> get_messages_after_seq(int64_t after_seq, int limit, int lag_ms);
+    std::vector<Message> get_messages_changed_between(int64_t after_ms, int64_t& horizon_ms, int lag_ms);
+    std::vector<Message> get_messages_by_ids(const std::vector<std::string>& message_ids);
+    // Sender or room admin/moderator only; room_id is set on success
+    // On success room_id and author_id (the message's sender) are filled in
+    bool delete_message(const std::string& message_id, const std::string& user_id, std::string& room_id,
+                        std::string& author_id);
     bool edit_message(const std::string& message_id, const std::string& new_content, 
-                     const std::string& user_id);
+                     const std::string& user_id, std::string& room_id, std::string& author_id,
+                     int64_t& edited_at_ms);
     
     // User relationships
     bool block_user(const std::string& user_id, const std::string& target_user_id);
     bool unblock_user(const std::string& user_id, const std::string& target_user_id);
     bool is_user_blocked(const std::string& user_id, const std::string& target_user_id);
+    bool mute_user(const std::string& user_id, const std::string& target_user_id);
+    bool unmute_user(const std::string& user_id, const std::string& target_user_id);
+    // Senders whose messages user_id should not receive (blocked or muted)
+    std::vector<std::string> get_filtered_senders(const std::string& user_id);
     
     // Typing indicators
     bool set_typing_indicator(const std::string& room_id, const std::string& user_id);
@@ -66,17 +108,55 @@ public:
     
     // Health and maintenance
     bool cleanup_expired_typing_indicators();
-    std::string get_database_stats();
+    std::string get_database_stats();  // catalog estimates, no table scans
+    // One round trip for every room: last_activity only moves forward, room_activity accumulates
+    bool flush_room_activity(const std::vector<RoomActivityDelta>& deltas);
+    
+    // Retention. Meetup rooms expire `days` after event_at (created_at when
+    // unset) and only once they have been quiet for as long.
+    bool try_maintenance_lock(const std::string& job);  // cluster-wide: one node runs a job at a time
+    void release_maintenance_lock(const std::string& job);
+    RetentionBatch delete_expired_messages(const std::string& room_type, int days, int limit);
+    RetentionBatch delete_expired_meetup_messages(int days, int limit);
+    int close_expired_meetup_rooms(int days);
+    // Time partitions of messages, if the table is partitioned (empty otherwise)
+    std::vector<std::string> get_message_partitions();
+    // Detach + drop when every row is past retention; reclaimed_bytes = relation size
+    bool drop_expired_message_partition(const std::string& partition, int min_age_days, int meetup_days,
+                                        uint64_t& reclaimed_bytes);
+    
+    // Archive tiering: rooms holding messages older than `days` (other than
+    // skip_room_types), a room's next run of them above after_seq (tombstones
+    // included), and the delete once written
+    std::vector<std::string> get_rooms_with_messages_before(int days, int limit,
+                                                            const std::vector<std::string>& skip_room_types);
+    // False on any error, an undecodable body included: nothing may be archived then
+    bool get_archivable_messages(const std::string& room_id, int days, int64_t after_seq, int limit,
+                                 std::vector<Message>& messages);
+    size_t delete_messages_by_ids(const std::vector<std::string>& message_ids);
     
 
+    // Storage codec dictionaries (content_dictionaries), oldest first
+    std::vector<std::pair<uint32_t, std::string>> get_content_dictionaries();
+    bool get_content_dictionary(uint32_t id, std::string& dictionary);
+    uint32_t save_content_dictionary(const std::string& dictionary, int sample_count);  // 0 on failure
+    // Recent non-deleted bodies of at least min_bytes, unpacked (dictionary training)
+    std::vector<std::string> get_content_samples(int limit, int min_bytes);
+    
+    // Message body of a row that selected content and content_packed
+    static std::string row_content(const pqxx::row& row);
+    
     bool ensure_user_in_default_room(const std::string& user_id, const std::string& username);
 
+    static std::string generate_uuid();
+
 private:
-    std::string generate_uuid();
     pqxx::result execute_query(const std::string& query);
     pqxx::result execute_prepared(const std::string& name, 
                                   const std::vector<std::string>& params);
     void prepare_statements();
+    bool set_relationship(const std::string& user_id, const std::string& target_user_id,
+                          const std::string& relationship_type, bool active);
 };
 
 } // namespace caffis
\ No newline at end of file
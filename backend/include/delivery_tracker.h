@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "config.h"
+#include "intern_table.h"
+
+namespace caffis {
+
+struct DeliveryStatus {
+    std::string room_id;
+    std::string message_id;
+    uint32_t delivered = 0;
+    uint32_t total = 0;
+};
+
+// Delivered/total counts for recently broadcast messages, from this node's
+// recipients only.
+//
+// Each room keeps its last tracked_per_room messages with a room-local
+// ordinal, plus one "acknowledged up to" ordinal per user. Devices
+// acknowledge in the order frames reached them, so an ack at or below a
+// user's mark is a second device (or a retry) and is not counted twice.
+// Acks only bump counters and mark the message dirty; the status pusher
+// collects dirty messages per sender at a fixed interval, so a receipt
+// storm costs one frame per sender per interval and no database writes.
+class DeliveryTracker {
+public:
+    void configure(const config::DeliveryConfig& delivery_config);
+    bool enabled() const { return enabled_; }
+
+    // Before the broadcast (acks may race it), then the recipient count after it
+    void track(IdHandle room, const std::string& message_id, IdHandle sender);
+    void set_recipients(IdHandle room, const std::string& message_id, uint32_t total);
+
+    // Returns how many of message_ids counted as new deliveries
+    size_t acknowledge(IdHandle room, IdHandle user, const std::vector<std::string>& message_ids);
+
+    // Changed counts grouped by sender; also expires old messages and idle rooms
+    std::vector<std::pair<IdHandle, std::vector<DeliveryStatus>>> collect_updates();
+
+    size_t tracked() const;
+    size_t memory_bytes() const;
+
+private:
+    struct Entry {
+        std::string message_id;
+        uint64_t ordinal = 0;
+        IdHandle sender = NO_ID;
+        uint32_t delivered = 0;
+        uint32_t total = 0;
+        bool dirty = false;
+        std::chrono::steady_clock::time_point tracked_at;
+    };
+
+    struct RoomState {
+        std::deque<Entry> entries;  // ascending ordinal
+        uint64_t next_ordinal = 1;
+        std::unordered_map<IdHandle, uint64_t> acked_up_to;
+    };
+
+    Entry* find_locked(RoomState& state, const std::string& message_id);
+
+    bool enabled_ = false;
+    config::DeliveryConfig settings_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<IdHandle, RoomState> rooms_;
+    size_t tracked_ = 0;
+};
+
+DeliveryTracker& delivery_tracker();
+
+} // namespace caffis
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "intern_table.h"
+
+namespace caffis {
+
+struct NearbyRoom {
+    std::string room_id;
+    std::string name;
+    double latitude = 0;
+    double longitude = 0;
+    double distance_km = 0;
+};
+
+// In-memory index of located rooms for nearby queries.
+//
+// Rooms are bucketed into geohash-style grid cells (latitude and longitude
+// each quantized to `bits` bits, interleaved into one key) at five levels,
+// from ~150 km down to ~600 m cells. A query picks the finest level whose
+// cells covering the search box stay under MAX_QUERY_CELLS, scans only
+// those buckets and filters by great-circle distance. Buckets carry the
+// coordinates inline so the scan never chases into the room table.
+class GeoIndex {
+public:
+    static constexpr int LEVEL_COUNT = 5;
+    static constexpr int LEVEL_BITS[LEVEL_COUNT] = {8, 10, 12, 14, 16};
+    static constexpr size_t MAX_QUERY_CELLS = 64;
+    static constexpr double MAX_RADIUS_KM = 500;
+
+    // Insert or move a room
+    void upsert(const std::string& room_id, const std::string& name, double latitude, double longitude);
+    void remove(const std::string& room_id);
+
+    std::vector<NearbyRoom> nearby(double latitude, double longitude, double radius_km, size_t limit) const;
+
+    size_t size() const;
+    size_t memory_bytes() const;
+
+    static bool valid_coordinates(double latitude, double longitude);
+    static double distance_km(double lat1, double lon1, double lat2, double lon2);
+
+private:
+    struct Entry {
+        std::string name;
+        double latitude = 0;
+        double longitude = 0;
+        uint64_t cells[LEVEL_COUNT] = {};
+    };
+
+    // Float (~1 m) is plenty to filter and rank; results use the exact entry
+    struct CellMember {
+        float latitude;
+        float longitude;
+        IdHandle room;
+    };
+
+    static uint64_t cell_key(int level, uint32_t lat_cell, uint32_t lon_cell);
+    static uint32_t lat_cell(double latitude, int bits);
+    static uint32_t lon_cell(double longitude, int bits);
+    void unlink_locked(IdHandle room, const Entry& entry);
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<IdHandle, Entry> rooms_;
+    std::unordered_map<uint64_t, std::vector<CellMember>> cells_;  // all levels, level in the key
+};
+
+GeoIndex& geo_index();
+
+} // namespace caffis
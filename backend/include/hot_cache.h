@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "message_types.h"
+#include "intern_table.h"
+
+namespace caffis {
+
+class DatabaseManager;
+
+struct CachedUser {
+    std::string username;
+    std::string display_name;
+
+    const std::string& name() const { return display_name.empty() ? username : display_name; }
+};
+
+// Point-in-time copy of every cache (warm-restart snapshots)
+struct HotCacheContents {
+    std::vector<std::pair<std::string, CachedUser>> users;
+    std::vector<std::pair<std::string, std::vector<std::string>>> room_members;
+    std::vector<std::pair<std::string, std::vector<Message>>> room_tails;
+};
+
+// In-memory caches in front of the chat database: user names, room
+// membership and the most recent messages of each room. A room tail is
+// only served once it has been loaded from the DB, after which every new
+// message in the room is appended so it stays complete.
+//
+// Ids are interned: the maps are keyed by IdHandle and membership checks
+// are integer lookups. Lookups of ids never seen do not grow the table.
+class HotCache {
+public:
+    static constexpr size_t ROOM_TAIL_CAPACITY = 50;
+    static constexpr size_t MAX_USERS = 200000;
+    static constexpr size_t MAX_ROOMS = 50000;
+
+    // Users
+    bool get_user(const std::string& user_id, CachedUser& user);
+    void put_user(const std::string& user_id, const CachedUser& user);
+
+    // Room membership
+    bool is_room_member(const std::string& room_id, const std::string& user_id);
+    void add_room_member(const std::string& room_id, const std::string& user_id);
+    void set_room_members(const std::string& room_id, const std::vector<std::string>& user_ids);
+
+    // Room tails (messages oldest first)
+    bool get_room_tail(const std::string& room_id, size_t limit, std::vector<Message>& messages);
+    // complete = messages is the room's whole history (a DB load that came back short)
+    void set_room_tail(const std::string& room_id, const std::vector<Message>& messages, bool complete = false);
+    void append_message(const Message& message);
+    // Patch a cached message in place; false if it isn't in a loaded tail
+    bool edit_cached_message(const std::string& room_id, const std::string& message_id, const std::string& content);
+    bool remove_cached_message(const std::string& room_id, const std::string& message_id);
+    // Record the seq a locally sent message got on save (the tail is dropped if that puts it out of order)
+    void set_seq(const std::string& room_id, const std::string& message_id, int64_t seq);
+    void drop_room_tail(const std::string& room_id);
+
+    // Every change to a loaded tail gets a new version, never reused within
+    // this process (a dropped and reloaded tail starts from a fresh one)
+    bool get_room_tail_version(const std::string& room_id, uint64_t& version);
+    // Up to limit messages with seq < before_seq (0 = from the newest),
+    // oldest first. False unless the tail can answer exactly what the DB
+    // would: it holds the whole page (or the room's whole history), and the
+    // cursor and the oldest message on the page have their seq already.
+    bool get_room_page(const std::string& room_id, size_t limit, int64_t before_seq,
+                       std::vector<Message>& messages, uint64_t& version);
+
+    HotCacheContents export_contents();
+
+    size_t user_count();
+    size_t room_tail_count();
+    size_t membership_room_count();
+    
+    // Approximate heap bytes held (entries, strings, hash nodes)
+    size_t memory_bytes();
+
+private:
+    std::mutex users_mutex_;
+    std::unordered_map<IdHandle, CachedUser> users_;
+
+    std::mutex members_mutex_;
+    std::unordered_map<IdHandle, std::unordered_set<IdHandle>> room_members_;
+
+    std::mutex tails_mutex_;
+    std::unordered_map<IdHandle, std::deque<Message>> room_tails_;
+    struct TailMeta {
+        uint64_t version = 0;
+        bool complete = false;  // nothing older exists; cleared once the tail overflows
+    };
+    std::unordered_map<IdHandle, TailMeta> tail_meta_;  // same keys as room_tails_
+    uint64_t next_tail_version_ = 1;
+};
+
+HotCache& hot_cache();
+
+// Preload the most recently active rooms (tails, members, senders).
+// Returns the number of rooms warmed.
+size_t warm_up_hot_cache(DatabaseManager& database, int hot_room_limit);
+
+} // namespace caffis
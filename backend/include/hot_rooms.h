@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "config.h"
+#include "intern_table.h"
+#include "outbound_queue.h"
+#include "room_stats.h"
+
+namespace caffis {
+
+// One frame waiting for a hot room's next batched fan-out
+struct HotFrame {
+    std::shared_ptr<const std::string> payload;
+    Lane lane = Lane::CHAT;
+    uint64_t coalesce_key = 0;
+    IdHandle sender = NO_ID;  // sessions skipped (echo suppression)
+    IdHandle author = NO_ID;  // recipients filtering this user are skipped
+    std::string receipt_id;   // message whose recipient count is set after the fan-out; empty = none
+    int64_t queued_us = 0;
+};
+
+// Which rooms take the batched delivery path.
+//
+// Most rooms are a handful of people: a frame is pushed to every member's
+// queue right on the sender's thread, which is the lowest latency there
+// is. A room becomes hot once its members present on this node or its
+// message rate (both from room_stats()) cross a threshold. Frames for a
+// hot room are queued here instead, and one fan-out worker delivers them
+// every batch_ms: the sender returns at once, sessions_mutex is taken once
+// per batch rather than per frame, and every recipient gets the whole
+// batch in one write. Typing frames in hot rooms are sampled.
+//
+// A room cools down only when both numbers fall well below the thresholds
+// and it has been hot for min_hot_seconds. Its queued frames are delivered
+// before it leaves, so nothing already queued is overtaken by a direct send.
+// That delivery runs outside the lock, so senders to other hot rooms never wait on it.
+class HotRooms {
+public:
+    void configure(const config::HotRoomConfig& hot_room_config);
+    bool enabled() const { return enabled_; }
+    const config::HotRoomConfig& settings() const { return settings_; }
+
+    // True if the room is hot and the frame was queued; false = deliver it directly
+    bool enqueue(IdHandle room, HotFrame frame);
+
+    // Everything queued since the last call, per room, in queue order
+    std::vector<std::pair<IdHandle, std::vector<HotFrame>>> take_batches();
+
+    // Applies thresholds to current room activity. Rooms leaving the hot set
+    // hand their queued frames to drain first (called without the lock; the
+    // room keeps queueing until a drain finds nothing left). A room whose
+    // drain throws stays hot with its frames queued again.
+    void reclassify(const std::vector<RoomActivity>& rooms,
+                    const std::function<void(IdHandle, std::vector<HotFrame>&)>& drain);
+
+    // False if a hot room's typing frame should be dropped; always true elsewhere
+    bool sample_typing(IdHandle room, IdHandle user, bool is_typing);
+
+    size_t hot_count() const;
+    size_t memory_bytes() const;
+
+private:
+    struct HotRoom {
+        std::vector<HotFrame> pending;
+        std::chrono::steady_clock::time_point hot_since;
+        std::unordered_map<IdHandle, std::chrono::steady_clock::time_point> typing_forwarded;  // last is_typing=true sent
+        int64_t typing_second = 0;
+        int typing_in_second = 0;
+        bool draining = false;  // cooled: frames go to reclassify's drain, not take_batches
+    };
+
+    bool is_hot_activity(const RoomActivity& activity) const;
+    bool is_cool_activity(const RoomActivity& activity) const;
+
+    bool enabled_ = false;
+    config::HotRoomConfig settings_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<IdHandle, HotRoom> rooms_;
+};
+
+HotRooms& hot_rooms();
+
+} // namespace caffis
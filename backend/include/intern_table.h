@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace caffis {
+
+// Dense 32-bit handle for an interned user or room id; 0 is "none"
+using IdHandle = uint32_t;
+constexpr IdHandle NO_ID = 0;
+
+// 128-bit binary form of a canonical UUID string
+struct Uuid128 {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const Uuid128& other) const { return hi == other.hi && lo == other.lo; }
+
+    // Accepts 8-4-4-4-12 hex (either case); false for anything else
+    static bool parse(const std::string& text, Uuid128& out);
+    std::string to_string() const;  // lowercase, hyphenated
+};
+
+struct Uuid128Hash {
+    size_t operator()(const Uuid128& id) const {
+        return static_cast<size_t>(id.hi ^ (id.lo * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+// Process-wide id <-> handle table shared by sessions, room indexes and
+// caches, so hot-path membership checks are integer compares instead of
+// 36-char string compares. UUIDs are stored as 16 bytes; ids that are not
+// UUIDs (legacy accounts) keep their text. Handles are never recycled, so
+// a handle stays valid for the life of the process; the table grows with
+// the number of distinct users and rooms seen.
+class InternTable {
+public:
+    // Existing handle or a new one
+    IdHandle intern(const std::string& id);
+
+    // Existing handle or NO_ID (never grows the table)
+    IdHandle find(const std::string& id) const;
+
+    // Canonical text of a handle; empty for NO_ID / unknown
+    std::string to_string(IdHandle handle) const;
+
+    size_t size() const;
+    size_t memory_bytes() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<Uuid128, IdHandle, Uuid128Hash> by_uuid_;
+    std::vector<Uuid128> ids_;  // indexed by handle - 1
+
+    std::unordered_map<std::string, IdHandle> by_text_;
+    std::unordered_map<IdHandle, std::string> text_;
+};
+
+InternTable& interned_ids();
+
+} // namespace caffis
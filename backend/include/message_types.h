@@ -2,6 +2,7 @@
 
 #include <string>
 #include <chrono>
+#include <cstdint>
 
 namespace caffis {
 
@@ -13,6 +14,25 @@ enum class MessageType {
     SYSTEM
 };
 
+inline const char* message_type_to_string(MessageType type) {
+    switch (type) {
+        case MessageType::TEXT: return "text";
+        case MessageType::IMAGE: return "image";
+        case MessageType::FILE: return "file";
+        case MessageType::LOCATION: return "location";
+        case MessageType::SYSTEM: return "system";
+    }
+    return "text";
+}
+
+inline MessageType message_type_from_string(const std::string& type_str) {
+    if (type_str == "image") return MessageType::IMAGE;
+    if (type_str == "file") return MessageType::FILE;
+    if (type_str == "location") return MessageType::LOCATION;
+    if (type_str == "system") return MessageType::SYSTEM;
+    return MessageType::TEXT;
+}
+
 struct Message {
     std::string id;
     std::string room_id;
@@ -20,6 +40,7 @@ struct Message {
     std::string content;
     MessageType type;
     std::chrono::system_clock::time_point timestamp;
+    int64_t seq = 0; // messages.seq, monotonic insert order across the cluster
     bool is_edited = false;
     bool is_deleted = false;
     
@@ -51,6 +72,23 @@ struct ChatRoom {
     }
 };
 
+// Meetup room placement as read by the nearby-rooms feed
+struct RoomLocation {
+    std::string room_id;
+    std::string name;
+    double latitude = 0;
+    double longitude = 0;
+    bool listed = false;  // active meetup with a location; false = drop from the index
+};
+
+// One room's activity since the previous stats flush (chat_rooms.last_activity, room_activity)
+struct RoomActivityDelta {
+    std::string room_id;
+    uint64_t messages = 0;
+    uint32_t peak_members = 0;
+    int64_t last_activity_ms = 0;  // Unix epoch; 0 = no messages in this delta
+};
+
 struct ChatUser {
     std::string id;
     std::string username;
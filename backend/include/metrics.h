@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace caffis {
+namespace metrics {
+
+// Monotonic counter (events, bytes, ...)
+class Counter {
+private:
+    std::atomic<uint64_t> value_{0};
+
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+};
+
+// Point-in-time value (queue depth, connections, ...)
+class Gauge {
+private:
+    std::atomic<int64_t> value_{0};
+
+public:
+    void set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+};
+
+// Fixed-bucket latency histogram, values in microseconds
+class Histogram {
+public:
+    static const std::vector<uint64_t>& bounds();
+
+    Histogram();
+    void observe(uint64_t value_us);
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t bucket(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket containing the q-th quantile (0 < q <= 1)
+    uint64_t percentile(double q) const;
+
+private:
+    std::vector<std::atomic<uint64_t>> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Registry lookups. Returned references stay valid for the process lifetime,
+// so hot paths should look a metric up once and keep the reference.
+// Names may carry Prometheus labels, e.g. "foo_total{transport=\"pg_notify\"}".
+Counter& counter(const std::string& name);
+Gauge& gauge(const std::string& name);
+Histogram& histogram(const std::string& name);
+
+// Prometheus text exposition of every registered metric
+std::string render();
+
+// Microseconds since the Unix epoch (used for cross-process latency stamps)
+int64_t now_us();
+
+} // namespace metrics
+} // namespace caffis
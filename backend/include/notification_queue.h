@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "message_types.h"
+
+namespace caffis {
+
+class DatabaseManager;
+
+// Everything one offline user missed during a coalescing window
+struct OfflineNotification {
+    std::string user_id;
+    size_t message_count = 0;
+    std::vector<std::string> room_ids;  // distinct, in first-seen order
+    std::string room_id;                // latest message
+    std::string sender_name;
+    std::string preview;
+    int64_t first_ms = 0;
+    int64_t last_ms = 0;
+};
+
+// Where notifications leave the service (APNs/FCM gateway, webhook, ...)
+class NotificationProvider {
+public:
+    virtual ~NotificationProvider() = default;
+
+    // One batch per call; false = the batch was not accepted
+    virtual bool deliver(const std::vector<OfflineNotification>& batch) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Development stand-in: one JSON line per notification
+class FileNotificationProvider : public NotificationProvider {
+private:
+    std::string path_;
+    std::ofstream out_;
+
+public:
+    explicit FileNotificationProvider(const std::string& path);
+
+    bool deliver(const std::vector<OfflineNotification>& batch) override;
+    const char* name() const override { return "file"; }
+};
+
+// nullptr for an unknown provider name
+std::unique_ptr<NotificationProvider> make_notification_provider(const config::NotificationConfig& notification_config);
+
+// Offline push pipeline. The sender path only appends the message to an
+// in-memory queue; a worker thread resolves recipients (active room
+// participants that have not muted the room or blocked/muted the sender,
+// one query per room and sender in a drained batch), drops users with a
+// live session anywhere, and coalesces the rest per user. A user's
+// notification goes out window_ms after their first missed message, in
+// batches to the provider.
+class NotificationQueue {
+public:
+    using PresenceCheck = std::function<bool(const std::string& user_id)>;  // true = has a live session
+
+    NotificationQueue(const config::NotificationConfig& notification_config, std::unique_ptr<DatabaseManager> db,
+                      std::unique_ptr<NotificationProvider> provider, PresenceCheck is_connected);
+    ~NotificationQueue();
+
+    void start();
+    void stop();  // flushes what is pending
+
+    // Sender path: never blocks on the database or the provider
+    void enqueue(const Message& msg, const std::string& sender_name);
+
+    size_t pending_users() const;
+
+private:
+    struct Event {
+        std::string room_id;
+        std::string sender_id;
+        std::string sender_name;
+        std::string preview;
+        int64_t sent_ms = 0;
+    };
+
+    struct Pending {
+        OfflineNotification notification;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    void run();
+    void resolve(std::vector<Event>& events);
+    void flush(bool everything);
+
+    static std::string preview_of(const Message& msg);
+
+    config::NotificationConfig settings_;
+    std::unique_ptr<DatabaseManager> db_;
+    std::unique_ptr<NotificationProvider> provider_;
+    PresenceCheck is_connected_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Event> queue_;
+
+    mutable std::mutex pending_mutex_;
+    std::unordered_map<std::string, Pending> pending_;  // by user; worker-owned, locked for stats
+
+    std::thread worker_;
+    std::atomic<bool> running_{false};
+};
+
+} // namespace caffis
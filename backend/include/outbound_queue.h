@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "config.h"
+
+namespace caffis {
+
+namespace metrics { class Gauge; }
+
+// How a session wants its outbound frames batched
+enum class SessionClass {
+    INTERACTIVE,  // browsers: flush immediately
+    BULK          // bridges, bots, dashboards: trade latency for fewer writes
+};
+
+SessionClass session_class_from_string(const std::string& value);
+const char* session_class_to_string(SessionClass session_class);
+
+// Outbound priority lanes, drained in this order
+enum class Lane : uint8_t {
+    CONTROL = 0,  // auth results, errors, acks: strict priority
+    CHAT = 1,     // messages and history: FIFO
+    EPHEMERAL = 2 // typing / presence: latest state per key wins, shed under backpressure
+};
+constexpr size_t LANE_COUNT = 3;
+
+// Per-session outbound frame queue.
+//
+// Frames are serialized as unmasked WebSocket text frames and written
+// straight to the socket with one sendmsg() per batch: everything queued
+// while a write is in flight (a busy room, a history replay) goes out as
+// one gathered write. Sends never block the caller; when the socket is
+// full the rest is handed to the shared flusher thread, which also flushes
+// BULK sessions once their latency budget expires.
+//
+// Frames wait in per-lane queues and each write takes control frames
+// first, then chat, then ephemeral. An ephemeral frame with the same
+// coalesce key as one still queued replaces it in place.
+//
+// All writes to a session's socket must go through its queue: Beast's own
+// writes reach it through QueuedStream. Beast still owns the read side.
+class OutboundQueue : public std::enable_shared_from_this<OutboundQueue> {
+public:
+    OutboundQueue(int fd, SessionClass session_class);
+    ~OutboundQueue();
+
+    // Queue one text frame. False if it wasn't queued: the queue is shut down
+    // or overflowed (the connection is then torn down as a slow consumer), or
+    // an ephemeral frame was shed under backpressure.
+    // coalesce_key only matters on the EPHEMERAL lane (0 = never coalesce).
+    bool push(std::shared_ptr<const std::string> payload, Lane lane = Lane::CHAT, uint64_t coalesce_key = 0);
+    bool push(std::string payload, Lane lane = Lane::CHAT, uint64_t coalesce_key = 0);
+    // Bytes that already form a complete frame (Beast's pongs and close
+    // frames, see QueuedStream), on the control lane. False once the queue
+    // is shut down, and only after any in-flight write has finished, so the
+    // caller may then write to the socket directly.
+    bool push_raw(std::string wire_bytes);
+
+    // Defers flushing while alive so a burst of pushes leaves as one write
+    class Cork {
+    public:
+        explicit Cork(OutboundQueue& queue);
+        ~Cork();
+        Cork(const Cork&) = delete;
+        Cork& operator=(const Cork&) = delete;
+    private:
+        OutboundQueue& queue_;
+    };
+
+    // Stop writing and wait for an in-flight write to finish. Call before
+    // anything else writes to or closes the socket.
+    void shutdown();
+
+    SessionClass session_class() const { return session_class_; }
+    size_t queued_bytes() const;
+    size_t lane_size(Lane lane) const;
+    bool is_shut_down() const;
+
+    struct Frame {
+        std::shared_ptr<const std::string> payload;
+        char header[10];
+        uint8_t header_len = 0;
+        size_t sent = 0;  // header + payload bytes already written
+        uint64_t coalesce_key = 0;
+
+        size_t wire_size() const { return header_len + payload->size(); }
+    };
+
+private:
+    friend class OutboundFlusher;
+
+    static metrics::Gauge& lane_depth(Lane lane);
+
+    bool push_locked(Frame frame, Lane lane, std::unique_lock<std::mutex>& lock);
+    void flush();
+    bool has_pending_locked() const;
+    void clear_locked();
+    int fd() const { return fd_; }
+
+    const int fd_;
+    const SessionClass session_class_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable writer_idle_;
+    std::deque<Frame> lanes_[LANE_COUNT];
+    std::deque<Frame> inflight_;  // current batch, writer-owned
+    size_t queued_bytes_ = 0;
+    int corks_ = 0;
+    bool writing_ = false;
+    bool scheduled_ = false;  // waiting on the flusher (budget or writable)
+    bool shut_down_ = false;
+};
+
+// Batching settings for all queues (call once at startup)
+void configure_outbound(const config::OutboundConfig& outbound_config);
+const config::OutboundConfig& outbound_settings();
+
+} // namespace caffis
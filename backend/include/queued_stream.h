@@ -0,0 +1,90 @@
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include "outbound_queue.h"
+
+namespace caffis {
+
+// Next layer of a session's WebSocket stream.
+//
+// Reads go straight to the TCP stream. Beast also writes on its own from
+// inside read(): pongs and close replies, each as one complete frame.
+// Once the session's OutboundQueue is attached those bytes are queued on
+// its control lane instead, so they can never land in the middle of a
+// frame the queue has only partly written. Before attach() (the
+// handshake) and after the queue is shut down nothing else writes to the
+// socket, and the bytes go out directly.
+class QueuedStream {
+public:
+    using executor_type = boost::beast::tcp_stream::executor_type;
+
+    explicit QueuedStream(boost::beast::tcp_stream stream) : stream_(std::move(stream)) {}
+
+    executor_type get_executor() noexcept { return stream_.get_executor(); }
+    boost::beast::tcp_stream& next_layer() { return stream_; }
+    const boost::beast::tcp_stream& next_layer() const { return stream_; }
+
+    void attach(std::shared_ptr<OutboundQueue> queue) { queue_ = std::move(queue); }
+    const std::shared_ptr<OutboundQueue>& queue() const { return queue_; }
+
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers) {
+        return stream_.read_some(buffers);
+    }
+
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers, boost::beast::error_code& ec) {
+        return stream_.read_some(buffers, ec);
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers) {
+        boost::beast::error_code ec;
+        std::size_t written = write_some(buffers, ec);
+        if (ec) {
+            BOOST_THROW_EXCEPTION(boost::system::system_error{ec});
+        }
+        return written;
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers, boost::beast::error_code& ec) {
+        if (queue_) {
+            std::string bytes = boost::beast::buffers_to_string(buffers);
+            if (queue_->push_raw(bytes)) {
+                ec = {};
+                return bytes.size();
+            }
+        }
+        return stream_.write_some(buffers, ec);
+    }
+
+private:
+    boost::beast::tcp_stream stream_;
+    std::shared_ptr<OutboundQueue> queue_;
+};
+
+// Found by Beast through ADL when the close handshake ends. The queue stops
+// first so its writer never races the socket shutdown.
+inline void teardown(boost::beast::role_type role, QueuedStream& stream, boost::beast::error_code& ec) {
+    if (stream.queue()) {
+        stream.queue()->shutdown();
+    }
+    using boost::beast::websocket::teardown;
+    teardown(role, stream.next_layer().socket(), ec);
+}
+
+template <class TeardownHandler>
+void async_teardown(boost::beast::role_type role, QueuedStream& stream, TeardownHandler&& handler) {
+    if (stream.queue()) {
+        stream.queue()->shutdown();
+    }
+    using boost::beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer().socket(), std::forward<TeardownHandler>(handler));
+}
+
+} // namespace caffis
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace caffis {
+
+struct RedisReply {
+    enum class Type { NIL, STATUS, ERROR, INTEGER, STRING, ARRAY };
+
+    Type type = Type::NIL;
+    std::string str;       // STATUS, ERROR, STRING
+    int64_t integer = 0;   // INTEGER
+    std::vector<RedisReply> elements;  // ARRAY
+
+    bool ok() const { return type != Type::ERROR; }
+};
+
+// Minimal synchronous RESP2 client. One socket, serialized by a mutex,
+// reconnects lazily after a failure. Enough for directory/lease style
+// commands; not meant for blocking SUBSCRIBE loops.
+class RedisClient {
+private:
+    std::string host_;
+    int port_;
+    boost::asio::io_context io_context_;
+    std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
+    boost::asio::streambuf read_buffer_;
+    std::mutex mutex_;
+
+public:
+    RedisClient(const std::string& host, int port);
+    ~RedisClient();
+
+    bool connect();
+    bool is_connected() const { return socket_ != nullptr; }
+
+    // Returns an ERROR reply (never throws) if the server is unreachable
+    RedisReply command(const std::vector<std::string>& args);
+
+    // Sends every command before reading any reply (one round trip)
+    std::vector<RedisReply> pipeline(const std::vector<std::vector<std::string>>& commands);
+
+private:
+    bool connect_locked();
+    static std::string encode(const std::vector<std::string>& args);
+    RedisReply read_reply();
+    std::string read_line();
+};
+
+} // namespace caffis
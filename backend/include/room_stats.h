@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "intern_table.h"
+#include "message_types.h"
+
+namespace caffis {
+
+// Per-room counters as read for the admin metrics
+struct RoomActivity {
+    IdHandle room = NO_ID;
+    std::string room_id;
+    double per_minute_1m = 0;   // messages per minute over the last 1/5/15 complete minutes
+    double per_minute_5m = 0;
+    double per_minute_15m = 0;
+    uint32_t members = 0;       // distinct users with a session in the room on this node
+    uint32_t peak_members = 0;  // while tracked (a room is forgotten after a quiet, empty window)
+    uint64_t messages = 0;      // while tracked
+};
+
+// Activity of the rooms this node serves: messages sent here and members
+// joined here (other nodes count their own).
+//
+// The message and join paths only do atomic adds. Each room spreads its
+// message counts over STRIPES cache-line-aligned stripes and every thread
+// sticks to one of them (handed out round-robin), so senders in one busy
+// room don't fight over a line; reads merge the stripes. A stripe is a
+// ring of per-minute buckets, each packed as minute << 24 | count, so a
+// bucket rolls over to a new minute with a single CAS and no lost counts.
+// Finding a room's counters takes the table's shared lock, like
+// interned_ids().
+class RoomStats {
+public:
+    static constexpr size_t STRIPES = 4;
+    static constexpr size_t MINUTE_BUCKETS = 16;  // 15 complete minutes + the current one
+
+    void configure(const config::RoomStatsConfig& room_stats_config);
+    bool enabled() const { return enabled_; }
+
+    void record_message(IdHandle room);
+    // Distinct users present, called when a user's first session enters or last one leaves
+    void member_joined(IdHandle room);
+    void member_left(IdHandle room);
+
+    std::vector<RoomActivity> snapshot() const;
+    // Prometheus lines for the busiest export_top_rooms rooms (label cardinality stays bounded)
+    std::string render_metrics() const;
+
+    // Rooms that saw messages or a new peak since the last call; also drops
+    // rooms that have been empty and quiet for the whole window
+    std::vector<RoomActivityDelta> take_deltas();
+    // A flush that failed: counted again by the next one
+    void restore_deltas(const std::vector<RoomActivityDelta>& deltas);
+
+    size_t tracked() const;
+    size_t memory_bytes() const;
+
+private:
+    struct alignas(64) Stripe {
+        std::array<std::atomic<uint64_t>, MINUTE_BUCKETS> minutes{};
+    };
+
+    struct RoomCounters {
+        std::array<Stripe, STRIPES> stripes;
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint32_t> members{0};
+        std::atomic<uint32_t> peak_members{0};
+        std::atomic<uint32_t> flush_peak_members{0};  // peak since the last flush
+        std::atomic<int64_t> last_activity_ms{0};
+
+        // Flusher only (under the exclusive lock)
+        uint64_t flushed_messages = 0;
+        uint32_t flushed_peak_members = 0;
+    };
+
+    // Runs apply on the room's counters, creating them on first use (UUID room ids only)
+    void update(IdHandle room, void (*apply)(RoomCounters&));
+    static RoomActivity read(IdHandle room, const RoomCounters& counters, int64_t minute);
+
+    bool enabled_ = false;
+    config::RoomStatsConfig settings_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<IdHandle, std::unique_ptr<RoomCounters>> rooms_;
+};
+
+RoomStats& room_stats();
+
+} // namespace caffis
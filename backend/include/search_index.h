@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "intern_table.h"
+
+namespace caffis {
+
+struct SearchHit {
+    std::string message_id;
+    IdHandle room = NO_ID;
+    int64_t seq = 0;
+    double score = 0;
+};
+
+// Incremental full-text index over message content, one shard per room.
+//
+// A shard appends documents in arrival order and keeps, per term, a posting
+// list of varint-encoded (doc delta, term frequency) pairs, so lists are
+// only ever appended to. An edit appends a new document for the same
+// message (same seq) and retires the old one; retired documents are
+// skipped at query time, and a shard whose retired documents outnumber its
+// live ones is compacted (documents renumbered, posting lists rewritten).
+// Queries rank with BM25, using statistics summed over the rooms being
+// searched.
+class SearchIndex {
+public:
+    static constexpr size_t MAX_TERM_BYTES = 32;
+    static constexpr size_t MAX_QUERY_TERMS = 8;
+    static constexpr size_t COMPACT_MIN_RETIRED = 64;  // per shard, and more than its live documents
+
+    // Index a message, or re-index it after an edit (seq identifies it in the room)
+    void upsert(const std::string& room_id, const std::string& message_id, int64_t seq,
+                const std::string& sender_id, const std::string& content);
+    void remove(const std::string& room_id, int64_t seq);
+
+    // Best `limit` matches across `rooms`, highest score first, leaving out
+    // messages from excluded_senders (sorted: the searcher's blocks and mutes)
+    std::vector<SearchHit> search(const std::vector<IdHandle>& rooms, const std::string& query, size_t limit,
+                                  const std::vector<IdHandle>& excluded_senders = {}) const;
+
+    size_t document_count() const;  // live documents
+    size_t retired_count() const;   // replaced or removed, not compacted yet
+    size_t shard_count() const;
+    size_t memory_bytes() const;
+
+    // Lowercased ASCII alphanumerics; bytes >= 0x80 (UTF-8) count as word characters
+    static std::vector<std::string> tokenize(const std::string& text);
+
+    // Posting list integers: 7 bits per byte, low groups first, high bit = more follow
+    static void put_varint(std::string& out, uint32_t value);
+    static uint32_t get_varint(const std::string& in, size_t& pos);
+
+private:
+    struct Document {
+        Uuid128 message_id;
+        int64_t seq = 0;
+        uint32_t length = 0;  // tokens
+        IdHandle sender = NO_ID;
+        bool live = true;
+    };
+
+    struct PostingList {
+        std::string bytes;
+        uint32_t last_doc = 0;
+        uint32_t doc_count = 0;  // includes retired documents
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::vector<Document> docs;
+        std::vector<std::pair<int64_t, uint32_t>> by_seq;  // seq -> current doc, sorted by seq
+        std::unordered_map<std::string, PostingList> terms;
+        uint64_t live_length = 0;
+        uint32_t live_docs = 0;
+    };
+
+    Shard* find_shard(IdHandle room) const;
+    Shard& shard_for(IdHandle room);
+    static bool retire(Shard& shard, int64_t seq);  // caller holds shard.mutex
+    static void compact_if_sparse(Shard& shard);    // caller holds shard.mutex
+
+    mutable std::shared_mutex shards_mutex_;
+    std::unordered_map<IdHandle, std::unique_ptr<Shard>> shards_;
+};
+
+SearchIndex& search_index();
+
+} // namespace caffis
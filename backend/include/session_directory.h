@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "redis_client.h"
+
+namespace caffis {
+
+// Cluster-wide user -> node map used to route targeted (1:1 / system)
+// messages to exactly the nodes holding a user's sessions instead of
+// broadcasting to every node. Entries are leases: a node that dies simply
+// stops refreshing and its entries age out.
+class SessionDirectory {
+public:
+    virtual ~SessionDirectory() = default;
+
+    virtual void register_user(const std::string& user_id, const std::string& node_id) = 0;
+    virtual void unregister_user(const std::string& user_id, const std::string& node_id) = 0;
+
+    // Extend the lease of every user currently held by node_id
+    virtual void refresh_leases(const std::vector<std::string>& user_ids, const std::string& node_id) = 0;
+
+    // Nodes with a live lease for the user
+    virtual std::vector<std::string> lookup(const std::string& user_id) = 0;
+
+    virtual const char* name() const = 0;
+
+    std::chrono::seconds lease_duration() const { return lease_; }
+
+protected:
+    explicit SessionDirectory(std::chrono::seconds lease) : lease_(lease) {}
+
+    std::chrono::seconds lease_;
+};
+
+// Process-local stand-in (single node, development)
+class InMemorySessionDirectory : public SessionDirectory {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unordered_map<std::string, Clock::time_point>> leases_;
+
+public:
+    explicit InMemorySessionDirectory(std::chrono::seconds lease);
+
+    void register_user(const std::string& user_id, const std::string& node_id) override;
+    void unregister_user(const std::string& user_id, const std::string& node_id) override;
+    void refresh_leases(const std::vector<std::string>& user_ids, const std::string& node_id) override;
+    std::vector<std::string> lookup(const std::string& user_id) override;
+    const char* name() const override { return "memory"; }
+};
+
+// Redis hash per user: chat:sessions:<user_id> { node_id -> lease expiry (ms) }
+class RedisSessionDirectory : public SessionDirectory {
+private:
+    std::unique_ptr<RedisClient> redis_;
+
+public:
+    RedisSessionDirectory(const std::string& host, int port, std::chrono::seconds lease);
+
+    void register_user(const std::string& user_id, const std::string& node_id) override;
+    void unregister_user(const std::string& user_id, const std::string& node_id) override;
+    void refresh_leases(const std::vector<std::string>& user_ids, const std::string& node_id) override;
+    std::vector<std::string> lookup(const std::string& user_id) override;
+    const char* name() const override { return "redis"; }
+
+private:
+    static std::string key_for(const std::string& user_id) { return "chat:sessions:" + user_id; }
+    std::vector<std::vector<std::string>> lease_commands(const std::string& user_id, const std::string& node_id) const;
+};
+
+} // namespace caffis
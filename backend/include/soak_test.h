@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+
+namespace caffis {
+
+// Hours-long churn against a running server (caffis_chat --soak):
+//   - `clients` connections that authenticate, join a room, exchange
+//     messages and disconnect, over and over
+//   - all of it through a local TCP proxy that stalls or cuts a share of
+//     the connections mid-session
+//   - optionally a command that restarts the database every so often
+// Every sample_seconds the server's /admin/metrics are scraped for RSS,
+// thread and FD counts, next to the client-side p99 of message echoes in
+// that window. Once warmup_seconds are over, the medians of the warm-up
+// samples are the baseline; the run fails as soon as the median of the
+// last three samples grows past a limit. After the churn stops, threads,
+// FDs and sessions must return to their pre-run idle values.
+struct SoakOptions {
+    std::string host = "127.0.0.1";
+    std::string port = "5002";
+    std::string admin_token;           // for /admin/metrics when the server has ADMIN_TOKEN set
+    std::string jwt_secret;
+    std::string users_path;            // one user id per line, existing in the main DB
+    std::string rooms_path;            // one room id per line those users may join
+    int duration_seconds = 3600;
+    int clients = 50;                  // concurrent connections
+    int messages_per_connection = 20;
+    int message_interval_ms = 200;
+
+    // Fault injection
+    double stall_probability = 0.05;   // per connection: forwarding pauses once
+    int stall_ms = 2000;
+    double reset_probability = 0.02;   // per connection: both sides cut mid-session
+    std::string db_restart_command;    // run through the shell; empty = no restarts
+    int db_restart_seconds = 600;
+
+    // Drift limits
+    int sample_seconds = 30;
+    int warmup_seconds = 120;
+    double max_rss_growth = 0.25;      // fraction over baseline
+    int max_thread_growth = 16;
+    int max_fd_growth = 64;
+    double max_p99_growth = 3.0;       // factor over baseline (histogram buckets are 2-2.5x apart)
+    int settle_seconds = 15;           // after the churn, before the idle check
+};
+
+// 0 = no drift, 1 = drift or the server went away
+int run_soak(const SoakOptions& options);
+
+} // namespace caffis
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace caffis {
+
+class DatabaseManager;
+
+// Warm-restart snapshot of the HotCache (users, room membership, room tails).
+//
+// File layout (little endian):
+//   SnapshotHeader
+//   payload: users | room members | room tails, strings as u32 length + bytes
+//
+// The payload is guarded by an FNV-1a checksum. high_water_seq is
+// messages.seq at write time: on load, room tails that received messages
+// after it are dropped and reload lazily from the DB.
+struct SnapshotHeader {
+    char magic[8];             // "CAFSNAP\0"
+    uint32_t version;
+    uint32_t reserved;
+    int64_t created_at_us;
+    int64_t high_water_seq;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+constexpr uint32_t SNAPSHOT_VERSION = 3;  // 2: attachment fields in room tails, 3: message metadata
+
+// Atomically replaces path (write to path.tmp, then rename)
+bool save_state_snapshot(const std::string& path, DatabaseManager& database);
+
+// Memory-maps and loads the snapshot into the HotCache. Corrupt, foreign-
+// version or older-than-max_age snapshots are discarded and the caches stay
+// cold. Returns true when anything was loaded.
+bool load_state_snapshot(const std::string& path, std::chrono::seconds max_age, DatabaseManager& database);
+
+} // namespace caffis
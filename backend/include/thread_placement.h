@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace caffis {
+namespace placement {
+
+// CPU / NUMA placement of acceptor and session threads.
+//
+// Each acceptor shard (SO_REUSEPORT listener) is assigned a NUMA node and
+// every session it accepts runs on that node's CPUs, so the session's
+// stack, malloc arena and buffers are first-touched on the local node.
+// With libnuma (CAFFIS_HAVE_NUMA) the node is also set as the thread's
+// preferred memory node.
+
+struct Topology {
+    std::vector<int> node_ids;                // NUMA node id of each entry below
+    std::vector<std::vector<int>> node_cpus;  // allowed CPUs per NUMA node
+
+    size_t node_count() const { return node_cpus.size(); }
+    size_t cpu_count() const;
+};
+
+// Read from sysfs once; a single node with every allowed CPU if unavailable
+const Topology& topology();
+
+void configure(const config::PlacementConfig& placement_config);
+bool pinning_enabled();
+int acceptor_shards();
+
+// NUMA node serving one acceptor shard
+int node_for_shard(int shard);
+
+// Pin the calling thread to `node` (one core or the whole node, per
+// config) and prefer that node's memory. No-op when pinning is off.
+void place_current_thread(int node);
+
+std::string describe();
+
+} // namespace placement
+} // namespace caffis
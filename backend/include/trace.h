@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace caffis {
+namespace trace {
+
+// Sampled per-message lifecycle tracing. Spans are recorded into one ring
+// buffer per CPU (sessions are thread-per-connection, so per-thread rings
+// would cost a ring per sampled session) and exported on demand in Chrome
+// trace format (load the JSON in chrome://tracing or ui.perfetto.dev).
+//
+// With sampling off a TraceScope costs one relaxed atomic load and no clock
+// reads; Span is a no-op unless the current thread is inside a sampled trace.
+
+// sample_rate in [0, 1]; 0 disables tracing. One in 1/sample_rate roots
+// node-wide is sampled. ring_capacity is spans per CPU ring, fixed by the
+// first call that enables tracing.
+void configure(double sample_rate, size_t ring_capacity);
+bool enabled();
+
+// Root of one traced unit of work (a received frame, a join, ...).
+// Decides sampling and makes the trace current for nested Spans.
+class TraceScope {
+private:
+    uint64_t trace_id_ = 0;
+    uint64_t parent_trace_id_ = 0;
+    const char* name_;
+    int64_t start_us_ = 0;
+
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    bool sampled() const { return trace_id_ != 0; }
+};
+
+// Timed child span of the current trace
+class Span {
+private:
+    const char* name_;
+    int64_t start_us_ = 0;
+
+public:
+    explicit Span(const char* name);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+};
+
+// {"traceEvents":[...]} with every span still held in the ring buffers
+std::string export_chrome_json();
+
+} // namespace trace
+} // namespace caffis
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.h"
+
+namespace caffis {
+
+// Inbound traffic recording for replay (see traffic_replay.h).
+//
+//   header:  "CAFCAP\0\0" | u32 version | u32 flags | i64 start (unix us)
+//   record:  u8 kind | u32 session | u64 offset (us since start) | u32 length | payload
+//
+// Sessions are numbered in accept order. Auth tokens are always blanked;
+// with redact_content, message text and search queries keep their length
+// and word boundaries but every other character becomes 'x', and shared
+// places and geo queries keep their coordinates to two decimals (~1 km).
+// Binary frames keep only their size.
+struct CaptureRecord {
+    enum Kind : uint8_t {
+        OPEN = 1,    // payload: request target ("/?delivery=bulk")
+        TEXT = 2,    // payload: the (redacted) frame
+        BINARY = 3,  // payload: empty, length = frame size
+        USER = 4,    // payload: user id the session authenticated as
+        CLOSE = 5,
+    };
+
+    Kind kind = TEXT;
+    uint32_t session = 0;
+    uint64_t offset_us = 0;
+    uint32_t length = 0;
+    std::string payload;
+};
+
+class TrafficCapture {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t FLAG_CONTENT_REDACTED = 1;
+
+    ~TrafficCapture();
+
+    bool start(const config::CaptureConfig& capture_config);
+    void stop();
+    bool enabled() const { return active_.load(std::memory_order_relaxed); }
+
+    uint32_t open_session(const std::string& target);  // 0 when not capturing
+    void record_text(uint32_t session, const std::string& frame);
+    void record_binary(uint32_t session, size_t size);
+    void record_user(uint32_t session, const std::string& user_id);
+    void close_session(uint32_t session);
+
+    // Whole file, records in time order; false on a bad header
+    static bool load(const std::string& path, std::vector<CaptureRecord>& records, uint32_t& flags);
+
+private:
+    void write_record(CaptureRecord::Kind kind, uint32_t session, uint32_t length, const std::string& payload);
+    std::string redact(const std::string& frame) const;
+
+    config::CaptureConfig settings_;
+    std::mutex mutex_;
+    std::FILE* file_ = nullptr;
+    int64_t start_us_ = 0;
+    uint64_t written_bytes_ = 0;
+    uint32_t next_session_ = 1;
+    bool full_ = false;
+    std::atomic<bool> active_{false};
+};
+
+TrafficCapture& traffic_capture();
+
+} // namespace caffis
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+namespace caffis {
+
+// Replays a capture (see traffic_capture.h) against a running server:
+// one WebSocket client per captured session, every frame sent at its
+// captured offset divided by speed. Auth tokens are minted locally (HS256
+// with jwt_secret) for the captured user, or for users from users_path
+// mapped round-robin; room ids are mapped the same way from rooms_path.
+// Both lists must name rows that exist in the target's databases.
+//
+// Measured per operation, on the client side:
+//   auth          auth frame -> auth_success
+//   message_echo  message frame -> the sender's own new_message
+struct ReplayOptions {
+    std::string capture_path;
+    std::string host = "127.0.0.1";
+    std::string port = "5002";
+    double speed = 1.0;            // 2 = twice as fast, 0.5 = half speed
+    std::string users_path;        // one user id per line; empty = captured ids as is
+    std::string rooms_path;        // one room id per line; empty = captured ids as is
+    std::string jwt_secret;
+    int drain_seconds = 5;         // replies still counted after the last frame
+    std::string report_path;       // JSON latency summary of this run
+    std::string baseline_path;     // report of an earlier run to compare against
+};
+
+// 0 when the capture was replayed (whatever the server answered)
+int run_replay(const ReplayOptions& options);
+
+// HS256 token with {"id": user_id}, the shape the main app issues (replay and soak clients)
+std::string mint_test_token(const std::string& user_id, const std::string& jwt_secret);
+
+} // namespace caffis
@@ -2,10 +2,14 @@
 
 #include <boost/beast.hpp>
 #include <boost/asio.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <string>
+#include "config.h"
 
 namespace caffis {
 
@@ -15,6 +19,51 @@ class DatabaseManager;
 // Database initialization function
 void init_websocket_database(const std::string& connection_string);
 
+// Cross-node fan-out (call after init_websocket_database)
+void init_cluster_transport(const config::ClusterConfig& cluster_config);
+
+// User -> node directory for targeted delivery (call before init_cluster_transport)
+void init_session_directory(const config::ClusterConfig& cluster_config, const config::RedisConfig& redis_config);
+
+// Periodic + shutdown warm-restart snapshots of the hot caches (own connection)
+void init_state_snapshots(const std::string& connection_string, const config::SnapshotConfig& snapshot_config);
+
+// Message search: in-process index fed from the messages table (own connection)
+void init_search(const std::string& connection_string, const config::SearchConfig& search_config);
+
+// Nearby meetup rooms: in-process geo index fed from chat_rooms (own connection)
+void init_geo(const std::string& connection_string, const config::GeoConfig& geo_config);
+
+// Message retention: background compaction on its own connection
+void init_retention(const std::string& connection_string, const config::RetentionConfig& retention_config);
+
+// Per-recipient delivery receipts: acks counted in memory, statuses pushed to senders
+void init_delivery_receipts(const config::DeliveryConfig& delivery_config);
+
+// Per-room activity counters; last_activity and room_activity flushed in batches (own connection)
+void init_room_stats(const std::string& connection_string, const config::RoomStatsConfig& room_stats_config);
+
+// Hot-room detection from room stats; hot rooms get batched fan-out and sampled typing
+void init_hot_rooms(const config::HotRoomConfig& hot_room_config);
+
+// Offline push notifications: coalesced per user off the send path (own connection)
+void init_notifications(const std::string& connection_string, const config::NotificationConfig& notification_config);
+
+// Storage codec for large message bodies; loads the trained dictionaries (own connection)
+void init_content_codec(const std::string& connection_string, const config::ContentCodecConfig& codec_config);
+
+// Cold history archive: mmap reads for history pages, tiering job on its own connection
+void init_archive(const std::string& connection_string, const config::ArchiveConfig& archive_config);
+
+// Read-only REST history (/api/rooms, /api/rooms/<id>/messages) with ETag revalidation (own connection)
+void init_history_api(const std::string& connection_string, const config::HistoryApiConfig& history_config);
+
+// Admin HTTP routes (/admin/metrics, /admin/trace, /admin/memory) and lifecycle tracing
+void init_admin(const config::AdminConfig& admin_config);
+
+// Deliver a frame to every session of one user, on this node or the owning nodes
+bool send_to_user(const std::string& user_id, const std::string& frame);
+
 // JWT verification function
 bool verify_jwt_token(const std::string& token, std::string& user_id, std::string& username);
 
@@ -27,7 +76,18 @@ class WebSocketServer {
 private:
     boost::asio::io_context io_context_;
     std::vector<std::thread> thread_pool_;
+    std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> acceptors_;  // one per SO_REUSEPORT shard
+    std::atomic<bool> stopping_{false};
     int port_;
+    
+    // One thread per connection; stop() waits for them instead of leaving them behind
+    std::mutex session_threads_mutex_;
+    std::condition_variable session_threads_cv_;
+    size_t session_threads_ = 0;
+    
+    std::thread maintenance_thread_;
+    std::mutex maintenance_mutex_;
+    std::condition_variable maintenance_cv_;
 
 public:
     explicit WebSocketServer(int port);
@@ -49,6 +109,7 @@ public:
     
 private:
     // Session handling
+    void accept_loop(size_t shard);
     void handle_session(boost::beast::tcp_stream stream, const std::string& client_endpoint);
     
     // Performance monitoring
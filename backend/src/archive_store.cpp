@@ -0,0 +1,606 @@
+#include "../include/archive_store.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef CAFFIS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace caffis {
+
+ArchiveStore& archive() {
+    static ArchiveStore store;
+    return store;
+}
+
+namespace {
+
+const char SEGMENT_MAGIC[8] = {'C', 'A', 'F', 'A', 'R', 'C', 'H', '\0'};
+constexpr uint32_t SEGMENT_VERSION = 1;
+
+// Block flags column
+constexpr uint8_t FLAG_EDITED = 1;
+constexpr uint8_t FLAG_FILE = 2;
+constexpr uint8_t FLAG_METADATA = 4;
+
+// Largest block a reader will inflate; the index is trusted no further
+constexpr uint32_t MAX_BLOCK_RAW_BYTES = 64u * 1024 * 1024;
+
+struct BlockIndexEntry {
+    int64_t first_seq;
+    int64_t last_seq;
+    int64_t first_ms;
+    int64_t last_ms;
+    uint64_t offset;
+    uint32_t stored_size;
+    uint32_t raw_size;
+    uint32_t count;
+    uint8_t codec;
+    uint8_t reserved[3];
+};
+
+struct SegmentFooter {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_count;
+    uint64_t index_offset;
+    uint64_t message_count;
+};
+
+int64_t timestamp_ms(const Message& msg) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(msg.timestamp.time_since_epoch()).count();
+}
+
+// ------------------------------------------------
+// Column encoding
+// ------------------------------------------------
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void put_signed(std::string& out, int64_t value) {
+    put_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));  // zigzag
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+// Bounds-checked reader over one inflated block
+class BlockReader {
+private:
+    const char* cursor_;
+    const char* end_;
+
+public:
+    BlockReader(const char* data, size_t size) : cursor_(data), end_(data + size) {}
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (cursor_ == end_) {
+                throw std::runtime_error("truncated block");
+            }
+            uint8_t byte = static_cast<uint8_t>(*cursor_++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("bad varint");
+    }
+
+    int64_t signed_varint() {
+        uint64_t raw = varint();
+        return static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    }
+
+    uint8_t byte() {
+        if (cursor_ == end_) {
+            throw std::runtime_error("truncated block");
+        }
+        return static_cast<uint8_t>(*cursor_++);
+    }
+
+    std::string string() {
+        uint64_t size = varint();
+        if (size > static_cast<uint64_t>(end_ - cursor_)) {
+            throw std::runtime_error("truncated block");
+        }
+        std::string value(cursor_, size);
+        cursor_ += size;
+        return value;
+    }
+};
+
+std::string encode_block(const Message* messages, size_t count) {
+    std::string out;
+    put_varint(out, count);
+    for (size_t i = 0; i < count; ++i) {
+        put_signed(out, i == 0 ? messages[i].seq : messages[i].seq - messages[i - 1].seq);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        put_signed(out, i == 0 ? timestamp_ms(messages[i]) : timestamp_ms(messages[i]) - timestamp_ms(messages[i - 1]));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(static_cast<char>(messages[i].type));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const Message& msg = messages[i];
+        uint8_t flags = (msg.is_edited ? FLAG_EDITED : 0) | (msg.file_url.empty() ? 0 : FLAG_FILE)
+                      | (msg.metadata.empty() ? 0 : FLAG_METADATA);
+        out.push_back(static_cast<char>(flags));
+    }
+    for (size_t i = 0; i < count; ++i) put_string(out, messages[i].id);
+    for (size_t i = 0; i < count; ++i) put_string(out, messages[i].sender_id);
+    for (size_t i = 0; i < count; ++i) put_string(out, messages[i].content);
+    for (size_t i = 0; i < count; ++i) {
+        const Message& msg = messages[i];
+        if (!msg.file_url.empty()) {
+            put_string(out, msg.file_url);
+            put_string(out, msg.file_name);
+            put_string(out, msg.file_type);
+            put_varint(out, msg.file_size);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!messages[i].metadata.empty()) {
+            put_string(out, messages[i].metadata);
+        }
+    }
+    return out;
+}
+
+std::vector<Message> decode_block(const std::string& room_id, const char* data, size_t size) {
+    BlockReader reader(data, size);
+    size_t count = static_cast<size_t>(reader.varint());
+    if (count > size) {
+        throw std::runtime_error("bad block count");
+    }
+
+    std::vector<Message> messages(count);
+    int64_t seq = 0, millis = 0;
+    for (auto& msg : messages) {
+        seq += reader.signed_varint();
+        msg.seq = seq;
+        msg.room_id = room_id;
+    }
+    for (auto& msg : messages) {
+        millis += reader.signed_varint();
+        msg.timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(millis));
+    }
+    for (auto& msg : messages) msg.type = static_cast<MessageType>(reader.byte());
+    std::vector<uint8_t> flags(count);
+    for (auto& flag : flags) flag = reader.byte();
+    for (auto& msg : messages) msg.id = reader.string();
+    for (auto& msg : messages) msg.sender_id = reader.string();
+    for (auto& msg : messages) msg.content = reader.string();
+    for (size_t i = 0; i < count; ++i) {
+        messages[i].is_edited = (flags[i] & FLAG_EDITED) != 0;
+        if (flags[i] & FLAG_FILE) {
+            messages[i].file_url = reader.string();
+            messages[i].file_name = reader.string();
+            messages[i].file_type = reader.string();
+            messages[i].file_size = static_cast<size_t>(reader.varint());
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (flags[i] & FLAG_METADATA) {
+            messages[i].metadata = reader.string();
+        }
+    }
+    return messages;
+}
+
+// ------------------------------------------------
+// Block compression
+// ------------------------------------------------
+uint8_t compress_block(const std::string& raw, std::string& stored, int level) {
+#ifdef CAFFIS_HAVE_ZSTD
+    if (level > 0) {
+        stored.resize(ZSTD_compressBound(raw.size()));
+        size_t size = ZSTD_compress(&stored[0], stored.size(), raw.data(), raw.size(), level);
+        if (!ZSTD_isError(size) && size < raw.size()) {
+            stored.resize(size);
+            return ArchiveStore::CODEC_ZSTD;
+        }
+    }
+#else
+    (void)level;
+#endif
+    stored = raw;
+    return ArchiveStore::CODEC_NONE;
+}
+
+bool inflate_block(const BlockIndexEntry& entry, const char* stored, std::string& raw) {
+    if (entry.codec == ArchiveStore::CODEC_NONE) {
+        raw.assign(stored, entry.stored_size);
+        return true;
+    }
+#ifdef CAFFIS_HAVE_ZSTD
+    if (entry.codec == ArchiveStore::CODEC_ZSTD) {
+        unsigned long long frame_size = ZSTD_getFrameContentSize(stored, entry.stored_size);
+        if (entry.raw_size > MAX_BLOCK_RAW_BYTES || frame_size != entry.raw_size) {
+            return false;
+        }
+        raw.resize(entry.raw_size);
+        size_t size = ZSTD_decompress(&raw[0], raw.size(), stored, entry.stored_size);
+        return !ZSTD_isError(size) && size == entry.raw_size;
+    }
+#endif
+    return false;
+}
+
+bool write_all(int fd, const std::string& bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// Mapped segment; the index is read in place
+struct ArchiveStore::Segment {
+    const char* data = nullptr;
+    size_t size = 0;
+    uint32_t block_count = 0;
+    uint64_t index_offset = 0;
+
+    BlockIndexEntry block(uint32_t i) const {
+        BlockIndexEntry entry;
+        std::memcpy(&entry, data + index_offset + i * sizeof(BlockIndexEntry), sizeof(entry));
+        return entry;
+    }
+
+    ~Segment() {
+        if (data) {
+            ::munmap(const_cast<char*>(data), size);
+        }
+    }
+};
+
+bool ArchiveStore::compression_available() {
+#ifdef CAFFIS_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Room ids become directory names: UUID characters only
+bool ArchiveStore::valid_room_id(const std::string& room_id) {
+    if (room_id.empty() || room_id.size() > 64) {
+        return false;
+    }
+    for (char c : room_id) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || c == '-';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ArchiveStore::configure(const config::ArchiveConfig& archive_config) {
+    settings_ = archive_config;
+    root_.clear();
+    if (archive_config.path.empty()) {
+        std::cout << "🧊 History archive: disabled" << std::endl;
+        return false;
+    }
+    if (::mkdir(archive_config.path.c_str(), 0750) != 0 && errno != EEXIST) {
+        std::cerr << "❌ Cannot create archive at " << archive_config.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    root_ = archive_config.path;
+    std::cout << "✅ History archive: " << root_ << " ("
+              << (compression_available() && settings_.zstd_level > 0 ? "zstd level " + std::to_string(settings_.zstd_level)
+                                                                      : std::string("uncompressed"))
+              << ")" << std::endl;
+    return true;
+}
+
+// ================================================
+// WRITING
+// ================================================
+bool ArchiveStore::write_segment(const std::string& room_id, const std::vector<Message>& messages) {
+    static auto& segments_written = metrics::counter("caffis_archive_segments_written_total");
+    static auto& messages_archived = metrics::counter("caffis_archive_messages_total");
+    static auto& raw_bytes = metrics::counter("caffis_archive_raw_bytes_total");
+    static auto& stored_bytes = metrics::counter("caffis_archive_stored_bytes_total");
+
+    if (!enabled() || !valid_room_id(room_id) || messages.empty()) {
+        return false;
+    }
+
+    std::string room_dir = root_ + "/" + room_id;
+    if (::mkdir(room_dir.c_str(), 0750) != 0 && errno != EEXIST) {
+        std::cerr << "❌ Cannot create archive room directory: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Blocks, then the index, then the footer
+    const size_t block_messages = static_cast<size_t>(std::max(16, settings_.block_messages));
+    std::string file;
+    std::vector<BlockIndexEntry> index;
+    uint64_t raw_total = 0;
+    for (size_t begin = 0; begin < messages.size(); begin += block_messages) {
+        size_t count = std::min(block_messages, messages.size() - begin);
+        std::string raw = encode_block(&messages[begin], count);
+        std::string stored;
+        uint8_t codec = compress_block(raw, stored, settings_.zstd_level);
+
+        BlockIndexEntry entry{};
+        entry.first_seq = messages[begin].seq;
+        entry.last_seq = messages[begin + count - 1].seq;
+        entry.first_ms = timestamp_ms(messages[begin]);
+        entry.last_ms = timestamp_ms(messages[begin + count - 1]);
+        entry.offset = file.size();
+        entry.stored_size = static_cast<uint32_t>(stored.size());
+        entry.raw_size = static_cast<uint32_t>(raw.size());
+        entry.count = static_cast<uint32_t>(count);
+        entry.codec = codec;
+        index.push_back(entry);
+
+        file += stored;
+        raw_total += raw.size();
+    }
+    file.resize((file.size() + 7) & ~size_t{7});  // index starts 8-aligned
+
+    SegmentFooter footer{};
+    std::memcpy(footer.magic, SEGMENT_MAGIC, sizeof(footer.magic));
+    footer.version = SEGMENT_VERSION;
+    footer.block_count = static_cast<uint32_t>(index.size());
+    footer.index_offset = file.size();
+    footer.message_count = messages.size();
+    file.append(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(BlockIndexEntry));
+    file.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "%020" PRId64 "-%020" PRId64 ".seg", messages.front().seq, messages.back().seq);
+    std::string path = room_dir + "/" + name;
+    std::string tmp_path = path + ".tmp";
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0 || !write_all(fd, file) || ::fsync(fd) != 0) {
+        std::cerr << "❌ Archive segment write failed: " << std::strerror(errno) << std::endl;
+        if (fd >= 0) ::close(fd);
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    ::close(fd);
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "❌ Archive segment rename failed: " << std::strerror(errno) << std::endl;
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    int dir_fd = ::open(room_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        ::fsync(dir_fd);  // the rename must survive a crash before the rows are deleted
+        ::close(dir_fd);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listings_.erase(room_id);
+    }
+    segments_written.inc();
+    messages_archived.inc(messages.size());
+    raw_bytes.inc(raw_total);
+    stored_bytes.inc(file.size());
+    return true;
+}
+
+// ================================================
+// READING
+// ================================================
+std::vector<ArchiveStore::SegmentRef> ArchiveStore::list_segments(const std::string& room_id) {
+    // Coarse mtime clocks (NFS, some filesystems): a listing taken within
+    // this long after the last change may have missed a second one in the
+    // same tick, so it is not trusted
+    static constexpr int64_t MTIME_SLACK_NS = 2000000000LL;
+
+    std::string room_dir = root_ + "/" + room_id;
+    struct stat dir_stat;
+    int64_t dir_mtime_ns = -1;
+    if (::stat(room_dir.c_str(), &dir_stat) == 0) {
+        dir_mtime_ns = static_cast<int64_t>(dir_stat.st_mtim.tv_sec) * 1000000000LL + dir_stat.st_mtim.tv_nsec;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cached = listings_.find(room_id);
+        if (cached != listings_.end() && cached->second.dir_mtime_ns == dir_mtime_ns
+            && cached->second.listed_at_ns - dir_mtime_ns > MTIME_SLACK_NS) {
+            return cached->second.segments;
+        }
+    }
+
+    const int64_t listed_at_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<SegmentRef> segments;
+    if (DIR* dir = ::opendir(room_dir.c_str())) {
+        while (dirent* entry = ::readdir(dir)) {
+            SegmentRef ref;
+            char suffix[8] = {};
+            if (std::sscanf(entry->d_name, "%" SCNd64 "-%" SCNd64 ".%4s", &ref.first_seq, &ref.last_seq, suffix) == 3
+                && std::strcmp(suffix, "seg") == 0) {
+                ref.path = room_dir + "/" + entry->d_name;
+                segments.push_back(std::move(ref));
+            }
+        }
+        ::closedir(dir);
+    }
+    std::sort(segments.begin(), segments.end(),
+              [](const SegmentRef& a, const SegmentRef& b) { return a.first_seq < b.first_seq; });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    listings_[room_id] = Listing{segments, dir_mtime_ns, listed_at_ns};
+    return segments;
+}
+
+std::shared_ptr<const ArchiveStore::Segment> ArchiveStore::open_segment(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = open_.find(path);
+        if (it != open_.end()) {
+            return it->second;
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentFooter)) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* mapped = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto segment = std::make_shared<Segment>();
+    segment->data = static_cast<const char*>(mapped);
+    segment->size = static_cast<size_t>(st.st_size);
+
+    SegmentFooter footer;
+    std::memcpy(&footer, segment->data + segment->size - sizeof(footer), sizeof(footer));
+    uint64_t index_bytes = static_cast<uint64_t>(footer.block_count) * sizeof(BlockIndexEntry);
+    if (std::memcmp(footer.magic, SEGMENT_MAGIC, sizeof(footer.magic)) != 0 || footer.version != SEGMENT_VERSION
+        || footer.index_offset + index_bytes + sizeof(footer) != segment->size) {
+        std::cerr << "⚠️ Ignoring damaged archive segment " << path << std::endl;
+        return nullptr;
+    }
+    segment->block_count = footer.block_count;
+    segment->index_offset = footer.index_offset;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.size() >= MAX_OPEN_SEGMENTS) {
+        open_.erase(open_.begin());  // readers still holding it keep the mapping alive
+    }
+    open_[path] = segment;
+    return segment;
+}
+
+std::vector<Message> ArchiveStore::read(const std::string& room_id, int64_t before_seq, size_t limit) {
+    static auto& reads = metrics::counter("caffis_archive_reads_total");
+    static auto& read_messages = metrics::counter("caffis_archive_read_messages_total");
+    static auto& latency = metrics::histogram("caffis_archive_read_latency_us");
+
+    std::vector<Message> page;  // newest first
+    if (!enabled() || !valid_room_id(room_id) || limit == 0) {
+        return page;
+    }
+    if (before_seq <= 0) {
+        before_seq = INT64_MAX;
+    }
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<SegmentRef> segments = list_segments(room_id);
+    std::string raw;
+    for (auto ref = segments.rbegin(); ref != segments.rend() && page.size() < limit; ++ref) {
+        if (ref->first_seq >= before_seq) {
+            continue;
+        }
+        auto segment = open_segment(ref->path);
+        if (!segment) {
+            continue;
+        }
+
+        // Sparse index: last block starting below the cursor, then walk back
+        uint32_t lo = 0, hi = segment->block_count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (segment->block(mid).first_seq < before_seq) lo = mid + 1; else hi = mid;
+        }
+        for (uint32_t b = lo; b-- > 0 && page.size() < limit;) {
+            BlockIndexEntry entry = segment->block(b);
+            if (entry.offset + entry.stored_size > segment->index_offset
+                || !inflate_block(entry, segment->data + entry.offset, raw)) {
+                std::cerr << "⚠️ Unreadable archive block " << b << " in " << ref->path << std::endl;
+                continue;
+            }
+            try {
+                std::vector<Message> block = decode_block(room_id, raw.data(), raw.size());
+                for (auto msg = block.rbegin(); msg != block.rend() && page.size() < limit; ++msg) {
+                    if (msg->seq < before_seq) {
+                        page.push_back(std::move(*msg));
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "⚠️ Bad archive block " << b << " in " << ref->path << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    reads.inc();
+    read_messages.inc(page.size());
+    latency.observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count()));
+    return page;
+}
+
+int64_t ArchiveStore::last_archived_seq(const std::string& room_id) {
+    if (!enabled() || !valid_room_id(room_id)) {
+        return 0;
+    }
+    std::vector<SegmentRef> segments = list_segments(room_id);
+    return segments.empty() ? 0 : segments.back().last_seq;
+}
+
+std::vector<std::string> ArchiveStore::last_segment_ids(const std::string& room_id) {
+    std::vector<std::string> ids;
+    if (!enabled() || !valid_room_id(room_id)) {
+        return ids;
+    }
+    std::vector<SegmentRef> segments = list_segments(room_id);
+    auto segment = segments.empty() ? nullptr : open_segment(segments.back().path);
+    if (!segment) {
+        return ids;
+    }
+
+    std::string raw;
+    for (uint32_t b = 0; b < segment->block_count; ++b) {
+        BlockIndexEntry entry = segment->block(b);
+        if (entry.offset + entry.stored_size > segment->index_offset
+            || !inflate_block(entry, segment->data + entry.offset, raw)) {
+            continue;
+        }
+        try {
+            for (auto& msg : decode_block(room_id, raw.data(), raw.size())) {
+                ids.push_back(std::move(msg.id));
+            }
+        } catch (const std::exception&) {
+            // damaged block: its rows stay in the DB, which is the safe side
+        }
+    }
+    return ids;
+}
+
+} // namespace caffis
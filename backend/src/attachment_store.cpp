@@ -0,0 +1,343 @@
+#include "../include/attachment_store.h"
+#include "../include/metrics.h"
+#include <openssl/evp.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace caffis {
+
+AttachmentStore& attachments() {
+    static AttachmentStore store;
+    return store;
+}
+
+AttachmentUpload::~AttachmentUpload() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+namespace {
+
+bool make_dir(const std::string& path) {
+    return ::mkdir(path.c_str(), 0750) == 0 || errno == EEXIST;
+}
+
+// Names end up in Content-Disposition: keep them to one safe line
+std::string sanitize_file_name(const std::string& name) {
+    std::string clean;
+    for (unsigned char c : name) {
+        if (c < 0x20 || c == '"' || c == '/' || c == '\\' || c == 0x7F) {
+            continue;
+        }
+        clean.push_back(static_cast<char>(c));
+    }
+    if (clean.size() > 255) {
+        clean.resize(255);
+    }
+    return clean.empty() ? "file" : clean;
+}
+
+std::string sanitize_content_type(const std::string& type) {
+    if (type.empty() || type.size() > 100) {
+        return "application/octet-stream";
+    }
+    for (char c : type) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+               || c == '/' || c == '.' || c == '+' || c == '-';
+        if (!ok) {
+            return "application/octet-stream";
+        }
+    }
+    return type;
+}
+
+// Streamed SHA-256 of a file, lowercase hex; empty on error
+std::string sha256_file(int fd) {
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx || EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
+        EVP_MD_CTX_free(ctx);
+        return "";
+    }
+
+    char buffer[64 * 1024];
+    off_t offset = 0;
+    for (;;) {
+        ssize_t n = ::pread(fd, buffer, sizeof(buffer), offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            EVP_MD_CTX_free(ctx);
+            return "";
+        }
+        if (n == 0) break;
+        EVP_DigestUpdate(ctx, buffer, static_cast<size_t>(n));
+        offset += n;
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    EVP_DigestFinal_ex(ctx, digest, &digest_len);
+    EVP_MD_CTX_free(ctx);
+
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    for (unsigned int i = 0; i < digest_len; ++i) {
+        out.push_back(hex[digest[i] >> 4]);
+        out.push_back(hex[digest[i] & 0xF]);
+    }
+    return out;
+}
+
+} // namespace
+
+bool AttachmentStore::valid_hash(const std::string& hash) {
+    if (hash.size() != 64) {
+        return false;
+    }
+    for (char c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AttachmentStore::valid_upload_id(const std::string& upload_id) {
+    if (upload_id.size() < 8 || upload_id.size() > 64) {
+        return false;
+    }
+    for (char c : upload_id) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AttachmentStore::configure(const config::AttachmentConfig& attachment_config) {
+    settings_ = attachment_config;
+    root_.clear();
+    if (attachment_config.store_path.empty()) {
+        std::cout << "📎 Attachments: disabled" << std::endl;
+        return false;
+    }
+
+    const std::string& root = attachment_config.store_path;
+    if (!make_dir(root) || !make_dir(root + "/staging") || !make_dir(root + "/objects")) {
+        std::cerr << "❌ Cannot create attachment store at " << root << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    root_ = root;
+    std::cout << "✅ Attachments: " << root_ << " (max " << settings_.max_file_bytes / (1024 * 1024) << " MB per file)" << std::endl;
+    return true;
+}
+
+std::string AttachmentStore::object_path(const std::string& hash) const {
+    return root_ + "/objects/" + hash.substr(0, 2) + "/" + hash;
+}
+
+// ================================================
+// UPLOADS
+// ================================================
+bool AttachmentStore::begin_upload(const std::string& user_id, const std::string& upload_id, uint64_t expected_size,
+                                   const std::string& file_name, const std::string& content_type,
+                                   AttachmentUpload& upload, std::string& error) {
+    if (!enabled()) {
+        error = "Attachments not available";
+        return false;
+    }
+    if (!valid_upload_id(upload_id)) {
+        error = "Invalid upload ID";
+        return false;
+    }
+    if (expected_size == 0 || expected_size > settings_.max_file_bytes) {
+        error = "File size must be between 1 and " + std::to_string(settings_.max_file_bytes) + " bytes";
+        return false;
+    }
+
+    // Scoped by user so one client can't append to another's upload
+    std::string path = root_ + "/staging/" + user_id + "-" + upload_id;
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        error = "Cannot open upload";
+        std::cerr << "❌ Attachment staging open failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st {};
+    ::fstat(fd, &st);
+    uint64_t offset = static_cast<uint64_t>(st.st_size);
+    if (offset > expected_size) {
+        // Stale partial for a different file under the same id: start over
+        if (::ftruncate(fd, 0) != 0) {
+            ::close(fd);
+            error = "Cannot reset upload";
+            return false;
+        }
+        offset = 0;
+    }
+
+    if (upload.fd >= 0) {
+        ::close(upload.fd);
+    }
+    upload.upload_id = upload_id;
+    upload.staging_path = path;
+    upload.file_name = sanitize_file_name(file_name);
+    upload.content_type = sanitize_content_type(content_type);
+    upload.expected_size = expected_size;
+    upload.offset = offset;
+    upload.fd = fd;
+    return true;
+}
+
+bool AttachmentStore::append(AttachmentUpload& upload, const void* data, size_t size, std::string& error) {
+    static auto& bytes_in = metrics::counter("caffis_attachment_upload_bytes_total");
+
+    if (upload.fd < 0) {
+        error = "No upload in progress";
+        return false;
+    }
+    if (size > settings_.max_chunk_bytes) {
+        error = "Chunk larger than " + std::to_string(settings_.max_chunk_bytes) + " bytes";
+        return false;
+    }
+    if (upload.offset + size > upload.expected_size) {
+        error = "Upload exceeds declared size";
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = ::pwrite(upload.fd, bytes + written, size - written, static_cast<off_t>(upload.offset + written));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = "Write failed";
+            std::cerr << "❌ Attachment write failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    upload.offset += size;
+    bytes_in.inc(size);
+    return true;
+}
+
+bool AttachmentStore::finish(AttachmentUpload& upload, AttachmentInfo& info, std::string& error) {
+    static auto& stored = metrics::counter("caffis_attachments_stored_total");
+    static auto& deduplicated = metrics::counter("caffis_attachments_deduplicated_total");
+
+    if (upload.fd < 0 || upload.offset != upload.expected_size) {
+        error = "Upload incomplete";
+        return false;
+    }
+
+    int read_fd = ::open(upload.staging_path.c_str(), O_RDONLY | O_CLOEXEC);
+    std::string hash = read_fd >= 0 ? sha256_file(read_fd) : "";
+    if (read_fd >= 0) {
+        ::close(read_fd);
+    }
+    if (hash.empty()) {
+        error = "Cannot hash upload";
+        return false;
+    }
+
+    ::fsync(upload.fd);
+    ::close(upload.fd);
+    upload.fd = -1;
+
+    std::string dir = root_ + "/objects/" + hash.substr(0, 2);
+    std::string path = object_path(hash);
+    struct stat st {};
+    if (::stat(path.c_str(), &st) == 0) {
+        ::unlink(upload.staging_path.c_str());  // already stored
+        deduplicated.inc();
+    } else {
+        if (!make_dir(dir) || std::rename(upload.staging_path.c_str(), path.c_str()) != 0) {
+            error = "Cannot store upload";
+            std::cerr << "❌ Attachment store failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        std::ofstream meta(path + ".meta", std::ios::trunc);
+        meta << upload.content_type << "\n" << upload.file_name << "\n";
+        stored.inc();
+    }
+
+    info.hash = hash;
+    info.size = upload.expected_size;
+    info.content_type = upload.content_type;
+    info.file_name = upload.file_name;
+    return true;
+}
+
+void AttachmentStore::cancel(AttachmentUpload& upload) {
+    if (upload.fd >= 0) {
+        ::close(upload.fd);
+        upload.fd = -1;
+    }
+    if (!upload.staging_path.empty()) {
+        ::unlink(upload.staging_path.c_str());
+    }
+}
+
+// ================================================
+// LOOKUPS AND MAINTENANCE
+// ================================================
+bool AttachmentStore::stat(const std::string& hash, AttachmentInfo& info) const {
+    if (!enabled() || !valid_hash(hash)) {
+        return false;
+    }
+    std::string path = object_path(hash);
+    struct stat st {};
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    info.hash = hash;
+    info.size = static_cast<uint64_t>(st.st_size);
+    std::ifstream meta(path + ".meta");
+    if (!std::getline(meta, info.content_type) || info.content_type.empty()) {
+        info.content_type = "application/octet-stream";
+    }
+    if (!std::getline(meta, info.file_name) || info.file_name.empty()) {
+        info.file_name = hash;
+    }
+    return true;
+}
+
+size_t AttachmentStore::sweep_staging() {
+    if (!enabled()) {
+        return 0;
+    }
+    std::string staging = root_ + "/staging";
+    DIR* dir = ::opendir(staging.c_str());
+    if (!dir) {
+        return 0;
+    }
+
+    const time_t cutoff = ::time(nullptr) - static_cast<time_t>(settings_.staging_ttl_hours) * 3600;
+    size_t removed = 0;
+    while (dirent* entry = ::readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = staging + "/" + entry->d_name;
+        struct stat st {};
+        if (::stat(path.c_str(), &st) == 0 && st.st_mtime < cutoff && ::unlink(path.c_str()) == 0) {
+            removed++;
+        }
+    }
+    ::closedir(dir);
+    return removed;
+}
+
+} // namespace caffis
@@ -0,0 +1,577 @@
+#include "../include/cluster_transport.h"
+#include "../include/database_manager.h"
+#include "../include/intern_table.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace caffis {
+
+namespace {
+
+bool parse_int64(const std::string& text, int64_t& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end && ptr != text.data();
+}
+
+// Columns deliver_row() expects
+const char* const MESSAGE_COLUMNS =
+    "m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.message_type, m.seq, "
+    "m.file_url, m.file_name, m.file_size, m.file_type, m.metadata, "
+    "(EXTRACT(EPOCH FROM m.created_at) * 1000)::bigint AS created_ms, "
+    "u.username, u.display_name ";
+
+} // namespace
+
+// ================================================
+// LISTEN RECEIVER (one per room channel, plus this node's direct channel)
+// ================================================
+class PgNotifyTransport::ChannelReceiver : public pqxx::notification_receiver {
+private:
+    PgNotifyTransport& owner_;
+    bool direct_;
+
+public:
+    ChannelReceiver(PgNotifyTransport& owner, pqxx::connection_base& connection,
+                    const std::string& channel, bool direct)
+        : pqxx::notification_receiver(connection, channel), owner_(owner), direct_(direct) {}
+
+    void operator()(const std::string& payload, int /*backend_pid*/) override {
+        if (direct_) {
+            owner_.on_direct(payload);
+        } else {
+            owner_.on_notification(payload);
+        }
+    }
+};
+
+PgNotifyTransport::PgNotifyTransport(const std::string& connection_string, const std::string& node_id)
+    : connection_string_(connection_string), node_id_(node_id) {
+    std::cout << "🛰️ PgNotifyTransport initialized for node " << node_id_ << std::endl;
+}
+
+PgNotifyTransport::~PgNotifyTransport() {
+    stop();
+}
+
+std::string PgNotifyTransport::room_channel(const std::string& room_id) {
+    std::string channel = "chat_room_";
+    for (char c : room_id) {
+        if (c != '-') channel.push_back(c);
+    }
+    return channel;
+}
+
+std::string PgNotifyTransport::node_channel(const std::string& node_id) {
+    std::string channel = "chat_node_";
+    for (char c : node_id) {
+        bool plain = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        else if (!plain) c = '_';
+        channel.push_back(c);
+    }
+    return channel.substr(0, 63);
+}
+
+std::string PgNotifyTransport::encode_payload(const std::string& room_id, int64_t seq,
+                                              const std::string& node_id, int64_t sent_at_us) {
+    return room_id + "," + std::to_string(seq) + "," + node_id + "," + std::to_string(sent_at_us);
+}
+
+bool PgNotifyTransport::start(DeliveryCallback deliver, DirectCallback direct, RoomFrameCallback room_frame) {
+    if (running_) {
+        return true;
+    }
+    deliver_ = std::move(deliver);
+    direct_ = std::move(direct);
+    room_frame_ = std::move(room_frame);
+    running_ = true;
+    listener_ = std::thread([this]() { run(); });
+    std::cout << "✅ Cluster transport started: " << name() << std::endl;
+    return true;
+}
+
+void PgNotifyTransport::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    if (listener_.joinable()) {
+        listener_.join();
+    }
+    std::cout << "🛰️ Cluster transport stopped: " << name() << std::endl;
+}
+
+void PgNotifyTransport::subscribe_room(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+    if (room_refcounts_[room_id]++ == 0) {
+        pending_listen_.push_back(room_id);
+    }
+}
+
+void PgNotifyTransport::unsubscribe_room(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+    auto it = room_refcounts_.find(room_id);
+    if (it == room_refcounts_.end()) {
+        return;
+    }
+    if (--it->second <= 0) {
+        room_refcounts_.erase(it);
+        pending_unlisten_.push_back(room_id);
+    }
+}
+
+void PgNotifyTransport::publish(const Message& message, const std::string& /*sender_name*/) {
+    // NOTIFY is issued by the persistence transaction itself. The id is kept
+    // so a catch-up pull doesn't hand this node its own message again.
+    std::lock_guard<std::mutex> lock(published_mutex_);
+    if (published_order_.size() < MAX_CATCH_UP_ROWS) {
+        published_order_.push_back(message.id);
+    } else {
+        published_ids_.erase(published_order_[published_next_]);
+        published_order_[published_next_] = message.id;
+        published_next_ = (published_next_ + 1) % MAX_CATCH_UP_ROWS;
+    }
+    published_ids_.insert(message.id);
+}
+
+bool PgNotifyTransport::publish_room_frame(const std::string& room_id, const std::string& author_id,
+                                           const std::string& frame, const std::string& fallback_frame) {
+    static auto& sent = metrics::counter("caffis_cluster_room_frames_sent_total{transport=\"pg_notify\"}");
+    static auto& fallbacks = metrics::counter("caffis_cluster_room_frame_fallbacks_total{transport=\"pg_notify\"}");
+
+    std::string header = "F\n" + node_id_ + "\n" + room_id + "\n" + author_id + "\n";
+    std::string payload = header + frame;
+    if (payload.size() > MAX_NOTIFY_PAYLOAD) {
+        // The change is already committed, so the other nodes still hear about it
+        payload = header + fallback_frame;
+        if (fallback_frame.empty() || payload.size() > MAX_NOTIFY_PAYLOAD) {
+            std::cerr << "⚠️ Room frame too large for NOTIFY (" << header.size() + frame.size() << " bytes)" << std::endl;
+            return false;
+        }
+        fallbacks.inc();
+    }
+
+    if (!notify(room_channel(room_id), payload)) {
+        return false;
+    }
+    sent.inc();
+    return true;
+}
+
+bool PgNotifyTransport::send_to_node(const std::string& node_id, const std::string& user_id,
+                                     const std::string& frame) {
+    static auto& sent = metrics::counter("caffis_cluster_direct_sent_total{transport=\"pg_notify\"}");
+
+    std::string payload = user_id + "\n" + frame;
+    if (payload.size() > MAX_NOTIFY_PAYLOAD) {
+        std::cerr << "⚠️ Direct frame too large for NOTIFY (" << payload.size() << " bytes)" << std::endl;
+        return false;
+    }
+
+    if (!notify(node_channel(node_id), payload)) {
+        return false;
+    }
+    sent.inc();
+    return true;
+}
+
+bool PgNotifyTransport::notify(const std::string& channel, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(notify_mutex_);
+    try {
+        if (!notify_connection_ || !notify_connection_->is_open()) {
+            notify_connection_ = std::make_unique<pqxx::connection>(connection_string_);
+        }
+        pqxx::nontransaction txn(*notify_connection_);
+        txn.exec_params("SELECT pg_notify($1, $2)", channel, payload);
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "❌ NOTIFY on " << channel << " failed: " << e.what() << std::endl;
+        notify_connection_.reset();
+        return false;
+    }
+}
+
+// ================================================
+// LISTENER THREAD
+// ================================================
+bool PgNotifyTransport::ensure_connected() {
+    if (connection_ && connection_->is_open()) {
+        return true;
+    }
+
+    try {
+        receivers_.clear();
+        node_receiver_.reset();
+        connection_ = std::make_unique<pqxx::connection>(connection_string_);
+        node_receiver_ = std::make_unique<ChannelReceiver>(*this, *connection_, node_channel(node_id_), true);
+
+        // Re-LISTEN every room we still hold after a reconnect, and pull
+        // whatever they missed meanwhile
+        std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+        pending_listen_.clear();
+        pending_unlisten_.clear();
+        for (const auto& [room_id, refs] : room_refcounts_) {
+            pending_listen_.push_back(room_id);
+        }
+        for (auto it = last_seen_seq_.begin(); it != last_seen_seq_.end();) {
+            it = room_refcounts_.count(it->first) ? std::next(it) : last_seen_seq_.erase(it);
+        }
+        catch_up_pending_ = !last_seen_seq_.empty();
+        std::cout << "✅ Cluster LISTEN connection established" << std::endl;
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Cluster LISTEN connection failed: " << e.what() << std::endl;
+        connection_.reset();
+        return false;
+    }
+}
+
+void PgNotifyTransport::apply_subscription_changes() {
+    std::vector<std::string> to_listen, to_unlisten;
+    {
+        std::lock_guard<std::mutex> lock(subscriptions_mutex_);
+        to_listen.swap(pending_listen_);
+        to_unlisten.swap(pending_unlisten_);
+    }
+
+    for (const auto& room_id : to_unlisten) {
+        receivers_.erase(room_id);
+        last_seen_seq_.erase(room_id);
+    }
+    for (const auto& room_id : to_listen) {
+        if (!receivers_.count(room_id)) {
+            receivers_[room_id] = std::make_unique<ChannelReceiver>(*this, *connection_, room_channel(room_id), false);
+        }
+    }
+    // After the LISTEN: anything newer than the baseline arrives as a NOTIFY
+    record_baselines(to_listen);
+}
+
+void PgNotifyTransport::record_baselines(const std::vector<std::string>& room_ids) {
+    std::unordered_map<std::string, std::string> keys;  // canonical uuid -> room id as subscribed
+    std::string room_array;
+    for (const auto& room_id : room_ids) {
+        Uuid128 uuid;
+        if (last_seen_seq_.count(room_id) || !Uuid128::parse(room_id, uuid)) {
+            continue;
+        }
+        room_array += (room_array.empty() ? "{" : ",") + uuid.to_string();
+        keys.emplace(uuid.to_string(), room_id);
+    }
+    if (keys.empty()) {
+        return;
+    }
+    room_array += "}";
+
+    pqxx::nontransaction txn(*connection_);
+    pqxx::result result = txn.exec_params(
+        "SELECT room_id, MAX(seq) AS seq FROM messages WHERE room_id = ANY($1::uuid[]) GROUP BY room_id",
+        room_array);
+
+    for (const auto& [uuid, room_id] : keys) {
+        last_seen_seq_[room_id] = 0;
+    }
+    for (const auto& row : result) {
+        auto key = keys.find(row["room_id"].c_str());
+        if (key != keys.end()) {
+            last_seen_seq_[key->second] = row["seq"].as<int64_t>();
+        }
+    }
+}
+
+void PgNotifyTransport::on_notification(const std::string& payload) {
+    static auto& received = metrics::counter("caffis_cluster_notifications_total{transport=\"pg_notify\"}");
+
+    if (payload.compare(0, 2, "F\n") == 0) {
+        on_room_frame(payload);
+        return;
+    }
+
+    std::vector<std::string> fields;
+    std::stringstream ss(payload);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        fields.push_back(field);
+    }
+    PendingNotice notice;
+    if (fields.size() != 4 || !parse_int64(fields[1], notice.seq) || !parse_int64(fields[3], notice.sent_at_us)) {
+        std::cerr << "⚠️ Malformed cluster notification: " << payload << std::endl;
+        return;
+    }
+    notice.room_id = fields[0];
+
+    auto seen = last_seen_seq_.find(notice.room_id);
+    if (seen != last_seen_seq_.end()) {
+        seen->second = std::max(seen->second, notice.seq);
+    }
+
+    // Our own messages were already broadcast locally; the last catch-up
+    // may have delivered this one already
+    if (fields[2] == node_id_ || caught_up_seqs_.count(notice.seq)) {
+        return;
+    }
+
+    received.inc();
+    pending_notices_.push_back(std::move(notice));
+}
+
+void PgNotifyTransport::on_direct(const std::string& payload) {
+    static auto& received = metrics::counter("caffis_cluster_direct_received_total{transport=\"pg_notify\"}");
+
+    size_t split = payload.find('\n');
+    if (split == std::string::npos) {
+        std::cerr << "⚠️ Malformed direct notification" << std::endl;
+        return;
+    }
+    received.inc();
+    if (direct_) {
+        direct_(payload.substr(0, split), payload.substr(split + 1));
+    }
+}
+
+void PgNotifyTransport::on_room_frame(const std::string& payload) {
+    static auto& received = metrics::counter("caffis_cluster_room_frames_received_total{transport=\"pg_notify\"}");
+
+    size_t node_end = payload.find('\n', 2);
+    size_t room_end = node_end == std::string::npos ? node_end : payload.find('\n', node_end + 1);
+    size_t author_end = room_end == std::string::npos ? room_end : payload.find('\n', room_end + 1);
+    if (author_end == std::string::npos) {
+        std::cerr << "⚠️ Malformed room frame notification" << std::endl;
+        return;
+    }
+    // Our own frames were already broadcast locally
+    if (payload.compare(2, node_end - 2, node_id_) == 0) {
+        return;
+    }
+
+    received.inc();
+    if (room_frame_) {
+        room_frame_(payload.substr(node_end + 1, room_end - node_end - 1),
+                    payload.substr(room_end + 1, author_end - room_end - 1), payload.substr(author_end + 1));
+    }
+}
+
+int64_t PgNotifyTransport::deliver_row(const pqxx::row& row) {
+    Message msg;
+    msg.id = row["id"].c_str();
+    msg.room_id = row["room_id"].c_str();
+    msg.sender_id = row["sender_id"].c_str();
+    msg.seq = row["seq"].as<int64_t>();
+    try {
+        msg.content = DatabaseManager::row_content(row);
+    } catch (const std::exception& e) {
+        // Retrying can't fix it, and a blank body must not go out: the room's
+        // history fetch reports the error instead
+        std::cerr << "⚠️ Cluster delivery skipped: " << e.what() << std::endl;
+        return msg.seq;
+    }
+    msg.type = message_type_from_string(row["message_type"].c_str());
+    msg.file_url = row["file_url"].c_str();
+    msg.file_name = row["file_name"].c_str();
+    msg.file_size = row["file_size"].as<size_t>(0);
+    msg.file_type = row["file_type"].c_str();
+    msg.metadata = row["metadata"].c_str();
+    msg.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(row["created_ms"].as<int64_t>()));
+
+    std::string display_name = row["display_name"].c_str();
+    std::string sender_name = display_name.empty() ? row["username"].c_str() : display_name;
+
+    if (deliver_) {
+        deliver_(msg, sender_name);
+    }
+    return msg.seq;
+}
+
+void PgNotifyTransport::remember_delivered(int64_t seq) {
+    if (delivered_order_.size() < MAX_CATCH_UP_ROWS) {
+        delivered_order_.push_back(seq);
+    } else {
+        delivered_seqs_.erase(delivered_order_[delivered_next_]);
+        delivered_order_[delivered_next_] = seq;
+        delivered_next_ = (delivered_next_ + 1) % MAX_CATCH_UP_ROWS;
+    }
+    delivered_seqs_.insert(seq);
+}
+
+void PgNotifyTransport::pull_and_deliver() {
+    static auto& pulled = metrics::counter("caffis_cluster_bodies_pulled_total{transport=\"pg_notify\"}");
+    static auto& batches = metrics::counter("caffis_cluster_pull_batches_total{transport=\"pg_notify\"}");
+    static auto& latency = metrics::histogram("caffis_cluster_delivery_latency_us{transport=\"pg_notify\"}");
+
+    std::vector<PendingNotice> notices;
+    notices.swap(pending_notices_);
+
+    size_t offset = 0;
+    try {
+        for (; offset < notices.size(); offset += MAX_PULL_BATCH) {
+            size_t end = std::min(notices.size(), offset + MAX_PULL_BATCH);
+
+            std::unordered_map<int64_t, int64_t> sent_at_by_seq;
+            std::string seq_array = "{";
+            for (size_t i = offset; i < end; ++i) {
+                if (i > offset) seq_array += ",";
+                seq_array += std::to_string(notices[i].seq);
+                sent_at_by_seq[notices[i].seq] = notices[i].sent_at_us;
+            }
+            seq_array += "}";
+
+            pqxx::nontransaction txn(*connection_);
+            pqxx::result result = txn.exec_params(
+                std::string("SELECT ") + MESSAGE_COLUMNS +
+                "FROM messages m "
+                "JOIN chat_users u ON m.sender_id = u.id "
+                "WHERE m.seq = ANY($1::bigint[]) "
+                "ORDER BY m.seq",
+                seq_array);
+            batches.inc();
+
+            for (const auto& row : result) {
+                int64_t seq = deliver_row(row);
+                remember_delivered(seq);
+                pulled.inc();
+
+                auto sent = sent_at_by_seq.find(seq);
+                if (sent != sent_at_by_seq.end()) {
+                    int64_t elapsed = metrics::now_us() - sent->second;
+                    latency.observe(elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0);
+                }
+            }
+        }
+    } catch (...) {
+        // Not delivered: the catch-up after the reconnect pulls them again
+        for (size_t i = offset; i < notices.size(); ++i) {
+            auto seen = last_seen_seq_.find(notices[i].room_id);
+            if (seen != last_seen_seq_.end()) {
+                seen->second = std::min(seen->second, notices[i].seq - 1);
+            }
+        }
+        throw;
+    }
+}
+
+void PgNotifyTransport::catch_up() {
+    static auto& caught_up = metrics::counter("caffis_cluster_caught_up_total{transport=\"pg_notify\"}");
+
+    std::unordered_map<std::string, std::string> keys;  // canonical uuid -> room id as subscribed
+    for (const auto& [room_id, seq] : last_seen_seq_) {
+        Uuid128 uuid;
+        if (Uuid128::parse(room_id, uuid)) {
+            keys.emplace(uuid.to_string(), room_id);
+        }
+    }
+
+    caught_up_seqs_.clear();
+    size_t delivered = 0;
+    size_t fetched = 0;
+    while (!keys.empty() && fetched < MAX_CATCH_UP_ROWS) {
+        std::string room_array = "{";
+        std::string seq_array = "{";
+        for (const auto& [uuid, room_id] : keys) {
+            if (room_array.size() > 1) {
+                room_array += ",";
+                seq_array += ",";
+            }
+            room_array += uuid;
+            seq_array += std::to_string(last_seen_seq_[room_id]);
+        }
+        room_array += "}";
+        seq_array += "}";
+
+        pqxx::nontransaction txn(*connection_);
+        pqxx::result result = txn.exec_params(
+            std::string("SELECT ") + MESSAGE_COLUMNS +
+            "FROM messages m "
+            "JOIN unnest($1::uuid[], $2::bigint[]) AS c(room_id, after_seq) ON m.room_id = c.room_id "
+            "JOIN chat_users u ON m.sender_id = u.id "
+            "WHERE m.seq > c.after_seq AND m.is_deleted = false "
+            "ORDER BY m.seq LIMIT $3",
+            room_array, seq_array, static_cast<int>(MAX_PULL_BATCH));
+
+        for (const auto& row : result) {
+            int64_t seq = row["seq"].as<int64_t>();
+            auto key = keys.find(row["room_id"].c_str());
+            if (key != keys.end()) {
+                int64_t& seen = last_seen_seq_[key->second];
+                seen = std::max(seen, seq);
+            }
+            caught_up_seqs_.insert(seq);
+
+            // Already delivered before an error rewound last_seen_seq_ below it
+            if (delivered_seqs_.count(seq)) {
+                continue;
+            }
+            bool own = false;
+            {
+                std::lock_guard<std::mutex> lock(published_mutex_);
+                own = published_ids_.count(row["id"].c_str()) > 0;
+            }
+            if (!own) {
+                deliver_row(row);
+                caught_up.inc();
+                delivered++;
+            }
+        }
+        fetched += result.size();
+        if (result.size() < MAX_PULL_BATCH) {
+            break;
+        }
+    }
+
+    if (fetched >= MAX_CATCH_UP_ROWS) {
+        std::cerr << "⚠️ Cluster catch-up stopped after " << fetched
+                  << " messages; older ones are only in room history" << std::endl;
+    } else if (delivered > 0) {
+        std::cout << "🛰️ Cluster catch-up delivered " << delivered << " missed messages" << std::endl;
+    }
+    catch_up_pending_ = false;
+}
+
+void PgNotifyTransport::run() {
+    while (running_) {
+        if (!ensure_connected()) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        try {
+            apply_subscription_changes();
+            if (catch_up_pending_) {
+                catch_up();
+            }
+
+            // Wake at least every 50ms to pick up subscription changes and stop()
+            connection_->await_notification(0, 50000);
+
+            if (!pending_notices_.empty()) {
+                pull_and_deliver();
+            }
+
+        } catch (const std::exception& e) {
+            std::cerr << "❌ Cluster transport error: " << e.what() << std::endl;
+            // Lost with the connection: rewind so the catch-up covers them
+            for (const auto& notice : pending_notices_) {
+                auto seen = last_seen_seq_.find(notice.room_id);
+                if (seen != last_seen_seq_.end()) {
+                    seen->second = std::min(seen->second, notice.seq - 1);
+                }
+            }
+            pending_notices_.clear();
+            receivers_.clear();
+            node_receiver_.reset();
+            connection_.reset();
+        }
+    }
+
+    receivers_.clear();
+    node_receiver_.reset();
+    connection_.reset();
+}
+
+} // namespace caffis
@@ -0,0 +1,272 @@
+#include "../include/content_codec.h"
+#include "../include/metrics.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#ifdef CAFFIS_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace caffis {
+
+ContentCodec& content_codec() {
+    static ContentCodec codec;
+    return codec;
+}
+
+namespace {
+
+constexpr size_t DICT_HEADER_BYTES = 5;  // format + dictionary id
+
+#ifdef CAFFIS_HAVE_ZSTD
+uint64_t elapsed_us(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+void put_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+uint32_t get_u32(const std::string& in, size_t pos) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(in[pos + i])) << (8 * i);
+    return v;
+}
+
+// Contexts are reused per thread; dictionaries are shared read-only
+ZSTD_CCtx* thread_cctx() {
+    thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    return cctx.get();
+}
+
+ZSTD_DCtx* thread_dctx() {
+    thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    return dctx.get();
+}
+
+// Appends a frame for content after the header already in packed
+bool append_frame(ZSTD_CCtx* cctx, const ZSTD_CDict* cdict, int level, const std::string& content, std::string& packed) {
+    size_t header = packed.size();
+    packed.resize(header + ZSTD_compressBound(content.size()));
+    size_t size = cdict ? ZSTD_compress_usingCDict(cctx, &packed[header], packed.size() - header,
+                                                   content.data(), content.size(), cdict)
+                        : ZSTD_compressCCtx(cctx, &packed[header], packed.size() - header,
+                                            content.data(), content.size(), level);
+    if (ZSTD_isError(size)) {
+        return false;
+    }
+    packed.resize(header + size);
+    return true;
+}
+#endif
+
+} // namespace
+
+struct ContentCodec::Dictionary {
+#ifdef CAFFIS_HAVE_ZSTD
+    ZSTD_CDict* cdict = nullptr;
+    ZSTD_DDict* ddict = nullptr;
+
+    ~Dictionary() {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+    }
+#endif
+};
+
+ContentCodec::ContentCodec() = default;
+ContentCodec::~ContentCodec() = default;
+
+bool ContentCodec::available() {
+#ifdef CAFFIS_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ContentCodec::configure(const config::ContentCodecConfig& codec_config) {
+    settings_ = codec_config;
+    enabled_ = codec_config.enabled && available();
+    if (codec_config.enabled && !available()) {
+        std::cerr << "⚠️ Content codec requested but built without zstd - bodies stored uncompressed" << std::endl;
+        return;
+    }
+}
+
+void ContentCodec::set_dictionary_loader(DictionaryLoader loader) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    loader_ = std::move(loader);
+}
+
+void ContentCodec::add_dictionary(uint32_t id, const std::string& dictionary) {
+#ifdef CAFFIS_HAVE_ZSTD
+    auto entry = std::make_unique<Dictionary>();
+    entry->cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), settings_.zstd_level);
+    entry->ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    if (!entry->cdict || !entry->ddict) {
+        std::cerr << "❌ Content dictionary #" << id << " rejected by zstd" << std::endl;
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    dictionaries_.emplace(id, std::move(entry));
+    encode_id_ = std::max(encode_id_, id);
+#else
+    (void)id;
+    (void)dictionary;
+#endif
+}
+
+uint32_t ContentCodec::encode_dictionary() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return encode_id_;
+}
+
+// Entries are never removed, so the pointer outlives the lock
+const ContentCodec::Dictionary* ContentCodec::find_dictionary(uint32_t id) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = dictionaries_.find(id);
+        if (it != dictionaries_.end()) {
+            return it->second.get();
+        }
+    }
+    // Trained after this node loaded its dictionaries
+    DictionaryLoader loader;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        loader = loader_;
+    }
+    std::string bytes;
+    if (!loader || !loader(id, bytes)) {
+        return nullptr;
+    }
+    add_dictionary(id, bytes);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = dictionaries_.find(id);
+    return it == dictionaries_.end() ? nullptr : it->second.get();
+}
+
+// ================================================
+// ENCODE / DECODE
+// ================================================
+bool ContentCodec::encode(const std::string& content, std::string& packed) {
+    if (!enabled_ || content.size() < settings_.min_bytes || content.size() > MAX_CONTENT_BYTES) {
+        return false;
+    }
+#ifdef CAFFIS_HAVE_ZSTD
+    static auto& encoded = metrics::counter("caffis_content_codec_encoded_total");
+    static auto& not_worth_it = metrics::counter("caffis_content_codec_skipped_total");
+    static auto& raw_bytes = metrics::counter("caffis_content_codec_raw_bytes_total");
+    static auto& stored_bytes = metrics::counter("caffis_content_codec_stored_bytes_total");
+    static auto& encode_latency = metrics::histogram("caffis_content_codec_encode_us");
+    const auto begin = std::chrono::steady_clock::now();
+
+    uint32_t dict_id = encode_dictionary();
+    const Dictionary* dictionary = dict_id ? find_dictionary(dict_id) : nullptr;
+    packed.clear();
+    if (dictionary) {
+        packed.push_back(static_cast<char>(FORMAT_ZSTD_DICT));
+        put_u32(packed, dict_id);
+    } else {
+        packed.push_back(static_cast<char>(FORMAT_ZSTD));
+    }
+    bool ok = append_frame(thread_cctx(), dictionary ? dictionary->cdict : nullptr, settings_.zstd_level, content, packed);
+    encode_latency.observe(elapsed_us(begin));
+
+    // Keep the plain text unless it saves at least an eighth
+    if (!ok || packed.size() > content.size() - content.size() / 8) {
+        not_worth_it.inc();
+        packed.clear();
+        return false;
+    }
+    encoded.inc();
+    raw_bytes.inc(content.size());
+    stored_bytes.inc(packed.size());
+    return true;
+#else
+    (void)packed;
+    return false;
+#endif
+}
+
+bool ContentCodec::decode(const std::string& packed, std::string& content) {
+    static auto& failures = metrics::counter("caffis_content_codec_decode_failures_total");
+#ifdef CAFFIS_HAVE_ZSTD
+    static auto& decode_latency = metrics::histogram("caffis_content_codec_decode_us");
+    const auto begin = std::chrono::steady_clock::now();
+
+    const Dictionary* dictionary = nullptr;
+    size_t header = 1;
+    uint8_t format = packed.empty() ? 0 : static_cast<uint8_t>(packed[0]);
+    if (format == FORMAT_ZSTD_DICT && packed.size() > DICT_HEADER_BYTES) {
+        uint32_t dict_id = get_u32(packed, 1);
+        dictionary = find_dictionary(dict_id);
+        header = DICT_HEADER_BYTES;
+        if (!dictionary) {
+            std::cerr << "❌ Content dictionary #" << dict_id << " not found" << std::endl;
+            failures.inc();
+            return false;
+        }
+    } else if (format != FORMAT_ZSTD) {
+        failures.inc();
+        return false;
+    }
+
+    unsigned long long size = ZSTD_getFrameContentSize(packed.data() + header, packed.size() - header);
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size > MAX_CONTENT_BYTES) {
+        failures.inc();
+        return false;
+    }
+    content.resize(static_cast<size_t>(size));
+    size_t got = dictionary
+        ? ZSTD_decompress_usingDDict(thread_dctx(), &content[0], content.size(),
+                                     packed.data() + header, packed.size() - header, dictionary->ddict)
+        : ZSTD_decompressDCtx(thread_dctx(), &content[0], content.size(), packed.data() + header, packed.size() - header);
+    decode_latency.observe(elapsed_us(begin));
+    if (ZSTD_isError(got) || got != size) {
+        content.clear();
+        failures.inc();
+        return false;
+    }
+    return true;
+#else
+    (void)packed;
+    (void)content;
+    std::cerr << "❌ Packed message body found but this build has no zstd" << std::endl;
+    failures.inc();
+    return false;
+#endif
+}
+
+// ================================================
+// TRAINING
+// ================================================
+std::string ContentCodec::train_dictionary(const std::vector<std::string>& samples, size_t dictionary_bytes) {
+#ifdef CAFFIS_HAVE_ZSTD
+    std::string buffer;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& sample : samples) {
+        buffer += sample;
+        sizes.push_back(sample.size());
+    }
+    std::string dictionary(dictionary_bytes, '\0');
+    size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(), buffer.data(), sizes.data(),
+                                        static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        std::cerr << "❌ Dictionary training failed: " << ZDICT_getErrorName(size) << std::endl;
+        return "";
+    }
+    dictionary.resize(size);
+    return dictionary;
+#else
+    (void)samples;
+    (void)dictionary_bytes;
+    return "";
+#endif
+}
+
+} // namespace caffis
@@ -1,5 +1,11 @@
 #include "../include/database_manager.h"
+#include "../include/archive_store.h"
+#include "../include/cluster_transport.h"
+#include "../include/content_codec.h"
+#include "../include/intern_table.h"
+#include "../include/metrics.h"
 #include <iostream>
+#include <stdexcept>
 #include <random>
 #include <sstream>
 #include <iomanip>
@@ -70,6 +76,12 @@ bool DatabaseManager::test_connection() {
     return false;
 }
 
+// Meetup room `cr` is past retention ($1 days): event long gone and quiet since
+static const std::string MEETUP_EXPIRED_SQL =
+    "cr.type = 'meetup' AND COALESCE(cr.event_at, cr.created_at) < NOW() - make_interval(days => $1) "
+    "AND NOT EXISTS (SELECT 1 FROM messages recent WHERE recent.room_id = cr.id "
+    "AND recent.created_at >= NOW() - make_interval(days => $1))";
+
 void DatabaseManager::prepare_statements() {
     try {
         // Prepare frequently used statements for better performance
@@ -95,19 +107,44 @@ void DatabaseManager::prepare_statements() {
         
         // Save message statement
         connection_->prepare("save_message",
-            "INSERT INTO messages (id, room_id, sender_id, content, message_type, file_url, file_name, file_size, file_type, metadata) "
-            "VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10) RETURNING id");
+            "INSERT INTO messages (id, room_id, sender_id, content, message_type, file_url, file_name, file_size, file_type, metadata, content_packed) "
+            "VALUES ($1, $2, $3, CASE WHEN $11::boolean THEN NULL ELSE $4 END, $5, $6, $7, $8, $9, $10, "
+            "CASE WHEN $11::boolean THEN $12::bytea END) RETURNING id, seq");
+        
+        // Cluster fan-out notification (sent on commit of the save transaction)
+        connection_->prepare("notify_message",
+            "SELECT pg_notify($1, $2)");
         
         // Get messages statement
         connection_->prepare("get_messages",
-            "SELECT m.id, m.room_id, m.sender_id, m.content, m.message_type, "
+            "SELECT m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.message_type, "
             "m.file_url, m.file_name, m.file_size, m.file_type, m.metadata, "
-            "m.is_edited, m.is_deleted, m.created_at, "
+            "m.is_edited, m.is_deleted, m.created_at, m.seq, "
+            "(EXTRACT(EPOCH FROM m.created_at) * 1000)::bigint AS created_ms, "
             "u.username, u.display_name "
             "FROM messages m "
             "JOIN chat_users u ON m.sender_id = u.id "
-            "WHERE m.room_id = $1 AND m.is_deleted = false "
-            "ORDER BY m.created_at DESC LIMIT $2");
+            "WHERE m.room_id = $1 AND m.is_deleted = false AND ($3::bigint <= 0 OR m.seq < $3) "
+            "ORDER BY m.seq DESC LIMIT $2");
+        
+        // Edit / delete: allowed for the sender and for room admins/moderators
+        connection_->prepare("edit_message",
+            "UPDATE messages m SET content = CASE WHEN $4::boolean THEN NULL ELSE $2 END, "
+            "content_packed = CASE WHEN $4::boolean THEN $5::bytea END, is_edited = true, edited_at = NOW() "
+            "WHERE m.id = $1 AND m.is_deleted = false AND (m.sender_id = $3 OR EXISTS ("
+            "  SELECT 1 FROM room_participants rp WHERE rp.room_id = m.room_id AND rp.user_id = $3 "
+            "  AND rp.is_active = true AND rp.role IN ('admin', 'moderator'))) "
+            "RETURNING m.room_id, m.sender_id, (EXTRACT(EPOCH FROM m.edited_at) * 1000)::bigint AS edited_ms");
+        
+        // Tombstone: the row stays (read receipts, seq order) but loses its content.
+        // edited_at doubles as the change time so the search feed sees deletes too.
+        connection_->prepare("delete_message",
+            "UPDATE messages m SET is_deleted = true, content = NULL, content_packed = NULL, file_url = NULL, metadata = NULL, "
+            "edited_at = NOW() "
+            "WHERE m.id = $1 AND m.is_deleted = false AND (m.sender_id = $2 OR EXISTS ("
+            "  SELECT 1 FROM room_participants rp WHERE rp.room_id = m.room_id AND rp.user_id = $2 "
+            "  AND rp.is_active = true AND rp.role IN ('admin', 'moderator'))) "
+            "RETURNING m.room_id, m.sender_id");
         
         // Mark message as read
         connection_->prepare("mark_read",
@@ -121,6 +158,29 @@ void DatabaseManager::prepare_statements() {
             "ON CONFLICT (room_id, user_id) DO UPDATE SET "
             "started_at = NOW(), expires_at = NOW() + INTERVAL '10 seconds'");
         
+        // Batch user lookup (cache warm-up)
+        connection_->prepare("get_users",
+            "SELECT id, username, display_name FROM chat_users WHERE id = ANY($1::uuid[])");
+        
+        // Most recently active rooms, driven by the messages time index
+        connection_->prepare("get_hot_room_ids",
+            "SELECT room_id FROM ("
+            "  SELECT room_id, MAX(created_at) AS last_message FROM ("
+            "    SELECT room_id, created_at FROM messages ORDER BY created_at DESC LIMIT 10000"
+            "  ) recent GROUP BY room_id"
+            ") hot ORDER BY last_message DESC LIMIT $1");
+        
+        connection_->prepare("get_room_participants",
+            "SELECT user_id FROM room_participants WHERE room_id = $1 AND is_active = true");
+        
+        connection_->prepare("get_notification_recipients",
+            "SELECT rp.user_id FROM room_participants rp "
+            "WHERE rp.room_id = $1 AND rp.is_active = true AND rp.is_muted = false AND rp.user_id <> $2 "
+            "AND EXISTS (SELECT 1 FROM room_participants sp WHERE sp.room_id = $1 AND sp.user_id = $2 "
+            "  AND sp.is_active = true) "
+            "AND NOT EXISTS (SELECT 1 FROM user_relationships ur WHERE ur.user_id = rp.user_id "
+            "  AND ur.target_user_id = $2 AND ur.relationship_type IN ('blocked', 'muted'))");
+        
         // NEW: Room access check
         connection_->prepare("can_user_join_room",
             "SELECT COUNT(*) FROM room_participants "
@@ -135,6 +195,121 @@ void DatabaseManager::prepare_statements() {
             "WHERE rp.user_id = $1 AND rp.is_active = true AND cr.is_active = true "
             "ORDER BY cr.last_activity DESC");
         
+        // Meetup locations (nearby-rooms index)
+        connection_->prepare("set_room_location",
+            "UPDATE chat_rooms cr SET latitude = $2, longitude = $3 "
+            "WHERE cr.id = $1 AND cr.type = 'meetup' AND cr.is_active = true AND (cr.created_by = $4 OR EXISTS ("
+            "  SELECT 1 FROM room_participants rp WHERE rp.room_id = cr.id AND rp.user_id = $4 "
+            "  AND rp.is_active = true AND rp.role IN ('admin', 'moderator'))) "
+            "RETURNING cr.name");
+        
+        connection_->prepare("get_room_locations_changed",
+            "WITH h AS (SELECT (EXTRACT(EPOCH FROM NOW() - make_interval(secs => $2::float8 / 1000)) * 1000)::bigint AS horizon_ms) "
+            "SELECT h.horizon_ms, cr.id, cr.name, cr.latitude, cr.longitude, "
+            "(cr.is_active AND cr.type = 'meetup' AND cr.latitude IS NOT NULL) AS listed "
+            "FROM h LEFT JOIN chat_rooms cr "
+            "ON cr.updated_at > to_timestamp($1::float8 / 1000) "
+            "AND cr.updated_at <= to_timestamp(h.horizon_ms::float8 / 1000) "
+            "AND ($1 >= 0 OR cr.latitude IS NOT NULL)");
+        
+        // Retention batches: receipts are measured, then cascade with their messages.
+        // Victims are picked oldest first from idx_messages_created.
+        connection_->prepare("retention_delete_by_age",
+            "WITH victims AS ("
+            "  SELECT m.id FROM messages m JOIN chat_rooms cr ON cr.id = m.room_id "
+            "  WHERE cr.type = $1 AND m.created_at < NOW() - make_interval(days => $2) "
+            "  ORDER BY m.created_at LIMIT $3"
+            "), receipts AS ("
+            "  SELECT COUNT(*) AS receipt_count, COALESCE(SUM(pg_column_size(rs.*)), 0) AS receipt_bytes "
+            "  FROM message_read_status rs WHERE rs.message_id IN (SELECT id FROM victims)"
+            "), deleted AS ("
+            "  DELETE FROM messages m WHERE m.id IN (SELECT id FROM victims) "
+            "  RETURNING m.room_id, m.seq, pg_column_size(m.*) AS bytes"
+            ") SELECT d.room_id, d.seq, d.bytes, r.receipt_count, r.receipt_bytes "
+            "FROM deleted d CROSS JOIN receipts r");
+        
+        connection_->prepare("retention_delete_meetups",
+            "WITH victims AS ("
+            "  SELECT m.id FROM chat_rooms cr JOIN messages m ON m.room_id = cr.id "
+            "  WHERE " + MEETUP_EXPIRED_SQL + " LIMIT $2"
+            "), receipts AS ("
+            "  SELECT COUNT(*) AS receipt_count, COALESCE(SUM(pg_column_size(rs.*)), 0) AS receipt_bytes "
+            "  FROM message_read_status rs WHERE rs.message_id IN (SELECT id FROM victims)"
+            "), deleted AS ("
+            "  DELETE FROM messages m WHERE m.id IN (SELECT id FROM victims) "
+            "  RETURNING m.room_id, m.seq, pg_column_size(m.*) AS bytes"
+            ") SELECT d.room_id, d.seq, d.bytes, r.receipt_count, r.receipt_bytes "
+            "FROM deleted d CROSS JOIN receipts r");
+        
+        // Emptied meetups close; the nearby-rooms feed drops them via updated_at
+        connection_->prepare("close_expired_meetups",
+            "UPDATE chat_rooms cr SET is_active = false "
+            "WHERE cr.is_active = true AND " + MEETUP_EXPIRED_SQL);
+        
+        // Archive tiering
+        // Room types under retention ($3) are never tiered: retention only deletes in Postgres
+        connection_->prepare("get_rooms_with_messages_before",
+            "SELECT DISTINCT m.room_id FROM messages m JOIN chat_rooms cr ON cr.id = m.room_id "
+            "WHERE m.created_at < NOW() - make_interval(days => $1) AND NOT (cr.type = ANY($3::text[])) LIMIT $2");
+        
+        connection_->prepare("get_archivable_messages",
+            "SELECT m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.message_type, "
+            "m.file_url, m.file_name, m.file_size, m.file_type, m.metadata, "
+            "m.is_edited, m.is_deleted, m.seq, "
+            "(EXTRACT(EPOCH FROM m.created_at) * 1000)::bigint AS created_ms "
+            "FROM messages m "
+            "WHERE m.room_id = $1 AND m.created_at < NOW() - make_interval(days => $2) AND m.seq > $3 "
+            "ORDER BY m.seq LIMIT $4");
+        
+        // Search index feed
+        connection_->prepare("get_messages_after_seq",
+            "SELECT m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.seq "
+            "FROM messages m "
+            "WHERE m.seq > $1 AND m.created_at <= NOW() - make_interval(secs => $3::float8 / 1000) "
+            "AND m.is_deleted = false "
+            "ORDER BY m.seq LIMIT $2");
+        
+        connection_->prepare("get_messages_changed_between",
+            "WITH h AS (SELECT (EXTRACT(EPOCH FROM NOW() - make_interval(secs => $2::float8 / 1000)) * 1000)::bigint AS horizon_ms) "
+            "SELECT h.horizon_ms, m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.seq, m.is_deleted "
+            "FROM h LEFT JOIN messages m "
+            "ON $1 >= 0 AND m.edited_at > to_timestamp($1::float8 / 1000) "
+            "AND m.edited_at <= to_timestamp(h.horizon_ms::float8 / 1000) "
+            "ORDER BY m.seq");
+        
+        // Storage codec dictionaries
+        connection_->prepare("get_content_dictionaries",
+            "SELECT id, dictionary FROM content_dictionaries ORDER BY id");
+        
+        connection_->prepare("get_content_dictionary",
+            "SELECT dictionary FROM content_dictionaries WHERE id = $1");
+        
+        connection_->prepare("save_content_dictionary",
+            "INSERT INTO content_dictionaries (dictionary, sample_count) VALUES ($1::bytea, $2) RETURNING id");
+        
+        connection_->prepare("get_content_samples",
+            "SELECT m.content, m.content_packed FROM messages m "
+            "WHERE m.is_deleted = false AND m.message_type = 'text' "
+            "AND (m.content_packed IS NOT NULL OR octet_length(m.content) >= $2) "
+            "ORDER BY m.seq DESC LIMIT $1");
+        
+        // User relationships (block / mute / favorite)
+        connection_->prepare("add_relationship",
+            "INSERT INTO user_relationships (user_id, target_user_id, relationship_type) "
+            "VALUES ($1, $2, $3) ON CONFLICT (user_id, target_user_id, relationship_type) DO NOTHING");
+        
+        connection_->prepare("remove_relationship",
+            "DELETE FROM user_relationships "
+            "WHERE user_id = $1 AND target_user_id = $2 AND relationship_type = $3");
+        
+        connection_->prepare("has_relationship",
+            "SELECT COUNT(*) FROM user_relationships "
+            "WHERE user_id = $1 AND target_user_id = $2 AND relationship_type = $3");
+        
+        connection_->prepare("get_filtered_senders",
+            "SELECT DISTINCT target_user_id FROM user_relationships "
+            "WHERE user_id = $1 AND relationship_type IN ('blocked', 'muted')");
+        
         std::cout << "✅ Database prepared statements created" << std::endl;
         
     } catch (const std::exception& e) {
@@ -210,6 +385,39 @@ bool DatabaseManager::update_user_status(const std::string& user_id, bool is_onl
     }
 }
 
+std::vector<ChatUser> DatabaseManager::get_users(const std::vector<std::string>& user_ids) {
+    std::vector<ChatUser> users;
+    if (user_ids.empty()) {
+        return users;
+    }
+    
+    try {
+        std::string id_array = "{";
+        for (size_t i = 0; i < user_ids.size(); ++i) {
+            if (i > 0) id_array += ",";
+            id_array += user_ids[i];
+        }
+        id_array += "}";
+        
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_users", id_array);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            ChatUser user;
+            user.id = row["id"].c_str();
+            user.username = row["username"].c_str();
+            user.display_name = row["display_name"].c_str();
+            users.push_back(user);
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get users: " << e.what() << std::endl;
+    }
+    
+    return users;
+}
+
 std::string DatabaseManager::create_room(const std::string& name, const std::string& type,
                                         const std::string& created_by, const std::string& invite_id) {
     try {
@@ -286,6 +494,19 @@ bool DatabaseManager::can_user_join_room(const std::string& user_id, const std::
     return true; // Allow by default for testing
 }
 
+// Unlike can_user_join_room, a real check: an active row in room_participants
+bool DatabaseManager::is_active_participant(const std::string& room_id, const std::string& user_id) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("can_user_join_room", room_id, user_id);
+        txn.commit();
+        return !result.empty() && result[0][0].as<int>() > 0;
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to check room membership: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 // NEW: Get user's rooms
 std::vector<ChatRoom> DatabaseManager::get_user_rooms(const std::string& user_id) {
     std::vector<ChatRoom> rooms;
@@ -323,25 +544,54 @@ std::vector<Message> DatabaseManager::get_room_messages(const std::string& room_
     return get_messages(room_id, limit);
 }
 
-std::string DatabaseManager::save_message(const Message& message) {
+std::vector<std::string> DatabaseManager::get_hot_room_ids(int limit) {
+    std::vector<std::string> room_ids;
+    
     try {
-        std::string message_id = generate_uuid();
-        
         pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_hot_room_ids", limit);
+        txn.commit();
         
-        // Convert message type to string
-        std::string type_str;
-        switch (message.type) {
-            case MessageType::TEXT: type_str = "text"; break;
-            case MessageType::IMAGE: type_str = "image"; break;
-            case MessageType::FILE: type_str = "file"; break;
-            case MessageType::LOCATION: type_str = "location"; break;
-            case MessageType::SYSTEM: type_str = "system"; break;
+        for (const auto& row : result) {
+            room_ids.push_back(row[0].c_str());
         }
         
-        txn.exec_prepared("save_message", message_id, message.room_id, message.sender_id,
-                         message.content, type_str, "", "", 0, "", "{}");
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get hot rooms: " << e.what() << std::endl;
+    }
+    
+    return room_ids;
+}
+
+std::string DatabaseManager::save_message(Message& message) {
+    try {
+        // Keep the ID the message was broadcast with so clients can reference it later
+        std::string message_id = message.id.empty() ? generate_uuid() : message.id;
+        
+        pqxx::work txn(*connection_);
+        
+        std::string type_str = message_type_to_string(message.type);
+        
+        // Large bodies go in packed (content NULL) when the storage codec is on
+        std::string packed;
+        bool is_packed = content_codec().encode(message.content, packed);
+        
+        // Attachments are referenced by URL only; the bytes live in the attachment store
+        pqxx::result saved = txn.exec_prepared("save_message", message_id, message.room_id, message.sender_id,
+                                               message.content, type_str, message.file_url, message.file_name,
+                                               static_cast<int64_t>(message.file_size), message.file_type,
+                                               message.metadata.empty() ? std::string("{}") : message.metadata,
+                                               is_packed, pqxx::binarystring(packed.data(), packed.size()));
+        
+        int64_t seq = saved.empty() ? 0 : saved[0]["seq"].as<int64_t>();
+        if (!notify_node_id_.empty() && seq > 0) {
+            txn.exec_prepared("notify_message",
+                              PgNotifyTransport::room_channel(message.room_id),
+                              PgNotifyTransport::encode_payload(message.room_id, seq, notify_node_id_,
+                                                                metrics::now_us()));
+        }
         txn.commit();
+        message.seq = seq;
         
         std::cout << "💬 Message saved: " << message_id << std::endl;
         return message_id;
@@ -352,13 +602,12 @@ std::string DatabaseManager::save_message(const Message& message) {
     }
 }
 
-std::vector<Message> DatabaseManager::get_messages(const std::string& room_id, int limit,
-                                                  const std::string& before_message_id) {
+std::vector<Message> DatabaseManager::get_messages(const std::string& room_id, int limit, int64_t before_seq) {
     std::vector<Message> messages;
     
     try {
         pqxx::work txn(*connection_);
-        pqxx::result result = txn.exec_prepared("get_messages", room_id, limit);
+        pqxx::result result = txn.exec_prepared("get_messages", room_id, limit, before_seq);
         txn.commit();
         
         for (const auto& row : result) {
@@ -366,18 +615,21 @@ std::vector<Message> DatabaseManager::get_messages(const std::string& room_id, i
             msg.id = row["id"].c_str();
             msg.room_id = row["room_id"].c_str();
             msg.sender_id = row["sender_id"].c_str();
-            msg.content = row["content"].c_str();
+            msg.content = row_content(row);
             
             // Convert type string back to enum
-            std::string type_str = row["message_type"].c_str();
-            if (type_str == "text") msg.type = MessageType::TEXT;
-            else if (type_str == "image") msg.type = MessageType::IMAGE;
-            else if (type_str == "file") msg.type = MessageType::FILE;
-            else if (type_str == "location") msg.type = MessageType::LOCATION;
-            else if (type_str == "system") msg.type = MessageType::SYSTEM;
+            msg.type = message_type_from_string(row["message_type"].c_str());
+            msg.file_url = row["file_url"].c_str();
+            msg.file_name = row["file_name"].c_str();
+            msg.file_size = row["file_size"].as<size_t>(0);
+            msg.file_type = row["file_type"].c_str();
+            msg.metadata = row["metadata"].c_str();
             
             msg.is_edited = row["is_edited"].as<bool>();
             msg.is_deleted = row["is_deleted"].as<bool>();
+            msg.seq = row["seq"].as<int64_t>();
+            msg.timestamp = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(row["created_ms"].as<int64_t>()));
             
             messages.push_back(msg);
         }
@@ -386,9 +638,275 @@ std::vector<Message> DatabaseManager::get_messages(const std::string& room_id, i
         std::cerr << "❌ Failed to get messages: " << e.what() << std::endl;
     }
     
+    // Cold tier: only when the page reaches down to archived seqs. Merged
+    // rather than appended, since a row can outlive its neighbours in Postgres.
+    if (archive().enabled()) {
+        int64_t archived_up_to = archive().last_archived_seq(room_id);
+        bool reaches_archive = static_cast<int>(messages.size()) < limit
+                            || (!messages.empty() && messages.back().seq <= archived_up_to);
+        if (archived_up_to > 0 && reaches_archive) {
+            std::vector<Message> cold = archive().read(room_id, before_seq, static_cast<size_t>(limit));
+            messages.insert(messages.end(), std::make_move_iterator(cold.begin()), std::make_move_iterator(cold.end()));
+            std::sort(messages.begin(), messages.end(), [](const Message& a, const Message& b) { return a.seq > b.seq; });
+            if (static_cast<int>(messages.size()) > limit) {
+                messages.resize(static_cast<size_t>(limit));
+            }
+        }
+    }
+    
+    return messages;
+}
+
+int64_t DatabaseManager::get_max_message_seq() {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec("SELECT COALESCE(MAX(seq), 0) FROM messages");
+        txn.commit();
+        
+        if (!result.empty()) {
+            return result[0][0].as<int64_t>();
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get max message seq: " << e.what() << std::endl;
+    }
+    
+    return -1;
+}
+
+std::vector<std::string> DatabaseManager::get_rooms_changed_since(int64_t seq, int64_t since_us) {
+    std::vector<std::string> room_ids;
+    
+    try {
+        // Edits and deletes keep their seq and only move edited_at; the slack
+        // covers clock skew between this node and the database
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_params(
+            "SELECT room_id FROM messages WHERE seq > $1 "
+            "UNION "
+            "SELECT room_id FROM messages WHERE edited_at > to_timestamp($2::bigint / 1000000.0) - INTERVAL '5 seconds'",
+            seq, since_us);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            room_ids.push_back(row[0].c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get changed rooms: " << e.what() << std::endl;
+    }
+    
+    return room_ids;
+}
+
+std::vector<Message> DatabaseManager::get_messages_after_seq(int64_t after_seq, int limit, int lag_ms) {
+    std::vector<Message> messages;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_messages_after_seq", after_seq, limit, lag_ms);
+        txn.commit();
+        
+        messages.reserve(result.size());
+        for (const auto& row : result) {
+            Message msg;
+            msg.id = row["id"].c_str();
+            msg.room_id = row["room_id"].c_str();
+            msg.sender_id = row["sender_id"].c_str();
+            msg.seq = row["seq"].as<int64_t>();
+            try {
+                msg.content = row_content(row);
+            } catch (const std::exception& e) {
+                // Left out of the feed rather than stalling it on every poll
+                std::cerr << "⚠️ Skipping message: " << e.what() << std::endl;
+                continue;
+            }
+            messages.push_back(std::move(msg));
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to read messages after seq " << after_seq << ": " << e.what() << std::endl;
+    }
+    
+    return messages;
+}
+
+// after_ms < 0 only establishes the horizon (first call)
+std::vector<Message> DatabaseManager::get_messages_changed_between(int64_t after_ms, int64_t& horizon_ms, int lag_ms) {
+    std::vector<Message> messages;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_messages_changed_between", after_ms, lag_ms);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            horizon_ms = row["horizon_ms"].as<int64_t>();
+            if (row["id"].is_null()) {
+                continue;
+            }
+            Message msg;
+            msg.id = row["id"].c_str();
+            msg.room_id = row["room_id"].c_str();
+            msg.sender_id = row["sender_id"].c_str();
+            msg.seq = row["seq"].as<int64_t>();
+            msg.is_deleted = row["is_deleted"].as<bool>();
+            try {
+                msg.content = row_content(row);
+            } catch (const std::exception& e) {
+                std::cerr << "⚠️ Skipping message: " << e.what() << std::endl;
+                continue;
+            }
+            messages.push_back(std::move(msg));
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to read changed messages: " << e.what() << std::endl;
+    }
+    
     return messages;
 }
 
+std::vector<Message> DatabaseManager::get_messages_by_ids(const std::vector<std::string>& message_ids) {
+    std::vector<Message> messages;
+    if (message_ids.empty()) {
+        return messages;
+    }
+    
+    try {
+        std::string id_array = "{";
+        for (size_t i = 0; i < message_ids.size(); ++i) {
+            if (i > 0) id_array += ",";
+            id_array += message_ids[i];
+        }
+        id_array += "}";
+        
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_params(
+            "SELECT m.id, m.room_id, m.sender_id, m.content, m.content_packed, m.message_type, m.seq, m.is_edited, "
+            "(EXTRACT(EPOCH FROM m.created_at) * 1000)::bigint AS created_ms "
+            "FROM messages m WHERE m.id = ANY($1::uuid[]) AND m.is_deleted = false",
+            id_array);
+        txn.commit();
+        
+        messages.reserve(result.size());
+        for (const auto& row : result) {
+            Message msg;
+            msg.id = row["id"].c_str();
+            msg.room_id = row["room_id"].c_str();
+            msg.sender_id = row["sender_id"].c_str();
+            msg.content = row_content(row);
+            msg.type = message_type_from_string(row["message_type"].c_str());
+            msg.seq = row["seq"].as<int64_t>();
+            msg.is_edited = row["is_edited"].as<bool>();
+            msg.timestamp = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(row["created_ms"].as<int64_t>()));
+            messages.push_back(std::move(msg));
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to load messages by id: " << e.what() << std::endl;
+    }
+    
+    return messages;
+}
+
+std::string DatabaseManager::row_content(const pqxx::row& row) {
+    if (!row["content_packed"].is_null()) {
+        // An unreadable body must never pass for an empty one: callers that
+        // would serve, index or archive it fail instead
+        std::string content;
+        if (!content_codec().decode(pqxx::binarystring(row["content_packed"]).str(), content)) {
+            throw std::runtime_error(std::string("undecodable content_packed in message ") + row["id"].c_str());
+        }
+        return content;
+    }
+    return row["content"].is_null() ? "" : row["content"].c_str();
+}
+
+std::vector<std::pair<uint32_t, std::string>> DatabaseManager::get_content_dictionaries() {
+    std::vector<std::pair<uint32_t, std::string>> dictionaries;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_content_dictionaries");
+        txn.commit();
+        
+        for (const auto& row : result) {
+            dictionaries.emplace_back(row["id"].as<uint32_t>(), pqxx::binarystring(row["dictionary"]).str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to load content dictionaries: " << e.what() << std::endl;
+    }
+    
+    return dictionaries;
+}
+
+bool DatabaseManager::get_content_dictionary(uint32_t id, std::string& dictionary) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_content_dictionary", id);
+        txn.commit();
+        
+        if (!result.empty()) {
+            dictionary = pqxx::binarystring(result[0]["dictionary"]).str();
+            return true;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to load content dictionary #" << id << ": " << e.what() << std::endl;
+    }
+    
+    return false;
+}
+
+uint32_t DatabaseManager::save_content_dictionary(const std::string& dictionary, int sample_count) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("save_content_dictionary",
+                                                pqxx::binarystring(dictionary.data(), dictionary.size()), sample_count);
+        txn.commit();
+        
+        if (!result.empty()) {
+            return result[0]["id"].as<uint32_t>();
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to save content dictionary: " << e.what() << std::endl;
+    }
+    
+    return 0;
+}
+
+std::vector<std::string> DatabaseManager::get_content_samples(int limit, int min_bytes) {
+    std::vector<std::string> samples;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_content_samples", limit, min_bytes);
+        txn.commit();
+        
+        samples.reserve(result.size());
+        for (const auto& row : result) {
+            std::string content;
+            try {
+                content = row_content(row);
+            } catch (const std::exception& e) {
+                continue;  // not a usable sample
+            }
+            if (!content.empty()) {
+                samples.push_back(std::move(content));
+            }
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to sample message bodies: " << e.what() << std::endl;
+    }
+    
+    return samples;
+}
+
 bool DatabaseManager::mark_message_read(const std::string& message_id, const std::string& user_id) {
     try {
         pqxx::work txn(*connection_);
@@ -513,17 +1031,28 @@ std::string DatabaseManager::get_database_stats() {
     try {
         pqxx::work txn(*connection_);
         
-        pqxx::result users = txn.exec("SELECT COUNT(*) FROM chat_users");
-        pqxx::result rooms = txn.exec("SELECT COUNT(*) FROM chat_rooms");
-        pqxx::result messages = txn.exec("SELECT COUNT(*) FROM messages");
+        // Planner estimates from the catalog: constant time regardless of
+        // table size (exact COUNT(*) took seconds on large tables)
+        pqxx::result estimates = txn.exec(
+            "SELECT relname, GREATEST(reltuples, 0)::bigint AS estimate "
+            "FROM pg_class "
+            "WHERE relname IN ('chat_users', 'chat_rooms', 'messages') AND relkind IN ('r', 'p')");
         
         txn.commit();
         
+        std::string users = "0", rooms = "0", messages = "0";
+        for (const auto& row : estimates) {
+            std::string table = row["relname"].c_str();
+            if (table == "chat_users") users = row["estimate"].c_str();
+            else if (table == "chat_rooms") rooms = row["estimate"].c_str();
+            else if (table == "messages") messages = row["estimate"].c_str();
+        }
+        
         std::stringstream stats;
-        stats << "📊 Database Stats:\n";
-        stats << "   • Users: " << users[0][0].c_str() << "\n";
-        stats << "   • Rooms: " << rooms[0][0].c_str() << "\n";
-        stats << "   • Messages: " << messages[0][0].c_str();
+        stats << "📊 Database Stats (estimated):\n";
+        stats << "   • Users: ~" << users << "\n";
+        stats << "   • Rooms: ~" << rooms << "\n";
+        stats << "   • Messages: ~" << messages;
         
         return stats.str();
         
@@ -532,6 +1061,281 @@ std::string DatabaseManager::get_database_stats() {
     }
 }
 
+bool DatabaseManager::flush_room_activity(const std::vector<RoomActivityDelta>& deltas) {
+    if (deltas.empty()) {
+        return true;
+    }
+    
+    try {
+        // Array literals are built from re-serialized UUIDs and integers only,
+        // so nothing client-supplied ever reaches the literal syntax
+        std::string room_ids = "{", messages = "{", peaks = "{", activity = "{";
+        size_t rows = 0;
+        for (const auto& delta : deltas) {
+            Uuid128 room_uuid;
+            if (!Uuid128::parse(delta.room_id, room_uuid)) {
+                std::cerr << "⚠️ Skipping room activity for invalid room id" << std::endl;
+                continue;
+            }
+            const char* separator = rows++ > 0 ? "," : "";
+            room_ids += separator + room_uuid.to_string();
+            messages += separator + std::to_string(delta.messages);
+            peaks += separator + std::to_string(delta.peak_members);
+            activity += separator + std::to_string(delta.last_activity_ms);
+        }
+        if (rows == 0) {
+            return true;
+        }
+        room_ids += "}";
+        messages += "}";
+        peaks += "}";
+        activity += "}";
+        
+        pqxx::work txn(*connection_);
+        txn.exec_params(
+            "UPDATE chat_rooms cr SET last_activity = to_timestamp(d.activity_ms / 1000.0) "
+            "FROM unnest($1::uuid[], $2::bigint[]) AS d(room_id, activity_ms) "
+            "WHERE cr.id = d.room_id AND d.activity_ms > 0 "
+            "AND cr.last_activity < to_timestamp(d.activity_ms / 1000.0)",
+            room_ids, activity);
+        txn.exec_params(
+            "INSERT INTO room_activity (room_id, messages_total, peak_members, updated_at) "
+            "SELECT d.room_id, d.messages, d.peak, NOW() "
+            "FROM unnest($1::uuid[], $2::bigint[], $3::int[]) AS d(room_id, messages, peak) "
+            "JOIN chat_rooms cr ON cr.id = d.room_id "
+            "ON CONFLICT (room_id) DO UPDATE SET "
+            "messages_total = room_activity.messages_total + EXCLUDED.messages_total, "
+            "peak_members = GREATEST(room_activity.peak_members, EXCLUDED.peak_members), "
+            "updated_at = NOW()",
+            room_ids, messages, peaks);
+        txn.commit();
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to flush room activity: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// ================================================
+// RETENTION
+// ================================================
+bool DatabaseManager::try_maintenance_lock(const std::string& job) {
+    try {
+        pqxx::nontransaction txn(*connection_);
+        pqxx::result result = txn.exec_params("SELECT pg_try_advisory_lock(hashtext($1))", "caffis_" + job);
+        return !result.empty() && result[0][0].as<bool>();
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to take " << job << " lock: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void DatabaseManager::release_maintenance_lock(const std::string& job) {
+    try {
+        pqxx::nontransaction txn(*connection_);
+        txn.exec_params("SELECT pg_advisory_unlock(hashtext($1))", "caffis_" + job);
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to release " << job << " lock: " << e.what() << std::endl;
+    }
+}
+
+static RetentionBatch read_retention_batch(const pqxx::result& result) {
+    RetentionBatch batch;
+    for (const auto& row : result) {
+        batch.removed.emplace_back(row["room_id"].c_str(), row["seq"].as<int64_t>());
+        batch.bytes += row["bytes"].as<uint64_t>(0);
+        batch.receipts = row["receipt_count"].as<size_t>(0);
+        batch.messages++;
+    }
+    if (!result.empty()) {
+        batch.bytes += result[0]["receipt_bytes"].as<uint64_t>(0);
+    }
+    return batch;
+}
+
+RetentionBatch DatabaseManager::delete_expired_messages(const std::string& room_type, int days, int limit) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("retention_delete_by_age", room_type, days, limit);
+        txn.commit();
+        return read_retention_batch(result);
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Retention delete failed (" << room_type << "): " << e.what() << std::endl;
+        return {};
+    }
+}
+
+RetentionBatch DatabaseManager::delete_expired_meetup_messages(int days, int limit) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("retention_delete_meetups", days, limit);
+        txn.commit();
+        return read_retention_batch(result);
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Retention delete failed (meetup): " << e.what() << std::endl;
+        return {};
+    }
+}
+
+int DatabaseManager::close_expired_meetup_rooms(int days) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("close_expired_meetups", days);
+        txn.commit();
+        return static_cast<int>(result.affected_rows());
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to close expired meetups: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+std::vector<std::string> DatabaseManager::get_message_partitions() {
+    std::vector<std::string> partitions;
+    
+    try {
+        pqxx::nontransaction txn(*connection_);
+        pqxx::result result = txn.exec(
+            "SELECT c.relname FROM pg_inherits i "
+            "JOIN pg_class c ON c.oid = i.inhrelid "
+            "JOIN pg_class p ON p.oid = i.inhparent "
+            "WHERE p.relname = 'messages' ORDER BY c.relname");
+        for (const auto& row : result) {
+            partitions.push_back(row[0].c_str());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to list message partitions: " << e.what() << std::endl;
+    }
+    
+    return partitions;
+}
+
+bool DatabaseManager::drop_expired_message_partition(const std::string& partition, int min_age_days, int meetup_days,
+                                                     uint64_t& reclaimed_bytes) {
+    try {
+        pqxx::work txn(*connection_);
+        std::string table = txn.quote_name(partition);
+        
+        // Empty partitions are kept: they are usually the ones being written next
+        pqxx::result check = txn.exec_params(
+            "SELECT (SELECT MAX(created_at) FROM " + table + ") < NOW() - make_interval(days => $2) AS expired, "
+            "EXISTS (SELECT 1 FROM " + table + " m JOIN chat_rooms cr ON cr.id = m.room_id "
+            "WHERE cr.type = 'meetup' AND NOT (" + MEETUP_EXPIRED_SQL + ")) AS live_meetups, "
+            "pg_total_relation_size(" + txn.quote(table) + "::regclass) AS bytes",
+            meetup_days, min_age_days);
+        
+        if (check.empty() || !check[0]["expired"].as<bool>(false) || check[0]["live_meetups"].as<bool>(true)) {
+            return false;
+        }
+        
+        reclaimed_bytes = check[0]["bytes"].as<uint64_t>(0);
+        txn.exec("DELETE FROM message_read_status WHERE message_id IN (SELECT id FROM " + table + ")");
+        txn.exec("ALTER TABLE messages DETACH PARTITION " + table);
+        txn.exec("DROP TABLE " + table);
+        txn.commit();
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to drop partition " << partition << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// ================================================
+// ARCHIVE TIERING
+// ================================================
+std::vector<std::string> DatabaseManager::get_rooms_with_messages_before(int days, int limit,
+                                                                        const std::vector<std::string>& skip_room_types) {
+    std::vector<std::string> room_ids;
+    
+    try {
+        std::string type_array = "{";
+        for (size_t i = 0; i < skip_room_types.size(); ++i) {
+            if (i > 0) type_array += ",";
+            type_array += skip_room_types[i];
+        }
+        type_array += "}";
+        
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_rooms_with_messages_before", days, limit, type_array);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            room_ids.push_back(row[0].c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to find archivable rooms: " << e.what() << std::endl;
+    }
+    
+    return room_ids;
+}
+
+bool DatabaseManager::get_archivable_messages(const std::string& room_id, int days, int64_t after_seq, int limit,
+                                              std::vector<Message>& messages) {
+    messages.clear();
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_archivable_messages", room_id, days, after_seq, limit);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            Message msg;
+            msg.id = row["id"].c_str();
+            msg.room_id = row["room_id"].c_str();
+            msg.sender_id = row["sender_id"].c_str();
+            msg.content = row_content(row);
+            msg.type = message_type_from_string(row["message_type"].c_str());
+            msg.file_url = row["file_url"].c_str();
+            msg.file_name = row["file_name"].c_str();
+            msg.file_size = row["file_size"].as<size_t>(0);
+            msg.file_type = row["file_type"].c_str();
+            msg.metadata = row["metadata"].c_str();
+            if (msg.metadata == "{}") {
+                msg.metadata.clear();
+            }
+            msg.is_edited = row["is_edited"].as<bool>(false);
+            msg.is_deleted = row["is_deleted"].as<bool>(false);
+            msg.seq = row["seq"].as<int64_t>();
+            msg.timestamp = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(row["created_ms"].as<int64_t>()));
+            messages.push_back(std::move(msg));
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to read archivable messages: " << e.what() << std::endl;
+        messages.clear();
+        return false;
+    }
+    
+    return true;
+}
+
+size_t DatabaseManager::delete_messages_by_ids(const std::vector<std::string>& message_ids) {
+    if (message_ids.empty()) {
+        return 0;
+    }
+    
+    try {
+        std::string id_array = "{";
+        for (size_t i = 0; i < message_ids.size(); ++i) {
+            if (i > 0) id_array += ",";
+            id_array += message_ids[i];
+        }
+        id_array += "}";
+        
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_params("DELETE FROM messages WHERE id = ANY($1::uuid[])", id_array);
+        txn.commit();
+        return static_cast<size_t>(result.affected_rows());
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to delete archived messages: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
 // Placeholder implementations for methods not yet needed
 bool DatabaseManager::remove_participant(const std::string& room_id, const std::string& user_id) {
     // TODO: Implement when needed
@@ -539,33 +1343,206 @@ bool DatabaseManager::remove_participant(const std::string& room_id, const std::
 }
 
 std::vector<std::string> DatabaseManager::get_room_participants(const std::string& room_id) {
-    // TODO: Implement when needed
-    return {};
+    std::vector<std::string> participants;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_room_participants", room_id);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            participants.push_back(row[0].c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get room participants: " << e.what() << std::endl;
+    }
+    
+    return participants;
 }
 
-bool DatabaseManager::delete_message(const std::string& message_id, const std::string& user_id) {
-    // TODO: Implement when needed
-    return true;
+std::vector<std::string> DatabaseManager::get_notification_recipients(const std::string& room_id,
+                                                                      const std::string& sender_id) {
+    std::vector<std::string> recipients;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_notification_recipients", room_id, sender_id);
+        txn.commit();
+        
+        recipients.reserve(result.size());
+        for (const auto& row : result) {
+            recipients.push_back(row[0].c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to get notification recipients: " << e.what() << std::endl;
+    }
+    
+    return recipients;
 }
 
-bool DatabaseManager::edit_message(const std::string& message_id, const std::string& new_content, const std::string& user_id) {
-    // TODO: Implement when needed
-    return true;
+bool DatabaseManager::delete_message(const std::string& message_id, const std::string& user_id, std::string& room_id,
+                                     std::string& author_id) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("delete_message", message_id, user_id);
+        txn.commit();
+        
+        if (!result.empty()) {
+            room_id = result[0]["room_id"].c_str();
+            author_id = result[0]["sender_id"].c_str();
+            return true;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to delete message: " << e.what() << std::endl;
+    }
+    
+    return false;
+}
+
+bool DatabaseManager::edit_message(const std::string& message_id, const std::string& new_content, 
+                                   const std::string& user_id, std::string& room_id, std::string& author_id,
+                                   int64_t& edited_at_ms) {
+    try {
+        pqxx::work txn(*connection_);
+        std::string packed;
+        bool is_packed = content_codec().encode(new_content, packed);
+        pqxx::result result = txn.exec_prepared("edit_message", message_id, new_content, user_id, is_packed,
+                                                pqxx::binarystring(packed.data(), packed.size()));
+        txn.commit();
+        
+        if (!result.empty()) {
+            room_id = result[0]["room_id"].c_str();
+            author_id = result[0]["sender_id"].c_str();
+            edited_at_ms = result[0]["edited_ms"].as<int64_t>();
+            return true;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to edit message: " << e.what() << std::endl;
+    }
+    
+    return false;
+}
+
+bool DatabaseManager::set_room_location(const std::string& room_id, const std::string& user_id,
+                                        double latitude, double longitude, std::string& name) {
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("set_room_location", room_id, latitude, longitude, user_id);
+        txn.commit();
+        
+        if (!result.empty()) {
+            name = result[0]["name"].c_str();
+            return true;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to set room location: " << e.what() << std::endl;
+    }
+    
+    return false;
+}
+
+std::vector<RoomLocation> DatabaseManager::get_room_locations_changed(int64_t after_ms, int64_t& horizon_ms, int lag_ms) {
+    std::vector<RoomLocation> rooms;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_room_locations_changed", after_ms, lag_ms);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            horizon_ms = row["horizon_ms"].as<int64_t>();
+            if (row["id"].is_null()) {
+                continue;
+            }
+            RoomLocation room;
+            room.room_id = row["id"].c_str();
+            room.name = row["name"].c_str();
+            room.listed = row["listed"].as<bool>(false);
+            if (room.listed) {
+                room.latitude = row["latitude"].as<double>();
+                room.longitude = row["longitude"].as<double>();
+            }
+            rooms.push_back(std::move(room));
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to read room locations: " << e.what() << std::endl;
+    }
+    
+    return rooms;
+}
+
+bool DatabaseManager::set_relationship(const std::string& user_id, const std::string& target_user_id,
+                                       const std::string& relationship_type, bool active) {
+    if (user_id == target_user_id) {
+        return false;
+    }
+    
+    try {
+        pqxx::work txn(*connection_);
+        txn.exec_prepared(active ? "add_relationship" : "remove_relationship",
+                          user_id, target_user_id, relationship_type);
+        txn.commit();
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to update " << relationship_type << " relationship: " << e.what() << std::endl;
+        return false;
+    }
 }
 
 bool DatabaseManager::block_user(const std::string& user_id, const std::string& target_user_id) {
-    // TODO: Implement when needed
-    return true;
+    return set_relationship(user_id, target_user_id, "blocked", true);
 }
 
 bool DatabaseManager::unblock_user(const std::string& user_id, const std::string& target_user_id) {
-    // TODO: Implement when needed
-    return true;
+    return set_relationship(user_id, target_user_id, "blocked", false);
+}
+
+bool DatabaseManager::mute_user(const std::string& user_id, const std::string& target_user_id) {
+    return set_relationship(user_id, target_user_id, "muted", true);
+}
+
+bool DatabaseManager::unmute_user(const std::string& user_id, const std::string& target_user_id) {
+    return set_relationship(user_id, target_user_id, "muted", false);
 }
 
 bool DatabaseManager::is_user_blocked(const std::string& user_id, const std::string& target_user_id) {
-    // TODO: Implement when needed
-    return false;
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("has_relationship", user_id, target_user_id, "blocked");
+        txn.commit();
+        
+        return !result.empty() && result[0][0].as<int>() > 0;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to check block: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::vector<std::string> DatabaseManager::get_filtered_senders(const std::string& user_id) {
+    std::vector<std::string> senders;
+    
+    try {
+        pqxx::work txn(*connection_);
+        pqxx::result result = txn.exec_prepared("get_filtered_senders", user_id);
+        txn.commit();
+        
+        for (const auto& row : result) {
+            senders.push_back(row[0].c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Failed to load blocked/muted users: " << e.what() << std::endl;
+    }
+    
+    return senders;
 }
 
 bool DatabaseManager::clear_typing_indicator(const std::string& room_id, const std::string& user_id) {
@@ -0,0 +1,162 @@
+#include "../include/delivery_tracker.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <iostream>
+
+namespace caffis {
+
+DeliveryTracker& delivery_tracker() {
+    static DeliveryTracker tracker;
+    return tracker;
+}
+
+void DeliveryTracker::configure(const config::DeliveryConfig& delivery_config) {
+    settings_ = delivery_config;
+    settings_.tracked_per_room = std::max(1, settings_.tracked_per_room);
+    enabled_ = delivery_config.enabled;
+}
+
+// Acks are for what was just delivered, so search from the newest end
+DeliveryTracker::Entry* DeliveryTracker::find_locked(RoomState& state, const std::string& message_id) {
+    for (auto it = state.entries.rbegin(); it != state.entries.rend(); ++it) {
+        if (it->message_id == message_id) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+void DeliveryTracker::track(IdHandle room, const std::string& message_id, IdHandle sender) {
+    if (!enabled_ || room == NO_ID) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    RoomState& state = rooms_[room];
+    if (state.entries.size() >= static_cast<size_t>(settings_.tracked_per_room)) {
+        state.entries.pop_front();
+        tracked_--;
+    }
+    Entry entry;
+    entry.message_id = message_id;
+    entry.ordinal = state.next_ordinal++;
+    entry.sender = sender;
+    entry.tracked_at = std::chrono::steady_clock::now();
+    state.entries.push_back(std::move(entry));
+    tracked_++;
+}
+
+void DeliveryTracker::set_recipients(IdHandle room, const std::string& message_id, uint32_t total) {
+    if (!enabled_ || room == NO_ID) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room);
+    Entry* entry = it == rooms_.end() ? nullptr : find_locked(it->second, message_id);
+    if (entry) {
+        entry->total = total;
+        entry->delivered = std::min(entry->delivered, total);
+        entry->dirty = true;
+    }
+}
+
+size_t DeliveryTracker::acknowledge(IdHandle room, IdHandle user, const std::vector<std::string>& message_ids) {
+    static auto& counted = metrics::counter("caffis_delivery_acks_total");
+    static auto& ignored = metrics::counter("caffis_delivery_acks_ignored_total");
+    if (!enabled_ || room == NO_ID || user == NO_ID) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        ignored.inc(message_ids.size());
+        return 0;
+    }
+    RoomState& state = it->second;
+
+    std::vector<Entry*> acked;
+    acked.reserve(message_ids.size());
+    for (const auto& message_id : message_ids) {
+        Entry* entry = find_locked(state, message_id);
+        if (entry && entry->sender != user) {
+            acked.push_back(entry);
+        }
+    }
+    std::sort(acked.begin(), acked.end(), [](const Entry* a, const Entry* b) { return a->ordinal < b->ordinal; });
+
+    uint64_t& mark = state.acked_up_to[user];
+    size_t new_deliveries = 0;
+    for (Entry* entry : acked) {
+        if (entry->ordinal <= mark) {
+            continue;  // another device of this user, or a duplicate in the batch
+        }
+        mark = entry->ordinal;
+        // total is 0 only while the broadcast is still running
+        if (entry->total == 0 || entry->delivered < entry->total) {
+            entry->delivered++;
+            entry->dirty = true;
+            new_deliveries++;
+        }
+    }
+    counted.inc(new_deliveries);
+    ignored.inc(message_ids.size() - new_deliveries);
+    return new_deliveries;
+}
+
+std::vector<std::pair<IdHandle, std::vector<DeliveryStatus>>> DeliveryTracker::collect_updates() {
+    std::vector<std::pair<IdHandle, std::vector<DeliveryStatus>>> updates;
+    if (!enabled_) {
+        return updates;
+    }
+    const auto expire_before = std::chrono::steady_clock::now() - std::chrono::seconds(settings_.track_seconds);
+
+    std::unordered_map<IdHandle, size_t> by_sender;  // sender -> index in updates
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto room_it = rooms_.begin(); room_it != rooms_.end();) {
+        RoomState& state = room_it->second;
+        for (Entry& entry : state.entries) {
+            if (!entry.dirty || entry.total == 0 || entry.sender == NO_ID) {
+                continue;
+            }
+            entry.dirty = false;
+            auto slot = by_sender.emplace(entry.sender, updates.size());
+            if (slot.second) {
+                updates.emplace_back(entry.sender, std::vector<DeliveryStatus>());
+            }
+            DeliveryStatus status;
+            status.room_id = interned_ids().to_string(room_it->first);
+            status.message_id = entry.message_id;
+            status.delivered = entry.delivered;
+            status.total = entry.total;
+            updates[slot.first->second].second.push_back(std::move(status));
+        }
+
+        while (!state.entries.empty() && state.entries.front().tracked_at < expire_before) {
+            state.entries.pop_front();
+            tracked_--;
+        }
+        if (state.entries.empty()) {
+            room_it = rooms_.erase(room_it);  // marks go too: nothing left to dedupe against
+        } else {
+            ++room_it;
+        }
+    }
+    return updates;
+}
+
+size_t DeliveryTracker::tracked() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tracked_;
+}
+
+size_t DeliveryTracker::memory_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = rooms_.size() * (sizeof(IdHandle) + sizeof(RoomState) + 2 * sizeof(void*));
+    bytes += tracked_ * (sizeof(Entry) + 37);  // UUID text on the heap
+    for (const auto& [room, state] : rooms_) {
+        bytes += state.acked_up_to.size() * (sizeof(IdHandle) + sizeof(uint64_t) + 2 * sizeof(void*));
+    }
+    return bytes;
+}
+
+} // namespace caffis
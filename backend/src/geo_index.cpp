@@ -0,0 +1,238 @@
+#include "../include/geo_index.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace caffis {
+
+GeoIndex& geo_index() {
+    static GeoIndex index;
+    return index;
+}
+
+constexpr int GeoIndex::LEVEL_BITS[GeoIndex::LEVEL_COUNT];
+
+namespace {
+
+constexpr double EARTH_RADIUS_KM = 6371.0;
+constexpr double KM_PER_DEGREE_LAT = 111.32;
+constexpr double PI = 3.14159265358979323846;
+
+double radians(double degrees) {
+    return degrees * PI / 180.0;
+}
+
+// Spread the low 32 bits of v to the even bit positions
+uint64_t spread_bits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+}
+
+} // namespace
+
+bool GeoIndex::valid_coordinates(double latitude, double longitude) {
+    return std::isfinite(latitude) && std::isfinite(longitude)
+        && latitude >= -90.0 && latitude <= 90.0 && longitude >= -180.0 && longitude <= 180.0;
+}
+
+// Haversine
+double GeoIndex::distance_km(double lat1, double lon1, double lat2, double lon2) {
+    double dlat = radians(lat2 - lat1);
+    double dlon = radians(lon2 - lon1);
+    double a = std::sin(dlat / 2) * std::sin(dlat / 2)
+             + std::cos(radians(lat1)) * std::cos(radians(lat2)) * std::sin(dlon / 2) * std::sin(dlon / 2);
+    return 2 * EARTH_RADIUS_KM * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+// Interleaved like a geohash (lon on odd bits, lat on even), level in the top byte
+uint64_t GeoIndex::cell_key(int level, uint32_t lat_cell, uint32_t lon_cell) {
+    return (static_cast<uint64_t>(level) << 56) | (spread_bits(lon_cell) << 1) | spread_bits(lat_cell);
+}
+
+uint32_t GeoIndex::lat_cell(double latitude, int bits) {
+    uint32_t cells = 1u << bits;
+    auto cell = static_cast<uint32_t>((latitude + 90.0) / 180.0 * cells);
+    return std::min(cell, cells - 1);
+}
+
+uint32_t GeoIndex::lon_cell(double longitude, int bits) {
+    uint32_t cells = 1u << bits;
+    auto cell = static_cast<uint32_t>((longitude + 180.0) / 360.0 * cells);
+    return std::min(cell, cells - 1);
+}
+
+// ================================================
+// UPDATES
+// ================================================
+void GeoIndex::unlink_locked(IdHandle room, const Entry& entry) {
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        auto it = cells_.find(entry.cells[level]);
+        if (it == cells_.end()) {
+            continue;
+        }
+        auto& members = it->second;
+        auto pos = std::find_if(members.begin(), members.end(),
+                                [room](const CellMember& member) { return member.room == room; });
+        if (pos != members.end()) {
+            *pos = members.back();
+            members.pop_back();
+        }
+        if (members.empty()) {
+            cells_.erase(it);
+        }
+    }
+}
+
+void GeoIndex::upsert(const std::string& room_id, const std::string& name, double latitude, double longitude) {
+    if (!valid_coordinates(latitude, longitude)) {
+        return;
+    }
+    IdHandle room = interned_ids().intern(room_id);
+
+    Entry entry;
+    entry.name = name;
+    entry.latitude = latitude;
+    entry.longitude = longitude;
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        int bits = LEVEL_BITS[level];
+        entry.cells[level] = cell_key(level, lat_cell(latitude, bits), lon_cell(longitude, bits));
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto existing = rooms_.find(room);
+    if (existing != rooms_.end()) {
+        unlink_locked(room, existing->second);
+    }
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        cells_[entry.cells[level]].push_back(
+            CellMember{static_cast<float>(latitude), static_cast<float>(longitude), room});
+    }
+    rooms_[room] = std::move(entry);
+}
+
+void GeoIndex::remove(const std::string& room_id) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        return;
+    }
+    unlink_locked(room, it->second);
+    rooms_.erase(it);
+}
+
+// ================================================
+// QUERIES
+// ================================================
+std::vector<NearbyRoom> GeoIndex::nearby(double latitude, double longitude, double radius_km, size_t limit) const {
+    std::vector<NearbyRoom> found;
+    if (!valid_coordinates(latitude, longitude) || radius_km <= 0 || limit == 0) {
+        return found;
+    }
+    radius_km = std::min(radius_km, MAX_RADIUS_KM);
+
+    // Search box in degrees; longitude degrees shrink towards the poles
+    double dlat = radius_km / KM_PER_DEGREE_LAT;
+    double cos_lat = std::cos(radians(latitude));
+    double dlon = cos_lat < 1e-6 ? 360.0 : std::min(360.0, radius_km / (KM_PER_DEGREE_LAT * cos_lat));
+    double min_lat = std::max(-90.0, latitude - dlat);
+    double max_lat = std::min(90.0, latitude + dlat);
+
+    // Finest level whose covering stays small
+    int level = 0;
+    for (int candidate = LEVEL_COUNT - 1; candidate >= 0; --candidate) {
+        double cells = 1u << LEVEL_BITS[candidate];
+        double rows = std::floor((max_lat + 90.0) / 180.0 * cells) - std::floor((min_lat + 90.0) / 180.0 * cells) + 1;
+        double cols = std::min(cells, std::ceil(2 * dlon / 360.0 * cells) + 1);
+        if (rows * cols <= MAX_QUERY_CELLS) {
+            level = candidate;
+            break;
+        }
+    }
+    int bits = LEVEL_BITS[level];
+    uint32_t lon_cells = 1u << bits;
+    uint32_t lat_first = lat_cell(min_lat, bits);
+    uint32_t lat_last = lat_cell(max_lat, bits);
+    uint32_t lon_first = lon_cell(std::max(-180.0, longitude - dlon), bits);
+    uint32_t lon_span = dlon >= 180.0 ? lon_cells
+                      : std::min(lon_cells, static_cast<uint32_t>(std::ceil(2 * dlon / 360.0 * lon_cells)) + 1);
+    if (longitude - dlon < -180.0) {
+        // Box crosses the antimeridian: start on the far side and wrap
+        lon_first = lon_cell(longitude - dlon + 360.0, bits);
+    }
+
+    // Rank on (distance, handle) and only materialize the rooms returned
+    std::vector<std::pair<double, IdHandle>> candidates;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (uint32_t lat_c = lat_first; lat_c <= lat_last; ++lat_c) {
+        for (uint32_t step = 0; step < lon_span; ++step) {
+            uint32_t lon_c = (lon_first + step) % lon_cells;
+            auto cell = cells_.find(cell_key(level, lat_c, lon_c));
+            if (cell == cells_.end()) {
+                continue;
+            }
+            for (const CellMember& member : cell->second) {
+                // Cheap box test first; haversine only for what is left
+                if (member.latitude < min_lat || member.latitude > max_lat) {
+                    continue;
+                }
+                double lon_delta = std::fabs(member.longitude - longitude);
+                if (std::min(lon_delta, 360.0 - lon_delta) > dlon) {
+                    continue;
+                }
+                double distance = distance_km(latitude, longitude, member.latitude, member.longitude);
+                if (distance <= radius_km) {
+                    candidates.emplace_back(distance, member.room);
+                }
+            }
+        }
+    }
+
+    if (candidates.size() > limit) {
+        std::partial_sort(candidates.begin(), candidates.begin() + limit, candidates.end());
+        candidates.resize(limit);
+    } else {
+        std::sort(candidates.begin(), candidates.end());
+    }
+
+    found.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        IdHandle room = candidate.second;
+        const Entry& entry = rooms_.at(room);
+        NearbyRoom match;
+        match.room_id = interned_ids().to_string(room);
+        match.name = entry.name;
+        match.latitude = entry.latitude;
+        match.longitude = entry.longitude;
+        match.distance_km = distance_km(latitude, longitude, entry.latitude, entry.longitude);
+        found.push_back(std::move(match));
+    }
+    return found;
+}
+
+size_t GeoIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return rooms_.size();
+}
+
+size_t GeoIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = rooms_.size() * (sizeof(IdHandle) + sizeof(Entry) + 2 * sizeof(void*));
+    for (const auto& [room, entry] : rooms_) {
+        bytes += entry.name.size() > 15 ? entry.name.capacity() : 0;
+    }
+    for (const auto& [key, members] : cells_) {
+        bytes += sizeof(key) + sizeof(members) + 2 * sizeof(void*) + members.capacity() * sizeof(CellMember);
+    }
+    return bytes;
+}
+
+} // namespace caffis
@@ -0,0 +1,379 @@
+#include "../include/hot_cache.h"
+#include "../include/database_manager.h"
+#include <algorithm>
+#include <iostream>
+
+namespace caffis {
+
+HotCache& hot_cache() {
+    static HotCache cache;
+    return cache;
+}
+
+// ================================================
+// USERS
+// ================================================
+bool HotCache::get_user(const std::string& user_id, CachedUser& user) {
+    IdHandle handle = interned_ids().find(user_id);
+    if (handle == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    auto it = users_.find(handle);
+    if (it == users_.end()) {
+        return false;
+    }
+    user = it->second;
+    return true;
+}
+
+void HotCache::put_user(const std::string& user_id, const CachedUser& user) {
+    IdHandle handle = interned_ids().intern(user_id);
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    if (users_.size() >= MAX_USERS && !users_.count(handle)) {
+        users_.erase(users_.begin());
+    }
+    users_[handle] = user;
+}
+
+// ================================================
+// ROOM MEMBERSHIP
+// ================================================
+bool HotCache::is_room_member(const std::string& room_id, const std::string& user_id) {
+    IdHandle room = interned_ids().find(room_id);
+    IdHandle user = interned_ids().find(user_id);
+    if (room == NO_ID || user == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    auto it = room_members_.find(room);
+    return it != room_members_.end() && it->second.count(user) > 0;
+}
+
+void HotCache::add_room_member(const std::string& room_id, const std::string& user_id) {
+    IdHandle room = interned_ids().intern(room_id);
+    IdHandle user = interned_ids().intern(user_id);
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    if (room_members_.size() >= MAX_ROOMS && !room_members_.count(room)) {
+        room_members_.erase(room_members_.begin());
+    }
+    room_members_[room].insert(user);
+}
+
+void HotCache::set_room_members(const std::string& room_id, const std::vector<std::string>& user_ids) {
+    IdHandle room = interned_ids().intern(room_id);
+    std::unordered_set<IdHandle> members;
+    members.reserve(user_ids.size());
+    for (const auto& user_id : user_ids) {
+        members.insert(interned_ids().intern(user_id));
+    }
+    
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    if (room_members_.size() >= MAX_ROOMS && !room_members_.count(room)) {
+        room_members_.erase(room_members_.begin());
+    }
+    room_members_[room] = std::move(members);
+}
+
+// ================================================
+// ROOM TAILS
+// ================================================
+bool HotCache::get_room_tail(const std::string& room_id, size_t limit, std::vector<Message>& messages) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return false;
+    }
+    const auto& tail = it->second;
+    size_t count = std::min(limit, tail.size());
+    messages.assign(tail.end() - count, tail.end());
+    return true;
+}
+
+void HotCache::set_room_tail(const std::string& room_id, const std::vector<Message>& messages, bool complete) {
+    IdHandle room = interned_ids().intern(room_id);
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    if (room_tails_.size() >= MAX_ROOMS && !room_tails_.count(room)) {
+        tail_meta_.erase(room_tails_.begin()->first);
+        room_tails_.erase(room_tails_.begin());
+    }
+    size_t skip = messages.size() > ROOM_TAIL_CAPACITY ? messages.size() - ROOM_TAIL_CAPACITY : 0;
+    room_tails_[room] = std::deque<Message>(messages.begin() + skip, messages.end());
+    // An empty load may just as well be a failed query
+    tail_meta_[room] = TailMeta{next_tail_version_++, complete && skip == 0 && !messages.empty()};
+}
+
+void HotCache::append_message(const Message& message) {
+    IdHandle room = interned_ids().find(message.room_id);
+    if (room == NO_ID) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return;  // not loaded yet: the first reader fills it from the DB
+    }
+    it->second.push_back(message);
+    TailMeta& meta = tail_meta_[room];
+    if (it->second.size() > ROOM_TAIL_CAPACITY) {
+        it->second.pop_front();
+        meta.complete = false;
+    }
+    meta.version = next_tail_version_++;
+}
+
+bool HotCache::edit_cached_message(const std::string& room_id, const std::string& message_id, const std::string& content) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return false;
+    }
+    // Edits almost always target recent messages: search newest first
+    for (auto msg = it->second.rbegin(); msg != it->second.rend(); ++msg) {
+        if (msg->id == message_id) {
+            msg->content = content;
+            msg->is_edited = true;
+            tail_meta_[room].version = next_tail_version_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void HotCache::set_seq(const std::string& room_id, const std::string& message_id, int64_t seq) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID || seq <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return;
+    }
+    auto& tail = it->second;
+    for (size_t i = tail.size(); i-- > 0;) {
+        if (tail[i].id != message_id) {
+            continue;
+        }
+        // Concurrent sends can commit in another order than they were appended
+        for (size_t j = 0; j < tail.size(); ++j) {
+            bool misplaced = j < i ? tail[j].seq > seq : tail[j].seq != 0 && tail[j].seq < seq;
+            if (j != i && misplaced) {
+                room_tails_.erase(it);
+                tail_meta_.erase(room);
+                return;
+            }
+        }
+        tail[i].seq = seq;
+        tail_meta_[room].version = next_tail_version_++;
+        return;
+    }
+}
+
+// History never returns deleted messages, so the tail just forgets it
+bool HotCache::remove_cached_message(const std::string& room_id, const std::string& message_id) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return false;
+    }
+    auto& tail = it->second;
+    auto msg = std::find_if(tail.rbegin(), tail.rend(),
+                            [&](const Message& cached) { return cached.id == message_id; });
+    if (msg == tail.rend()) {
+        return false;
+    }
+    tail.erase(std::next(msg).base());
+    tail_meta_[room].version = next_tail_version_++;
+    return true;
+}
+
+void HotCache::drop_room_tail(const std::string& room_id) {
+    IdHandle room = interned_ids().find(room_id);
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    room_tails_.erase(room);
+    tail_meta_.erase(room);
+}
+
+bool HotCache::get_room_tail_version(const std::string& room_id, uint64_t& version) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = tail_meta_.find(room);
+    if (it == tail_meta_.end()) {
+        return false;
+    }
+    version = it->second.version;
+    return true;
+}
+
+bool HotCache::get_room_page(const std::string& room_id, size_t limit, int64_t before_seq,
+                             std::vector<Message>& messages, uint64_t& version) {
+    IdHandle room = interned_ids().find(room_id);
+    if (room == NO_ID || limit == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    auto it = room_tails_.find(room);
+    if (it == room_tails_.end()) {
+        return false;
+    }
+    const auto& tail = it->second;
+    const TailMeta& meta = tail_meta_[room];
+    
+    // Messages sent on this node get their seq only in the DB: fine at the
+    // newest end of a first page, but a cursor can't be placed among them
+    size_t end = tail.size();
+    if (before_seq > 0) {
+        end = 0;
+        while (end < tail.size() && tail[end].seq < before_seq) {
+            if (tail[end].seq == 0) {
+                return false;
+            }
+            ++end;
+        }
+    }
+    size_t begin = end > limit ? end - limit : 0;
+    if (end - begin < limit && !meta.complete) {
+        return false;  // the page reaches below the tail: the DB has to answer
+    }
+    if (end > begin && tail[begin].seq == 0) {
+        return false;  // no cursor for the next page
+    }
+    messages.assign(tail.begin() + static_cast<std::ptrdiff_t>(begin), tail.begin() + static_cast<std::ptrdiff_t>(end));
+    version = meta.version;
+    return true;
+}
+
+// Snapshots store text ids so they stay valid across restarts (handles don't)
+HotCacheContents HotCache::export_contents() {
+    InternTable& ids = interned_ids();
+    HotCacheContents contents;
+    {
+        std::lock_guard<std::mutex> lock(users_mutex_);
+        contents.users.reserve(users_.size());
+        for (const auto& [user, cached] : users_) {
+            contents.users.emplace_back(ids.to_string(user), cached);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(members_mutex_);
+        contents.room_members.reserve(room_members_.size());
+        for (const auto& [room, members] : room_members_) {
+            std::vector<std::string> user_ids;
+            user_ids.reserve(members.size());
+            for (IdHandle user : members) {
+                user_ids.push_back(ids.to_string(user));
+            }
+            contents.room_members.emplace_back(ids.to_string(room), std::move(user_ids));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(tails_mutex_);
+        contents.room_tails.reserve(room_tails_.size());
+        for (const auto& [room, tail] : room_tails_) {
+            contents.room_tails.emplace_back(ids.to_string(room), std::vector<Message>(tail.begin(), tail.end()));
+        }
+    }
+    return contents;
+}
+
+size_t HotCache::user_count() {
+    std::lock_guard<std::mutex> lock(users_mutex_);
+    return users_.size();
+}
+
+size_t HotCache::room_tail_count() {
+    std::lock_guard<std::mutex> lock(tails_mutex_);
+    return room_tails_.size();
+}
+
+size_t HotCache::membership_room_count() {
+    std::lock_guard<std::mutex> lock(members_mutex_);
+    return room_members_.size();
+}
+
+namespace {
+
+// Heap bytes of a string beyond the object itself (0 while in the SSO buffer)
+size_t string_heap_bytes(const std::string& value) {
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+}
+
+// Per-entry overhead of a node-based hash container (node link + bucket slot)
+constexpr size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+
+} // namespace
+
+size_t HotCache::memory_bytes() {
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(users_mutex_);
+        for (const auto& [user, cached] : users_) {
+            bytes += sizeof(IdHandle) + sizeof(CachedUser) + HASH_NODE_OVERHEAD
+                   + string_heap_bytes(cached.username) + string_heap_bytes(cached.display_name);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(members_mutex_);
+        for (const auto& [room, members] : room_members_) {
+            bytes += sizeof(IdHandle) + sizeof(members) + HASH_NODE_OVERHEAD
+                   + members.size() * (sizeof(IdHandle) + HASH_NODE_OVERHEAD);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(tails_mutex_);
+        for (const auto& [room, tail] : room_tails_) {
+            bytes += 2 * (sizeof(IdHandle) + HASH_NODE_OVERHEAD) + sizeof(tail) + sizeof(TailMeta);
+            for (const auto& msg : tail) {
+                bytes += sizeof(Message) + string_heap_bytes(msg.id) + string_heap_bytes(msg.room_id)
+                       + string_heap_bytes(msg.sender_id) + string_heap_bytes(msg.content);
+            }
+        }
+    }
+    return bytes;
+}
+
+// ================================================
+// STARTUP WARM-UP
+// ================================================
+size_t warm_up_hot_cache(DatabaseManager& database, int hot_room_limit) {
+    HotCache& cache = hot_cache();
+    std::vector<std::string> room_ids = database.get_hot_room_ids(hot_room_limit);
+    std::unordered_set<std::string> sender_ids;
+
+    for (const auto& room_id : room_ids) {
+        std::vector<Message> messages = database.get_room_messages(room_id, HotCache::ROOM_TAIL_CAPACITY);
+        std::reverse(messages.begin(), messages.end());
+        for (const auto& msg : messages) {
+            sender_ids.insert(msg.sender_id);
+        }
+        cache.set_room_tail(room_id, messages, messages.size() < HotCache::ROOM_TAIL_CAPACITY);
+        cache.set_room_members(room_id, database.get_room_participants(room_id));
+    }
+
+    std::vector<ChatUser> users = database.get_users(
+        std::vector<std::string>(sender_ids.begin(), sender_ids.end()));
+    for (const auto& user : users) {
+        cache.put_user(user.id, CachedUser{user.username, user.display_name});
+    }
+
+    std::cout << "🔥 Cache warm-up: " << room_ids.size() << " rooms, " << users.size() << " users" << std::endl;
+    return room_ids.size();
+}
+
+} // namespace caffis
@@ -0,0 +1,215 @@
+#include "../include/hot_rooms.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace caffis {
+
+HotRooms& hot_rooms() {
+    static HotRooms rooms;
+    return rooms;
+}
+
+void HotRooms::configure(const config::HotRoomConfig& hot_room_config) {
+    settings_ = hot_room_config;
+    settings_.batch_ms = std::max(1, settings_.batch_ms);
+    settings_.classify_seconds = std::max(1, settings_.classify_seconds);
+    settings_.cool_percent = std::clamp(settings_.cool_percent, 0, 100);
+    enabled_ = hot_room_config.enabled;
+}
+
+bool HotRooms::enqueue(IdHandle room, HotFrame frame) {
+    if (!enabled_ || room == NO_ID) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        return false;
+    }
+    it->second.pending.push_back(std::move(frame));
+    return true;
+}
+
+std::vector<std::pair<IdHandle, std::vector<HotFrame>>> HotRooms::take_batches() {
+    std::vector<std::pair<IdHandle, std::vector<HotFrame>>> batches;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [room, state] : rooms_) {
+        if (!state.pending.empty() && !state.draining) {
+            batches.emplace_back(room, std::move(state.pending));
+            state.pending.clear();
+        }
+    }
+    return batches;
+}
+
+bool HotRooms::is_hot_activity(const RoomActivity& activity) const {
+    return activity.members >= static_cast<uint32_t>(settings_.hot_members)
+        || activity.per_minute_1m >= settings_.hot_messages_per_minute;
+}
+
+bool HotRooms::is_cool_activity(const RoomActivity& activity) const {
+    const double share = settings_.cool_percent / 100.0;
+    return activity.members < settings_.hot_members * share
+        && activity.per_minute_1m < settings_.hot_messages_per_minute * share;
+}
+
+void HotRooms::reclassify(const std::vector<RoomActivity>& rooms,
+                          const std::function<void(IdHandle, std::vector<HotFrame>&)>& drain) {
+    static auto& to_hot = metrics::counter("caffis_room_class_transitions_total{to=\"hot\"}");
+    static auto& to_direct = metrics::counter("caffis_room_class_transitions_total{to=\"direct\"}");
+    static auto& hot_gauge = metrics::gauge("caffis_rooms_by_class{class=\"hot\"}");
+    static auto& direct_gauge = metrics::gauge("caffis_rooms_by_class{class=\"direct\"}");
+    static auto& drain_failures = metrics::counter("caffis_hot_room_drain_failures_total");
+    if (!enabled_) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto min_hot = std::chrono::seconds(settings_.min_hot_seconds);
+    const auto typing_expiry = std::chrono::milliseconds(settings_.typing_interval_ms);
+
+    std::unordered_map<IdHandle, const RoomActivity*> activity;
+    activity.reserve(rooms.size());
+    for (const auto& room : rooms) {
+        activity.emplace(room.room, &room);
+    }
+
+    std::vector<std::pair<IdHandle, std::vector<HotFrame>>> cooled;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& room : rooms) {
+        if (room.room != NO_ID && !rooms_.count(room.room) && is_hot_activity(room)) {
+            rooms_[room.room].hot_since = now;
+            to_hot.inc();
+            std::cout << "🔥 Room " << room.room_id << " is hot (" << room.members << " members, "
+                      << room.per_minute_1m << " msg/min): batched delivery" << std::endl;
+        }
+    }
+
+    for (auto it = rooms_.begin(); it != rooms_.end();) {
+        auto current = activity.find(it->first);
+        bool cool = current == activity.end() || is_cool_activity(*current->second);
+        if (cool && !it->second.draining && now - it->second.hot_since >= min_hot) {
+            if (it->second.pending.empty()) {
+                to_direct.inc();
+                std::cout << "🧊 Room " << interned_ids().to_string(it->first) << " cooled down: direct delivery" << std::endl;
+                it = rooms_.erase(it);
+                continue;
+            }
+            // Delivered below, without the lock; frames sent meanwhile still queue behind them
+            it->second.draining = true;
+            cooled.emplace_back(it->first, std::move(it->second.pending));
+            it->second.pending.clear();
+        }
+
+        // Typers who went quiet without an is_typing=false
+        auto& typing = it->second.typing_forwarded;
+        for (auto user = typing.begin(); user != typing.end();) {
+            user = now - user->second > 2 * typing_expiry ? typing.erase(user) : std::next(user);
+        }
+        ++it;
+    }
+
+    lock.unlock();
+
+    // A cooled room leaves the hot set only once nothing is queued for it,
+    // so no direct send overtakes a frame still waiting here
+    for (auto& [room, frames] : cooled) {
+        while (!frames.empty()) {
+            try {
+                drain(room, frames);
+            } catch (...) {
+                // Stay hot with the frames queued again in front of whatever came
+                // meanwhile: the next batch retries them. Other rooms still drain.
+                drain_failures.inc();
+                std::cerr << "❌ Draining cooled room " << interned_ids().to_string(room)
+                          << " failed: " << frames.size() << " frames requeued" << std::endl;
+                std::lock_guard<std::mutex> relock(mutex_);
+                HotRoom& state = rooms_[room];
+                state.draining = false;
+                frames.insert(frames.end(), std::make_move_iterator(state.pending.begin()),
+                              std::make_move_iterator(state.pending.end()));
+                state.pending = std::move(frames);
+                frames.clear();
+                break;
+            }
+            frames.clear();
+
+            lock.lock();
+            auto it = rooms_.find(room);
+            frames = std::move(it->second.pending);
+            it->second.pending.clear();
+            if (frames.empty()) {
+                rooms_.erase(it);
+                to_direct.inc();
+                std::cout << "🧊 Room " << interned_ids().to_string(room) << " cooled down: direct delivery" << std::endl;
+            }
+            lock.unlock();
+        }
+    }
+
+    lock.lock();
+    hot_gauge.set(static_cast<int64_t>(rooms_.size()));
+    direct_gauge.set(static_cast<int64_t>(rooms.size() > rooms_.size() ? rooms.size() - rooms_.size() : 0));
+}
+
+bool HotRooms::sample_typing(IdHandle room, IdHandle user, bool is_typing) {
+    if (!enabled_) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(room);
+    if (it == rooms_.end()) {
+        return true;
+    }
+    HotRoom& state = it->second;
+    const auto now = std::chrono::steady_clock::now();
+
+    // A stop only matters to those who were shown the start
+    auto forwarded = state.typing_forwarded.find(user);
+    if (!is_typing) {
+        if (forwarded == state.typing_forwarded.end()) {
+            return false;
+        }
+        state.typing_forwarded.erase(forwarded);
+        return true;
+    }
+
+    if (forwarded != state.typing_forwarded.end() &&
+        now - forwarded->second < std::chrono::milliseconds(settings_.typing_interval_ms)) {
+        return false;
+    }
+    const int64_t second = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    if (second != state.typing_second) {
+        state.typing_second = second;
+        state.typing_in_second = 0;
+    }
+    if (state.typing_in_second >= settings_.typing_per_second) {
+        return false;
+    }
+    state.typing_in_second++;
+    state.typing_forwarded[user] = now;
+    return true;
+}
+
+size_t HotRooms::hot_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rooms_.size();
+}
+
+size_t HotRooms::memory_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t bytes = rooms_.bucket_count() * sizeof(void*);
+    for (const auto& [room, state] : rooms_) {
+        bytes += sizeof(room) + sizeof(state) + 2 * sizeof(void*)
+               + state.pending.capacity() * sizeof(HotFrame)
+               + state.typing_forwarded.size() * (sizeof(IdHandle) + sizeof(std::chrono::steady_clock::time_point) + 2 * sizeof(void*));
+        for (const auto& frame : state.pending) {
+            bytes += frame.receipt_id.capacity();
+        }
+    }
+    return bytes;
+}
+
+} // namespace caffis
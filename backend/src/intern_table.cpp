@@ -0,0 +1,153 @@
+#include "../include/intern_table.h"
+#include <mutex>
+
+namespace caffis {
+
+InternTable& interned_ids() {
+    static InternTable table;
+    return table;
+}
+
+// ================================================
+// BINARY UUIDS
+// ================================================
+namespace {
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool is_hyphen_position(size_t i) {
+    return i == 8 || i == 13 || i == 18 || i == 23;
+}
+
+} // namespace
+
+bool Uuid128::parse(const std::string& text, Uuid128& out) {
+    if (text.size() != 36) {
+        return false;
+    }
+
+    uint64_t words[2] = {0, 0};
+    int nibbles = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (is_hyphen_position(i)) {
+            if (text[i] != '-') return false;
+            continue;
+        }
+        int value = hex_value(text[i]);
+        if (value < 0) return false;
+        uint64_t& word = words[nibbles / 16];
+        word = (word << 4) | static_cast<uint64_t>(value);
+        ++nibbles;
+    }
+
+    out.hi = words[0];
+    out.lo = words[1];
+    return true;
+}
+
+std::string Uuid128::to_string() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(36, '-');
+    int nibble = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (is_hyphen_position(i)) {
+            continue;
+        }
+        uint64_t word = nibble < 16 ? hi : lo;
+        int shift = 60 - 4 * (nibble % 16);
+        text[i] = digits[(word >> shift) & 0xF];
+        ++nibble;
+    }
+    return text;
+}
+
+// ================================================
+// INTERN TABLE
+// ================================================
+IdHandle InternTable::find(const std::string& id) const {
+    if (id.empty()) {
+        return NO_ID;
+    }
+
+    Uuid128 uuid;
+    bool binary = Uuid128::parse(id, uuid);
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (binary) {
+        auto it = by_uuid_.find(uuid);
+        return it == by_uuid_.end() ? NO_ID : it->second;
+    }
+    auto it = by_text_.find(id);
+    return it == by_text_.end() ? NO_ID : it->second;
+}
+
+IdHandle InternTable::intern(const std::string& id) {
+    IdHandle existing = find(id);
+    if (existing != NO_ID || id.empty()) {
+        return existing;
+    }
+
+    Uuid128 uuid;
+    bool binary = Uuid128::parse(id, uuid);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // Re-check: another thread may have interned it since the shared lookup
+    if (binary) {
+        auto it = by_uuid_.find(uuid);
+        if (it != by_uuid_.end()) {
+            return it->second;
+        }
+    } else {
+        auto it = by_text_.find(id);
+        if (it != by_text_.end()) {
+            return it->second;
+        }
+    }
+
+    ids_.push_back(uuid);
+    IdHandle handle = static_cast<IdHandle>(ids_.size());
+    if (binary) {
+        by_uuid_.emplace(uuid, handle);
+    } else {
+        by_text_.emplace(id, handle);
+        text_.emplace(handle, id);
+    }
+    return handle;
+}
+
+std::string InternTable::to_string(IdHandle handle) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (handle == NO_ID || handle > ids_.size()) {
+        return "";
+    }
+    if (!text_.empty()) {
+        auto it = text_.find(handle);
+        if (it != text_.end()) {
+            return it->second;
+        }
+    }
+    return ids_[handle - 1].to_string();
+}
+
+size_t InternTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return ids_.size();
+}
+
+size_t InternTable::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    // Approximate: vector slot + hash node per id, plus text of non-UUID ids
+    size_t bytes = ids_.capacity() * sizeof(Uuid128)
+                 + by_uuid_.size() * (sizeof(Uuid128) + sizeof(IdHandle) + 2 * sizeof(void*));
+    for (const auto& [handle, text] : text_) {
+        bytes += 2 * (text.capacity() + sizeof(std::string) + sizeof(void*));
+    }
+    return bytes;
+}
+
+} // namespace caffis
@@ -1,11 +1,28 @@
 #include "../include/websocket_server.h"
 #include "../include/database_manager.h"
 #include "../include/config.h"
+#include "../include/hot_cache.h"
+#include "../include/state_snapshot.h"
+#include "../include/metrics.h"
+#include "../include/thread_placement.h"
+#include "../include/outbound_queue.h"
+#include "../include/attachment_store.h"
+#include "../include/content_codec.h"
+#include "../include/traffic_capture.h"
+#include "../include/traffic_replay.h"
+#include "../include/soak_test.h"
 #include <iostream>
+#include <chrono>
+#include <future>
+#include <iomanip>
 #include <csignal>
 #include <memory>
 #include <cstdlib>
+#include <functional>
+#include <map>
 #include <string>
+#include <unistd.h>
+#include <vector>
 
 std::unique_ptr<caffis::WebSocketServer> server;
 std::unique_ptr<caffis::DatabaseManager> database;
@@ -32,6 +49,14 @@ std::string get_env_var(const char* name, const std::string& default_value = "")
     return value ? std::string(value) : default_value;
 }
 
+std::string default_node_id() {
+    char hostname[256] = {0};
+    if (gethostname(hostname, sizeof(hostname) - 1) != 0 || hostname[0] == '\0') {
+        return "node-" + std::to_string(getpid());
+    }
+    return std::string(hostname) + "-" + std::to_string(getpid());
+}
+
 void print_startup_banner() {
     std::cout << R"(
 ╔══════════════════════════════════════════════════════════════╗
@@ -69,7 +94,7 @@ bool validate_environment() {
     }
     
     // Optional but recommended variables
-    std::vector<std::string> optional_vars = {"MAIN_DATABASE_URL", "JWT_SECRET", "REDIS_HOST"};
+    std::vector<std::string> optional_vars = {"MAIN_DATABASE_URL", "JWT_SECRET", "REDIS_HOST", "CLUSTER_TRANSPORT", "NODE_ID", "SESSION_DIRECTORY", "CACHE_WARMUP_ROOMS", "SNAPSHOT_PATH"};
     for (const auto& var : optional_vars) {
         std::string value = get_env_var(var.c_str());
         if (value.empty()) {
@@ -82,7 +107,249 @@ bool validate_environment() {
     return valid;
 }
 
-int main() {
+long long elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+caffis::config::ContentCodecConfig content_codec_config_from_env() {
+    caffis::config::ContentCodecConfig codec_config;
+    codec_config.enabled = get_env_var("CONTENT_CODEC_ENABLED", "false") == "true";
+    codec_config.min_bytes = std::stoul(get_env_var("CONTENT_CODEC_MIN_BYTES", "512"));
+    codec_config.zstd_level = std::stoi(get_env_var("CONTENT_CODEC_ZSTD_LEVEL", "3"));
+    codec_config.dictionary_bytes = std::stoul(get_env_var("CONTENT_CODEC_DICTIONARY_BYTES", "65536"));
+    codec_config.training_samples = std::stoi(get_env_var("CONTENT_CODEC_TRAINING_SAMPLES", "50000"));
+    return codec_config;
+}
+
+// ================================================
+// DICTIONARY TRAINING (caffis_chat --train-content-dictionary [--dry-run])
+// ================================================
+// Samples recent bodies, trains a zstd dictionary on nine tenths of them and
+// reports what the codec would save on the rest, with and without it.
+struct CodecTrial {
+    size_t messages = 0;
+    size_t packed = 0;
+    uint64_t raw_bytes = 0;
+    uint64_t stored_bytes = 0;
+    uint64_t encode_us = 0;
+    uint64_t decode_us = 0;
+};
+
+CodecTrial run_codec_trial(caffis::ContentCodec& codec, const std::vector<std::string>& bodies) {
+    CodecTrial trial;
+    std::vector<std::string> packed(bodies.size());
+    std::vector<bool> is_packed(bodies.size());
+    
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        is_packed[i] = codec.encode(bodies[i], packed[i]);
+    }
+    trial.encode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    
+    std::string content;
+    begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        if (is_packed[i] && !codec.decode(packed[i], content)) {
+            std::cerr << "❌ Round trip failed for sample " << i << std::endl;
+        }
+    }
+    trial.decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        trial.messages++;
+        trial.raw_bytes += bodies[i].size();
+        trial.stored_bytes += is_packed[i] ? packed[i].size() : bodies[i].size();
+        trial.packed += is_packed[i] ? 1 : 0;
+    }
+    return trial;
+}
+
+void print_codec_trial(const std::string& label, const CodecTrial& trial) {
+    double ratio = trial.stored_bytes ? static_cast<double>(trial.raw_bytes) / trial.stored_bytes : 0;
+    double per_message = trial.messages ? 1.0 / trial.messages : 0;
+    std::cout << "   • " << label << ": " << trial.raw_bytes / 1024 << " KB -> " << trial.stored_bytes / 1024
+              << " KB (" << std::fixed << std::setprecision(2) << ratio << "x, " << trial.packed << "/" << trial.messages
+              << " packed), encode " << trial.encode_us * per_message << " us/msg, decode "
+              << trial.decode_us * per_message << " us/msg" << std::endl;
+}
+
+int train_content_dictionary(bool dry_run) {
+    caffis::config::ContentCodecConfig codec_config = content_codec_config_from_env();
+    std::string db_url = get_env_var("DATABASE_URL");
+    if (!caffis::ContentCodec::available()) {
+        std::cerr << "❌ This build has no zstd - nothing to train" << std::endl;
+        return 1;
+    }
+    if (db_url.empty()) {
+        std::cerr << "❌ DATABASE_URL environment variable not set!" << std::endl;
+        return 1;
+    }
+    
+    caffis::DatabaseManager db(db_url);
+    if (!db.connect()) {
+        return 1;
+    }
+    // Already-packed rows are sampled too, so the current dictionaries must decode
+    caffis::content_codec().configure(codec_config);
+    for (const auto& [id, dictionary] : db.get_content_dictionaries()) {
+        caffis::content_codec().add_dictionary(id, dictionary);
+    }
+    
+    // Short lines still teach the dictionary the phrasing of chat text
+    std::vector<std::string> samples = db.get_content_samples(codec_config.training_samples, 32);
+    std::vector<std::string> training;
+    std::vector<std::string> held_out;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        (i % 10 == 9 ? held_out : training).push_back(std::move(samples[i]));
+    }
+    std::cout << "📚 Sampled " << training.size() + held_out.size() << " bodies (" << held_out.size()
+              << " held out for the report)" << std::endl;
+    
+    std::string dictionary = caffis::ContentCodec::train_dictionary(training, codec_config.dictionary_bytes);
+    if (dictionary.empty()) {
+        std::cerr << "❌ Not enough message text to train a dictionary" << std::endl;
+        return 1;
+    }
+    std::cout << "✅ Trained a " << dictionary.size() / 1024 << " KB dictionary" << std::endl;
+    
+    // Same settings as the live codec, so the report counts what save_message would pack
+    caffis::config::ContentCodecConfig trial_config = codec_config;
+    trial_config.enabled = true;
+    caffis::ContentCodec plain;
+    plain.configure(trial_config);
+    caffis::ContentCodec with_dictionary;
+    with_dictionary.configure(trial_config);
+    with_dictionary.add_dictionary(1, dictionary);
+    
+    std::cout << "📊 Held-out bodies, codec threshold " << codec_config.min_bytes << " bytes:" << std::endl;
+    print_codec_trial("zstd", run_codec_trial(plain, held_out));
+    print_codec_trial("zstd + dictionary", run_codec_trial(with_dictionary, held_out));
+    
+    if (dry_run) {
+        std::cout << "🧪 Dry run - dictionary not saved" << std::endl;
+        return 0;
+    }
+    uint32_t id = db.save_content_dictionary(dictionary, static_cast<int>(training.size()));
+    if (id == 0) {
+        return 1;
+    }
+    std::cout << "💾 Saved as dictionary #" << id << " - nodes encode with it after their next restart" << std::endl;
+    return 0;
+}
+
+// ================================================
+// TRAFFIC REPLAY (caffis_chat --replay <capture> [--target host:port] [--speed x]
+//                 [--users file] [--rooms file] [--drain seconds] [--report file] [--baseline file])
+// ================================================
+int replay_capture(int argc, char* argv[]) {
+    caffis::ReplayOptions options;
+    options.capture_path = argc > 2 ? argv[2] : "";
+    options.jwt_secret = get_env_var("JWT_SECRET", "caffis_jwt_secret_2024_super_secure_key_xY9mN3pQ7rT2wK5vL8bC");
+    try {
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            std::string value = argv[i + 1];
+            if (flag == "--target") {
+                size_t colon = value.rfind(':');
+                options.host = value.substr(0, colon);
+                if (colon != std::string::npos) {
+                    options.port = value.substr(colon + 1);
+                }
+            } else if (flag == "--speed") {
+                options.speed = std::stod(value);
+            } else if (flag == "--users") {
+                options.users_path = value;
+            } else if (flag == "--rooms") {
+                options.rooms_path = value;
+            } else if (flag == "--drain") {
+                options.drain_seconds = std::stoi(value);
+            } else if (flag == "--report") {
+                options.report_path = value;
+            } else if (flag == "--baseline") {
+                options.baseline_path = value;
+            } else {
+                std::cerr << "❌ Unknown replay option " << flag << std::endl;
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Bad replay option value: " << e.what() << std::endl;
+        return 1;
+    }
+    if (options.capture_path.empty()) {
+        std::cerr << "❌ Usage: caffis_chat --replay <capture> [--target host:port] [--speed x] [--users file] "
+                     "[--rooms file] [--drain seconds] [--report file] [--baseline file]" << std::endl;
+        return 1;
+    }
+    return caffis::run_replay(options);
+}
+
+// ================================================
+// SOAK TEST (caffis_chat --soak --users file --rooms file [--target host:port] [--duration s] ...)
+// ================================================
+int soak_test(int argc, char* argv[]) {
+    caffis::SoakOptions options;
+    options.jwt_secret = get_env_var("JWT_SECRET", "caffis_jwt_secret_2024_super_secure_key_xY9mN3pQ7rT2wK5vL8bC");
+    options.admin_token = get_env_var("ADMIN_TOKEN", "");
+    
+    const std::map<std::string, std::function<void(const std::string&)>> flags = {
+        {"--target", [&](const std::string& v) {
+            size_t colon = v.rfind(':');
+            options.host = v.substr(0, colon);
+            if (colon != std::string::npos) options.port = v.substr(colon + 1);
+        }},
+        {"--admin-token", [&](const std::string& v) { options.admin_token = v; }},
+        {"--users", [&](const std::string& v) { options.users_path = v; }},
+        {"--rooms", [&](const std::string& v) { options.rooms_path = v; }},
+        {"--duration", [&](const std::string& v) { options.duration_seconds = std::stoi(v); }},
+        {"--clients", [&](const std::string& v) { options.clients = std::stoi(v); }},
+        {"--messages", [&](const std::string& v) { options.messages_per_connection = std::stoi(v); }},
+        {"--interval-ms", [&](const std::string& v) { options.message_interval_ms = std::stoi(v); }},
+        {"--stall-probability", [&](const std::string& v) { options.stall_probability = std::stod(v); }},
+        {"--stall-ms", [&](const std::string& v) { options.stall_ms = std::stoi(v); }},
+        {"--reset-probability", [&](const std::string& v) { options.reset_probability = std::stod(v); }},
+        {"--db-restart-cmd", [&](const std::string& v) { options.db_restart_command = v; }},
+        {"--db-restart-every", [&](const std::string& v) { options.db_restart_seconds = std::stoi(v); }},
+        {"--sample-seconds", [&](const std::string& v) { options.sample_seconds = std::stoi(v); }},
+        {"--warmup", [&](const std::string& v) { options.warmup_seconds = std::stoi(v); }},
+        {"--settle", [&](const std::string& v) { options.settle_seconds = std::stoi(v); }},
+        {"--max-rss-growth", [&](const std::string& v) { options.max_rss_growth = std::stod(v); }},
+        {"--max-thread-growth", [&](const std::string& v) { options.max_thread_growth = std::stoi(v); }},
+        {"--max-fd-growth", [&](const std::string& v) { options.max_fd_growth = std::stoi(v); }},
+        {"--max-p99-growth", [&](const std::string& v) { options.max_p99_growth = std::stod(v); }},
+    };
+    try {
+        for (int i = 2; i < argc; i += 2) {
+            auto flag = flags.find(argv[i]);
+            if (flag == flags.end() || i + 1 >= argc) {
+                std::cerr << "❌ Unknown or incomplete soak option " << argv[i] << std::endl;
+                return 1;
+            }
+            flag->second(argv[i + 1]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Bad soak option value: " << e.what() << std::endl;
+        return 1;
+    }
+    if (options.clients <= 0 || options.sample_seconds <= 0) {
+        std::cerr << "❌ --clients and --sample-seconds must be positive" << std::endl;
+        return 1;
+    }
+    return caffis::run_soak(options);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--train-content-dictionary") {
+        return train_content_dictionary(argc > 2 && std::string(argv[2]) == "--dry-run");
+    }
+    if (argc > 1 && std::string(argv[1]) == "--replay") {
+        return replay_capture(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--soak") {
+        return soak_test(argc, argv);
+    }
+    
+    const auto startup_begin = std::chrono::steady_clock::now();
     print_startup_banner();
     
     // Register signal handlers for graceful shutdown
@@ -114,6 +381,127 @@ int main() {
         int redis_port = std::stoi(get_env_var("REDIS_PORT", "6379"));
         std::string jwt_secret = get_env_var("JWT_SECRET", "caffis_jwt_secret_2024_super_secure_key_xY9mN3pQ7rT2wK5vL8bC");
         
+        caffis::config::ClusterConfig cluster_config;
+        cluster_config.transport = get_env_var("CLUSTER_TRANSPORT", "none");
+        cluster_config.node_id = get_env_var("NODE_ID", default_node_id());
+        cluster_config.session_directory = get_env_var("SESSION_DIRECTORY", "none");
+        cluster_config.session_lease_seconds = std::stoi(get_env_var("SESSION_LEASE_SECONDS", "60"));
+        
+        caffis::config::RedisConfig redis_config;
+        redis_config.host = redis_host;
+        redis_config.port = redis_port;
+        
+        // Optional: preload the N most recently active rooms before accepting connections
+        int warmup_rooms = std::stoi(get_env_var("CACHE_WARMUP_ROOMS", "0"));
+        
+        caffis::config::SnapshotConfig snapshot_config;
+        snapshot_config.path = get_env_var("SNAPSHOT_PATH", "");
+        snapshot_config.interval_seconds = std::stoi(get_env_var("SNAPSHOT_INTERVAL_SECONDS", "300"));
+        snapshot_config.max_age_seconds = std::stoi(get_env_var("SNAPSHOT_MAX_AGE_SECONDS", "900"));
+        
+        caffis::config::AdminConfig admin_config;
+        admin_config.token = get_env_var("ADMIN_TOKEN", "");
+        admin_config.trace_sample_rate = std::stod(get_env_var("TRACE_SAMPLE_RATE", "0"));
+        admin_config.trace_ring_capacity = std::stoi(get_env_var("TRACE_RING_CAPACITY", "4096"));
+        
+        caffis::config::OutboundConfig outbound_config;
+        outbound_config.coalesce = get_env_var("OUTBOUND_COALESCE", "true") != "false";
+        outbound_config.interactive_budget_us = std::stoi(get_env_var("OUTBOUND_INTERACTIVE_BUDGET_US", "0"));
+        outbound_config.bulk_budget_us = std::stoi(get_env_var("OUTBOUND_BULK_BUDGET_US", "5000"));
+        outbound_config.interactive_nodelay = get_env_var("OUTBOUND_INTERACTIVE_NODELAY", "true") != "false";
+        outbound_config.bulk_nodelay = get_env_var("OUTBOUND_BULK_NODELAY", "false") == "true";
+        outbound_config.max_queued_bytes = std::stoul(get_env_var("OUTBOUND_MAX_QUEUED_BYTES", "4194304"));
+        
+        caffis::config::PlacementConfig placement_config;
+        placement_config.cpu_pinning = get_env_var("CPU_PINNING", "none");
+        placement_config.acceptor_shards = std::stoi(get_env_var("ACCEPTOR_SHARDS", "1"));
+        
+        caffis::config::AttachmentConfig attachment_config;
+        attachment_config.store_path = get_env_var("ATTACHMENT_STORE_PATH", "");
+        attachment_config.max_file_bytes = std::stoull(get_env_var("ATTACHMENT_MAX_FILE_BYTES", "26214400"));
+        attachment_config.max_chunk_bytes = std::stoul(get_env_var("ATTACHMENT_MAX_CHUNK_BYTES", "262144"));
+        attachment_config.staging_ttl_hours = std::stoi(get_env_var("ATTACHMENT_STAGING_TTL_HOURS", "24"));
+        
+        caffis::config::SearchConfig search_config;
+        search_config.enabled = get_env_var("SEARCH_ENABLED", "true") != "false";
+        search_config.database_url = get_env_var("SEARCH_DATABASE_URL", "");
+        search_config.poll_interval_ms = std::stoi(get_env_var("SEARCH_POLL_INTERVAL_MS", "500"));
+        search_config.batch_size = std::stoi(get_env_var("SEARCH_BATCH_SIZE", "5000"));
+        search_config.lag_ms = std::stoi(get_env_var("SEARCH_LAG_MS", "2000"));
+        
+        caffis::config::GeoConfig geo_config;
+        geo_config.enabled = get_env_var("GEO_ENABLED", "true") != "false";
+        geo_config.refresh_interval_ms = std::stoi(get_env_var("GEO_REFRESH_INTERVAL_MS", "2000"));
+        geo_config.lag_ms = std::stoi(get_env_var("GEO_LAG_MS", "2000"));
+        
+        caffis::config::RetentionConfig retention_config;
+        retention_config.enabled = get_env_var("RETENTION_ENABLED", "false") == "true";
+        retention_config.private_days = std::stoi(get_env_var("RETENTION_PRIVATE_DAYS", "0"));
+        retention_config.group_days = std::stoi(get_env_var("RETENTION_GROUP_DAYS", "0"));
+        retention_config.meetup_days_after_event = std::stoi(get_env_var("RETENTION_MEETUP_DAYS_AFTER_EVENT", "0"));
+        retention_config.interval_minutes = std::stoi(get_env_var("RETENTION_INTERVAL_MINUTES", "60"));
+        retention_config.batch_size = std::stoi(get_env_var("RETENTION_BATCH_SIZE", "1000"));
+        retention_config.duty_percent = std::stoi(get_env_var("RETENTION_DUTY_PERCENT", "10"));
+        
+        caffis::config::ContentCodecConfig content_codec_config = content_codec_config_from_env();
+        
+        caffis::config::NotificationConfig notification_config;
+        notification_config.enabled = get_env_var("NOTIFICATIONS_ENABLED", "false") == "true";
+        notification_config.provider = get_env_var("NOTIFICATIONS_PROVIDER", "file");
+        notification_config.file_path = get_env_var("NOTIFICATIONS_FILE_PATH", "/tmp/caffis-notifications.jsonl");
+        notification_config.window_ms = std::stoi(get_env_var("NOTIFICATIONS_WINDOW_MS", "10000"));
+        notification_config.batch_size = std::stoi(get_env_var("NOTIFICATIONS_BATCH_SIZE", "100"));
+        notification_config.max_queued = std::stoul(get_env_var("NOTIFICATIONS_MAX_QUEUED", "100000"));
+        notification_config.max_pending_users = std::stoul(get_env_var("NOTIFICATIONS_MAX_PENDING_USERS", "100000"));
+        
+        caffis::config::CaptureConfig capture_config;
+        capture_config.path = get_env_var("CAPTURE_PATH", "");
+        capture_config.redact_content = get_env_var("CAPTURE_REDACT_CONTENT", "true") != "false";
+        capture_config.max_bytes = std::stoull(get_env_var("CAPTURE_MAX_BYTES", "1073741824"));
+        
+        caffis::config::DeliveryConfig delivery_config;
+        delivery_config.enabled = get_env_var("DELIVERY_RECEIPTS_ENABLED", "true") != "false";
+        delivery_config.status_interval_ms = std::stoi(get_env_var("DELIVERY_STATUS_INTERVAL_MS", "500"));
+        delivery_config.tracked_per_room = std::stoi(get_env_var("DELIVERY_TRACKED_PER_ROOM", "128"));
+        delivery_config.track_seconds = std::stoi(get_env_var("DELIVERY_TRACK_SECONDS", "300"));
+        
+        caffis::config::RoomStatsConfig room_stats_config;
+        room_stats_config.enabled = get_env_var("ROOM_STATS_ENABLED", "true") != "false";
+        room_stats_config.flush_seconds = std::stoi(get_env_var("ROOM_STATS_FLUSH_SECONDS", "30"));
+        room_stats_config.export_top_rooms = std::stoi(get_env_var("ROOM_STATS_EXPORT_TOP_ROOMS", "20"));
+        
+        caffis::config::HotRoomConfig hot_room_config;
+        hot_room_config.enabled = room_stats_config.enabled && get_env_var("HOT_ROOMS_ENABLED", "true") != "false";
+        hot_room_config.hot_members = std::stoi(get_env_var("HOT_ROOM_MEMBERS", "200"));
+        hot_room_config.hot_messages_per_minute = std::stod(get_env_var("HOT_ROOM_MESSAGES_PER_MINUTE", "120"));
+        hot_room_config.cool_percent = std::stoi(get_env_var("HOT_ROOM_COOL_PERCENT", "50"));
+        hot_room_config.min_hot_seconds = std::stoi(get_env_var("HOT_ROOM_MIN_SECONDS", "60"));
+        hot_room_config.classify_seconds = std::stoi(get_env_var("HOT_ROOM_CLASSIFY_SECONDS", "5"));
+        hot_room_config.batch_ms = std::stoi(get_env_var("HOT_ROOM_BATCH_MS", "5"));
+        hot_room_config.typing_interval_ms = std::stoi(get_env_var("HOT_ROOM_TYPING_INTERVAL_MS", "3000"));
+        hot_room_config.typing_per_second = std::stoi(get_env_var("HOT_ROOM_TYPING_PER_SECOND", "5"));
+        
+        caffis::config::HistoryApiConfig history_config;
+        history_config.enabled = get_env_var("HISTORY_API_ENABLED", "true") != "false";
+        history_config.max_page = std::max(1, std::stoi(get_env_var("HISTORY_API_MAX_PAGE", "100")));
+        history_config.token_cache_seconds = std::stoi(get_env_var("HISTORY_API_TOKEN_CACHE_SECONDS", "60"));
+        
+        caffis::config::ArchiveConfig archive_config;
+        archive_config.path = get_env_var("ARCHIVE_PATH", "");
+        archive_config.after_days = std::stoi(get_env_var("ARCHIVE_AFTER_DAYS", "180"));
+        archive_config.segment_messages = std::stoi(get_env_var("ARCHIVE_SEGMENT_MESSAGES", "4096"));
+        archive_config.block_messages = std::stoi(get_env_var("ARCHIVE_BLOCK_MESSAGES", "256"));
+        archive_config.zstd_level = std::stoi(get_env_var("ARCHIVE_ZSTD_LEVEL", "3"));
+        archive_config.interval_minutes = std::stoi(get_env_var("ARCHIVE_INTERVAL_MINUTES", "60"));
+        archive_config.rooms_per_pass = std::stoi(get_env_var("ARCHIVE_ROOMS_PER_PASS", "200"));
+        archive_config.duty_percent = std::stoi(get_env_var("ARCHIVE_DUTY_PERCENT", "10"));
+        // Retention can't reach archived rows: a room type it governs is never tiered
+        if (retention_config.enabled) {
+            if (retention_config.private_days > 0) archive_config.skip_room_types.push_back("private");
+            if (retention_config.group_days > 0) archive_config.skip_room_types.push_back("group");
+            if (retention_config.meetup_days_after_event > 0) archive_config.skip_room_types.push_back("meetup");
+        }
+        
         std::cout << "✅ Configuration loaded:" << std::endl;
         std::cout << "   • Chat Port: " << config.port << std::endl;
         std::cout << "   • Chat Host: " << config.host << std::endl;
@@ -121,6 +509,8 @@ int main() {
         std::cout << "   • Main Database: " << (main_db_url.empty() ? "❌ NOT SET" : "✅ Connected") << std::endl;
         std::cout << "   • Redis: " << redis_host << ":" << redis_port << std::endl;
         std::cout << "   • JWT Secret: " << (jwt_secret.length() < 20 ? "❌ TOO SHORT" : "✅ Configured") << std::endl;
+        std::cout << "   • Cluster Transport: " << cluster_config.transport << " (node " << cluster_config.node_id << ")" << std::endl;
+        std::cout << "   • Session Directory: " << cluster_config.session_directory << std::endl;
         
         if (db_url.empty()) {
             std::cerr << "❌ DATABASE_URL environment variable not set!" << std::endl;
@@ -129,27 +519,34 @@ int main() {
         }
         
         // ================================================
-        // 3. INITIALIZE CHAT DATABASE
+        // 3. CONNECT DATABASES (concurrently)
         // ================================================
-        std::cout << "\n🗄️ Initializing chat database connection..." << std::endl;
+        std::cout << "\n🗄️ Initializing chat database connections..." << std::endl;
+        const auto connect_begin = std::chrono::steady_clock::now();
         
         database = std::make_unique<caffis::DatabaseManager>(db_url);
         
-        if (!database->connect()) {
+        // The chat DB, the WebSocket DB manager and the main app connection are
+        // independent, so pay one connection latency instead of three
+        auto chat_db_ready = std::async(std::launch::async, []() {
+            return database->connect() && database->test_connection();
+        });
+        auto websocket_db_ready = std::async(std::launch::async, [&db_url]() {
+            caffis::init_websocket_database(db_url);
+        });
+        
+        websocket_db_ready.get();
+        
+        if (!chat_db_ready.get()) {
             std::cerr << "❌ Failed to connect to chat database!" << std::endl;
             std::cerr << "   Please ensure chat database is running and accessible" << std::endl;
             return 1;
         }
         
-        // Test database connection
-        if (!database->test_connection()) {
-            std::cerr << "❌ Chat database health check failed!" << std::endl;
-            return 1;
-        }
-        
-        std::cout << "✅ Chat database connection established successfully!" << std::endl;
+        std::cout << "✅ Chat database connection established successfully! (" 
+                  << elapsed_ms(connect_begin) << "ms)" << std::endl;
         
-        // Get database stats
+        // Get database stats (catalog estimates - constant time)
         try {
             std::cout << database->get_database_stats() << std::endl;
         } catch (const std::exception& e) {
@@ -157,9 +554,45 @@ int main() {
         }
         
         // ================================================
-        // 4. INITIALIZE WEBSOCKET DATABASE MANAGER
+        // 4. WARM RESTART, CLUSTER SERVICES AND CACHE WARM-UP
         // ================================================
-        caffis::init_websocket_database(db_url);
+        // Before anything reads message rows: packed bodies need the dictionaries
+        caffis::init_content_codec(db_url, content_codec_config);
+        
+        // Load the previous run's hot state before accepting any connection
+        if (!snapshot_config.path.empty()) {
+            const auto snapshot_begin = std::chrono::steady_clock::now();
+            caffis::load_state_snapshot(snapshot_config.path,
+                                        std::chrono::seconds(snapshot_config.max_age_seconds), *database);
+            std::cout << "📸 Snapshot phase: " << elapsed_ms(snapshot_begin) << "ms" << std::endl;
+        }
+        
+        // Warm-up uses the otherwise idle startup connection and overlaps with the rest of init
+        std::future<size_t> warmup_done;
+        if (warmup_rooms > 0) {
+            std::cout << "🔥 Warming caches for " << warmup_rooms << " hot rooms..." << std::endl;
+            warmup_done = std::async(std::launch::async, [warmup_rooms]() {
+                return caffis::warm_up_hot_cache(*database, warmup_rooms);
+            });
+        }
+        
+        caffis::init_session_directory(cluster_config, redis_config);
+        caffis::init_cluster_transport(cluster_config);
+        caffis::init_state_snapshots(db_url, snapshot_config);
+        caffis::init_admin(admin_config);
+        caffis::init_search(search_config.database_url.empty() ? db_url : search_config.database_url, search_config);
+        caffis::init_geo(db_url, geo_config);
+        caffis::init_retention(db_url, retention_config);
+        caffis::init_archive(db_url, archive_config);
+        caffis::init_history_api(db_url, history_config);
+        caffis::init_delivery_receipts(delivery_config);
+        caffis::init_notifications(db_url, notification_config);
+        caffis::init_room_stats(db_url, room_stats_config);
+        caffis::init_hot_rooms(hot_room_config);
+        caffis::placement::configure(placement_config);
+        caffis::configure_outbound(outbound_config);
+        caffis::attachments().configure(attachment_config);
+        caffis::traffic_capture().start(capture_config);
         
         // ================================================
         // 5. INITIALIZE WEBSOCKET SERVER
@@ -173,6 +606,15 @@ int main() {
         // Start maintenance tasks
         server->start_maintenance_tasks();
         
+        if (warmup_done.valid()) {
+            const auto warmup_begin = std::chrono::steady_clock::now();
+            warmup_done.get();
+            std::cout << "✅ Cache warm-up finished (waited " << elapsed_ms(warmup_begin) << "ms)" << std::endl;
+        }
+        
+        const long long time_to_ready_ms = elapsed_ms(startup_begin);
+        caffis::metrics::gauge("caffis_startup_time_to_ready_ms").set(time_to_ready_ms);
+        
         // ================================================
         // 6. SYSTEM READY - PRODUCTION START
         // ================================================
@@ -186,6 +628,7 @@ int main() {
         std::cout << "🔴 Redis: " << redis_host << ":" << redis_port << std::endl;
         std::cout << "🔐 JWT Authentication: Enabled" << std::endl;
         std::cout << "🔄 Auto User Sync: Enabled" << std::endl;
+        std::cout << "⏱️ Time to ready: " << time_to_ready_ms << "ms" << std::endl;
         std::cout << "================================================================" << std::endl;
         std::cout << "💡 Ready to serve millions of users!" << std::endl;
         std::cout << "================================================================" << std::endl;
@@ -0,0 +1,129 @@
+#include "../include/metrics.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace caffis {
+namespace metrics {
+
+namespace {
+
+std::mutex registry_mutex;
+std::map<std::string, std::unique_ptr<Counter>> counters;
+std::map<std::string, std::unique_ptr<Gauge>> gauges;
+std::map<std::string, std::unique_ptr<Histogram>> histograms;
+
+template <typename T>
+T& lookup(std::map<std::string, std::unique_ptr<T>>& registry, const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto& slot = registry[name];
+    if (!slot) {
+        slot = std::make_unique<T>();
+    }
+    return *slot;
+}
+
+// Split "name{labels}" into base name and the label list without braces
+void split_name(const std::string& full, std::string& base, std::string& labels) {
+    size_t brace = full.find('{');
+    if (brace == std::string::npos) {
+        base = full;
+        labels.clear();
+        return;
+    }
+    base = full.substr(0, brace);
+    labels = full.substr(brace + 1, full.size() - brace - 2);
+}
+
+std::string with_labels(const std::string& base, const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) {
+        return base;
+    }
+    std::string joined = labels;
+    if (!extra.empty()) {
+        joined += (joined.empty() ? "" : ",") + extra;
+    }
+    return base + "{" + joined + "}";
+}
+
+} // namespace
+
+const std::vector<uint64_t>& Histogram::bounds() {
+    static const std::vector<uint64_t> upper_bounds = {
+        50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000, 5000000
+    };
+    return upper_bounds;
+}
+
+Histogram::Histogram() : buckets_(bounds().size() + 1) {}
+
+void Histogram::observe(uint64_t value_us) {
+    const auto& upper_bounds = bounds();
+    size_t index = 0;
+    while (index < upper_bounds.size() && value_us > upper_bounds[index]) {
+        ++index;
+    }
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value_us, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::percentile(double q) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * total);
+    if (target == 0) target = 1;
+
+    const auto& upper_bounds = bounds();
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        seen += bucket(i);
+        if (seen >= target) {
+            return i < upper_bounds.size() ? upper_bounds[i] : upper_bounds.back() * 2;
+        }
+    }
+    return upper_bounds.back() * 2;
+}
+
+Counter& counter(const std::string& name) { return lookup(counters, name); }
+Gauge& gauge(const std::string& name) { return lookup(gauges, name); }
+Histogram& histogram(const std::string& name) { return lookup(histograms, name); }
+
+std::string render() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::ostringstream out;
+    std::string base, labels;
+
+    for (const auto& [name, metric] : counters) {
+        out << name << " " << metric->value() << "\n";
+    }
+    for (const auto& [name, metric] : gauges) {
+        out << name << " " << metric->value() << "\n";
+    }
+    for (const auto& [name, metric] : histograms) {
+        split_name(name, base, labels);
+        const auto& upper_bounds = Histogram::bounds();
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i <= upper_bounds.size(); ++i) {
+            cumulative += metric->bucket(i);
+            std::string le = i < upper_bounds.size() ? std::to_string(upper_bounds[i]) : "+Inf";
+            out << with_labels(base + "_bucket", labels, "le=\"" + le + "\"") << " " << cumulative << "\n";
+        }
+        out << with_labels(base + "_sum", labels) << " " << metric->sum() << "\n";
+        out << with_labels(base + "_count", labels) << " " << metric->count() << "\n";
+    }
+    return out.str();
+}
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace metrics
+} // namespace caffis
@@ -0,0 +1,294 @@
+#include "../include/notification_queue.h"
+#include "../include/database_manager.h"
+#include "../include/metrics.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace caffis {
+
+namespace pt = boost::property_tree;
+
+namespace {
+
+constexpr size_t PREVIEW_BYTES = 120;
+constexpr size_t MAX_DRAIN = 1000;  // events resolved per worker round
+const auto POLL_INTERVAL = std::chrono::milliseconds(200);
+
+int64_t epoch_ms(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+// Cut at a byte budget without splitting a UTF-8 sequence
+std::string truncate_utf8(const std::string& text, size_t max_bytes) {
+    if (text.size() <= max_bytes) {
+        return text;
+    }
+    size_t cut = max_bytes;
+    while (cut > 0 && (static_cast<unsigned char>(text[cut]) & 0xC0) == 0x80) {
+        cut--;
+    }
+    return text.substr(0, cut) + "…";
+}
+
+} // namespace
+
+// ================================================
+// PROVIDERS
+// ================================================
+FileNotificationProvider::FileNotificationProvider(const std::string& path)
+    : path_(path), out_(path, std::ios::app) {
+    if (!out_) {
+        std::cerr << "❌ Cannot open notification file " << path << std::endl;
+    }
+}
+
+bool FileNotificationProvider::deliver(const std::vector<OfflineNotification>& batch) {
+    if (!out_) {
+        return false;
+    }
+    for (const auto& notification : batch) {
+        pt::ptree line;
+        line.put("user_id", notification.user_id);
+        line.put("message_count", notification.message_count);
+        pt::ptree rooms;
+        for (const auto& room_id : notification.room_ids) {
+            pt::ptree room;
+            room.put("", room_id);
+            rooms.push_back(std::make_pair("", room));
+        }
+        line.add_child("room_ids", rooms);
+        line.put("room_id", notification.room_id);
+        line.put("sender_name", notification.sender_name);
+        line.put("preview", notification.preview);
+        line.put("first_ms", notification.first_ms);
+        line.put("last_ms", notification.last_ms);
+        pt::write_json(out_, line, false);
+    }
+    out_.flush();
+    return static_cast<bool>(out_);
+}
+
+std::unique_ptr<NotificationProvider> make_notification_provider(const config::NotificationConfig& notification_config) {
+    if (notification_config.provider == "file") {
+        return std::make_unique<FileNotificationProvider>(notification_config.file_path);
+    }
+    return nullptr;
+}
+
+// ================================================
+// QUEUE
+// ================================================
+NotificationQueue::NotificationQueue(const config::NotificationConfig& notification_config,
+                                     std::unique_ptr<DatabaseManager> db,
+                                     std::unique_ptr<NotificationProvider> provider, PresenceCheck is_connected)
+    : settings_(notification_config), db_(std::move(db)), provider_(std::move(provider)),
+      is_connected_(std::move(is_connected)) {
+    settings_.batch_size = std::max(1, settings_.batch_size);
+}
+
+NotificationQueue::~NotificationQueue() {
+    stop();
+}
+
+void NotificationQueue::start() {
+    running_ = true;
+    worker_ = std::thread([this]() { run(); });
+}
+
+void NotificationQueue::stop() {
+    if (running_.exchange(false)) {
+        queue_cv_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+}
+
+std::string NotificationQueue::preview_of(const Message& msg) {
+    switch (msg.type) {
+        case MessageType::IMAGE: return "📷 Photo";
+        case MessageType::FILE: return "📎 " + truncate_utf8(msg.file_name, PREVIEW_BYTES);
+        case MessageType::LOCATION: return "📍 " + (msg.content.empty() ? std::string("Location") : truncate_utf8(msg.content, PREVIEW_BYTES));
+        default: return truncate_utf8(msg.content, PREVIEW_BYTES);
+    }
+}
+
+void NotificationQueue::enqueue(const Message& msg, const std::string& sender_name) {
+    static auto& queued = metrics::counter("caffis_notify_messages_total");
+    static auto& dropped = metrics::counter("caffis_notify_messages_dropped_total");
+
+    Event event;
+    event.room_id = msg.room_id;
+    event.sender_id = msg.sender_id;
+    event.sender_name = sender_name;
+    event.preview = preview_of(msg);
+    event.sent_ms = epoch_ms(msg.timestamp);
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (queue_.size() >= settings_.max_queued) {
+        dropped.inc();
+        return;
+    }
+    queue_.push_back(std::move(event));
+    queued.inc();
+}
+
+size_t NotificationQueue::pending_users() const {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    return pending_.size();
+}
+
+void NotificationQueue::run() {
+    static auto& pending_gauge = metrics::gauge("caffis_notify_pending_users");
+
+    std::vector<Event> events;
+    while (running_) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait_for(lock, POLL_INTERVAL, [this]() { return !running_.load(); });
+            size_t take = std::min(queue_.size(), MAX_DRAIN);
+            events.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + take));
+            queue_.erase(queue_.begin(), queue_.begin() + take);
+        }
+        try {
+            resolve(events);
+            flush(false);
+        } catch (const std::exception& e) {
+            std::cerr << "❌ Notification worker error: " << e.what() << std::endl;
+        }
+        pending_gauge.set(static_cast<int64_t>(pending_users()));
+    }
+
+    // Shutdown: whatever is known goes out now rather than never
+    try {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            events.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.end()));
+            queue_.clear();
+        }
+        resolve(events);
+        flush(true);
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Final notification flush failed: " << e.what() << std::endl;
+    }
+}
+
+// Offline recipients for each (room, sender) in the batch, merged into their pending notification
+void NotificationQueue::resolve(std::vector<Event>& events) {
+    static auto& recipients = metrics::counter("caffis_notify_recipients_total");
+    static auto& coalesced = metrics::counter("caffis_notify_coalesced_total");
+    static auto& overflow = metrics::counter("caffis_notify_users_dropped_total");
+    static auto& resolve_latency = metrics::histogram("caffis_notify_resolve_us");
+    if (events.empty()) {
+        return;
+    }
+    const auto begin = std::chrono::steady_clock::now();
+
+    // Group so a burst in one room costs one query
+    std::map<std::pair<std::string, std::string>, std::vector<const Event*>> by_room_sender;
+    for (const auto& event : events) {
+        by_room_sender[{event.room_id, event.sender_id}].push_back(&event);
+    }
+
+    const auto window = std::chrono::milliseconds(settings_.window_ms);
+    for (const auto& [key, room_events] : by_room_sender) {
+        std::vector<std::string> users = db_->get_notification_recipients(key.first, key.second);
+        for (const auto& user_id : users) {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            auto it = pending_.find(user_id);
+            if (it == pending_.end()) {
+                // Presence is checked once per window, not per message
+                if (pending_.size() >= settings_.max_pending_users) {
+                    overflow.inc();
+                    continue;
+                }
+                if (is_connected_ && is_connected_(user_id)) {
+                    continue;
+                }
+                Pending pending;
+                pending.notification.user_id = user_id;
+                pending.notification.first_ms = room_events.front()->sent_ms;
+                pending.due = std::chrono::steady_clock::now() + window;
+                it = pending_.emplace(user_id, std::move(pending)).first;
+                recipients.inc();
+            } else {
+                coalesced.inc(room_events.size());
+            }
+
+            OfflineNotification& notification = it->second.notification;
+            const Event& latest = *room_events.back();
+            notification.message_count += room_events.size();
+            if (std::find(notification.room_ids.begin(), notification.room_ids.end(), key.first) == notification.room_ids.end()) {
+                notification.room_ids.push_back(key.first);
+            }
+            if (latest.sent_ms >= notification.last_ms) {
+                notification.room_id = key.first;
+                notification.sender_name = latest.sender_name;
+                notification.preview = latest.preview;
+                notification.last_ms = latest.sent_ms;
+            }
+        }
+    }
+    events.clear();
+    resolve_latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count());
+}
+
+void NotificationQueue::flush(bool everything) {
+    static auto& sent = metrics::counter("caffis_notify_sent_total");
+    static auto& came_online = metrics::counter("caffis_notify_suppressed_online_total");
+    static auto& failures = metrics::counter("caffis_notify_provider_failures_total");
+    static auto& deliver_latency = metrics::histogram("caffis_notify_provider_us");
+
+    std::vector<OfflineNotification> due;
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (everything || it->second.due <= now) {
+                due.push_back(std::move(it->second.notification));
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::vector<OfflineNotification> batch;
+    batch.reserve(static_cast<size_t>(settings_.batch_size));
+    auto send_batch = [&]() {
+        if (batch.empty()) {
+            return;
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        if (provider_->deliver(batch)) {
+            sent.inc(batch.size());
+        } else {
+            failures.inc();
+            std::cerr << "❌ Notification provider " << provider_->name() << " rejected " << batch.size()
+                      << " notifications" << std::endl;
+        }
+        deliver_latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count());
+        batch.clear();
+    };
+
+    for (auto& notification : due) {
+        // Back within the window: they have seen it (or will on join)
+        if (!everything && is_connected_ && is_connected_(notification.user_id)) {
+            came_online.inc();
+            continue;
+        }
+        batch.push_back(std::move(notification));
+        if (batch.size() >= static_cast<size_t>(settings_.batch_size)) {
+            send_batch();
+        }
+    }
+    send_batch();
+}
+
+} // namespace caffis
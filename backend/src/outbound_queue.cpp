@@ -0,0 +1,477 @@
+#include "../include/outbound_queue.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace caffis {
+
+namespace {
+
+config::OutboundConfig settings;
+
+// Frames per sendmsg(); well under IOV_MAX with header + payload per frame
+constexpr size_t MAX_FRAMES_PER_WRITE = 64;
+
+metrics::Counter& frames_counter() {
+    static auto& counter = metrics::counter("caffis_outbound_frames_total");
+    return counter;
+}
+
+metrics::Counter& syscalls_counter() {
+    static auto& counter = metrics::counter("caffis_outbound_write_syscalls_total");
+    return counter;
+}
+
+int budget_us(SessionClass session_class) {
+    return session_class == SessionClass::BULK ? settings.bulk_budget_us : settings.interactive_budget_us;
+}
+
+} // namespace
+
+// ================================================
+// FLUSHER THREAD
+// ================================================
+// Flushes queues whose batching budget expired and queues whose socket
+// was full, once it becomes writable again.
+class OutboundFlusher {
+public:
+    OutboundFlusher() {
+        wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~OutboundFlusher() {
+        running_ = false;
+        wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        ::close(wake_fd_);
+    }
+
+    void flush_at(std::shared_ptr<OutboundQueue> queue, std::chrono::steady_clock::time_point deadline) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timed_.push_back({deadline, std::move(queue)});
+        }
+        wake();
+    }
+
+    void flush_when_writable(std::shared_ptr<OutboundQueue> queue) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            blocked_.push_back(std::move(queue));
+        }
+        wake();
+    }
+
+private:
+    struct Timed {
+        std::chrono::steady_clock::time_point deadline;
+        std::shared_ptr<OutboundQueue> queue;
+    };
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        std::vector<std::shared_ptr<OutboundQueue>> ready;
+
+        while (running_) {
+            fds.clear();
+            fds.push_back({wake_fd_, POLLIN, 0});
+
+            int timeout_ms = 1000;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& queue : blocked_) {
+                    fds.push_back({queue->fd(), POLLOUT, 0});
+                }
+                auto now = std::chrono::steady_clock::now();
+                for (const auto& entry : timed_) {
+                    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(entry.deadline - now).count();
+                    timeout_ms = std::min<int>(timeout_ms, wait <= 0 ? 0 : static_cast<int>((wait + 999) / 1000));
+                }
+            }
+
+            ::poll(fds.data(), fds.size(), timeout_ms);
+            if (fds[0].revents & POLLIN) {
+                uint64_t drained;
+                ssize_t ignored = ::read(wake_fd_, &drained, sizeof(drained));
+                (void)ignored;
+            }
+
+            ready.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                // blocked_ may have grown since the poll set was built: only
+                // the first fds.size() - 1 entries were polled
+                size_t polled = fds.size() - 1;
+                size_t kept = 0;
+                for (size_t i = 0; i < blocked_.size(); ++i) {
+                    bool signalled = i < polled && fds[i + 1].revents != 0;
+                    if (signalled || blocked_[i]->is_shut_down()) {
+                        ready.push_back(std::move(blocked_[i]));
+                    } else {
+                        blocked_[kept++] = std::move(blocked_[i]);
+                    }
+                }
+                blocked_.resize(kept);
+
+                auto now = std::chrono::steady_clock::now();
+                auto due = std::partition(timed_.begin(), timed_.end(),
+                    [&](const Timed& entry) { return entry.deadline > now; });
+                for (auto it = due; it != timed_.end(); ++it) {
+                    ready.push_back(std::move(it->queue));
+                }
+                timed_.erase(due, timed_.end());
+            }
+
+            for (auto& queue : ready) {
+                {
+                    std::lock_guard<std::mutex> lock(queue->mutex_);
+                    queue->scheduled_ = false;
+                }
+                queue->flush();
+            }
+        }
+    }
+
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{true};
+    std::mutex mutex_;
+    std::vector<Timed> timed_;
+    std::vector<std::shared_ptr<OutboundQueue>> blocked_;
+    std::thread thread_;
+};
+
+static OutboundFlusher& flusher() {
+    static OutboundFlusher instance;
+    return instance;
+}
+
+// ================================================
+// CONFIGURATION
+// ================================================
+void configure_outbound(const config::OutboundConfig& outbound_config) {
+    settings = outbound_config;
+    std::cout << "📤 Outbound queues: " << (settings.coalesce ? "coalescing" : "one write per frame")
+              << ", budget interactive " << settings.interactive_budget_us << "us / bulk "
+              << settings.bulk_budget_us << "us" << std::endl;
+}
+
+const config::OutboundConfig& outbound_settings() {
+    return settings;
+}
+
+SessionClass session_class_from_string(const std::string& value) {
+    return value == "bulk" ? SessionClass::BULK : SessionClass::INTERACTIVE;
+}
+
+const char* session_class_to_string(SessionClass session_class) {
+    return session_class == SessionClass::BULK ? "bulk" : "interactive";
+}
+
+// ================================================
+// QUEUE
+// ================================================
+OutboundQueue::OutboundQueue(int fd, SessionClass session_class)
+    : fd_(fd), session_class_(session_class) {
+    int nodelay = (session_class == SessionClass::BULK ? settings.bulk_nodelay : settings.interactive_nodelay) ? 1 : 0;
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+OutboundQueue::~OutboundQueue() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clear_locked();
+}
+
+static void encode_header(OutboundQueue::Frame& frame) {
+    size_t length = frame.payload->size();
+    frame.header[0] = static_cast<char>(0x81);  // FIN + text, unmasked (server -> client)
+    if (length < 126) {
+        frame.header[1] = static_cast<char>(length);
+        frame.header_len = 2;
+    } else if (length <= 0xFFFF) {
+        frame.header[1] = 126;
+        frame.header[2] = static_cast<char>((length >> 8) & 0xFF);
+        frame.header[3] = static_cast<char>(length & 0xFF);
+        frame.header_len = 4;
+    } else {
+        frame.header[1] = 127;
+        for (int i = 0; i < 8; ++i) {
+            frame.header[2 + i] = static_cast<char>((static_cast<uint64_t>(length) >> (56 - 8 * i)) & 0xFF);
+        }
+        frame.header_len = 10;
+    }
+}
+
+bool OutboundQueue::push(std::string payload, Lane lane, uint64_t coalesce_key) {
+    return push(std::make_shared<const std::string>(std::move(payload)), lane, coalesce_key);
+}
+
+bool OutboundQueue::push(std::shared_ptr<const std::string> payload, Lane lane, uint64_t coalesce_key) {
+    Frame frame;
+    frame.payload = std::move(payload);
+    frame.coalesce_key = coalesce_key;
+    encode_header(frame);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (shut_down_) {
+        return false;
+    }
+    return push_locked(std::move(frame), lane, lock);
+}
+
+bool OutboundQueue::push_raw(std::string wire_bytes) {
+    Frame frame;
+    frame.payload = std::make_shared<const std::string>(std::move(wire_bytes));
+    frame.header_len = 0;  // already a complete frame
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (shut_down_) {
+        // The caller writes to the socket itself: let an in-flight batch finish first
+        writer_idle_.wait(lock, [this]() { return !writing_; });
+        return false;
+    }
+    return push_locked(std::move(frame), Lane::CONTROL, lock);
+}
+
+bool OutboundQueue::push_locked(Frame frame, Lane lane, std::unique_lock<std::mutex>& lock) {
+    static auto& overflows = metrics::counter("caffis_outbound_overflow_total");
+    static auto& coalesced = metrics::counter("caffis_outbound_coalesced_total");
+    static auto& shed = metrics::counter("caffis_outbound_ephemeral_dropped_total");
+
+    frames_counter().inc();
+
+    auto& queue = lanes_[static_cast<size_t>(lane)];
+    if (lane == Lane::EPHEMERAL) {
+        // Latest wins: a newer state for the same key replaces the queued one
+        if (frame.coalesce_key != 0) {
+            for (Frame& queued : queue) {
+                if (queued.coalesce_key == frame.coalesce_key) {
+                    queued_bytes_ += frame.wire_size();
+                    queued_bytes_ -= queued.wire_size();
+                    queued = std::move(frame);
+                    coalesced.inc();
+                    return true;
+                }
+            }
+        }
+        // Under backpressure ephemeral state is shed, never queued behind chat
+        if (queued_bytes_ > settings.max_queued_bytes / 2) {
+            shed.inc();
+            return false;
+        }
+    }
+
+    queued_bytes_ += frame.wire_size();
+    queue.push_back(std::move(frame));
+    lane_depth(lane).add(1);
+
+    if (queued_bytes_ > settings.max_queued_bytes) {
+        // Slow consumer: drop the connection rather than grow without bound.
+        // The session thread's read fails and runs the normal cleanup.
+        overflows.inc();
+        shut_down_ = true;
+        if (!writing_) {
+            clear_locked();  // otherwise the writer clears once its write returns
+        }
+        ::shutdown(fd_, SHUT_RDWR);
+        return false;
+    }
+
+    if (writing_ || scheduled_ || corks_ > 0) {
+        return true;  // the active writer / flusher / cork picks it up
+    }
+
+    // Control frames never wait out a batching budget
+    int budget = settings.coalesce && lane != Lane::CONTROL ? budget_us(session_class_) : 0;
+    if (budget > 0 && queued_bytes_ < settings.max_batch_bytes) {
+        scheduled_ = true;
+        lock.unlock();
+        flusher().flush_at(shared_from_this(), std::chrono::steady_clock::now() + std::chrono::microseconds(budget));
+        return true;
+    }
+
+    lock.unlock();
+    flush();
+    return true;
+}
+
+metrics::Gauge& OutboundQueue::lane_depth(Lane lane) {
+    static metrics::Gauge* gauges[LANE_COUNT] = {
+        &metrics::gauge("caffis_outbound_queue_depth{lane=\"control\"}"),
+        &metrics::gauge("caffis_outbound_queue_depth{lane=\"chat\"}"),
+        &metrics::gauge("caffis_outbound_queue_depth{lane=\"ephemeral\"}"),
+    };
+    return *gauges[static_cast<size_t>(lane)];
+}
+
+bool OutboundQueue::has_pending_locked() const {
+    if (!inflight_.empty()) {
+        return true;
+    }
+    for (const auto& lane : lanes_) {
+        if (!lane.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void OutboundQueue::clear_locked() {
+    for (size_t i = 0; i < LANE_COUNT; ++i) {
+        lane_depth(static_cast<Lane>(i)).add(-static_cast<int64_t>(lanes_[i].size()));
+        lanes_[i].clear();
+    }
+    inflight_.clear();
+    queued_bytes_ = 0;
+}
+
+void OutboundQueue::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (writing_ || scheduled_ || shut_down_) {
+        return;
+    }
+    writing_ = true;
+
+    const size_t max_frames = settings.coalesce ? MAX_FRAMES_PER_WRITE : 1;
+    iovec iov[MAX_FRAMES_PER_WRITE * 2];
+
+    while (!shut_down_ && has_pending_locked()) {
+        // Top up the batch in strict lane order. inflight_ is only touched by
+        // the writer, so its frames stay put while the lock is released;
+        // a partially written frame is always first.
+        size_t batch_bytes = 0;
+        for (const Frame& frame : inflight_) {
+            batch_bytes += frame.wire_size() - frame.sent;
+        }
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            auto& queue = lanes_[lane];
+            while (!queue.empty() && inflight_.size() < max_frames && batch_bytes < settings.max_batch_bytes) {
+                batch_bytes += queue.front().wire_size();
+                inflight_.push_back(std::move(queue.front()));
+                queue.pop_front();
+                lane_depth(static_cast<Lane>(lane)).add(-1);
+            }
+        }
+
+        size_t count = 0;
+        for (const Frame& frame : inflight_) {
+            if (frame.sent < frame.header_len) {
+                iov[count++] = {const_cast<char*>(frame.header + frame.sent), frame.header_len - frame.sent};
+            }
+            size_t payload_sent = frame.sent > frame.header_len ? frame.sent - frame.header_len : 0;
+            if (payload_sent < frame.payload->size()) {
+                iov[count++] = {const_cast<char*>(frame.payload->data() + payload_sent), frame.payload->size() - payload_sent};
+            }
+        }
+
+        lock.unlock();
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t written = ::sendmsg(fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        int error = errno;
+        syscalls_counter().inc();
+        lock.lock();
+
+        if (written < 0) {
+            if (error == EINTR) {
+                continue;
+            }
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                static auto& would_block = metrics::counter("caffis_outbound_would_block_total");
+                would_block.inc();
+                writing_ = false;
+                scheduled_ = true;
+                writer_idle_.notify_all();
+                lock.unlock();
+                flusher().flush_when_writable(shared_from_this());
+                return;
+            }
+            // Peer gone: the read side will notice and clean up
+            shut_down_ = true;
+            break;
+        }
+
+        static auto& bytes = metrics::counter("caffis_outbound_bytes_total");
+        bytes.inc(static_cast<uint64_t>(written));
+
+        size_t remaining = static_cast<size_t>(written);
+        queued_bytes_ -= std::min(queued_bytes_, remaining);
+        while (remaining > 0 && !inflight_.empty()) {
+            Frame& front = inflight_.front();
+            size_t left = front.wire_size() - front.sent;
+            if (remaining < left) {
+                front.sent += remaining;
+                remaining = 0;
+            } else {
+                remaining -= left;
+                inflight_.pop_front();
+            }
+        }
+    }
+
+    if (shut_down_) {
+        clear_locked();
+    }
+    writing_ = false;
+    writer_idle_.notify_all();
+}
+
+void OutboundQueue::shutdown() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    shut_down_ = true;
+    writer_idle_.wait(lock, [this]() { return !writing_; });
+    clear_locked();
+}
+
+size_t OutboundQueue::queued_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_bytes_;
+}
+
+size_t OutboundQueue::lane_size(Lane lane) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lanes_[static_cast<size_t>(lane)].size();
+}
+
+bool OutboundQueue::is_shut_down() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return shut_down_;
+}
+
+OutboundQueue::Cork::Cork(OutboundQueue& queue) : queue_(queue) {
+    std::lock_guard<std::mutex> lock(queue_.mutex_);
+    ++queue_.corks_;
+}
+
+OutboundQueue::Cork::~Cork() {
+    {
+        std::lock_guard<std::mutex> lock(queue_.mutex_);
+        if (--queue_.corks_ > 0) {
+            return;
+        }
+    }
+    queue_.flush();
+}
+
+} // namespace caffis
@@ -1,5 +1,166 @@
+#include "../include/redis_client.h"
 #include <iostream>
-// Redis client implementation - Phase 2
-void placeholder_redis_client() {
-    std::cout << "Redis client initialized" << std::endl;
-}
\ No newline at end of file
+
+namespace caffis {
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+RedisClient::RedisClient(const std::string& host, int port) : host_(host), port_(port) {}
+
+RedisClient::~RedisClient() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socket_) {
+        boost::system::error_code ec;
+        socket_->close(ec);
+    }
+}
+
+bool RedisClient::connect() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connect_locked();
+}
+
+bool RedisClient::connect_locked() {
+    try {
+        tcp::resolver resolver(io_context_);
+        auto endpoints = resolver.resolve(host_, std::to_string(port_));
+
+        auto socket = std::make_unique<tcp::socket>(io_context_);
+        net::connect(*socket, endpoints);
+        socket->set_option(tcp::no_delay(true));
+
+        socket_ = std::move(socket);
+        read_buffer_.consume(read_buffer_.size());
+        std::cout << "✅ Redis connected: " << host_ << ":" << port_ << std::endl;
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Redis connection failed (" << host_ << ":" << port_ << "): " << e.what() << std::endl;
+        socket_.reset();
+        return false;
+    }
+}
+
+std::string RedisClient::encode(const std::vector<std::string>& args) {
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for (const auto& arg : args) {
+        out += "$" + std::to_string(arg.size()) + "\r\n";
+        out += arg;
+        out += "\r\n";
+    }
+    return out;
+}
+
+std::string RedisClient::read_line() {
+    net::read_until(*socket_, read_buffer_, "\r\n");
+    std::istream stream(&read_buffer_);
+    std::string line;
+    std::getline(stream, line);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return line;
+}
+
+RedisReply RedisClient::read_reply() {
+    std::string line = read_line();
+    if (line.empty()) {
+        throw std::runtime_error("empty RESP line");
+    }
+
+    RedisReply reply;
+    std::string body = line.substr(1);
+
+    switch (line[0]) {
+        case '+':
+            reply.type = RedisReply::Type::STATUS;
+            reply.str = body;
+            break;
+        case '-':
+            reply.type = RedisReply::Type::ERROR;
+            reply.str = body;
+            break;
+        case ':':
+            reply.type = RedisReply::Type::INTEGER;
+            reply.integer = std::stoll(body);
+            break;
+        case '$': {
+            long long length = std::stoll(body);
+            if (length < 0) {
+                reply.type = RedisReply::Type::NIL;
+                break;
+            }
+            size_t needed = static_cast<size_t>(length) + 2;
+            if (read_buffer_.size() < needed) {
+                net::read(*socket_, read_buffer_, net::transfer_exactly(needed - read_buffer_.size()));
+            }
+            reply.type = RedisReply::Type::STRING;
+            reply.str.assign(net::buffers_begin(read_buffer_.data()),
+                             net::buffers_begin(read_buffer_.data()) + length);
+            read_buffer_.consume(needed);
+            break;
+        }
+        case '*': {
+            long long count = std::stoll(body);
+            if (count < 0) {
+                reply.type = RedisReply::Type::NIL;
+                break;
+            }
+            reply.type = RedisReply::Type::ARRAY;
+            reply.elements.reserve(static_cast<size_t>(count));
+            for (long long i = 0; i < count; ++i) {
+                reply.elements.push_back(read_reply());
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("unexpected RESP type: " + line);
+    }
+
+    return reply;
+}
+
+RedisReply RedisClient::command(const std::vector<std::string>& args) {
+    auto replies = pipeline({args});
+    return replies.front();
+}
+
+std::vector<RedisReply> RedisClient::pipeline(const std::vector<std::vector<std::string>>& commands) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<RedisReply> replies;
+
+    if (!socket_ && !connect_locked()) {
+        RedisReply error;
+        error.type = RedisReply::Type::ERROR;
+        error.str = "not connected";
+        replies.assign(commands.size(), error);
+        return replies;
+    }
+
+    try {
+        std::string request;
+        for (const auto& args : commands) {
+            request += encode(args);
+        }
+        net::write(*socket_, net::buffer(request));
+
+        replies.reserve(commands.size());
+        for (size_t i = 0; i < commands.size(); ++i) {
+            replies.push_back(read_reply());
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Redis command failed: " << e.what() << std::endl;
+        socket_.reset();
+
+        RedisReply error;
+        error.type = RedisReply::Type::ERROR;
+        error.str = e.what();
+        replies.resize(commands.size(), error);
+    }
+
+    return replies;
+}
+
+} // namespace caffis
@@ -0,0 +1,226 @@
+#include "../include/room_stats.h"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+namespace caffis {
+
+RoomStats& room_stats() {
+    static RoomStats stats;
+    return stats;
+}
+
+namespace {
+
+constexpr unsigned COUNT_BITS = 24;
+constexpr uint64_t COUNT_MASK = (1ULL << COUNT_BITS) - 1;
+
+int64_t current_minute() {
+    return std::chrono::duration_cast<std::chrono::minutes>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+size_t this_thread_stripe() {
+    static std::atomic<size_t> next_stripe{0};
+    thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % RoomStats::STRIPES;
+    return stripe;
+}
+
+void raise_to(std::atomic<uint32_t>& peak, uint32_t value) {
+    uint32_t seen = peak.load(std::memory_order_relaxed);
+    while (seen < value && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void RoomStats::configure(const config::RoomStatsConfig& room_stats_config) {
+    settings_ = room_stats_config;
+    enabled_ = room_stats_config.enabled;
+}
+
+void RoomStats::update(IdHandle room, void (*apply)(RoomCounters&)) {
+    if (!enabled_ || room == NO_ID) {
+        return;
+    }
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = rooms_.find(room);
+        if (it != rooms_.end()) {
+            apply(*it->second);
+            return;
+        }
+    }
+    // Only real room ids are tracked (and flushed as uuid[]); a join_room
+    // with an arbitrary string must not reach the table or the database
+    Uuid128 room_uuid;
+    if (!Uuid128::parse(interned_ids().to_string(room), room_uuid)) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto& counters = rooms_[room];
+    if (!counters) {
+        counters = std::make_unique<RoomCounters>();
+    }
+    apply(*counters);
+}
+
+void RoomStats::record_message(IdHandle room) {
+    update(room, [](RoomCounters& counters) {
+        const uint64_t minute = static_cast<uint64_t>(current_minute());
+        auto& slot = counters.stripes[this_thread_stripe()].minutes[minute % MINUTE_BUCKETS];
+        uint64_t seen = slot.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            // Same minute: one more (saturating); older minute: this is its first message
+            next = (seen >> COUNT_BITS) == minute ? seen + ((seen & COUNT_MASK) < COUNT_MASK) : (minute << COUNT_BITS) | 1;
+        } while (!slot.compare_exchange_weak(seen, next, std::memory_order_relaxed));
+
+        counters.messages.fetch_add(1, std::memory_order_relaxed);
+        counters.last_activity_ms.store(now_ms(), std::memory_order_relaxed);
+    });
+}
+
+void RoomStats::member_joined(IdHandle room) {
+    update(room, [](RoomCounters& counters) {
+        uint32_t members = counters.members.fetch_add(1, std::memory_order_relaxed) + 1;
+        raise_to(counters.peak_members, members);
+        raise_to(counters.flush_peak_members, members);
+    });
+}
+
+void RoomStats::member_left(IdHandle room) {
+    update(room, [](RoomCounters& counters) {
+        uint32_t members = counters.members.load(std::memory_order_relaxed);
+        while (members > 0 && !counters.members.compare_exchange_weak(members, members - 1, std::memory_order_relaxed)) {
+        }
+    });
+}
+
+RoomActivity RoomStats::read(IdHandle room, const RoomCounters& counters, int64_t minute) {
+    RoomActivity activity;
+    activity.room = room;
+    activity.room_id = interned_ids().to_string(room);
+    activity.members = counters.members.load(std::memory_order_relaxed);
+    activity.peak_members = counters.peak_members.load(std::memory_order_relaxed);
+    activity.messages = counters.messages.load(std::memory_order_relaxed);
+
+    // Complete minutes only: the current one would read low until it ends
+    uint64_t per_minute[MINUTE_BUCKETS] = {};
+    for (const auto& stripe : counters.stripes) {
+        for (const auto& slot : stripe.minutes) {
+            uint64_t value = slot.load(std::memory_order_relaxed);
+            int64_t age = minute - static_cast<int64_t>(value >> COUNT_BITS);
+            if (value != 0 && age >= 1 && age < static_cast<int64_t>(MINUTE_BUCKETS)) {
+                per_minute[age] += value & COUNT_MASK;
+            }
+        }
+    }
+    auto rate = [&per_minute](size_t window) {
+        uint64_t total = 0;
+        for (size_t age = 1; age <= window; ++age) {
+            total += per_minute[age];
+        }
+        return static_cast<double>(total) / static_cast<double>(window);
+    };
+    activity.per_minute_1m = rate(1);
+    activity.per_minute_5m = rate(5);
+    activity.per_minute_15m = rate(15);
+    return activity;
+}
+
+std::vector<RoomActivity> RoomStats::snapshot() const {
+    const int64_t minute = current_minute();
+    std::vector<RoomActivity> activity;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    activity.reserve(rooms_.size());
+    for (const auto& [room, counters] : rooms_) {
+        activity.push_back(read(room, *counters, minute));
+    }
+    return activity;
+}
+
+std::string RoomStats::render_metrics() const {
+    std::vector<RoomActivity> rooms = snapshot();
+    std::ostringstream out;
+    out << "caffis_room_stats_rooms_tracked " << rooms.size() << "\n";
+
+    size_t top = std::min(rooms.size(), static_cast<size_t>(std::max(0, settings_.export_top_rooms)));
+    std::partial_sort(rooms.begin(), rooms.begin() + top, rooms.end(), [](const RoomActivity& a, const RoomActivity& b) {
+        if (a.per_minute_5m != b.per_minute_5m) {
+            return a.per_minute_5m > b.per_minute_5m;
+        }
+        return a.members > b.members;
+    });
+    for (size_t i = 0; i < top; ++i) {
+        const RoomActivity& room = rooms[i];
+        const std::string label = "room=\"" + room.room_id + "\"";
+        out << "caffis_room_messages_per_minute{" << label << ",window=\"1m\"} " << room.per_minute_1m << "\n";
+        out << "caffis_room_messages_per_minute{" << label << ",window=\"5m\"} " << room.per_minute_5m << "\n";
+        out << "caffis_room_messages_per_minute{" << label << ",window=\"15m\"} " << room.per_minute_15m << "\n";
+        out << "caffis_room_messages_total{" << label << "} " << room.messages << "\n";
+        out << "caffis_room_members{" << label << "} " << room.members << "\n";
+        out << "caffis_room_peak_members{" << label << "} " << room.peak_members << "\n";
+    }
+    return out.str();
+}
+
+std::vector<RoomActivityDelta> RoomStats::take_deltas() {
+    const int64_t idle_before_ms = now_ms() - static_cast<int64_t>(MINUTE_BUCKETS) * 60 * 1000;
+    std::vector<RoomActivityDelta> deltas;
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (auto it = rooms_.begin(); it != rooms_.end();) {
+        RoomCounters& counters = *it->second;
+        uint64_t messages = counters.messages.load(std::memory_order_relaxed);
+        uint32_t members = counters.members.load(std::memory_order_relaxed);
+        uint32_t peak = counters.flush_peak_members.exchange(members, std::memory_order_relaxed);
+        int64_t last_activity_ms = counters.last_activity_ms.load(std::memory_order_relaxed);
+
+        if (messages != counters.flushed_messages || peak > counters.flushed_peak_members) {
+            RoomActivityDelta delta;
+            delta.room_id = interned_ids().to_string(it->first);
+            delta.messages = messages - counters.flushed_messages;
+            delta.peak_members = peak;
+            delta.last_activity_ms = delta.messages > 0 ? last_activity_ms : 0;
+            deltas.push_back(std::move(delta));
+            counters.flushed_messages = messages;
+            counters.flushed_peak_members = std::max(counters.flushed_peak_members, peak);
+        } else if (members == 0 && last_activity_ms < idle_before_ms) {
+            it = rooms_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    return deltas;
+}
+
+void RoomStats::restore_deltas(const std::vector<RoomActivityDelta>& deltas) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    for (const auto& delta : deltas) {
+        auto it = rooms_.find(interned_ids().find(delta.room_id));
+        if (it == rooms_.end()) {
+            continue;
+        }
+        RoomCounters& counters = *it->second;
+        counters.flushed_messages -= delta.messages;
+        counters.flushed_peak_members = 0;
+        raise_to(counters.flush_peak_members, delta.peak_members);
+    }
+}
+
+size_t RoomStats::tracked() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return rooms_.size();
+}
+
+size_t RoomStats::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return rooms_.size() * (sizeof(RoomCounters) + sizeof(IdHandle) + sizeof(std::unique_ptr<RoomCounters>) + 2 * sizeof(void*))
+         + rooms_.bucket_count() * sizeof(void*);
+}
+
+} // namespace caffis
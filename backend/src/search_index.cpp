@@ -0,0 +1,392 @@
+#include "../include/search_index.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <queue>
+
+namespace caffis {
+
+SearchIndex& search_index() {
+    static SearchIndex index;
+    return index;
+}
+
+namespace {
+
+// BM25 parameters (the usual defaults)
+constexpr double BM25_K1 = 1.2;
+constexpr double BM25_B = 0.75;
+
+bool is_word_byte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+} // namespace
+
+// ================================================
+// POSTING ENCODING
+// ================================================
+void SearchIndex::put_varint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint32_t SearchIndex::get_varint(const std::string& in, size_t& pos) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (pos < in.size()) {
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+// ================================================
+// TOKENIZER
+// ================================================
+std::vector<std::string> SearchIndex::tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string token;
+    auto flush = [&]() {
+        if (!token.empty() && token.size() <= MAX_TERM_BYTES) {
+            tokens.push_back(token);
+        }
+        token.clear();
+    };
+
+    for (unsigned char c : text) {
+        if (!is_word_byte(c)) {
+            flush();
+            continue;
+        }
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<unsigned char>(c - 'A' + 'a');
+        }
+        token.push_back(static_cast<char>(c));
+    }
+    flush();
+    return tokens;
+}
+
+// ================================================
+// INDEXING
+// ================================================
+SearchIndex::Shard* SearchIndex::find_shard(IdHandle room) const {
+    std::shared_lock<std::shared_mutex> lock(shards_mutex_);
+    auto it = shards_.find(room);
+    return it == shards_.end() ? nullptr : it->second.get();
+}
+
+SearchIndex::Shard& SearchIndex::shard_for(IdHandle room) {
+    if (Shard* shard = find_shard(room)) {
+        return *shard;
+    }
+    std::unique_lock<std::shared_mutex> lock(shards_mutex_);
+    auto& slot = shards_[room];
+    if (!slot) {
+        slot = std::make_unique<Shard>();
+    }
+    return *slot;
+}
+
+bool SearchIndex::retire(Shard& shard, int64_t seq) {
+    auto it = std::lower_bound(shard.by_seq.begin(), shard.by_seq.end(), std::make_pair(seq, uint32_t{0}));
+    if (it == shard.by_seq.end() || it->first != seq) {
+        return false;
+    }
+    Document& doc = shard.docs[it->second];
+    if (doc.live) {
+        doc.live = false;
+        shard.live_docs--;
+        shard.live_length -= doc.length;
+    }
+    return true;
+}
+
+// Drop retired documents once they outnumber live ones: ids are renumbered
+// densely and every posting list is rewritten without them. Amortized, as
+// at least as many retirements as live documents precede each rewrite.
+void SearchIndex::compact_if_sparse(Shard& shard) {
+    size_t retired = shard.docs.size() - shard.live_docs;
+    if (retired < COMPACT_MIN_RETIRED || retired <= shard.live_docs) {
+        return;
+    }
+
+    constexpr uint32_t DROPPED = UINT32_MAX;
+    std::vector<uint32_t> renumbered(shard.docs.size(), DROPPED);
+    std::vector<Document> docs;
+    docs.reserve(shard.live_docs);
+    for (uint32_t doc_id = 0; doc_id < shard.docs.size(); ++doc_id) {
+        if (shard.docs[doc_id].live) {
+            renumbered[doc_id] = static_cast<uint32_t>(docs.size());
+            docs.push_back(shard.docs[doc_id]);
+        }
+    }
+
+    // A removed message's seq goes too; re-adding it later inserts it again
+    std::vector<std::pair<int64_t, uint32_t>> by_seq;
+    by_seq.reserve(docs.size());
+    for (const auto& [seq, doc_id] : shard.by_seq) {
+        if (renumbered[doc_id] != DROPPED) {
+            by_seq.emplace_back(seq, renumbered[doc_id]);
+        }
+    }
+
+    for (auto it = shard.terms.begin(); it != shard.terms.end();) {
+        const PostingList& old_postings = it->second;
+        PostingList postings;
+        size_t pos = 0;
+        uint32_t doc_id = 0;
+        for (uint32_t i = 0; i < old_postings.doc_count; ++i) {
+            uint32_t delta = get_varint(old_postings.bytes, pos);
+            doc_id = i == 0 ? delta : doc_id + delta;
+            uint32_t frequency = get_varint(old_postings.bytes, pos);
+            uint32_t new_id = renumbered[doc_id];
+            if (new_id == DROPPED) {
+                continue;
+            }
+            put_varint(postings.bytes, postings.doc_count == 0 ? new_id : new_id - postings.last_doc);
+            put_varint(postings.bytes, frequency);
+            postings.last_doc = new_id;
+            postings.doc_count++;
+        }
+        if (postings.doc_count == 0) {
+            it = shard.terms.erase(it);
+        } else {
+            postings.bytes.shrink_to_fit();
+            it->second = std::move(postings);
+            ++it;
+        }
+    }
+
+    shard.docs = std::move(docs);
+    shard.by_seq = std::move(by_seq);
+}
+
+void SearchIndex::upsert(const std::string& room_id, const std::string& message_id, int64_t seq,
+                         const std::string& sender_id, const std::string& content) {
+    Uuid128 id;
+    if (!Uuid128::parse(message_id, id)) {
+        return;  // message ids are UUIDs; anything else can't be stored compactly
+    }
+
+    // Term frequencies, computed outside the lock
+    std::vector<std::string> tokens = tokenize(content);
+    std::sort(tokens.begin(), tokens.end());
+    std::vector<std::pair<std::string, uint32_t>> frequencies;
+    for (auto& token : tokens) {
+        if (!frequencies.empty() && frequencies.back().first == token) {
+            frequencies.back().second++;
+        } else {
+            frequencies.emplace_back(std::move(token), 1);
+        }
+    }
+
+    Shard& shard = shard_for(interned_ids().intern(room_id));
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+    uint32_t doc_id = static_cast<uint32_t>(shard.docs.size());
+    bool replaced = retire(shard, seq);
+    shard.docs.push_back(Document{id, seq, static_cast<uint32_t>(tokens.size()), interned_ids().intern(sender_id), true});
+    shard.live_docs++;
+    shard.live_length += tokens.size();
+
+    auto slot = std::lower_bound(shard.by_seq.begin(), shard.by_seq.end(), std::make_pair(seq, uint32_t{0}));
+    if (replaced) {
+        slot->second = doc_id;
+    } else {
+        shard.by_seq.insert(slot, {seq, doc_id});  // almost always the end: rows arrive in seq order
+    }
+
+    for (const auto& [term, frequency] : frequencies) {
+        PostingList& postings = shard.terms[term];
+        put_varint(postings.bytes, postings.doc_count == 0 ? doc_id : doc_id - postings.last_doc);
+        put_varint(postings.bytes, frequency);
+        postings.last_doc = doc_id;
+        postings.doc_count++;
+    }
+    if (replaced) {
+        compact_if_sparse(shard);
+    }
+}
+
+void SearchIndex::remove(const std::string& room_id, int64_t seq) {
+    IdHandle room = interned_ids().find(room_id);
+    Shard* shard = room == NO_ID ? nullptr : find_shard(room);
+    if (!shard) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(shard->mutex);
+    if (retire(*shard, seq)) {
+        compact_if_sparse(*shard);
+    }
+}
+
+// ================================================
+// QUERIES
+// ================================================
+std::vector<SearchHit> SearchIndex::search(const std::vector<IdHandle>& rooms, const std::string& query,
+                                           size_t limit, const std::vector<IdHandle>& excluded_senders) const {
+    std::vector<std::string> terms = tokenize(query);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    if (terms.size() > MAX_QUERY_TERMS) {
+        terms.resize(MAX_QUERY_TERMS);
+    }
+    if (terms.empty() || limit == 0) {
+        return {};
+    }
+
+    std::vector<std::pair<IdHandle, Shard*>> shards;
+    for (IdHandle room : rooms) {
+        if (Shard* shard = find_shard(room)) {
+            shards.emplace_back(room, shard);
+        }
+    }
+
+    // Pass 1: collection statistics over the searched rooms only
+    double total_docs = 0;
+    double total_length = 0;
+    std::vector<double> doc_frequency(terms.size(), 0);
+    for (const auto& [room, shard] : shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        total_docs += shard->live_docs;
+        total_length += static_cast<double>(shard->live_length);
+        for (size_t t = 0; t < terms.size(); ++t) {
+            auto it = shard->terms.find(terms[t]);
+            if (it != shard->terms.end()) {
+                doc_frequency[t] += it->second.doc_count;
+            }
+        }
+    }
+    if (total_docs == 0) {
+        return {};
+    }
+    double average_length = std::max(1.0, total_length / total_docs);
+
+    std::vector<double> idf(terms.size());
+    for (size_t t = 0; t < terms.size(); ++t) {
+        double df = std::min(doc_frequency[t], total_docs);
+        idf[t] = std::log(1.0 + (total_docs - df + 0.5) / (df + 0.5));
+    }
+
+    // Pass 2: score each shard, keep a min-heap of the best `limit` (ties: newer first)
+    auto ranks_higher = [](const SearchHit& a, const SearchHit& b) {
+        return a.score != b.score ? a.score > b.score : a.seq > b.seq;
+    };
+    std::priority_queue<SearchHit, std::vector<SearchHit>, decltype(ranks_higher)> best(ranks_higher);
+
+    // Dense accumulator per shard: posting walks are sequential, lookups are O(1)
+    std::vector<double> scores;
+    std::vector<uint32_t> touched;
+    for (const auto& [room, shard] : shards) {
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        scores.assign(shard->docs.size(), 0.0);
+        touched.clear();
+
+        for (size_t t = 0; t < terms.size(); ++t) {
+            auto it = shard->terms.find(terms[t]);
+            if (it == shard->terms.end()) {
+                continue;
+            }
+            const PostingList& postings = it->second;
+            size_t pos = 0;
+            uint32_t doc_id = 0;
+            for (uint32_t i = 0; i < postings.doc_count; ++i) {
+                uint32_t delta = get_varint(postings.bytes, pos);
+                doc_id = i == 0 ? delta : doc_id + delta;
+                uint32_t frequency = get_varint(postings.bytes, pos);
+
+                const Document& doc = shard->docs[doc_id];
+                if (!doc.live || (!excluded_senders.empty()
+                                  && std::binary_search(excluded_senders.begin(), excluded_senders.end(), doc.sender))) {
+                    continue;
+                }
+                double tf = frequency;
+                double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * doc.length / average_length);
+                if (scores[doc_id] == 0.0) {
+                    touched.push_back(doc_id);
+                }
+                scores[doc_id] += idf[t] * tf * (BM25_K1 + 1.0) / (tf + norm);
+            }
+        }
+
+        for (uint32_t doc_id : touched) {
+            const Document& doc = shard->docs[doc_id];
+            SearchHit hit;
+            hit.room = room;
+            hit.seq = doc.seq;
+            hit.score = scores[doc_id];
+            if (best.size() < limit) {
+                hit.message_id = doc.message_id.to_string();
+                best.push(std::move(hit));
+            } else if (ranks_higher(hit, best.top())) {
+                best.pop();
+                hit.message_id = doc.message_id.to_string();
+                best.push(std::move(hit));
+            }
+        }
+    }
+
+    std::vector<SearchHit> hits;
+    hits.reserve(best.size());
+    while (!best.empty()) {
+        hits.push_back(best.top());
+        best.pop();
+    }
+    std::reverse(hits.begin(), hits.end());
+    return hits;
+}
+
+// ================================================
+// STATS
+// ================================================
+size_t SearchIndex::document_count() const {
+    std::shared_lock<std::shared_mutex> lock(shards_mutex_);
+    size_t count = 0;
+    for (const auto& [room, shard] : shards_) {
+        std::shared_lock<std::shared_mutex> shard_lock(shard->mutex);
+        count += shard->live_docs;
+    }
+    return count;
+}
+
+size_t SearchIndex::retired_count() const {
+    std::shared_lock<std::shared_mutex> lock(shards_mutex_);
+    size_t count = 0;
+    for (const auto& [room, shard] : shards_) {
+        std::shared_lock<std::shared_mutex> shard_lock(shard->mutex);
+        count += shard->docs.size() - shard->live_docs;
+    }
+    return count;
+}
+
+size_t SearchIndex::shard_count() const {
+    std::shared_lock<std::shared_mutex> lock(shards_mutex_);
+    return shards_.size();
+}
+
+size_t SearchIndex::memory_bytes() const {
+    std::shared_lock<std::shared_mutex> lock(shards_mutex_);
+    size_t bytes = 0;
+    for (const auto& [room, shard] : shards_) {
+        std::shared_lock<std::shared_mutex> shard_lock(shard->mutex);
+        bytes += sizeof(Shard) + shard->docs.capacity() * sizeof(Document)
+               + shard->by_seq.capacity() * sizeof(std::pair<int64_t, uint32_t>);
+        for (const auto& [term, postings] : shard->terms) {
+            // hash node + key + posting bytes (short terms stay in the SSO buffer)
+            bytes += sizeof(term) + sizeof(postings) + 2 * sizeof(void*) + postings.bytes.capacity()
+                   + (term.size() > 15 ? term.capacity() : 0);
+        }
+    }
+    return bytes;
+}
+
+} // namespace caffis
@@ -0,0 +1,134 @@
+#include "../include/session_directory.h"
+#include "../include/metrics.h"
+#include <iostream>
+
+namespace caffis {
+
+// ================================================
+// IN-MEMORY STAND-IN
+// ================================================
+InMemorySessionDirectory::InMemorySessionDirectory(std::chrono::seconds lease)
+    : SessionDirectory(lease) {
+    std::cout << "📇 In-memory session directory initialized (lease " << lease.count() << "s)" << std::endl;
+}
+
+void InMemorySessionDirectory::register_user(const std::string& user_id, const std::string& node_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    leases_[user_id][node_id] = Clock::now() + lease_;
+}
+
+void InMemorySessionDirectory::unregister_user(const std::string& user_id, const std::string& node_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = leases_.find(user_id);
+    if (it == leases_.end()) {
+        return;
+    }
+    it->second.erase(node_id);
+    if (it->second.empty()) {
+        leases_.erase(it);
+    }
+}
+
+void InMemorySessionDirectory::refresh_leases(const std::vector<std::string>& user_ids, const std::string& node_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto expiry = Clock::now() + lease_;
+    for (const auto& user_id : user_ids) {
+        leases_[user_id][node_id] = expiry;
+    }
+}
+
+std::vector<std::string> InMemorySessionDirectory::lookup(const std::string& user_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> nodes;
+
+    auto it = leases_.find(user_id);
+    if (it == leases_.end()) {
+        return nodes;
+    }
+
+    auto now = Clock::now();
+    for (auto node = it->second.begin(); node != it->second.end();) {
+        if (node->second < now) {
+            node = it->second.erase(node);
+        } else {
+            nodes.push_back(node->first);
+            ++node;
+        }
+    }
+    if (it->second.empty()) {
+        leases_.erase(it);
+    }
+    return nodes;
+}
+
+// ================================================
+// REDIS DIRECTORY
+// ================================================
+RedisSessionDirectory::RedisSessionDirectory(const std::string& host, int port, std::chrono::seconds lease)
+    : SessionDirectory(lease), redis_(std::make_unique<RedisClient>(host, port)) {
+    redis_->connect();
+    std::cout << "📇 Redis session directory initialized (lease " << lease.count() << "s)" << std::endl;
+}
+
+std::vector<std::vector<std::string>> RedisSessionDirectory::lease_commands(const std::string& user_id,
+                                                                            const std::string& node_id) const {
+    int64_t lease_ms = std::chrono::duration_cast<std::chrono::milliseconds>(lease_).count();
+    int64_t expiry_ms = metrics::now_us() / 1000 + lease_ms;
+    std::string key = key_for(user_id);
+
+    // The per-node expiry guards against dead nodes; the key TTL reclaims
+    // users nobody refreshes any more
+    return {
+        {"HSET", key, node_id, std::to_string(expiry_ms)},
+        {"PEXPIRE", key, std::to_string(lease_ms * 2)}
+    };
+}
+
+void RedisSessionDirectory::register_user(const std::string& user_id, const std::string& node_id) {
+    auto replies = redis_->pipeline(lease_commands(user_id, node_id));
+    if (!replies.front().ok()) {
+        std::cerr << "⚠️ Session directory register failed for " << user_id << ": " << replies.front().str << std::endl;
+    }
+}
+
+void RedisSessionDirectory::unregister_user(const std::string& user_id, const std::string& node_id) {
+    redis_->command({"HDEL", key_for(user_id), node_id});
+}
+
+void RedisSessionDirectory::refresh_leases(const std::vector<std::string>& user_ids, const std::string& node_id) {
+    if (user_ids.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<std::string>> commands;
+    commands.reserve(user_ids.size() * 2);
+    for (const auto& user_id : user_ids) {
+        auto lease = lease_commands(user_id, node_id);
+        commands.insert(commands.end(), lease.begin(), lease.end());
+    }
+    redis_->pipeline(commands);
+}
+
+std::vector<std::string> RedisSessionDirectory::lookup(const std::string& user_id) {
+    std::vector<std::string> nodes;
+    RedisReply reply = redis_->command({"HGETALL", key_for(user_id)});
+    if (reply.type != RedisReply::Type::ARRAY) {
+        return nodes;
+    }
+
+    int64_t now_ms = metrics::now_us() / 1000;
+    for (size_t i = 0; i + 1 < reply.elements.size(); i += 2) {
+        int64_t expiry_ms = 0;
+        try {
+            expiry_ms = std::stoll(reply.elements[i + 1].str);
+        } catch (const std::exception&) {
+            continue;
+        }
+        if (expiry_ms >= now_ms) {
+            nodes.push_back(reply.elements[i].str);
+        }
+    }
+    return nodes;
+}
+
+} // namespace caffis
@@ -0,0 +1,679 @@
+#include "../include/soak_test.h"
+#include "../include/traffic_replay.h"
+#include "../include/metrics.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace caffis {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace pt = boost::property_tree;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr size_t PROXY_BUFFER_BYTES = 16 * 1024;
+const auto RECONNECT_DELAY = std::chrono::milliseconds(100);
+const auto ECHO_GRACE = std::chrono::seconds(1);  // after the last message, before closing
+
+std::vector<std::string> read_id_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        line.erase(std::remove_if(line.begin(), line.end(), [](unsigned char c) { return std::isspace(c); }), line.end());
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+class ChurnClient;
+class ProxyLink;
+
+// Everything here is touched only from the io thread, except the metrics
+struct SoakState {
+    const SoakOptions& options;
+    net::io_context ioc;
+    tcp::endpoint upstream;
+    tcp::acceptor proxy_acceptor;
+    std::vector<std::string> users;
+    std::vector<std::string> rooms;
+    std::mt19937 rng{std::random_device{}()};
+    bool churning = true;
+    uint64_t next_connection = 0;
+    std::vector<std::weak_ptr<ChurnClient>> clients;  // by slot
+    std::vector<std::weak_ptr<ProxyLink>> links;
+
+    metrics::Histogram& echo_latency = metrics::histogram("caffis_soak_latency_us{op=\"message_echo\"}");
+    metrics::Counter& connections = metrics::counter("caffis_soak_connections_total");
+    metrics::Counter& failed_connections = metrics::counter("caffis_soak_connections_failed_total");
+    metrics::Counter& stalls = metrics::counter("caffis_soak_faults_total{fault=\"stall\"}");
+    metrics::Counter& resets = metrics::counter("caffis_soak_faults_total{fault=\"reset\"}");
+
+    explicit SoakState(const SoakOptions& soak_options) : options(soak_options), proxy_acceptor(ioc) {}
+
+    double roll() { return std::uniform_real_distribution<double>(0, 1)(rng); }
+
+    template <typename T>
+    const T& pick(const std::vector<T>& from) {
+        return from[std::uniform_int_distribution<size_t>(0, from.size() - 1)(rng)];
+    }
+
+    void spawn_client(size_t slot);
+    void accept_proxy();
+};
+
+// ================================================
+// FAULT-INJECTING PROXY
+// ================================================
+// One client connection and its upstream twin. At most one fault per link,
+// at a random point of a typical connection's lifetime: forwarding pauses
+// in both directions for stall_ms, or both sockets are closed.
+class ProxyLink : public std::enable_shared_from_this<ProxyLink> {
+private:
+    SoakState& state_;
+    tcp::socket client_;
+    tcp::socket server_;
+    std::array<char, PROXY_BUFFER_BYTES> upstream_buffer_;    // client -> server
+    std::array<char, PROXY_BUFFER_BYTES> downstream_buffer_;  // server -> client
+    net::steady_timer upstream_stall_;
+    net::steady_timer downstream_stall_;
+    net::steady_timer fault_timer_;
+    Clock::time_point stalled_until_{};
+    bool closed_ = false;
+
+public:
+    ProxyLink(SoakState& state, tcp::socket client)
+        : state_(state), client_(std::move(client)), server_(state.ioc), upstream_stall_(state.ioc),
+          downstream_stall_(state.ioc), fault_timer_(state.ioc) {}
+
+    void start() {
+        auto self = shared_from_this();
+        server_.async_connect(state_.upstream, [self](beast::error_code ec) {
+            if (ec) {
+                self->close();
+                return;
+            }
+            beast::error_code option_ec;
+            self->client_.set_option(tcp::no_delay(true), option_ec);
+            self->server_.set_option(tcp::no_delay(true), option_ec);
+            self->pump(self->client_, self->server_, self->upstream_buffer_, self->upstream_stall_);
+            self->pump(self->server_, self->client_, self->downstream_buffer_, self->downstream_stall_);
+            self->arm_fault();
+        });
+    }
+
+    void close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        beast::error_code ec;
+        client_.close(ec);
+        server_.close(ec);
+        upstream_stall_.cancel();
+        downstream_stall_.cancel();
+        fault_timer_.cancel();
+    }
+
+private:
+    using Buffer = std::array<char, PROXY_BUFFER_BYTES>;
+
+    void arm_fault() {
+        const SoakOptions& options = state_.options;
+        double roll = state_.roll();
+        bool stall = roll < options.stall_probability;
+        if (!stall && roll >= options.stall_probability + options.reset_probability) {
+            return;
+        }
+        int lifetime_ms = std::max(1, options.messages_per_connection * options.message_interval_ms);
+        fault_timer_.expires_after(std::chrono::milliseconds(std::uniform_int_distribution<int>(0, lifetime_ms)(state_.rng)));
+        auto self = shared_from_this();
+        fault_timer_.async_wait([self, stall](beast::error_code ec) {
+            if (ec || self->closed_) {
+                return;
+            }
+            if (stall) {
+                self->state_.stalls.inc();
+                self->stalled_until_ = Clock::now() + std::chrono::milliseconds(self->state_.options.stall_ms);
+            } else {
+                self->state_.resets.inc();
+                self->close();
+            }
+        });
+    }
+
+    void pump(tcp::socket& from, tcp::socket& to, Buffer& buffer, net::steady_timer& stall) {
+        auto self = shared_from_this();
+        from.async_read_some(net::buffer(buffer), [self, &from, &to, &buffer, &stall](beast::error_code ec, size_t bytes) {
+            if (ec) {
+                self->close();
+                return;
+            }
+            self->forward(from, to, buffer, bytes, stall);
+        });
+    }
+
+    void forward(tcp::socket& from, tcp::socket& to, Buffer& buffer, size_t bytes, net::steady_timer& stall) {
+        auto self = shared_from_this();
+        if (Clock::now() < stalled_until_) {
+            stall.expires_at(stalled_until_);
+            stall.async_wait([self, &from, &to, &buffer, bytes, &stall](beast::error_code ec) {
+                if (ec || self->closed_) {
+                    return;
+                }
+                self->forward(from, to, buffer, bytes, stall);
+            });
+            return;
+        }
+        net::async_write(to, net::buffer(buffer.data(), bytes), [self, &from, &to, &buffer, &stall](beast::error_code ec, size_t) {
+            if (ec) {
+                self->close();
+                return;
+            }
+            self->pump(from, to, buffer, stall);
+        });
+    }
+};
+
+void SoakState::accept_proxy() {
+    proxy_acceptor.async_accept([this](beast::error_code ec, tcp::socket socket) {
+        if (ec) {
+            return;  // acceptor closed
+        }
+        auto link = std::make_shared<ProxyLink>(*this, std::move(socket));
+        link->start();
+        if (links.size() >= 4 * clients.size()) {
+            links.erase(std::remove_if(links.begin(), links.end(),
+                [](const std::weak_ptr<ProxyLink>& weak) { return weak.expired(); }), links.end());
+        }
+        links.push_back(link);
+        accept_proxy();
+    });
+}
+
+// ================================================
+// CHURN CLIENTS
+// ================================================
+// connect -> auth -> join_room -> messages_per_connection messages -> close,
+// then the slot starts over with a fresh connection
+class ChurnClient : public std::enable_shared_from_this<ChurnClient> {
+private:
+    SoakState& state_;
+    size_t slot_;
+    std::string tag_;
+    std::string user_id_;
+    std::string room_id_;
+    websocket::stream<beast::tcp_stream> ws_;
+    net::steady_timer timer_;
+    beast::flat_buffer read_buffer_;
+    std::string out_;
+    int sent_ = 0;
+    bool closing_ = false;
+    bool finished_ = false;
+    std::unordered_map<std::string, Clock::time_point> awaiting_echo_;  // by content
+
+public:
+    ChurnClient(SoakState& state, size_t slot)
+        : state_(state), slot_(slot), tag_(std::to_string(slot) + "-" + std::to_string(state.next_connection++)),
+          user_id_(state.pick(state.users)), room_id_(state.pick(state.rooms)), ws_(state.ioc), timer_(state.ioc) {}
+
+    void start() {
+        state_.connections.inc();
+        websocket::stream_base::timeout timeouts;
+        timeouts.handshake_timeout = std::chrono::seconds(10);
+        timeouts.idle_timeout = std::chrono::seconds(30);
+        timeouts.keep_alive_pings = false;
+        ws_.set_option(timeouts);
+
+        auto self = shared_from_this();
+        beast::get_lowest_layer(ws_).async_connect(state_.proxy_acceptor.local_endpoint(), [self](beast::error_code ec) {
+            if (ec) {
+                self->finish();
+                return;
+            }
+            beast::get_lowest_layer(self->ws_).expires_never();  // the websocket timeouts take over
+            self->ws_.async_handshake(self->state_.options.host, "/", [self](beast::error_code handshake_ec) {
+                if (handshake_ec) {
+                    self->finish();
+                    return;
+                }
+                pt::ptree auth;
+                auth.put("type", "auth");
+                auth.put("token", mint_test_token(self->user_id_, self->state_.options.jwt_secret));
+                self->send(auth, [self]() { self->read_next(); });
+            });
+        });
+    }
+
+    void close() {
+        if (finished_ || closing_) {
+            return;
+        }
+        closing_ = true;
+        timer_.cancel();
+        auto self = shared_from_this();
+        ws_.async_close(websocket::close_code::normal, [self](beast::error_code) {});
+    }
+
+private:
+    template <typename Next>
+    void send(const pt::ptree& frame, Next next) {
+        std::ostringstream oss;
+        pt::write_json(oss, frame, false);
+        out_ = oss.str();
+        auto self = shared_from_this();
+        ws_.async_write(net::buffer(out_), [self, next](beast::error_code ec, size_t) {
+            if (ec) {
+                self->finish();
+                return;
+            }
+            next();
+        });
+    }
+
+    void read_next() {
+        auto self = shared_from_this();
+        ws_.async_read(read_buffer_, [self](beast::error_code ec, size_t) {
+            if (ec) {
+                self->finish();
+                return;
+            }
+            std::string frame = beast::buffers_to_string(self->read_buffer_.data());
+            self->read_buffer_.consume(self->read_buffer_.size());
+            self->on_frame(frame);
+            self->read_next();
+        });
+    }
+
+    void on_frame(const std::string& frame) {
+        pt::ptree tree;
+        try {
+            std::istringstream iss(frame);
+            pt::read_json(iss, tree);
+        } catch (const std::exception&) {
+            return;
+        }
+        std::string type = tree.get<std::string>("type", "");
+        if (type == "auth_success") {
+            pt::ptree join;
+            join.put("type", "join_room");
+            join.put("room_id", room_id_);
+            auto self = shared_from_this();
+            send(join, [self]() { self->schedule_message(); });
+        } else if (type == "new_message") {
+            auto it = awaiting_echo_.find(tree.get<std::string>("content", ""));
+            if (it != awaiting_echo_.end()) {
+                state_.echo_latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - it->second).count());
+                awaiting_echo_.erase(it);
+            }
+        } else if (type == "auth_error") {
+            close();  // e.g. the main DB is restarting
+        }
+    }
+
+    void schedule_message() {
+        auto self = shared_from_this();
+        if (sent_ >= state_.options.messages_per_connection) {
+            timer_.expires_after(ECHO_GRACE);
+            timer_.async_wait([self](beast::error_code ec) {
+                if (!ec) {
+                    self->close();
+                }
+            });
+            return;
+        }
+        timer_.expires_after(std::chrono::milliseconds(state_.options.message_interval_ms));
+        timer_.async_wait([self](beast::error_code ec) {
+            if (ec || self->closing_) {
+                return;
+            }
+            std::string content = "soak " + self->tag_ + "-" + std::to_string(self->sent_++);
+            pt::ptree message;
+            message.put("type", "message");
+            message.put("roomId", self->room_id_);
+            message.put("content", content);
+            self->awaiting_echo_[content] = Clock::now();
+            self->send(message, [self]() { self->schedule_message(); });
+        });
+    }
+
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        timer_.cancel();
+        beast::error_code ec;
+        beast::get_lowest_layer(ws_).socket().close(ec);
+        if (!closing_ || sent_ < state_.options.messages_per_connection) {
+            state_.failed_connections.inc();  // injected resets land here too
+        }
+        if (state_.churning) {
+            auto timer = std::make_shared<net::steady_timer>(state_.ioc, RECONNECT_DELAY);
+            SoakState* state = &state_;
+            size_t slot = slot_;
+            timer->async_wait([timer, state, slot](beast::error_code) {
+                if (state->churning) {
+                    state->spawn_client(slot);
+                }
+            });
+        }
+    }
+};
+
+void SoakState::spawn_client(size_t slot) {
+    auto client = std::make_shared<ChurnClient>(*this, slot);
+    clients[slot] = client;
+    client->start();
+}
+
+// ================================================
+// SAMPLING AND DRIFT
+// ================================================
+struct SoakSample {
+    bool ok = false;
+    int64_t rss = 0;
+    int64_t threads = 0;
+    int64_t fds = 0;
+    int64_t sessions = 0;
+    uint64_t p99_us = 0;   // client-side echo latency in this window
+    uint64_t echoes = 0;
+};
+
+std::string fetch_server_metrics(const SoakOptions& options) {
+    try {
+        net::io_context ioc;
+        tcp::resolver resolver(ioc);
+        beast::tcp_stream stream(ioc);
+        stream.expires_after(std::chrono::seconds(5));
+        stream.connect(resolver.resolve(options.host, options.port));
+
+        http::request<http::empty_body> request{http::verb::get, "/admin/metrics", 11};
+        request.set(http::field::host, options.host);
+        if (!options.admin_token.empty()) {
+            request.set(http::field::authorization, "Bearer " + options.admin_token);
+        }
+        http::write(stream, request);
+
+        beast::flat_buffer buffer;
+        http::response<http::string_body> response;
+        http::read(stream, buffer, response);
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+        return response.result() == http::status::ok ? response.body() : std::string();
+    } catch (const std::exception&) {
+        return "";
+    }
+}
+
+int64_t metric_value(const std::string& exposition, const std::string& name) {
+    std::istringstream lines(exposition);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.size() > name.size() && line.compare(0, name.size(), name) == 0 && line[name.size()] == ' ') {
+            return std::stoll(line.substr(name.size() + 1));
+        }
+    }
+    return -1;
+}
+
+// Percentile of what the histogram saw since the previous call
+uint64_t window_percentile(const metrics::Histogram& histogram, std::vector<uint64_t>& previous, double q, uint64_t& count) {
+    const auto& upper_bounds = metrics::Histogram::bounds();
+    std::vector<uint64_t> delta(upper_bounds.size() + 1);
+    previous.resize(delta.size());
+    count = 0;
+    for (size_t i = 0; i < delta.size(); ++i) {
+        uint64_t now = histogram.bucket(i);
+        delta[i] = now - previous[i];
+        previous[i] = now;
+        count += delta[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(q * count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < delta.size(); ++i) {
+        seen += delta[i];
+        if (seen >= target) {
+            return i < upper_bounds.size() ? upper_bounds[i] : upper_bounds.back() * 2;
+        }
+    }
+    return upper_bounds.back() * 2;
+}
+
+SoakSample take_sample(const SoakOptions& options, const metrics::Histogram& latency, std::vector<uint64_t>& previous) {
+    SoakSample sample;
+    std::string exposition = fetch_server_metrics(options);
+    sample.p99_us = window_percentile(latency, previous, 0.99, sample.echoes);
+    if (exposition.empty()) {
+        return sample;
+    }
+    sample.rss = metric_value(exposition, "caffis_process_resident_bytes");
+    sample.threads = metric_value(exposition, "caffis_process_threads");
+    sample.fds = metric_value(exposition, "caffis_process_open_fds");
+    sample.sessions = metric_value(exposition, "caffis_sessions_active");
+    sample.ok = sample.rss >= 0 && sample.threads >= 0 && sample.fds >= 0;
+    return sample;
+}
+
+template <typename T, typename Field>
+T median_of(const std::vector<SoakSample>& samples, size_t first, Field field) {
+    std::vector<T> values;
+    for (size_t i = first; i < samples.size(); ++i) {
+        values.push_back(samples[i].*field);
+    }
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+SoakSample median_sample(const std::vector<SoakSample>& samples, size_t first) {
+    SoakSample median;
+    median.ok = true;
+    median.rss = median_of<int64_t>(samples, first, &SoakSample::rss);
+    median.threads = median_of<int64_t>(samples, first, &SoakSample::threads);
+    median.fds = median_of<int64_t>(samples, first, &SoakSample::fds);
+    median.sessions = median_of<int64_t>(samples, first, &SoakSample::sessions);
+    median.p99_us = median_of<uint64_t>(samples, first, &SoakSample::p99_us);
+    return median;
+}
+
+// Empty = within limits
+std::string drift_reason(const SoakOptions& options, const SoakSample& baseline, const SoakSample& recent) {
+    std::ostringstream reason;
+    if (recent.rss > baseline.rss * (1 + options.max_rss_growth)) {
+        reason << "RSS " << baseline.rss / (1024 * 1024) << " -> " << recent.rss / (1024 * 1024) << " MB";
+    } else if (recent.threads > baseline.threads + options.max_thread_growth) {
+        reason << "threads " << baseline.threads << " -> " << recent.threads;
+    } else if (recent.fds > baseline.fds + options.max_fd_growth) {
+        reason << "open FDs " << baseline.fds << " -> " << recent.fds;
+    } else if (baseline.p99_us > 0 && recent.p99_us > baseline.p99_us * options.max_p99_growth) {
+        reason << "echo p99 " << baseline.p99_us << " -> " << recent.p99_us << " us";
+    }
+    return reason.str();
+}
+
+void print_sample(const std::string& label, const SoakSample& sample) {
+    std::cout << "🧪 [" << label << "] RSS " << sample.rss / (1024 * 1024) << " MB, " << sample.threads
+              << " threads, " << sample.fds << " FDs, " << sample.sessions << " sessions, echo p99 "
+              << sample.p99_us << "us (" << sample.echoes << " echoes)" << std::endl;
+}
+
+} // namespace
+
+int run_soak(const SoakOptions& options) {
+    SoakState state(options);
+    state.users = read_id_lines(options.users_path);
+    state.rooms = read_id_lines(options.rooms_path);
+    if (state.users.empty() || state.rooms.empty()) {
+        std::cerr << "❌ --users and --rooms must name files with at least one id each" << std::endl;
+        return 1;
+    }
+    try {
+        tcp::resolver resolver(state.ioc);
+        state.upstream = *resolver.resolve(options.host, options.port).begin();
+        state.proxy_acceptor.open(tcp::v4());
+        state.proxy_acceptor.bind(tcp::endpoint(net::ip::address_v4::loopback(), 0));
+        state.proxy_acceptor.listen();
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Soak setup failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> latency_buckets;
+    SoakSample idle = take_sample(options, state.echo_latency, latency_buckets);
+    if (!idle.ok) {
+        std::cerr << "❌ Cannot read /admin/metrics from " << options.host << ":" << options.port
+                  << " (run from the server host or pass --admin-token)" << std::endl;
+        return 1;
+    }
+    std::cout << "🧪 Soak: " << options.clients << " clients through proxy port "
+              << state.proxy_acceptor.local_endpoint().port() << " for " << options.duration_seconds << "s" << std::endl;
+    print_sample("idle", idle);
+
+    state.clients.resize(static_cast<size_t>(options.clients));
+    state.accept_proxy();
+    for (size_t slot = 0; slot < state.clients.size(); ++slot) {
+        state.spawn_client(slot);
+    }
+    auto work = net::make_work_guard(state.ioc);
+    std::thread io_thread([&state]() { state.ioc.run(); });
+
+    const auto begin = Clock::now();
+    const auto end = begin + std::chrono::seconds(options.duration_seconds);
+    std::atomic<bool> running{true};
+    std::thread db_restarts;
+    if (!options.db_restart_command.empty()) {
+        db_restarts = std::thread([&options, &running, end]() {
+            auto next = Clock::now() + std::chrono::seconds(options.db_restart_seconds);
+            while (running && next < end) {
+                while (running && Clock::now() < next) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                }
+                if (!running) {
+                    break;
+                }
+                int status = std::system(options.db_restart_command.c_str());
+                std::cout << "🧪 DB restart command exited with " << status << std::endl;
+                next += std::chrono::seconds(options.db_restart_seconds);
+            }
+        });
+    }
+
+    // Sample until the end or the first drift
+    std::vector<SoakSample> samples;
+    size_t warmup_samples = 0;
+    SoakSample baseline;
+    std::string failure;
+    int unreachable = 0;
+    while (Clock::now() + std::chrono::seconds(options.sample_seconds) <= end && failure.empty()) {
+        std::this_thread::sleep_for(std::chrono::seconds(options.sample_seconds));
+        long elapsed_s = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - begin).count();
+        SoakSample sample = take_sample(options, state.echo_latency, latency_buckets);
+        if (!sample.ok) {
+            std::cerr << "⚠️ [" << elapsed_s << "s] metrics scrape failed" << std::endl;
+            if (++unreachable >= 3) {
+                failure = "server unreachable for 3 samples";
+            }
+            continue;
+        }
+        unreachable = 0;
+        print_sample(std::to_string(elapsed_s) + "s", sample);
+        samples.push_back(sample);
+
+        if (elapsed_s <= options.warmup_seconds) {
+            continue;
+        }
+        if (warmup_samples == 0) {
+            warmup_samples = samples.size() - 1;
+            if (warmup_samples == 0) {
+                continue;  // warm-up shorter than one sample interval: next sample is the baseline
+            }
+            baseline = median_sample(std::vector<SoakSample>(samples.begin(), samples.begin() + warmup_samples), 0);
+            print_sample("baseline", baseline);
+        }
+        if (samples.size() >= warmup_samples + 3) {
+            failure = drift_reason(options, baseline, median_sample(samples, samples.size() - 3));
+        }
+    }
+
+    // Stop the churn, let the server unwind, then it must look like it did before
+    running = false;
+    net::post(state.ioc, [&state]() {
+        state.churning = false;
+        beast::error_code ec;
+        state.proxy_acceptor.close(ec);
+        for (auto& weak : state.clients) {
+            if (auto client = weak.lock()) {
+                client->close();
+            }
+        }
+        for (auto& weak : state.links) {
+            if (auto link = weak.lock()) {
+                link->close();
+            }
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(2));  // close handshakes
+    work.reset();
+    state.ioc.stop();
+    io_thread.join();
+    if (db_restarts.joinable()) {
+        db_restarts.join();
+    }
+
+    std::cout << "🧪 " << state.connections.value() << " connections, " << state.failed_connections.value()
+              << " cut short, " << state.stalls.value() << " stalls, " << state.resets.value() << " resets injected" << std::endl;
+
+    if (failure.empty()) {
+        std::this_thread::sleep_for(std::chrono::seconds(options.settle_seconds));
+        SoakSample settled = take_sample(options, state.echo_latency, latency_buckets);
+        print_sample("settled", settled);
+        if (!settled.ok) {
+            failure = "server unreachable after the churn";
+        } else if (settled.sessions > idle.sessions) {
+            failure = "sessions not released: " + std::to_string(idle.sessions) + " -> " + std::to_string(settled.sessions);
+        } else if (settled.threads > idle.threads + options.max_thread_growth / 4) {
+            failure = "threads not released: " + std::to_string(idle.threads) + " -> " + std::to_string(settled.threads);
+        } else if (settled.fds > idle.fds + options.max_fd_growth / 4) {
+            failure = "FDs not released: " + std::to_string(idle.fds) + " -> " + std::to_string(settled.fds);
+        }
+    }
+
+    if (!failure.empty()) {
+        std::cerr << "❌ Soak failed: " << failure << std::endl;
+        return 1;
+    }
+    std::cout << "✅ Soak passed: no drift over " << samples.size() << " samples" << std::endl;
+    return 0;
+}
+
+} // namespace caffis
@@ -0,0 +1,340 @@
+#include "../include/state_snapshot.h"
+#include "../include/hot_cache.h"
+#include "../include/database_manager.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace caffis {
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'C', 'A', 'F', 'S', 'N', 'A', 'P', '\0'};
+
+uint64_t fnv1a(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// ------------------------------------------------
+// Encoding
+// ------------------------------------------------
+class SnapshotWriter {
+public:
+    std::string buffer;
+
+    template <typename T>
+    void put(T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put_string(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        buffer.append(value);
+    }
+};
+
+// Bounds-checked reader over the mapped payload
+class SnapshotReader {
+private:
+    const char* cursor_;
+    const char* end_;
+
+public:
+    SnapshotReader(const char* data, size_t size) : cursor_(data), end_(data + size) {}
+
+    template <typename T>
+    T get() {
+        if (static_cast<size_t>(end_ - cursor_) < sizeof(T)) {
+            throw std::runtime_error("snapshot truncated");
+        }
+        T value;
+        std::memcpy(&value, cursor_, sizeof(T));
+        cursor_ += sizeof(T);
+        return value;
+    }
+
+    std::string get_string() {
+        uint32_t size = get<uint32_t>();
+        if (static_cast<size_t>(end_ - cursor_) < size) {
+            throw std::runtime_error("snapshot truncated");
+        }
+        std::string value(cursor_, size);
+        cursor_ += size;
+        return value;
+    }
+};
+
+std::string encode_payload(const HotCacheContents& contents) {
+    SnapshotWriter writer;
+
+    writer.put<uint32_t>(static_cast<uint32_t>(contents.users.size()));
+    for (const auto& [user_id, user] : contents.users) {
+        writer.put_string(user_id);
+        writer.put_string(user.username);
+        writer.put_string(user.display_name);
+    }
+
+    writer.put<uint32_t>(static_cast<uint32_t>(contents.room_members.size()));
+    for (const auto& [room_id, members] : contents.room_members) {
+        writer.put_string(room_id);
+        writer.put<uint32_t>(static_cast<uint32_t>(members.size()));
+        for (const auto& user_id : members) {
+            writer.put_string(user_id);
+        }
+    }
+
+    writer.put<uint32_t>(static_cast<uint32_t>(contents.room_tails.size()));
+    for (const auto& [room_id, messages] : contents.room_tails) {
+        writer.put_string(room_id);
+        writer.put<uint32_t>(static_cast<uint32_t>(messages.size()));
+        for (const auto& msg : messages) {
+            writer.put_string(msg.id);
+            writer.put_string(msg.sender_id);
+            writer.put_string(msg.content);
+            writer.put<uint8_t>(static_cast<uint8_t>(msg.type));
+            bool has_file = !msg.file_url.empty();
+            bool has_metadata = !msg.metadata.empty();
+            writer.put<uint8_t>(static_cast<uint8_t>((msg.is_edited ? 1 : 0) | (msg.is_deleted ? 2 : 0) |
+                                                     (has_file ? 4 : 0) | (has_metadata ? 8 : 0)));
+            if (has_file) {
+                writer.put_string(msg.file_url);
+                writer.put_string(msg.file_name);
+                writer.put_string(msg.file_type);
+                writer.put<uint64_t>(msg.file_size);
+            }
+            if (has_metadata) {
+                writer.put_string(msg.metadata);
+            }
+            writer.put<int64_t>(msg.seq);
+            writer.put<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                msg.timestamp.time_since_epoch()).count());
+        }
+    }
+
+    return writer.buffer;
+}
+
+// Decodes fully before touching the cache so a bad file never half-loads
+HotCacheContents decode_payload(const char* data, size_t size) {
+    SnapshotReader reader(data, size);
+    HotCacheContents contents;
+
+    uint32_t user_count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < user_count; ++i) {
+        std::string user_id = reader.get_string();
+        CachedUser user;
+        user.username = reader.get_string();
+        user.display_name = reader.get_string();
+        contents.users.emplace_back(std::move(user_id), std::move(user));
+    }
+
+    uint32_t member_rooms = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < member_rooms; ++i) {
+        std::string room_id = reader.get_string();
+        uint32_t member_count = reader.get<uint32_t>();
+        std::vector<std::string> members;
+        members.reserve(member_count);
+        for (uint32_t j = 0; j < member_count; ++j) {
+            members.push_back(reader.get_string());
+        }
+        contents.room_members.emplace_back(std::move(room_id), std::move(members));
+    }
+
+    uint32_t tail_rooms = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < tail_rooms; ++i) {
+        std::string room_id = reader.get_string();
+        uint32_t message_count = reader.get<uint32_t>();
+        std::vector<Message> messages;
+        messages.reserve(message_count);
+        for (uint32_t j = 0; j < message_count; ++j) {
+            Message msg;
+            msg.room_id = room_id;
+            msg.id = reader.get_string();
+            msg.sender_id = reader.get_string();
+            msg.content = reader.get_string();
+            msg.type = static_cast<MessageType>(reader.get<uint8_t>());
+            uint8_t flags = reader.get<uint8_t>();
+            msg.is_edited = (flags & 1) != 0;
+            msg.is_deleted = (flags & 2) != 0;
+            if (flags & 4) {
+                msg.file_url = reader.get_string();
+                msg.file_name = reader.get_string();
+                msg.file_type = reader.get_string();
+                msg.file_size = reader.get<uint64_t>();
+            }
+            if (flags & 8) {
+                msg.metadata = reader.get_string();
+            }
+            msg.seq = reader.get<int64_t>();
+            msg.timestamp = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(reader.get<int64_t>()));
+            messages.push_back(std::move(msg));
+        }
+        contents.room_tails.emplace_back(std::move(room_id), std::move(messages));
+    }
+
+    return contents;
+}
+
+} // namespace
+
+// ================================================
+// SAVE
+// ================================================
+bool save_state_snapshot(const std::string& path, DatabaseManager& database) {
+    static auto& saved = metrics::counter("caffis_snapshot_saves_total");
+    static auto& bytes = metrics::gauge("caffis_snapshot_bytes");
+
+    try {
+        // Read the high-water mark and the time before copying the caches:
+        // newer messages, edits and deletes are detected and refetched on load
+        int64_t created_at_us = metrics::now_us();
+        int64_t high_water_seq = database.get_max_message_seq();
+        if (high_water_seq < 0) {
+            std::cerr << "⚠️ Snapshot skipped: database unavailable" << std::endl;
+            return false;
+        }
+
+        std::string payload = encode_payload(hot_cache().export_contents());
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.created_at_us = created_at_us;
+        header.high_water_seq = high_water_seq;
+        header.payload_size = payload.size();
+        header.checksum = fnv1a(payload.data(), payload.size());
+
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                std::cerr << "❌ Cannot open snapshot file: " << tmp_path << std::endl;
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            out.flush();
+            if (!out) {
+                std::cerr << "❌ Failed writing snapshot: " << tmp_path << std::endl;
+                return false;
+            }
+        }
+
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::cerr << "❌ Failed to publish snapshot: " << path << std::endl;
+            return false;
+        }
+
+        saved.inc();
+        bytes.set(static_cast<int64_t>(sizeof(header) + payload.size()));
+        std::cout << "📸 State snapshot written: " << path << " (" << payload.size() << " bytes)" << std::endl;
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "❌ State snapshot failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// ================================================
+// LOAD
+// ================================================
+bool load_state_snapshot(const std::string& path, std::chrono::seconds max_age, DatabaseManager& database) {
+    static auto& discarded = metrics::counter("caffis_snapshot_discarded_total");
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "📸 No state snapshot at " << path << " - starting cold" << std::endl;
+        return false;
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        discarded.inc();
+        std::cerr << "⚠️ Snapshot too small - discarded" << std::endl;
+        return false;
+    }
+
+    size_t file_size = static_cast<size_t>(st.st_size);
+    void* mapped = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "⚠️ Snapshot mmap failed - starting cold" << std::endl;
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(mapped);
+    SnapshotHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    std::string rejection;
+    int64_t age_us = metrics::now_us() - header.created_at_us;
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        rejection = "bad magic";
+    } else if (header.version != SNAPSHOT_VERSION) {
+        rejection = "version " + std::to_string(header.version);
+    } else if (header.payload_size != file_size - sizeof(header)) {
+        rejection = "size mismatch";
+    } else if (fnv1a(data + sizeof(header), header.payload_size) != header.checksum) {
+        rejection = "checksum mismatch";
+    } else if (age_us < 0 || age_us > std::chrono::duration_cast<std::chrono::microseconds>(max_age).count()) {
+        rejection = "stale (" + std::to_string(age_us / 1000000) + "s old)";
+    }
+
+    HotCacheContents contents;
+    if (rejection.empty()) {
+        try {
+            contents = decode_payload(data + sizeof(header), header.payload_size);
+        } catch (const std::exception& e) {
+            rejection = e.what();
+        }
+    }
+    ::munmap(mapped, file_size);
+
+    if (!rejection.empty()) {
+        discarded.inc();
+        std::cerr << "⚠️ Snapshot discarded (" << rejection << ") - starting cold" << std::endl;
+        return false;
+    }
+
+    // Rooms that got messages, edits or deletes after the snapshot was taken reload lazily
+    std::vector<std::string> changed_rooms = database.get_rooms_changed_since(header.high_water_seq, header.created_at_us);
+
+    HotCache& cache = hot_cache();
+    for (const auto& [user_id, user] : contents.users) {
+        cache.put_user(user_id, user);
+    }
+    for (const auto& [room_id, members] : contents.room_members) {
+        cache.set_room_members(room_id, members);
+    }
+    for (const auto& [room_id, messages] : contents.room_tails) {
+        cache.set_room_tail(room_id, messages);
+    }
+    for (const auto& room_id : changed_rooms) {
+        cache.drop_room_tail(room_id);
+    }
+
+    std::cout << "📸 State snapshot loaded: " << contents.users.size() << " users, "
+              << contents.room_members.size() << " rooms with members, "
+              << contents.room_tails.size() << " room tails (" << changed_rooms.size()
+              << " rooms changed since, reloading lazily)" << std::endl;
+    return true;
+}
+
+} // namespace caffis
@@ -0,0 +1,204 @@
+#include "../include/thread_placement.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef CAFFIS_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace caffis {
+namespace placement {
+
+namespace {
+
+enum class PinMode { NONE, CORE, NODE };
+
+PinMode pin_mode = PinMode::NONE;
+int shard_count = 1;
+bool numa_memory = false;
+
+// Round-robin cursor per node for CORE mode
+std::unique_ptr<std::atomic<size_t>[]> next_core;
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // malformed entry: skip
+        }
+    }
+    return cpus;
+}
+
+Topology read_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto is_allowed = [&](int cpu) {
+        return !have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+    };
+
+    Topology topo;
+    for (int node = 0; node < 1024; ++node) {
+        std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!cpulist) {
+            continue;  // node ids may be sparse
+        }
+        std::string line;
+        std::getline(cpulist, line);
+
+        std::vector<int> cpus;
+        for (int cpu : parse_cpu_list(line)) {
+            if (is_allowed(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            topo.node_ids.push_back(node);
+            topo.node_cpus.push_back(std::move(cpus));
+        }
+    }
+
+    if (topo.node_cpus.empty()) {
+        std::vector<int> cpus;
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < online; ++cpu) {
+            if (is_allowed(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        topo.node_ids.push_back(0);
+        topo.node_cpus.push_back(std::move(cpus));
+    }
+    return topo;
+}
+
+bool set_affinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace
+
+size_t Topology::cpu_count() const {
+    size_t count = 0;
+    for (const auto& cpus : node_cpus) {
+        count += cpus.size();
+    }
+    return count;
+}
+
+const Topology& topology() {
+    static const Topology topo = read_topology();
+    return topo;
+}
+
+void configure(const config::PlacementConfig& placement_config) {
+    if (placement_config.cpu_pinning == "core") {
+        pin_mode = PinMode::CORE;
+    } else if (placement_config.cpu_pinning == "node") {
+        pin_mode = PinMode::NODE;
+    } else {
+        if (placement_config.cpu_pinning != "none" && !placement_config.cpu_pinning.empty()) {
+            std::cerr << "⚠️ Unknown CPU_PINNING '" << placement_config.cpu_pinning << "' - pinning disabled" << std::endl;
+        }
+        pin_mode = PinMode::NONE;
+    }
+    shard_count = std::max(1, placement_config.acceptor_shards);
+
+    const Topology& topo = topology();
+    next_core = std::make_unique<std::atomic<size_t>[]>(topo.node_count());
+
+#ifdef CAFFIS_HAVE_NUMA
+    numa_memory = pin_mode != PinMode::NONE && numa_available() >= 0 && topo.node_count() > 1;
+#endif
+
+    std::cout << "🧭 Thread placement: " << describe() << std::endl;
+}
+
+bool pinning_enabled() {
+    return pin_mode != PinMode::NONE;
+}
+
+int acceptor_shards() {
+    return shard_count;
+}
+
+int node_for_shard(int shard) {
+    return static_cast<int>(static_cast<size_t>(shard) % topology().node_count());
+}
+
+void place_current_thread(int node) {
+    if (pin_mode == PinMode::NONE) {
+        return;
+    }
+
+    const Topology& topo = topology();
+    size_t index = static_cast<size_t>(node) % topo.node_count();
+    const std::vector<int>& cpus = topo.node_cpus[index];
+    if (cpus.empty()) {
+        return;
+    }
+
+    bool pinned;
+    if (pin_mode == PinMode::CORE) {
+        size_t slot = next_core[index].fetch_add(1, std::memory_order_relaxed) % cpus.size();
+        pinned = set_affinity({cpus[slot]});
+    } else {
+        pinned = set_affinity(cpus);
+    }
+
+#ifdef CAFFIS_HAVE_NUMA
+    if (numa_memory) {
+        numa_set_preferred(topo.node_ids[index]);
+    }
+#endif
+
+    static auto& failures = metrics::counter("caffis_thread_pin_failures_total");
+    if (!pinned) {
+        failures.inc();
+        return;
+    }
+    metrics::counter("caffis_placed_threads_total{node=\"" + std::to_string(topo.node_ids[index]) + "\"}").inc();
+}
+
+std::string describe() {
+    const Topology& topo = topology();
+    std::ostringstream oss;
+    oss << (pin_mode == PinMode::CORE ? "pin per core" : pin_mode == PinMode::NODE ? "pin per node" : "unpinned")
+        << ", " << topo.node_count() << " NUMA node(s), " << topo.cpu_count() << " CPUs, "
+        << shard_count << " acceptor shard(s)"
+#ifdef CAFFIS_HAVE_NUMA
+        << (numa_memory ? ", node-local memory" : "")
+#endif
+        ;
+    return oss.str();
+}
+
+} // namespace placement
+} // namespace caffis
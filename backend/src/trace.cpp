@@ -0,0 +1,165 @@
+#include "../include/trace.h"
+#include "../include/metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sched.h>
+
+namespace caffis {
+namespace trace {
+
+namespace {
+
+struct SpanRecord {
+    const char* name;
+    uint64_t trace_id;
+    int64_t start_us;
+    int64_t duration_us;
+    uint32_t tid;
+};
+
+// One ring per CPU, shared by every thread that runs there. Threads rarely
+// migrate mid-span, so the mutex is all but uncontended except while an
+// export is copying the ring.
+struct SharedRing {
+    std::mutex mutex;
+    std::vector<SpanRecord> records;
+    size_t next = 0;
+    bool wrapped = false;
+
+    void push(const SpanRecord& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        records[next] = record;
+        if (++next == records.size()) {
+            next = 0;
+            wrapped = true;
+        }
+    }
+};
+
+std::atomic<uint32_t> sample_every{0};  // 0 = off, N = one in N
+std::atomic<uint64_t> sample_counter{0};  // TraceScopes seen, across all threads
+std::atomic<uint64_t> next_trace_id{1};
+std::atomic<uint32_t> next_tid{1};
+
+// Allocated by the first configure() that enables tracing, never freed
+std::once_flag rings_once;
+std::vector<std::unique_ptr<SharedRing>> rings;
+
+struct ThreadState {
+    uint64_t current_trace = 0;
+    uint32_t tid = 0;
+};
+
+thread_local ThreadState state;
+
+void record(const char* name, uint64_t trace_id, int64_t start_us) {
+    if (state.tid == 0) {
+        state.tid = next_tid.fetch_add(1, std::memory_order_relaxed);
+    }
+    int cpu = ::sched_getcpu();
+    SharedRing& ring = *rings[static_cast<size_t>(cpu < 0 ? state.tid : cpu) % rings.size()];
+    ring.push(SpanRecord{name, trace_id, start_us, metrics::now_us() - start_us, state.tid});
+}
+
+} // namespace
+
+void configure(double sample_rate, size_t capacity) {
+    uint32_t every = 0;
+    if (sample_rate > 0) {
+        every = static_cast<uint32_t>(std::lround(1.0 / std::min(1.0, sample_rate)));
+        if (every == 0) every = 1;
+        std::call_once(rings_once, [capacity]() {
+            size_t count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 256);
+            for (size_t i = 0; i < count; ++i) {
+                rings.push_back(std::make_unique<SharedRing>());
+                rings.back()->records.resize(capacity > 0 ? capacity : 1);
+            }
+        });
+    }
+    sample_every.store(every, std::memory_order_release);
+}
+
+bool enabled() {
+    return sample_every.load(std::memory_order_relaxed) != 0;
+}
+
+TraceScope::TraceScope(const char* name) : name_(name) {
+    parent_trace_id_ = state.current_trace;
+    if (parent_trace_id_ != 0) {
+        // Nested root: just a child span of the enclosing trace
+        trace_id_ = parent_trace_id_;
+        start_us_ = metrics::now_us();
+        return;
+    }
+
+    // One shared count: a session sending fewer than N frames is still
+    // sampled whenever its frame is the Nth one on the node
+    uint32_t every = sample_every.load(std::memory_order_acquire);
+    if (every == 0 || sample_counter.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+        return;
+    }
+
+    trace_id_ = next_trace_id.fetch_add(1, std::memory_order_relaxed);
+    state.current_trace = trace_id_;
+    start_us_ = metrics::now_us();
+}
+
+TraceScope::~TraceScope() {
+    if (trace_id_ == 0) {
+        return;
+    }
+    record(name_, trace_id_, start_us_);
+    state.current_trace = parent_trace_id_;
+}
+
+Span::Span(const char* name) : name_(name) {
+    if (state.current_trace != 0) {
+        start_us_ = metrics::now_us();
+    }
+}
+
+Span::~Span() {
+    if (start_us_ != 0 && state.current_trace != 0) {
+        record(name_, state.current_trace, start_us_);
+    }
+}
+
+std::string export_chrome_json() {
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+
+    // rings is complete once tracing is enabled and never changes after
+    const size_t ring_count = enabled() ? rings.size() : 0;
+    for (size_t i = 0; i < ring_count; ++i) {
+        SharedRing* ring = rings[i].get();
+        std::vector<SpanRecord> records;
+        {
+            std::lock_guard<std::mutex> lock(ring->mutex);
+            if (ring->wrapped) {
+                records.assign(ring->records.begin() + ring->next, ring->records.end());
+            }
+            records.insert(records.end(), ring->records.begin(), ring->records.begin() + ring->next);
+        }
+
+        for (const auto& span : records) {
+            out << (first ? "" : ",")
+                << "{\"name\":\"" << span.name << "\",\"cat\":\"chat\",\"ph\":\"X\""
+                << ",\"ts\":" << span.start_us << ",\"dur\":" << span.duration_us
+                << ",\"pid\":1,\"tid\":" << span.tid
+                << ",\"args\":{\"trace_id\":" << span.trace_id << "}}";
+            first = false;
+        }
+    }
+
+    out << "]}";
+    return out.str();
+}
+
+} // namespace trace
+} // namespace caffis
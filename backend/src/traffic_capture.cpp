@@ -0,0 +1,238 @@
+#include "../include/traffic_capture.h"
+#include "../include/metrics.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace caffis {
+
+namespace pt = boost::property_tree;
+
+TrafficCapture& traffic_capture() {
+    static TrafficCapture capture;
+    return capture;
+}
+
+namespace {
+
+const char CAPTURE_MAGIC[8] = {'C', 'A', 'F', 'C', 'A', 'P', '\0', '\0'};
+constexpr size_t RECORD_HEADER_BYTES = 1 + 4 + 8 + 4;
+constexpr size_t FILE_HEADER_BYTES = 8 + 4 + 4 + 8;
+
+void put_le(std::string& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+uint64_t get_le(const char* in, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+    return v;
+}
+
+// Same length and word boundaries, no text
+std::string mask_text(const std::string& text) {
+    std::string masked = text;
+    for (char& c : masked) {
+        if (c != ' ' && c != '\n' && c != '\t') {
+            c = 'x';
+        }
+    }
+    return masked;
+}
+
+// Two decimals (about 1 km): enough to replay geo load, not to find anyone
+void coarsen_coordinate(pt::ptree& tree, const char* key) {
+    auto value = tree.get_optional<double>(key);
+    if (value) {
+        tree.put(key, std::round(*value * 100.0) / 100.0);
+    }
+}
+
+} // namespace
+
+TrafficCapture::~TrafficCapture() {
+    stop();
+}
+
+bool TrafficCapture::start(const config::CaptureConfig& capture_config) {
+    settings_ = capture_config;
+    if (capture_config.path.empty()) {
+        return false;
+    }
+    std::FILE* file = std::fopen(capture_config.path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "❌ Cannot open capture file " << capture_config.path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    start_us_ = metrics::now_us();
+    std::string header(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    put_le(header, VERSION, 4);
+    put_le(header, capture_config.redact_content ? FLAG_CONTENT_REDACTED : 0, 4);
+    put_le(header, static_cast<uint64_t>(start_us_), 8);
+    std::fwrite(header.data(), 1, header.size(), file);
+    written_bytes_ = header.size();
+    file_ = file;
+    active_ = true;
+
+    std::cout << "🎥 Capturing inbound traffic to " << capture_config.path
+              << (capture_config.redact_content ? " (content redacted)" : " (content kept)") << std::endl;
+    return true;
+}
+
+void TrafficCapture::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_ = false;
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+        std::cout << "🎥 Capture closed: " << written_bytes_ / 1024 << " KB" << std::endl;
+    }
+}
+
+// Caller holds mutex_
+void TrafficCapture::write_record(CaptureRecord::Kind kind, uint32_t session, uint32_t length, const std::string& payload) {
+    static auto& records = metrics::counter("caffis_capture_records_total");
+    if (!file_ || full_) {
+        return;
+    }
+    if (written_bytes_ + RECORD_HEADER_BYTES + payload.size() > settings_.max_bytes) {
+        full_ = true;
+        std::cerr << "⚠️ Capture reached " << settings_.max_bytes / (1024 * 1024) << " MB - recording stopped" << std::endl;
+        std::fflush(file_);
+        return;
+    }
+    std::string header;
+    header.reserve(RECORD_HEADER_BYTES);
+    header.push_back(static_cast<char>(kind));
+    put_le(header, session, 4);
+    put_le(header, static_cast<uint64_t>(std::max<int64_t>(0, metrics::now_us() - start_us_)), 8);
+    put_le(header, length, 4);
+    std::fwrite(header.data(), 1, header.size(), file_);
+    std::fwrite(payload.data(), 1, payload.size(), file_);
+    written_bytes_ += header.size() + payload.size();
+    records.inc();
+}
+
+std::string TrafficCapture::redact(const std::string& frame) const {
+    pt::ptree tree;
+    try {
+        std::istringstream iss(frame);
+        pt::read_json(iss, tree);
+    } catch (const std::exception&) {
+        return mask_text(frame);  // the server rejects it anyway; keep only the size
+    }
+    if (tree.get_child_optional("token")) {
+        tree.put("token", "");
+    }
+    if (settings_.redact_content) {
+        for (const char* key : {"content", "query"}) {
+            auto value = tree.get_optional<std::string>(key);
+            if (value) {
+                tree.put(key, mask_text(*value));
+            }
+        }
+        // Shared places ("location" in a message) and nearby-room queries
+        auto location = tree.get_child_optional("location");
+        for (pt::ptree* coordinates : {location.get_ptr(), &tree}) {
+            if (coordinates) {
+                coarsen_coordinate(*coordinates, "lat");
+                coarsen_coordinate(*coordinates, "lon");
+            }
+        }
+    }
+    std::ostringstream oss;
+    pt::write_json(oss, tree, false);
+    std::string redacted = oss.str();
+    if (!redacted.empty() && redacted.back() == '\n') {
+        redacted.pop_back();
+    }
+    return redacted;
+}
+
+uint32_t TrafficCapture::open_session(const std::string& target) {
+    if (!enabled()) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t session = next_session_++;
+    write_record(CaptureRecord::OPEN, session, static_cast<uint32_t>(target.size()), target);
+    return session;
+}
+
+void TrafficCapture::record_text(uint32_t session, const std::string& frame) {
+    if (session == 0) {
+        return;
+    }
+    std::string redacted = redact(frame);  // outside the lock
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_record(CaptureRecord::TEXT, session, static_cast<uint32_t>(redacted.size()), redacted);
+}
+
+void TrafficCapture::record_binary(uint32_t session, size_t size) {
+    if (session == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_record(CaptureRecord::BINARY, session, static_cast<uint32_t>(size), "");
+}
+
+void TrafficCapture::record_user(uint32_t session, const std::string& user_id) {
+    if (session == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_record(CaptureRecord::USER, session, static_cast<uint32_t>(user_id.size()), user_id);
+}
+
+void TrafficCapture::close_session(uint32_t session) {
+    if (session == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_record(CaptureRecord::CLOSE, session, 0, "");
+}
+
+// ================================================
+// READING
+// ================================================
+bool TrafficCapture::load(const std::string& path, std::vector<CaptureRecord>& records, uint32_t& flags) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "❌ Cannot open capture " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    char header[FILE_HEADER_BYTES];
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header)
+        || std::memcmp(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0
+        || get_le(header + 8, 4) != VERSION) {
+        std::cerr << "❌ " << path << " is not a version " << VERSION << " capture" << std::endl;
+        std::fclose(file);
+        return false;
+    }
+    flags = static_cast<uint32_t>(get_le(header + 12, 4));
+
+    char record_header[RECORD_HEADER_BYTES];
+    while (std::fread(record_header, 1, sizeof(record_header), file) == sizeof(record_header)) {
+        CaptureRecord record;
+        record.kind = static_cast<CaptureRecord::Kind>(record_header[0]);
+        record.session = static_cast<uint32_t>(get_le(record_header + 1, 4));
+        record.offset_us = get_le(record_header + 5, 8);
+        record.length = static_cast<uint32_t>(get_le(record_header + 13, 4));
+        size_t payload_bytes = record.kind == CaptureRecord::BINARY ? 0 : record.length;
+        record.payload.resize(payload_bytes);
+        if (payload_bytes > 0 && std::fread(&record.payload[0], 1, payload_bytes, file) != payload_bytes) {
+            break;  // truncated tail (capture cut short by a crash)
+        }
+        records.push_back(std::move(record));
+    }
+    std::fclose(file);
+    return true;
+}
+
+} // namespace caffis
@@ -0,0 +1,466 @@
+#include "../include/traffic_replay.h"
+#include "../include/traffic_capture.h"
+#include "../include/metrics.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace caffis {
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace pt = boost::property_tree;
+using tcp = net::ip::tcp;
+
+namespace {
+
+const char* const REPLAY_OPS[] = {"auth", "message_echo"};
+
+metrics::Histogram& op_latency(const std::string& op) {
+    return metrics::histogram("caffis_replay_latency_us{op=\"" + op + "\"}");
+}
+
+std::string base64url_encode(const std::string& data) {
+    std::string out(4 * ((data.size() + 2) / 3), '\0');
+    int written = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(&out[0]),
+                                  reinterpret_cast<const unsigned char*>(data.data()), static_cast<int>(data.size()));
+    out.resize(static_cast<size_t>(written));
+    while (!out.empty() && out.back() == '=') {
+        out.pop_back();
+    }
+    std::replace(out.begin(), out.end(), '+', '-');
+    std::replace(out.begin(), out.end(), '/', '_');
+    return out;
+}
+
+std::vector<std::string> read_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    if (path.empty()) {
+        return lines;
+    }
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "❌ Cannot read " << path << std::endl;
+        return lines;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        line.erase(std::remove_if(line.begin(), line.end(), [](unsigned char c) { return std::isspace(c); }), line.end());
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+// Captured id -> replay id, distinct captured ids spread round-robin over the list
+class IdMapping {
+private:
+    std::vector<std::string> targets_;
+    std::map<std::string, std::string> mapped_;
+
+public:
+    explicit IdMapping(std::vector<std::string> targets) : targets_(std::move(targets)) {}
+
+    std::string map(const std::string& captured) {
+        if (targets_.empty() || captured.empty()) {
+            return captured;
+        }
+        auto it = mapped_.find(captured);
+        if (it == mapped_.end()) {
+            it = mapped_.emplace(captured, targets_[mapped_.size() % targets_.size()]).first;
+        }
+        return it->second;
+    }
+};
+
+struct ReplayContext {
+    net::io_context ioc;
+    tcp::resolver::results_type endpoints;
+    ReplayOptions options;
+    std::chrono::steady_clock::time_point start;
+    uint64_t first_offset_us = 0;
+    IdMapping users;
+    IdMapping rooms;
+    std::map<std::string, std::string> tokens;  // by replay user
+    size_t live_sessions = 0;
+    net::steady_timer deadline;
+
+    uint64_t next_nonce = 1;  // replay-wide, tags message bodies so each echo finds its send
+    uint64_t frames_sent = 0;
+    uint64_t connect_failures = 0;
+    uint64_t server_errors = 0;
+
+    ReplayContext(const ReplayOptions& replay_options, std::vector<std::string> user_list, std::vector<std::string> room_list)
+        : options(replay_options), users(std::move(user_list)), rooms(std::move(room_list)), deadline(ioc) {}
+
+    std::chrono::steady_clock::time_point at(uint64_t offset_us) const {
+        double scaled = static_cast<double>(offset_us - std::min(offset_us, first_offset_us)) / options.speed;
+        return start + std::chrono::microseconds(static_cast<int64_t>(scaled));
+    }
+
+    const std::string& token_for(const std::string& user_id) {
+        auto it = tokens.find(user_id);
+        if (it == tokens.end()) {
+            it = tokens.emplace(user_id, mint_test_token(user_id, options.jwt_secret)).first;
+        }
+        return it->second;
+    }
+
+    void session_finished() {
+        if (--live_sessions == 0) {
+            deadline.cancel();
+        }
+    }
+};
+
+// One captured connection. Frames go out one after another at their
+// captured offsets; the read side runs alongside and closes the latency
+// samples the sends opened.
+class ReplaySession : public std::enable_shared_from_this<ReplaySession> {
+private:
+    ReplayContext& ctx_;
+    std::string target_;
+    std::string user_id_;      // after mapping; empty = never authenticated in the capture
+    uint64_t open_offset_us_;
+    std::vector<const CaptureRecord*> records_;
+    size_t next_ = 0;
+
+    websocket::stream<beast::tcp_stream> ws_;
+    net::steady_timer timer_;
+    beast::flat_buffer read_buffer_;
+    std::string out_;
+    bool finished_ = false;
+
+    std::chrono::steady_clock::time_point auth_sent_{};
+    // Open echo samples by room + "\n" + content. The same user's other
+    // sessions get these echoes too, so only a send's own body closes it.
+    std::map<std::string, std::deque<std::chrono::steady_clock::time_point>> messages_sent_;
+
+public:
+    ReplaySession(ReplayContext& ctx, std::string target, std::string user_id, uint64_t open_offset_us,
+                  std::vector<const CaptureRecord*> records)
+        : ctx_(ctx), target_(std::move(target)), user_id_(std::move(user_id)), open_offset_us_(open_offset_us),
+          records_(std::move(records)), ws_(ctx.ioc), timer_(ctx.ioc) {}
+
+    void start() {
+        auto self = shared_from_this();
+        timer_.expires_at(ctx_.at(open_offset_us_));
+        timer_.async_wait([self](beast::error_code) { self->connect(); });
+    }
+
+private:
+    void connect() {
+        auto self = shared_from_this();
+        beast::get_lowest_layer(ws_).async_connect(ctx_.endpoints,
+            [self](beast::error_code ec, tcp::endpoint) {
+                if (ec) {
+                    self->ctx_.connect_failures++;
+                    self->finish();
+                    return;
+                }
+                // Don't measure our own Nagle delay
+                beast::error_code option_ec;
+                beast::get_lowest_layer(self->ws_).socket().set_option(tcp::no_delay(true), option_ec);
+                self->ws_.async_handshake(self->ctx_.options.host, self->target_.empty() ? "/" : self->target_,
+                    [self](beast::error_code handshake_ec) {
+                        if (handshake_ec) {
+                            self->ctx_.connect_failures++;
+                            self->finish();
+                            return;
+                        }
+                        self->read_next();
+                        self->send_next();
+                    });
+            });
+    }
+
+    void send_next() {
+        if (next_ >= records_.size() || finished_) {
+            return;
+        }
+        auto self = shared_from_this();
+        timer_.expires_at(ctx_.at(records_[next_]->offset_us));
+        timer_.async_wait([self](beast::error_code) {
+            const CaptureRecord& record = *self->records_[self->next_++];
+            if (self->finished_) {
+                return;
+            }
+            if (record.kind == CaptureRecord::CLOSE) {
+                self->ws_.async_close(websocket::close_code::normal, [self](beast::error_code) {});
+                return;
+            }
+            if (record.kind == CaptureRecord::BINARY) {
+                self->out_.assign(record.length, '\0');  // upload bytes are not captured, only their size
+            } else {
+                self->out_ = self->rewrite(record.payload);
+            }
+            self->ws_.binary(record.kind == CaptureRecord::BINARY);
+            self->ws_.async_write(net::buffer(self->out_), [self](beast::error_code ec, size_t) {
+                if (ec) {
+                    self->finish();
+                    return;
+                }
+                self->ctx_.frames_sent++;
+                self->send_next();
+            });
+        });
+    }
+
+    // Fresh token, mapped rooms; also opens the latency sample for the frame
+    std::string rewrite(const std::string& frame) {
+        pt::ptree tree;
+        try {
+            std::istringstream iss(frame);
+            pt::read_json(iss, tree);
+        } catch (const std::exception&) {
+            return frame;
+        }
+        std::string type = tree.get<std::string>("type", "");
+        if (type == "auth") {
+            tree.put("token", user_id_.empty() ? std::string() : ctx_.token_for(user_id_));
+            auth_sent_ = std::chrono::steady_clock::now();
+        }
+        for (const char* key : {"roomId", "room_id"}) {
+            auto room_id = tree.get_optional<std::string>(key);
+            if (room_id) {
+                tree.put(key, ctx_.rooms.map(*room_id));
+            }
+        }
+        if (type == "message") {
+            // Nonce over the body's tail (same length where it fits): masked
+            // bodies are all alike, and sibling sessions may send at once.
+            // Empty bodies (attachments, places) stay empty and pair in order.
+            std::string content = tree.get<std::string>("content", "");
+            if (!content.empty()) {
+                std::string nonce = "~" + std::to_string(ctx_.next_nonce++);
+                content = content.size() > nonce.size() ? content.substr(0, content.size() - nonce.size()) + nonce
+                                                         : content + nonce;
+                tree.put("content", content);
+            }
+            messages_sent_[tree.get<std::string>("roomId", "") + "\n" + content].push_back(std::chrono::steady_clock::now());
+        }
+        std::ostringstream oss;
+        pt::write_json(oss, tree, false);
+        return oss.str();
+    }
+
+    void read_next() {
+        auto self = shared_from_this();
+        ws_.async_read(read_buffer_, [self](beast::error_code ec, size_t) {
+            if (ec) {
+                self->finish();
+                return;
+            }
+            self->on_frame(beast::buffers_to_string(self->read_buffer_.data()));
+            self->read_buffer_.consume(self->read_buffer_.size());
+            self->read_next();
+        });
+    }
+
+    void on_frame(const std::string& frame) {
+        static auto& auth_latency = op_latency("auth");
+        static auto& echo_latency = op_latency("message_echo");
+        pt::ptree tree;
+        try {
+            std::istringstream iss(frame);
+            pt::read_json(iss, tree);
+        } catch (const std::exception&) {
+            return;
+        }
+        std::string type = tree.get<std::string>("type", "");
+        const auto now = std::chrono::steady_clock::now();
+        if (type == "auth_success" && auth_sent_ != std::chrono::steady_clock::time_point{}) {
+            auth_latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(now - auth_sent_).count());
+            auth_sent_ = {};
+        } else if (type == "new_message" && tree.get<std::string>("sender_id", "") == user_id_) {
+            auto sent = messages_sent_.find(tree.get<std::string>("room_id", "") + "\n" + tree.get<std::string>("content", ""));
+            if (sent != messages_sent_.end()) {
+                echo_latency.observe(std::chrono::duration_cast<std::chrono::microseconds>(now - sent->second.front()).count());
+                sent->second.pop_front();
+                if (sent->second.empty()) {
+                    messages_sent_.erase(sent);
+                }
+            }
+        } else if (type == "error" || type == "auth_error") {
+            ctx_.server_errors++;
+        }
+    }
+
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        timer_.cancel();
+        beast::error_code ec;
+        beast::get_lowest_layer(ws_).socket().close(ec);
+        ctx_.session_finished();
+    }
+};
+
+pt::ptree latency_report() {
+    pt::ptree report;
+    for (const char* op : REPLAY_OPS) {
+        const auto& histogram = op_latency(op);
+        pt::ptree entry;
+        entry.put("count", histogram.count());
+        entry.put("mean_us", histogram.count() ? histogram.sum() / histogram.count() : 0);
+        entry.put("p50_us", histogram.percentile(0.50));
+        entry.put("p90_us", histogram.percentile(0.90));
+        entry.put("p99_us", histogram.percentile(0.99));
+        report.add_child(op, entry);
+    }
+    return report;
+}
+
+void print_report(const pt::ptree& report, const pt::ptree* baseline) {
+    std::cout << "📊 Replay latency (client side, bucket upper bounds):" << std::endl;
+    for (const char* op : REPLAY_OPS) {
+        std::cout << "   • " << op << ": " << report.get<uint64_t>(std::string(op) + ".count") << " samples";
+        for (const char* q : {"p50_us", "p90_us", "p99_us"}) {
+            uint64_t value = report.get<uint64_t>(std::string(op) + "." + q);
+            std::cout << ", " << std::string(q, 3) << " " << value << "us";
+            if (baseline) {
+                uint64_t before = baseline->get<uint64_t>(std::string(op) + "." + q, 0);
+                if (before > 0) {
+                    double change = 100.0 * (static_cast<double>(value) - before) / before;
+                    std::cout << " (" << std::showpos << std::fixed << std::setprecision(0) << change
+                              << std::noshowpos << "% vs " << before << "us)";
+                }
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+} // namespace
+
+std::string mint_test_token(const std::string& user_id, const std::string& jwt_secret) {
+    pt::ptree payload;
+    payload.put("id", user_id);
+    std::ostringstream payload_oss;
+    pt::write_json(payload_oss, payload, false);
+    std::string payload_json = payload_oss.str();
+    if (!payload_json.empty() && payload_json.back() == '\n') {
+        payload_json.pop_back();
+    }
+
+    std::string signing_input = base64url_encode(R"({"alg":"HS256","typ":"JWT"})") + "." + base64url_encode(payload_json);
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int mac_len = 0;
+    HMAC(EVP_sha256(), jwt_secret.data(), static_cast<int>(jwt_secret.size()),
+         reinterpret_cast<const unsigned char*>(signing_input.data()), signing_input.size(), mac, &mac_len);
+    return signing_input + "." + base64url_encode(std::string(reinterpret_cast<char*>(mac), mac_len));
+}
+
+int run_replay(const ReplayOptions& options) {
+    std::vector<CaptureRecord> records;
+    uint32_t flags = 0;
+    if (!TrafficCapture::load(options.capture_path, records, flags)) {
+        return 1;
+    }
+    if (options.speed <= 0) {
+        std::cerr << "❌ Replay speed must be positive" << std::endl;
+        return 1;
+    }
+
+    ReplayContext ctx(options, read_lines(options.users_path), read_lines(options.rooms_path));
+    try {
+        tcp::resolver resolver(ctx.ioc);
+        ctx.endpoints = resolver.resolve(options.host, options.port);
+    } catch (const std::exception& e) {
+        std::cerr << "❌ Cannot resolve " << options.host << ":" << options.port << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Group records by captured session
+    struct CapturedSession {
+        std::string target;
+        std::string user_id;
+        uint64_t open_offset_us = 0;
+        std::vector<const CaptureRecord*> records;
+    };
+    std::map<uint32_t, CapturedSession> sessions;
+    uint64_t last_offset_us = 0;
+    for (const auto& record : records) {
+        last_offset_us = std::max(last_offset_us, record.offset_us);
+        if (record.kind == CaptureRecord::OPEN) {
+            sessions[record.session].target = record.payload;
+            sessions[record.session].open_offset_us = record.offset_us;
+        } else if (record.kind == CaptureRecord::USER) {
+            sessions[record.session].user_id = ctx.users.map(record.payload);
+        } else {
+            sessions[record.session].records.push_back(&record);
+        }
+    }
+    if (sessions.empty()) {
+        std::cerr << "❌ " << options.capture_path << " holds no sessions" << std::endl;
+        return 1;
+    }
+    ctx.first_offset_us = records.front().offset_us;
+
+    std::cout << "▶️ Replaying " << records.size() << " records from " << sessions.size() << " sessions against "
+              << options.host << ":" << options.port << " at " << options.speed << "x ("
+              << (last_offset_us - ctx.first_offset_us) / options.speed / 1000000 << "s"
+              << ((flags & TrafficCapture::FLAG_CONTENT_REDACTED) ? ", content redacted" : "") << ")" << std::endl;
+
+    ctx.start = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    ctx.live_sessions = sessions.size();
+    for (auto& [id, captured] : sessions) {
+        std::make_shared<ReplaySession>(ctx, captured.target, captured.user_id, captured.open_offset_us,
+                                        std::move(captured.records))->start();
+    }
+    ctx.deadline.expires_at(ctx.at(last_offset_us) + std::chrono::seconds(options.drain_seconds));
+    ctx.deadline.async_wait([&ctx](beast::error_code ec) {
+        if (!ec) {
+            ctx.ioc.stop();  // sessions the capture never saw close
+        }
+    });
+    ctx.ioc.run();
+
+    std::cout << "✅ Replay finished: " << ctx.frames_sent << " frames sent, " << ctx.connect_failures
+              << " connect failures, " << ctx.server_errors << " error replies" << std::endl;
+
+    pt::ptree report = latency_report();
+    pt::ptree baseline;
+    bool have_baseline = false;
+    if (!options.baseline_path.empty()) {
+        try {
+            pt::read_json(options.baseline_path, baseline);
+            have_baseline = true;
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️ Cannot read baseline " << options.baseline_path << ": " << e.what() << std::endl;
+        }
+    }
+    print_report(report, have_baseline ? &baseline : nullptr);
+
+    if (!options.report_path.empty()) {
+        try {
+            pt::write_json(options.report_path, report);
+            std::cout << "💾 Report written to " << options.report_path << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "❌ Cannot write report " << options.report_path << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace caffis
@@ -1,7 +1,28 @@
 #include "../include/websocket_server.h"
 #include "../include/database_manager.h"
 #include "../include/message_types.h"
+#include "../include/cluster_transport.h"
+#include "../include/session_directory.h"
+#include "../include/hot_cache.h"
+#include "../include/intern_table.h"
+#include "../include/state_snapshot.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+#include "../include/thread_placement.h"
+#include "../include/outbound_queue.h"
+#include "../include/queued_stream.h"
+#include "../include/search_index.h"
+#include "../include/attachment_store.h"
+#include "../include/geo_index.h"
+#include "../include/archive_store.h"
+#include "../include/content_codec.h"
+#include "../include/delivery_tracker.h"
+#include "../include/notification_queue.h"
+#include "../include/traffic_capture.h"
+#include "../include/room_stats.h"
+#include "../include/hot_rooms.h"
 #include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/property_tree/ptree.hpp>
@@ -10,10 +31,23 @@
 #include <iostream>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
 #include <mutex>
 #include <memory>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <dirent.h>
+#include <future>
+#include <fstream>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
 #include <pqxx/pqxx>
 
 namespace beast = boost::beast;
@@ -53,24 +87,105 @@ void init_main_app_connection() {
 // ================================================
 // SESSION MANAGEMENT
 // ================================================
-struct ClientSession {
-    std::string user_id;
+
+// Read buffers above this are released after the frame is handled
+static constexpr size_t READ_BUFFER_RETAIN_BYTES = 16 * 1024;
+
+// How long stop() waits for session threads to unwind after their sockets are closed
+static constexpr std::chrono::seconds SESSION_DRAIN_TIMEOUT{10};
+
+// Per-session state off the delivery path: profile strings and the
+// session thread's read buffer
+struct SessionColdState {
     std::string username;
     std::string display_name;
-    std::string email;
-    std::string room_id;
-    std::shared_ptr<websocket::stream<beast::tcp_stream>> ws;
-    bool is_authenticated = false;
+    std::string client_endpoint;
+    std::chrono::system_clock::time_point connected_at = std::chrono::system_clock::now();
+    beast::flat_buffer read_buffer;               // reused across frames, session thread only
+    std::atomic<size_t> read_buffer_capacity{0};  // published for memory accounting
+    std::vector<IdHandle> filtered_senders;       // blocked/muted, sorted; guarded by sessions_mutex
+    std::vector<IdHandle> rooms;                  // rooms the user belongs to (search scope), session thread only
+    std::unique_ptr<AttachmentUpload> upload;     // upload receiving binary frames, session thread only
+};
+
+// Hot part: only what broadcast / direct delivery / cleanup touch, kept
+// within one cache line. Everything else lives behind `cold`.
+struct ClientSession {
+    std::shared_ptr<websocket::stream<QueuedStream>> ws;
+    std::shared_ptr<OutboundQueue> outbound;  // every write to the client goes through here
     std::chrono::system_clock::time_point last_activity;
+    IdHandle user = NO_ID;  // interned user id, set on auth
+    IdHandle room = NO_ID;  // interned id of the current room (room_sessions index)
+    bool is_authenticated = false;
+    uint32_t sender_filter = 0;  // Bloom bits over cold->filtered_senders (fits in padding)
+    std::unique_ptr<SessionColdState> cold;
+    
+    ClientSession(std::shared_ptr<websocket::stream<QueuedStream>> ws_ptr) 
+        : ws(ws_ptr), last_activity(std::chrono::system_clock::now()), cold(std::make_unique<SessionColdState>()) {}
     
-    ClientSession(std::shared_ptr<websocket::stream<beast::tcp_stream>> ws_ptr) 
-        : ws(ws_ptr), last_activity(std::chrono::system_clock::now()) {}
+    std::string user_id() const { return interned_ids().to_string(user); }
+    std::string room_id() const { return interned_ids().to_string(room); }
 };
 
+static_assert(sizeof(ClientSession) <= 64, "ClientSession hot state should fit one cache line");
+
 // Global session management
 static std::unordered_map<std::string, std::shared_ptr<ClientSession>> active_sessions;
 static std::mutex sessions_mutex;
+
+// Sessions currently in each room (guarded by sessions_mutex)
+static std::unordered_map<IdHandle, std::vector<std::shared_ptr<ClientSession>>> room_sessions;
 static std::unique_ptr<DatabaseManager> db_manager;
+static std::unique_ptr<ClusterTransport> cluster_transport;
+static std::unique_ptr<SessionDirectory> session_directory;
+static std::string local_node_id;
+
+// Authenticated sessions per user on this node (guarded by sessions_mutex);
+// the directory entry lives while the count is non-zero
+static std::unordered_map<IdHandle, int> local_user_sessions;
+
+static std::thread lease_thread;
+static std::atomic<bool> lease_running{false};
+static std::mutex lease_mutex;
+static std::condition_variable lease_cv;
+
+static config::AdminConfig admin_settings;
+
+static config::SnapshotConfig snapshot_settings;
+static std::unique_ptr<DatabaseManager> snapshot_db;
+static std::thread snapshot_thread;
+static std::atomic<bool> snapshot_running{false};
+static std::mutex snapshot_mutex;
+static std::condition_variable snapshot_cv;
+
+static config::SearchConfig search_settings;
+static std::unique_ptr<DatabaseManager> search_db;  // feed + result bodies, may be a replica
+static std::mutex search_db_mutex;
+static std::thread search_thread;
+static std::atomic<bool> search_running{false};
+static std::mutex search_mutex;
+static std::condition_variable search_cv;
+
+static config::GeoConfig geo_settings;
+static std::unique_ptr<DatabaseManager> geo_db;
+static std::thread geo_thread;
+static std::atomic<bool> geo_running{false};
+static std::mutex geo_mutex;
+static std::condition_variable geo_cv;
+
+static config::RetentionConfig retention_settings;
+static std::unique_ptr<DatabaseManager> retention_db;
+static std::thread retention_thread;
+static std::atomic<bool> retention_running{false};
+static std::mutex retention_mutex;
+static std::condition_variable retention_cv;
+
+static config::ArchiveConfig archive_settings;
+static std::unique_ptr<DatabaseManager> archive_db;
+static std::thread archive_thread;
+static std::atomic<bool> archive_running{false};
+static std::mutex archive_mutex;
+static std::condition_variable archive_cv;
 
 // ================================================
 // DATABASE INITIALIZATION FOR WEBSOCKET
@@ -78,6 +193,10 @@ static std::unique_ptr<DatabaseManager> db_manager;
 void init_websocket_database(const std::string& connection_string) {
     try {
         std::cout << "🗄️ Initializing WebSocket database manager..." << std::endl;
+        
+        // Main app connection is independent - establish it concurrently
+        auto main_app_ready = std::async(std::launch::async, init_main_app_connection);
+        
         db_manager = std::make_unique<DatabaseManager>(connection_string);
         if (db_manager->connect()) {
             std::cout << "✅ WebSocket database manager connected successfully" << std::endl;
@@ -86,8 +205,7 @@ void init_websocket_database(const std::string& connection_string) {
             db_manager.reset();
         }
         
-        // Initialize main app database connection
-        init_main_app_connection();
+        main_app_ready.get();
         
     } catch (const std::exception& e) {
         std::cerr << "⚠️ WebSocket database error: " << e.what() << std::endl;
@@ -363,229 +481,2383 @@ bool verify_jwt_token(const std::string& token, std::string& user_id, std::strin
 // ================================================
 // MESSAGE BROADCASTING
 // ================================================
-void broadcast_to_room(const std::string& room_id, const std::string& message, const std::string& sender_id = "") {
-    std::lock_guard<std::mutex> lock(sessions_mutex);
+// Replies to the session itself default to the control lane (acks, errors)
+static bool send_frame(const std::shared_ptr<ClientSession>& session, std::string frame, Lane lane = Lane::CONTROL) {
+    return session->outbound && session->outbound->push(std::move(frame), lane);
+}
+
+// Latest-wins key for ephemeral per-user state (typing in a room, presence with NO_ID)
+static uint64_t ephemeral_key(IdHandle room, IdHandle user) {
+    return (static_cast<uint64_t>(room) << 32) | user;
+}
+
+static bool has_user_session(const std::vector<std::shared_ptr<ClientSession>>& members, IdHandle user) {
+    return std::any_of(members.begin(), members.end(),
+                       [user](const std::shared_ptr<ClientSession>& member) { return member->user == user; });
+}
+
+// Caller holds sessions_mutex. Room stats count users, so a second device
+// entering or leaving doesn't move them.
+static void index_session_room(const std::shared_ptr<ClientSession>& session, IdHandle room) {
+    if (session->room != NO_ID) {
+        auto it = room_sessions.find(session->room);
+        if (it != room_sessions.end()) {
+            auto& members = it->second;
+            members.erase(std::remove(members.begin(), members.end(), session), members.end());
+            if (!has_user_session(members, session->user)) {
+                room_stats().member_left(session->room);
+            }
+            if (members.empty()) {
+                room_sessions.erase(it);
+            }
+        }
+    }
+    session->room = room;
+    if (room != NO_ID) {
+        auto& members = room_sessions[room];
+        if (!has_user_session(members, session->user)) {
+            room_stats().member_joined(room);
+        }
+        members.push_back(session);
+    }
+}
+
+// ================================================
+// BLOCK / MUTE FILTER
+// ================================================
+// One bit per sender in a 32-bit Bloom word on the hot session: a clear bit
+// settles the common case without touching the cold state; a set bit falls
+// back to a binary search of the exact list.
+static uint32_t sender_filter_bit(IdHandle user) {
+    return 1u << ((user * 0x9E3779B1u) >> 27);
+}
+
+// Caller holds sessions_mutex
+static bool filters_sender(const ClientSession& session, IdHandle author) {
+    if (author == NO_ID || (session.sender_filter & sender_filter_bit(author)) == 0) {
+        return false;
+    }
+    const auto& senders = session.cold->filtered_senders;
+    return std::binary_search(senders.begin(), senders.end(), author);
+}
+
+// Caller holds sessions_mutex
+static void set_sender_filter(ClientSession& session, std::vector<IdHandle> senders) {
+    std::sort(senders.begin(), senders.end());
+    senders.erase(std::unique(senders.begin(), senders.end()), senders.end());
     
-    int delivered_count = 0;
-    int total_in_room = 0;
+    uint32_t bits = 0;
+    for (IdHandle sender : senders) {
+        bits |= sender_filter_bit(sender);
+    }
+    session.cold->filtered_senders = std::move(senders);
+    session.sender_filter = bits;
+}
+
+// Reload a user's blocked/muted senders from the DB into all of their local sessions
+static size_t refresh_sender_filters(const std::string& user_id) {
+    if (!db_manager) {
+        return 0;
+    }
     
-    std::cout << "🔍 Broadcasting to room: " << room_id << " (excluding sender: " << sender_id.substr(0, 8) << "...)" << std::endl;
+    std::vector<IdHandle> senders;
+    for (const auto& sender_id : db_manager->get_filtered_senders(user_id)) {
+        senders.push_back(interned_ids().intern(sender_id));
+    }
     
+    IdHandle user = interned_ids().find(user_id);
+    std::lock_guard<std::mutex> lock(sessions_mutex);
     for (auto& [session_id, session] : active_sessions) {
-        if (session->room_id == room_id && session->is_authenticated) {
-            total_in_room++;
+        if (session->user == user && session->is_authenticated) {
+            set_sender_filter(*session, senders);
+        }
+    }
+    return senders.size();
+}
+
+// author_id: whose content this is, dropped for recipients that blocked or
+// muted them. sender_id: whose sessions are skipped (echo suppression).
+// receipt_id: tracked message whose recipient count (distinct users other
+// than the author reached) is recorded once the frame is out. Returns that
+// count, or 0 when a hot room queued the frame for its next batch.
+size_t broadcast_to_room(const std::string& room_id, const std::string& message, const std::string& sender_id = "",
+                         Lane lane = Lane::CHAT, uint64_t coalesce_key = 0, const std::string& author_id = "",
+                         const std::string& receipt_id = "") {
+    static auto& filtered = metrics::counter("caffis_fanout_filtered_total");
+    
+    IdHandle room = interned_ids().find(room_id);
+    IdHandle sender = interned_ids().find(sender_id);
+    IdHandle author = interned_ids().find(author_id);
+    
+    if (hot_rooms().enabled()) {
+        HotFrame hot_frame;
+        hot_frame.payload = std::make_shared<const std::string>(message);
+        hot_frame.lane = lane;
+        hot_frame.coalesce_key = coalesce_key;
+        hot_frame.sender = sender;
+        hot_frame.author = author;
+        hot_frame.receipt_id = receipt_id;
+        hot_frame.queued_us = metrics::now_us();
+        if (hot_rooms().enqueue(room, std::move(hot_frame))) {
+            return 0;
+        }
+    }
+    
+    std::unique_lock<std::mutex> lock(sessions_mutex);
+    
+    thread_local std::vector<IdHandle> reached_users;
+    reached_users.clear();
+    
+    auto members = room_sessions.find(room);
+    if (room == NO_ID || members == room_sessions.end()) {
+        return 0;
+    }
+    
+    // One payload shared by every recipient's queue; pushes never block.
+    // Nothing is logged per recipient: this runs under sessions_mutex for every
+    // keystroke, and failed or shed pushes are already counted by the queue.
+    auto frame = std::make_shared<const std::string>(message);
+    for (auto& session : members->second) {
+        if (session->is_authenticated) {
+            if (filters_sender(*session, author)) {
+                filtered.inc();
+                continue;
+            }
             
-            if (session->user_id != sender_id) {
-                try {
-                    if (session->ws && session->ws->is_open()) {
-                        session->ws->text(true);
-                        session->ws->write(net::buffer(message));
-                        delivered_count++;
-                        std::cout << "   ✅ Delivered to " << session->username << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "   ❌ Failed to deliver to " << session->username << ": " << e.what() << std::endl;
+            if (sender == NO_ID || session->user != sender) {
+                if (session->outbound && session->outbound->push(frame, lane, coalesce_key) && session->user != author) {
+                    reached_users.push_back(session->user);
                 }
             }
         }
     }
     
-    std::cout << "📢 Broadcast complete: " << delivered_count << " delivered out of " << total_in_room << " users" << std::endl;
+    // Several devices of one user count once
+    std::sort(reached_users.begin(), reached_users.end());
+    size_t reached = static_cast<size_t>(std::unique(reached_users.begin(), reached_users.end()) - reached_users.begin());
+    lock.unlock();
+    if (!receipt_id.empty()) {
+        delivery_tracker().set_recipients(room, receipt_id, static_cast<uint32_t>(reached));
+    }
+    return reached;
+}
+
+// Serialize a chat message into the "new_message" frame the frontend expects
+std::string build_message_frame(const Message& msg, const std::string& sender_name) {
+    pt::ptree frame;
+    frame.put("type", "new_message");
+    frame.put("message_id", msg.id);
+    frame.put("room_id", msg.room_id);
+    frame.put("sender_id", msg.sender_id);
+    frame.put("sender_name", sender_name);
+    frame.put("content", msg.content);
+    
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(msg.timestamp.time_since_epoch()).count();
+    frame.put("timestamp", std::to_string(millis));
+    frame.put("message_type", message_type_to_string(msg.type));
+    if (!msg.file_url.empty()) {
+        frame.put("file_url", msg.file_url);
+        frame.put("file_name", msg.file_name);
+        frame.put("file_size", msg.file_size);
+        frame.put("file_type", msg.file_type);
+    }
+    if (msg.type == MessageType::LOCATION && !msg.metadata.empty()) {
+        try {
+            pt::ptree metadata;
+            std::istringstream metadata_iss(msg.metadata);
+            pt::read_json(metadata_iss, metadata);
+            frame.put("latitude", metadata.get<double>("lat"));
+            frame.put("longitude", metadata.get<double>("lon"));
+        } catch (const std::exception&) {
+            // Stored by an older writer without coordinates: send it as plain text
+        }
+    }
+    if (msg.is_edited) {
+        frame.put("is_edited", true);
+    }
+    
+    std::ostringstream frame_oss;
+    pt::write_json(frame_oss, frame);
+    return frame_oss.str();
+}
+
+// Fan a chat message out to the room's local sessions, tracking its delivery receipts
+static void broadcast_chat_message(const Message& msg, const std::string& sender_name) {
+    IdHandle room = interned_ids().find(msg.room_id);
+    delivery_tracker().track(room, msg.id, interned_ids().intern(msg.sender_id));
+    broadcast_to_room(msg.room_id, build_message_frame(msg, sender_name), "", Lane::CHAT, 0, msg.sender_id, msg.id);
+}
+
+// Deltas for an already delivered message: clients patch it in place
+static std::string build_message_updated_frame(const std::string& message_id, const std::string& room_id,
+                                               const std::string& content, int64_t edited_at_ms) {
+    pt::ptree frame;
+    frame.put("type", "message_updated");
+    frame.put("message_id", message_id);
+    frame.put("room_id", room_id);
+    frame.put("content", content);
+    frame.put("edited_at", std::to_string(edited_at_ms));
+    
+    std::ostringstream frame_oss;
+    pt::write_json(frame_oss, frame);
+    return frame_oss.str();
+}
+
+// Edit notice without the body, for transports that can't carry it: clients
+// refetch the message, nodes drop the room's cached tail
+static std::string build_message_refetch_frame(const std::string& message_id, const std::string& room_id,
+                                               int64_t edited_at_ms) {
+    pt::ptree frame;
+    frame.put("type", "message_updated");
+    frame.put("message_id", message_id);
+    frame.put("room_id", room_id);
+    frame.put("edited_at", std::to_string(edited_at_ms));
+    frame.put("content_omitted", true);
+    
+    std::ostringstream frame_oss;
+    pt::write_json(frame_oss, frame);
+    return frame_oss.str();
+}
+
+static std::string build_message_deleted_frame(const std::string& message_id, const std::string& room_id) {
+    pt::ptree frame;
+    frame.put("type", "message_deleted");
+    frame.put("message_id", message_id);
+    frame.put("room_id", room_id);
+    
+    std::ostringstream frame_oss;
+    pt::write_json(frame_oss, frame);
+    return frame_oss.str();
+}
+
+// Keep the room tail coherent with a delta frame (local or from another node)
+static void apply_delta_to_cache(const std::string& room_id, const std::string& frame) {
+    std::istringstream iss(frame);
+    pt::ptree delta;
+    pt::read_json(iss, delta);
+    
+    std::string type = delta.get<std::string>("type", "");
+    std::string message_id = delta.get<std::string>("message_id", "");
+    if (type == "message_updated" && delta.get<bool>("content_omitted", false)) {
+        hot_cache().drop_room_tail(room_id);
+    } else if (type == "message_updated") {
+        hot_cache().edit_cached_message(room_id, message_id, delta.get<std::string>("content", ""));
+    } else if (type == "message_deleted") {
+        hot_cache().remove_cached_message(room_id, message_id);
+    }
 }
 
 // ================================================
-// MESSAGE PROCESSING
+// TARGETED DELIVERY
 // ================================================
-void handle_message(std::shared_ptr<ClientSession> session, const std::string& raw_message) {
-    try {
-        std::istringstream iss(raw_message);
-        pt::ptree message_json;
-        pt::read_json(iss, message_json);
-        
-        std::string type = message_json.get<std::string>("type", "");
-        
-        if (type == "auth") {
-            std::string token = message_json.get<std::string>("token", "");
-            
-            if (token.empty()) {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"auth_error","error":"Token required"})"));
-                return;
-            }
-            
-            std::string user_id, username;
-            if (verify_jwt_token(token, user_id, username)) {
-                session->user_id = user_id;
-                session->username = username;
-                session->is_authenticated = true;
-                session->last_activity = std::chrono::system_clock::now();
-                
-                // Get full user details
-                UserDetails user_details = get_user_details_from_main_db(user_id);
-                if (user_details.found) {
-                    session->display_name = user_details.firstName + " " + user_details.lastName;
-                    session->email = user_details.email;
-                }
-                
-                // Send success response
-                pt::ptree response;
-                response.put("type", "auth_success");
-                response.put("user_id", user_id);
-                response.put("username", username);
-                response.put("display_name", session->display_name);
-                
-                std::ostringstream response_oss;
-                pt::write_json(response_oss, response);
-                
-                session->ws->text(true);
-                session->ws->write(net::buffer(response_oss.str()));
-                
-                std::cout << "🔐 User authenticated: " << username << std::endl;
-                
-                // ================================================
-                // AUTO-CREATE DEFAULT ROOM AND AUTO-JOIN USER
-                // ================================================
-                if (db_manager) {
-                    try {
-                        // Ensure user is in default room (creates room if needed)
-                        bool auto_room_success = db_manager->ensure_user_in_default_room(session->user_id, session->username);
-                        
-                        if (auto_room_success) {
-                            std::cout << "✅ User " << session->username << " auto-added to default room" << std::endl;
-                            
-                            // Send available rooms to user
-                            std::vector<ChatRoom> user_rooms = db_manager->get_user_rooms(session->user_id);
-                            
-                            pt::ptree rooms_response;
-                            rooms_response.put("type", "rooms_list");
-                            
-                            pt::ptree rooms_array;
-                            for (const auto& room : user_rooms) {
-                                pt::ptree room_obj;
-                                room_obj.put("id", room.id);
-                                room_obj.put("name", room.name);
-                                room_obj.put("type", room.type);
-                                room_obj.put("isOnline", true);
-                                rooms_array.push_back(std::make_pair("", room_obj));
-                            }
-                            
-                            rooms_response.add_child("rooms", rooms_array);
-                            
-                            std::ostringstream rooms_oss;
-                            pt::write_json(rooms_oss, rooms_response);
-                            
-                            session->ws->text(true);
-                            session->ws->write(net::buffer(rooms_oss.str()));
-                            
-                            std::cout << "📋 Sent " << user_rooms.size() << " available rooms to " << session->username << std::endl;
-                        }
-                        
-                    } catch (const std::exception& e) {
-                        std::cerr << "❌ Auto-room setup failed: " << e.what() << std::endl;
-                    }
-                }
-                
+static int deliver_to_local_user(const std::string& user_id, const std::string& frame) {
+    IdHandle user = interned_ids().find(user_id);
+    if (user == NO_ID) {
+        return 0;
+    }
+    
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    int delivered = 0;
+    auto payload = std::make_shared<const std::string>(frame);
+    
+    for (auto& [session_id, session] : active_sessions) {
+        if (session->is_authenticated && session->user == user) {
+            if (session->outbound && session->outbound->push(payload)) {
+                delivered++;
             } else {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"auth_error","error":"Invalid token"})"));
+                std::cerr << "   ❌ Failed direct delivery to " << session->cold->username << std::endl;
             }
-            
-        } else if (type == "message") {
-            if (!session->is_authenticated) {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"error","error":"Authentication required"})"));
-                return;
+        }
+    }
+    return delivered;
+}
+
+bool send_to_user(const std::string& user_id, const std::string& frame) {
+    static auto& local_sends = metrics::counter("caffis_direct_local_total");
+    static auto& remote_sends = metrics::counter("caffis_direct_remote_total");
+    
+    bool delivered = deliver_to_local_user(user_id, frame) > 0;
+    if (delivered) {
+        local_sends.inc();
+    }
+    
+    // Route only to the nodes that actually hold the user
+    if (session_directory && cluster_transport) {
+        for (const auto& node_id : session_directory->lookup(user_id)) {
+            if (node_id == local_node_id) {
+                continue;
             }
-            
-            std::string roomId = message_json.get<std::string>("roomId", "");
-            std::string content = message_json.get<std::string>("content", "");
-            std::string timestamp = message_json.get<std::string>("timestamp", "");
-            
-            if (roomId.empty() || content.empty()) {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"error","error":"Room ID and content required"})"));
-                return;
+            if (cluster_transport->send_to_node(node_id, user_id, frame)) {
+                remote_sends.inc();
+                delivered = true;
+            }
+        }
+    }
+    
+    return delivered;
+}
+
+static void register_local_user(IdHandle user) {
+    bool first_session;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        first_session = local_user_sessions[user]++ == 0;
+    }
+    if (first_session && session_directory) {
+        session_directory->register_user(interned_ids().to_string(user), local_node_id);
+    }
+}
+
+static void unregister_local_user(IdHandle user) {
+    bool last_session = false;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto it = local_user_sessions.find(user);
+        if (it != local_user_sessions.end() && --it->second <= 0) {
+            local_user_sessions.erase(it);
+            last_session = true;
+        }
+    }
+    if (last_session && session_directory) {
+        session_directory->unregister_user(interned_ids().to_string(user), local_node_id);
+    }
+}
+
+void init_session_directory(const config::ClusterConfig& cluster_config, const config::RedisConfig& redis_config) {
+    local_node_id = cluster_config.node_id;
+    std::chrono::seconds lease(cluster_config.session_lease_seconds);
+    
+    if (cluster_config.session_directory == "redis") {
+        session_directory = std::make_unique<RedisSessionDirectory>(redis_config.host, redis_config.port, lease);
+    } else if (cluster_config.session_directory == "memory") {
+        session_directory = std::make_unique<InMemorySessionDirectory>(lease);
+    } else {
+        std::cout << "📇 Session directory: disabled" << std::endl;
+        return;
+    }
+    
+    // Refresh our leases well before they expire
+    lease_running = true;
+    lease_thread = std::thread([lease]() {
+        auto interval = std::max(std::chrono::seconds(1), lease / 3);
+        while (lease_running) {
+            {
+                std::unique_lock<std::mutex> lock(lease_mutex);
+                lease_cv.wait_for(lock, interval, []() { return !lease_running.load(); });
+            }
+            if (!lease_running) {
+                break;
             }
             
-            // Generate message ID and timestamp
-            auto now = std::chrono::system_clock::now();
-            auto epoch = now.time_since_epoch();
-            auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(epoch).count();
-            std::string message_id = "msg_" + std::to_string(millis);
-            
-            // Create message for frontend (new_message format)
-            pt::ptree msg_response;
-            msg_response.put("type", "new_message");
-            msg_response.put("message_id", message_id);
-            msg_response.put("room_id", roomId);  
-            msg_response.put("sender_id", session->user_id);
-            msg_response.put("sender_name", session->display_name.empty() ? session->username : session->display_name);
-            msg_response.put("content", content);
-            msg_response.put("timestamp", std::to_string(millis));
-            msg_response.put("message_type", "text");
-            
-            std::ostringstream msg_oss;
-            pt::write_json(msg_oss, msg_response);
-            
-            std::cout << "💬 Message from " << session->username << ": " << content << std::endl;
-            
-            // Broadcast to ALL users in room (including sender for confirmation)
-            broadcast_to_room(roomId, msg_oss.str(), "");
-            
-            // Save to database
-            if (db_manager) {
-                try {
-                    Message msg;
-                    msg.id = message_id;
-                    msg.room_id = roomId;
-                    msg.sender_id = session->user_id;
-                    msg.content = content;
-                    msg.type = MessageType::TEXT;
-                    msg.is_edited = false;
-                    msg.is_deleted = false;
-                    
-                    std::string saved_id = db_manager->save_message(msg);
-                    if (!saved_id.empty()) {
-                        std::cout << "💾 Message saved: " << saved_id << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "❌ Database save failed: " << e.what() << std::endl;
+            std::vector<IdHandle> handles;
+            {
+                std::lock_guard<std::mutex> lock(sessions_mutex);
+                handles.reserve(local_user_sessions.size());
+                for (const auto& [user, count] : local_user_sessions) {
+                    handles.push_back(user);
                 }
             }
-            
-        } else if (type == "join_room") {
-            if (!session->is_authenticated) {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"error","error":"Authentication required"})"));
-                return;
+            std::vector<std::string> users;
+            users.reserve(handles.size());
+            for (IdHandle user : handles) {
+                users.push_back(interned_ids().to_string(user));
             }
-            
-            std::string room_id = message_json.get<std::string>("room_id", "");
-            
-            if (room_id.empty()) {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"error","error":"Room ID required"})"));
-                return;
+            session_directory->refresh_leases(users, local_node_id);
+        }
+    });
+    
+    std::cout << "✅ Session directory: " << session_directory->name() << " (node " << local_node_id << ")" << std::endl;
+}
+
+// ================================================
+// WARM-RESTART SNAPSHOTS
+// ================================================
+void init_state_snapshots(const std::string& connection_string, const config::SnapshotConfig& snapshot_config) {
+    snapshot_settings = snapshot_config;
+    if (snapshot_settings.path.empty()) {
+        std::cout << "📸 State snapshots: disabled" << std::endl;
+        return;
+    }
+    
+    snapshot_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!snapshot_db->connect()) {
+        std::cerr << "⚠️ Snapshot database unavailable - state snapshots disabled" << std::endl;
+        snapshot_db.reset();
+        return;
+    }
+    
+    snapshot_running = true;
+    snapshot_thread = std::thread([]() {
+        auto interval = std::chrono::seconds(std::max(10, snapshot_settings.interval_seconds));
+        while (snapshot_running) {
+            {
+                std::unique_lock<std::mutex> lock(snapshot_mutex);
+                snapshot_cv.wait_for(lock, interval, []() { return !snapshot_running.load(); });
             }
-            
-            std::cout << "🏠 User " << session->username << " joining room: " << room_id << std::endl;
-            
-            // Check if user can join this room (is participant)
-            if (db_manager) {
-                try {
-                    bool can_join = db_manager->can_user_join_room(session->user_id, room_id);
-                    
-                    if (!can_join) {
-                        session->ws->text(true);
-                        session->ws->write(net::buffer(R"({"type":"error","error":"Access denied to room"})"));
-                        return;
+            if (!snapshot_running) {
+                break;
+            }
+            save_state_snapshot(snapshot_settings.path, *snapshot_db);
+        }
+    });
+    
+    std::cout << "✅ State snapshots: " << snapshot_settings.path << " every " 
+              << snapshot_settings.interval_seconds << "s" << std::endl;
+}
+
+// ================================================
+// MESSAGE SEARCH
+// ================================================
+// Tail messages.seq into the index (from seq 0 on start, which is the
+// rebuild), then apply edits and deletes by edited_at
+static void run_search_feed() {
+    static auto& indexed = metrics::counter("caffis_search_indexed_total");
+    static auto& changes_applied = metrics::counter("caffis_search_changes_total");
+    static auto& documents = metrics::gauge("caffis_search_documents");
+    static auto& retired = metrics::gauge("caffis_search_retired_documents");
+    
+    const size_t batch_size = static_cast<size_t>(std::max(1, search_settings.batch_size));
+    const auto rebuild_begin = std::chrono::steady_clock::now();
+    int64_t seq_cursor = 0;
+    int64_t change_cursor_ms = -1;
+    bool caught_up = false;
+    
+    while (search_running) {
+        std::vector<Message> batch, changes;
+        {
+            std::lock_guard<std::mutex> lock(search_db_mutex);
+            batch = search_db->get_messages_after_seq(seq_cursor, static_cast<int>(batch_size), search_settings.lag_ms);
+            int64_t horizon_ms = change_cursor_ms;
+            changes = search_db->get_messages_changed_between(change_cursor_ms, horizon_ms, search_settings.lag_ms);
+            change_cursor_ms = horizon_ms;
+        }
+        
+        for (const auto& msg : batch) {
+            search_index().upsert(msg.room_id, msg.id, msg.seq, msg.sender_id, msg.content);
+            seq_cursor = std::max(seq_cursor, msg.seq);
+        }
+        for (const auto& msg : changes) {
+            if (msg.is_deleted) {
+                search_index().remove(msg.room_id, msg.seq);
+            } else {
+                search_index().upsert(msg.room_id, msg.id, msg.seq, msg.sender_id, msg.content);
+            }
+        }
+        indexed.inc(batch.size());
+        changes_applied.inc(changes.size());
+        
+        if (batch.size() == batch_size) {
+            continue;  // still catching up: no pause between batches
+        }
+        
+        size_t document_count = search_index().document_count();
+        documents.set(static_cast<int64_t>(document_count));
+        retired.set(static_cast<int64_t>(search_index().retired_count()));
+        if (!caught_up) {
+            caught_up = true;
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - rebuild_begin).count();
+            std::cout << "🔎 Search index built: " << document_count << " messages in "
+                      << search_index().shard_count() << " rooms (" << elapsed << "ms)" << std::endl;
+        }
+        
+        std::unique_lock<std::mutex> lock(search_mutex);
+        search_cv.wait_for(lock, std::chrono::milliseconds(std::max(50, search_settings.poll_interval_ms)),
+                           []() { return !search_running.load(); });
+    }
+}
+
+void init_search(const std::string& connection_string, const config::SearchConfig& search_config) {
+    search_settings = search_config;
+    if (!search_settings.enabled) {
+        std::cout << "🔎 Search: disabled" << std::endl;
+        return;
+    }
+    
+    search_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!search_db->connect()) {
+        std::cerr << "⚠️ Search database unavailable - search disabled" << std::endl;
+        search_db.reset();
+        return;
+    }
+    
+    search_running = true;
+    search_thread = std::thread(run_search_feed);
+    std::cout << "✅ Search: indexing messages every " << search_settings.poll_interval_ms << "ms" << std::endl;
+}
+
+static void stop_search() {
+    if (search_running.exchange(false)) {
+        search_cv.notify_all();
+        if (search_thread.joinable()) {
+            search_thread.join();
+        }
+    }
+}
+
+// ================================================
+// NEARBY ROOMS
+// ================================================
+// Load every located meetup room, then follow chat_rooms.updated_at so
+// placements, renames and closures from any node reach this node's index
+static void run_geo_feed() {
+    static auto& changes_applied = metrics::counter("caffis_geo_changes_total");
+    static auto& indexed_rooms = metrics::gauge("caffis_geo_rooms");
+    
+    int64_t change_cursor_ms = -1;
+    bool loaded = false;
+    
+    while (geo_running) {
+        int64_t horizon_ms = change_cursor_ms;
+        std::vector<RoomLocation> changes = geo_db->get_room_locations_changed(change_cursor_ms, horizon_ms,
+                                                                              geo_settings.lag_ms);
+        change_cursor_ms = horizon_ms;
+        
+        for (const auto& room : changes) {
+            if (room.listed) {
+                geo_index().upsert(room.room_id, room.name, room.latitude, room.longitude);
+            } else {
+                geo_index().remove(room.room_id);
+            }
+        }
+        changes_applied.inc(changes.size());
+        indexed_rooms.set(static_cast<int64_t>(geo_index().size()));
+        
+        if (!loaded && change_cursor_ms >= 0) {
+            loaded = true;
+            std::cout << "📍 Geo index loaded: " << geo_index().size() << " meetup rooms" << std::endl;
+        }
+        
+        std::unique_lock<std::mutex> lock(geo_mutex);
+        geo_cv.wait_for(lock, std::chrono::milliseconds(std::max(100, geo_settings.refresh_interval_ms)),
+                        []() { return !geo_running.load(); });
+    }
+}
+
+void init_geo(const std::string& connection_string, const config::GeoConfig& geo_config) {
+    geo_settings = geo_config;
+    if (!geo_settings.enabled) {
+        std::cout << "📍 Nearby rooms: disabled" << std::endl;
+        return;
+    }
+    
+    geo_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!geo_db->connect()) {
+        std::cerr << "⚠️ Geo database unavailable - nearby rooms disabled" << std::endl;
+        geo_db.reset();
+        return;
+    }
+    
+    geo_running = true;
+    geo_thread = std::thread(run_geo_feed);
+    std::cout << "✅ Nearby rooms: refreshing every " << geo_settings.refresh_interval_ms << "ms" << std::endl;
+}
+
+static void stop_geo() {
+    if (geo_running.exchange(false)) {
+        geo_cv.notify_all();
+        if (geo_thread.joinable()) {
+            geo_thread.join();
+        }
+    }
+}
+
+// ================================================
+// RETENTION
+// ================================================
+// Sleep so a background job's work takes about duty_percent of wall time; false on shutdown
+static bool duty_cycle_pause(std::chrono::steady_clock::duration busy, int duty_percent, std::mutex& mutex,
+                             std::condition_variable& cv, const std::atomic<bool>& running) {
+    int duty = std::min(100, std::max(1, duty_percent));
+    auto pause = std::max<std::chrono::steady_clock::duration>(busy * (100 - duty) / duty, std::chrono::milliseconds(10));
+    std::unique_lock<std::mutex> lock(mutex);
+    return !cv.wait_for(lock, pause, [&running]() { return !running.load(); });
+}
+
+static bool retention_pause(std::chrono::steady_clock::duration busy) {
+    return duty_cycle_pause(busy, retention_settings.duty_percent, retention_mutex, retention_cv, retention_running);
+}
+
+// Drop what was deleted from this node's search index and cached room tails
+static void forget_retained(const RetentionBatch& batch) {
+    std::unordered_set<std::string> rooms;
+    for (const auto& [room_id, seq] : batch.removed) {
+        search_index().remove(room_id, seq);
+        rooms.insert(room_id);
+    }
+    for (const auto& room_id : rooms) {
+        hot_cache().drop_room_tail(room_id);
+    }
+}
+
+static void run_retention_pass() {
+    static auto& receipts_deleted = metrics::counter("caffis_retention_receipts_deleted_total");
+    static auto& reclaimed = metrics::counter("caffis_retention_reclaimed_bytes_total");
+    static auto& partitions_dropped = metrics::counter("caffis_retention_partitions_dropped_total");
+    static auto& rooms_closed = metrics::counter("caffis_retention_rooms_closed_total");
+    static auto& pass_running = metrics::gauge("caffis_retention_pass_running");
+    static auto& pass_deleted = metrics::gauge("caffis_retention_pass_deleted");
+    static auto& last_pass_seconds = metrics::gauge("caffis_retention_last_pass_seconds");
+    
+    if (!retention_db->try_maintenance_lock("retention")) {
+        return;  // another node is compacting
+    }
+    const auto pass_begin = std::chrono::steady_clock::now();
+    pass_running.set(1);
+    pass_deleted.set(0);
+    uint64_t pass_bytes = 0;
+    
+    const int private_days = retention_settings.private_days;
+    const int group_days = retention_settings.group_days;
+    const int meetup_days = retention_settings.meetup_days_after_event;
+    
+    // Whole partitions first: only possible when no room type keeps messages forever
+    if (private_days > 0 && group_days > 0 && meetup_days > 0) {
+        for (const auto& partition : retention_db->get_message_partitions()) {
+            if (!retention_running) break;
+            uint64_t bytes = 0;
+            auto begin = std::chrono::steady_clock::now();
+            if (retention_db->drop_expired_message_partition(partition, std::max(private_days, group_days),
+                                                             meetup_days, bytes)) {
+                partitions_dropped.inc();
+                reclaimed.inc(bytes);
+                pass_bytes += bytes;
+                std::cout << "🗑️ Retention dropped partition " << partition << " (" << bytes / (1024 * 1024) << " MB)" << std::endl;
+            }
+            if (!retention_pause(std::chrono::steady_clock::now() - begin)) break;
+        }
+    }
+    
+    // Then whatever is left, batch by batch with pauses in between
+    const int batch_size = std::max(1, retention_settings.batch_size);
+    auto drain = [&](const char* room_type, const std::function<RetentionBatch()>& next_batch) {
+        auto& deleted = metrics::counter(std::string("caffis_retention_messages_deleted_total{room_type=\"") + room_type + "\"}");
+        while (retention_running) {
+            auto begin = std::chrono::steady_clock::now();
+            RetentionBatch batch = next_batch();
+            deleted.inc(batch.messages);
+            receipts_deleted.inc(batch.receipts);
+            reclaimed.inc(batch.bytes);
+            pass_deleted.add(static_cast<int64_t>(batch.messages));
+            pass_bytes += batch.bytes;
+            forget_retained(batch);
+            
+            if (batch.messages < static_cast<size_t>(batch_size)) break;
+            if (!retention_pause(std::chrono::steady_clock::now() - begin)) break;
+        }
+    };
+    if (private_days > 0) {
+        drain("private", [&]() { return retention_db->delete_expired_messages("private", private_days, batch_size); });
+    }
+    if (group_days > 0) {
+        drain("group", [&]() { return retention_db->delete_expired_messages("group", group_days, batch_size); });
+    }
+    if (meetup_days > 0) {
+        drain("meetup", [&]() { return retention_db->delete_expired_meetup_messages(meetup_days, batch_size); });
+        if (retention_running) {
+            rooms_closed.inc(static_cast<uint64_t>(retention_db->close_expired_meetup_rooms(meetup_days)));
+        }
+    }
+    
+    retention_db->release_maintenance_lock("retention");
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - pass_begin).count();
+    pass_running.set(0);
+    last_pass_seconds.set(elapsed);
+    std::cout << "🗑️ Retention pass: " << pass_deleted.value() << " messages, "
+              << pass_bytes / 1024 << " KB reclaimed in " << elapsed << "s" << std::endl;
+}
+
+void init_retention(const std::string& connection_string, const config::RetentionConfig& retention_config) {
+    retention_settings = retention_config;
+    bool any_limit = retention_settings.private_days > 0 || retention_settings.group_days > 0
+                  || retention_settings.meetup_days_after_event > 0;
+    if (!retention_settings.enabled || !any_limit) {
+        std::cout << "🗑️ Retention: disabled (messages kept forever)" << std::endl;
+        return;
+    }
+    
+    retention_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!retention_db->connect()) {
+        std::cerr << "⚠️ Retention database unavailable - retention disabled" << std::endl;
+        retention_db.reset();
+        return;
+    }
+    
+    retention_running = true;
+    retention_thread = std::thread([]() {
+        auto interval = std::chrono::minutes(std::max(1, retention_settings.interval_minutes));
+        // First pass shortly after start, once startup load has settled
+        auto wait = std::chrono::steady_clock::duration(std::chrono::minutes(1));
+        while (retention_running) {
+            {
+                std::unique_lock<std::mutex> lock(retention_mutex);
+                retention_cv.wait_for(lock, wait, []() { return !retention_running.load(); });
+            }
+            if (!retention_running) {
+                break;
+            }
+            run_retention_pass();
+            wait = interval;
+        }
+    });
+    
+    std::cout << "✅ Retention: private " << retention_settings.private_days << "d, group "
+              << retention_settings.group_days << "d, meetup " << retention_settings.meetup_days_after_event
+              << "d after event (0 = forever), every " << retention_settings.interval_minutes << " min" << std::endl;
+}
+
+static void stop_retention() {
+    if (retention_running.exchange(false)) {
+        retention_cv.notify_all();
+        if (retention_thread.joinable()) {
+            retention_thread.join();
+        }
+    }
+}
+
+// ================================================
+// DELIVERY RECEIPTS
+// ================================================
+static std::thread delivery_thread;
+static std::atomic<bool> delivery_running{false};
+static std::mutex delivery_mutex;
+static std::condition_variable delivery_cv;
+
+// Counts are this node's recipients; with several nodes a sender gets one
+// status per node and sums the latest from each
+static void push_delivery_statuses() {
+    static auto& frames = metrics::counter("caffis_delivery_status_frames_total");
+    static auto& tracked = metrics::gauge("caffis_delivery_tracked_messages");
+    
+    for (const auto& [sender, statuses] : delivery_tracker().collect_updates()) {
+        pt::ptree entries;
+        for (const auto& status : statuses) {
+            pt::ptree entry;
+            entry.put("room_id", status.room_id);
+            entry.put("message_id", status.message_id);
+            entry.put("delivered", status.delivered);
+            entry.put("total", status.total);
+            entries.push_back(std::make_pair("", entry));
+        }
+        pt::ptree frame;
+        frame.put("type", "delivery_status");
+        frame.put("node_id", local_node_id);
+        frame.add_child("statuses", entries);
+        
+        std::ostringstream frame_oss;
+        pt::write_json(frame_oss, frame);
+        if (send_to_user(interned_ids().to_string(sender), frame_oss.str())) {
+            frames.inc();
+        }
+    }
+    tracked.set(static_cast<int64_t>(delivery_tracker().tracked()));
+}
+
+void init_delivery_receipts(const config::DeliveryConfig& delivery_config) {
+    delivery_tracker().configure(delivery_config);
+    if (!delivery_config.enabled) {
+        std::cout << "📬 Delivery receipts: disabled" << std::endl;
+        return;
+    }
+    
+    delivery_running = true;
+    delivery_thread = std::thread([interval = std::chrono::milliseconds(std::max(50, delivery_config.status_interval_ms))]() {
+        while (delivery_running) {
+            {
+                std::unique_lock<std::mutex> lock(delivery_mutex);
+                delivery_cv.wait_for(lock, interval, []() { return !delivery_running.load(); });
+            }
+            try {
+                push_delivery_statuses();
+            } catch (const std::exception& e) {
+                std::cerr << "❌ Delivery status push failed: " << e.what() << std::endl;
+            }
+        }
+    });
+    
+    std::cout << "✅ Delivery receipts: statuses every " << delivery_config.status_interval_ms << "ms, last "
+              << delivery_config.tracked_per_room << " messages per room" << std::endl;
+}
+
+static void stop_delivery_receipts() {
+    if (delivery_running.exchange(false)) {
+        delivery_cv.notify_all();
+        if (delivery_thread.joinable()) {
+            delivery_thread.join();
+        }
+    }
+}
+
+// ================================================
+// ROOM ACTIVITY STATS
+// ================================================
+static std::unique_ptr<DatabaseManager> room_stats_db;
+static std::thread room_stats_thread;
+static std::atomic<bool> room_stats_running{false};
+static std::mutex room_stats_mutex;
+static std::condition_variable room_stats_cv;
+
+static void flush_room_stats() {
+    static auto& flushed_rooms = metrics::counter("caffis_room_stats_flushed_rooms_total");
+    static auto& failures = metrics::counter("caffis_room_stats_flush_failures_total");
+    static auto& dropped_rooms = metrics::counter("caffis_room_stats_dropped_rooms_total");
+    
+    // Taken even without a database: that is also what forgets idle rooms
+    std::vector<RoomActivityDelta> deltas = room_stats().take_deltas();
+    if (deltas.empty() || !room_stats_db) {
+        return;
+    }
+    if (room_stats_db->flush_room_activity(deltas)) {
+        flushed_rooms.inc(deltas.size());
+        return;
+    }
+    failures.inc();
+    
+    // Room by room, so one row the database rejects can't hold back the rest
+    // forever. If none goes through the database itself is the problem: keep
+    // everything for the next flush. Otherwise the rejected rooms are dropped.
+    std::vector<RoomActivityDelta> rejected;
+    for (const auto& delta : deltas) {
+        if (room_stats_db->flush_room_activity({delta})) {
+            flushed_rooms.inc();
+        } else {
+            rejected.push_back(delta);
+        }
+    }
+    if (rejected.size() == deltas.size()) {
+        room_stats().restore_deltas(deltas);
+    } else if (!rejected.empty()) {
+        dropped_rooms.inc(rejected.size());
+        std::cerr << "⚠️ Dropped activity of " << rejected.size() << " rooms the database rejected" << std::endl;
+    }
+}
+
+void init_room_stats(const std::string& connection_string, const config::RoomStatsConfig& room_stats_config) {
+    room_stats().configure(room_stats_config);
+    if (!room_stats_config.enabled) {
+        std::cout << "📈 Room stats: disabled" << std::endl;
+        return;
+    }
+    
+    room_stats_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!room_stats_db->connect()) {
+        std::cerr << "⚠️ Room stats database unavailable - counting in memory only" << std::endl;
+        room_stats_db.reset();
+    }
+    
+    room_stats_running = true;
+    room_stats_thread = std::thread([interval = std::chrono::seconds(std::max(1, room_stats_config.flush_seconds))]() {
+        while (room_stats_running) {
+            {
+                std::unique_lock<std::mutex> lock(room_stats_mutex);
+                room_stats_cv.wait_for(lock, interval, []() { return !room_stats_running.load(); });
+            }
+            try {
+                flush_room_stats();
+            } catch (const std::exception& e) {
+                std::cerr << "❌ Room stats flush failed: " << e.what() << std::endl;
+            }
+        }
+    });
+    
+    std::cout << "✅ Room stats: flushed every " << room_stats_config.flush_seconds << "s, top "
+              << room_stats_config.export_top_rooms << " rooms in /admin/metrics" << std::endl;
+}
+
+// The loop flushes once more on its way out, so nothing counted is lost
+static void stop_room_stats() {
+    if (room_stats_running.exchange(false)) {
+        room_stats_cv.notify_all();
+        if (room_stats_thread.joinable()) {
+            room_stats_thread.join();
+        }
+    }
+}
+
+// ================================================
+// HOT ROOMS (batched fan-out)
+// ================================================
+static std::thread hot_room_thread;
+static std::atomic<bool> hot_room_running{false};
+static std::mutex hot_room_mutex;
+static std::condition_variable hot_room_cv;
+
+// One pass over the room per batch: each recipient gets every frame it
+// should see under a single cork, so the batch leaves as one write
+static void fan_out_hot_batch(IdHandle room, std::vector<HotFrame>& frames) {
+    static auto& batches = metrics::counter("caffis_hot_fanout_batches_total");
+    static auto& batched_frames = metrics::counter("caffis_hot_fanout_frames_total");
+    static auto& filtered = metrics::counter("caffis_fanout_filtered_total");
+    static auto& delay = metrics::histogram("caffis_hot_fanout_delay_us");
+    
+    std::vector<std::vector<IdHandle>> reached(frames.size());
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        auto members = room_sessions.find(room);
+        if (members != room_sessions.end()) {
+            for (auto& session : members->second) {
+                if (!session->is_authenticated || !session->outbound) {
+                    continue;
+                }
+                OutboundQueue::Cork cork(*session->outbound);
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    const HotFrame& frame = frames[i];
+                    if (filters_sender(*session, frame.author)) {
+                        filtered.inc();
+                        continue;
+                    }
+                    if (frame.sender != NO_ID && session->user == frame.sender) {
+                        continue;
+                    }
+                    if (session->outbound->push(frame.payload, frame.lane, frame.coalesce_key) && session->user != frame.author) {
+                        reached[i].push_back(session->user);
+                    }
+                }
+            }
+        }
+    }
+    
+    const int64_t now_us = metrics::now_us();
+    for (size_t i = 0; i < frames.size(); ++i) {
+        delay.observe(static_cast<uint64_t>(std::max<int64_t>(0, now_us - frames[i].queued_us)));
+        if (!frames[i].receipt_id.empty()) {
+            auto& users = reached[i];
+            std::sort(users.begin(), users.end());
+            size_t distinct = static_cast<size_t>(std::unique(users.begin(), users.end()) - users.begin());
+            delivery_tracker().set_recipients(room, frames[i].receipt_id, static_cast<uint32_t>(distinct));
+        }
+    }
+    batches.inc();
+    batched_frames.inc(frames.size());
+}
+
+void init_hot_rooms(const config::HotRoomConfig& hot_room_config) {
+    hot_rooms().configure(hot_room_config);
+    if (!hot_room_config.enabled) {
+        std::cout << "🔥 Hot rooms: disabled (every room on the direct path)" << std::endl;
+        return;
+    }
+    
+    hot_room_running = true;
+    hot_room_thread = std::thread([]() {
+        const auto batch_interval = std::chrono::milliseconds(hot_rooms().settings().batch_ms);
+        const auto classify_interval = std::chrono::seconds(hot_rooms().settings().classify_seconds);
+        auto next_classify = std::chrono::steady_clock::now();
+        
+        while (hot_room_running) {
+            try {
+                for (auto& [room, frames] : hot_rooms().take_batches()) {
+                    fan_out_hot_batch(room, frames);
+                }
+                if (std::chrono::steady_clock::now() >= next_classify) {
+                    hot_rooms().reclassify(room_stats().snapshot(), fan_out_hot_batch);
+                    next_classify = std::chrono::steady_clock::now() + classify_interval;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "❌ Hot room fan-out failed: " << e.what() << std::endl;
+            }
+            
+            // Nothing hot: only the classifier needs to run
+            std::unique_lock<std::mutex> lock(hot_room_mutex);
+            hot_room_cv.wait_for(lock, hot_rooms().hot_count() > 0 ? batch_interval : classify_interval,
+                                 []() { return !hot_room_running.load(); });
+        }
+        
+        // Whatever was queued before the stop still goes out
+        for (auto& [room, frames] : hot_rooms().take_batches()) {
+            fan_out_hot_batch(room, frames);
+        }
+    });
+    
+    const auto& settings = hot_rooms().settings();
+    std::cout << "✅ Hot rooms: from " << settings.hot_members << " members or " << settings.hot_messages_per_minute
+              << " msg/min, fan-out every " << settings.batch_ms << "ms" << std::endl;
+}
+
+static void stop_hot_rooms() {
+    if (hot_room_running.exchange(false)) {
+        hot_room_cv.notify_all();
+        if (hot_room_thread.joinable()) {
+            hot_room_thread.join();
+        }
+    }
+}
+
+// ================================================
+// OFFLINE NOTIFICATIONS
+// ================================================
+static std::unique_ptr<NotificationQueue> notification_queue;
+
+// Any live session: here, or on another node per the session directory
+static bool user_has_session(const std::string& user_id) {
+    IdHandle user = interned_ids().find(user_id);
+    if (user != NO_ID) {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        if (local_user_sessions.count(user)) {
+            return true;
+        }
+    }
+    return session_directory && !session_directory->lookup(user_id).empty();
+}
+
+void init_notifications(const std::string& connection_string, const config::NotificationConfig& notification_config) {
+    if (!notification_config.enabled) {
+        std::cout << "🔕 Offline notifications: disabled" << std::endl;
+        return;
+    }
+    auto provider = make_notification_provider(notification_config);
+    if (!provider) {
+        std::cerr << "⚠️ Unknown notification provider '" << notification_config.provider
+                  << "' - offline notifications disabled" << std::endl;
+        return;
+    }
+    auto db = std::make_unique<DatabaseManager>(connection_string);
+    if (!db->connect()) {
+        std::cerr << "⚠️ Notification database unavailable - offline notifications disabled" << std::endl;
+        return;
+    }
+    
+    std::string provider_name = provider->name();
+    notification_queue = std::make_unique<NotificationQueue>(notification_config, std::move(db), std::move(provider),
+                                                              user_has_session);
+    notification_queue->start();
+    std::cout << "✅ Offline notifications: " << provider_name << " provider, " << notification_config.window_ms
+              << "ms coalescing window" << std::endl;
+}
+
+static void stop_notifications() {
+    if (notification_queue) {
+        notification_queue->stop();
+    }
+}
+
+// ================================================
+// CONTENT CODEC
+// ================================================
+// Dictionaries trained after startup are fetched on first use, one at a time
+static std::unique_ptr<DatabaseManager> codec_db;
+static std::mutex codec_db_mutex;
+
+void init_content_codec(const std::string& connection_string, const config::ContentCodecConfig& codec_config) {
+    content_codec().configure(codec_config);
+    
+    codec_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!codec_db->connect()) {
+        std::cerr << "⚠️ Content dictionaries unavailable - packed bodies written with one will not decode" << std::endl;
+        codec_db.reset();
+        return;
+    }
+    auto dictionaries = codec_db->get_content_dictionaries();
+    for (const auto& [id, dictionary] : dictionaries) {
+        content_codec().add_dictionary(id, dictionary);
+    }
+    if (!content_codec().enabled() && dictionaries.empty()) {
+        codec_db.reset();  // nothing stored needs a dictionary
+        return;
+    }
+    content_codec().set_dictionary_loader([](uint32_t id, std::string& dictionary) {
+        std::lock_guard<std::mutex> lock(codec_db_mutex);
+        return codec_db && codec_db->get_content_dictionary(id, dictionary);
+    });
+    
+    if (content_codec().enabled()) {
+        uint32_t encode_id = content_codec().encode_dictionary();
+        std::cout << "✅ Content codec: zstd level " << codec_config.zstd_level << " for bodies >= "
+                  << codec_config.min_bytes << " bytes, dictionary "
+                  << (encode_id ? "#" + std::to_string(encode_id) : std::string("none (plain zstd)"))
+                  << " of " << dictionaries.size() << std::endl;
+    }
+}
+
+// ================================================
+// HISTORY ARCHIVE
+// ================================================
+// Move one room's old messages into segments; false when the pass should stop
+static bool archive_room(const std::string& room_id) {
+    static auto& rows_removed = metrics::counter("caffis_archive_rows_removed_total");
+    static auto& skipped_rooms = metrics::counter("caffis_archive_rooms_skipped_total");
+    
+    // A crash between writing a segment and deleting its rows leaves them in
+    // Postgres; deleting by the segment's ids is idempotent
+    archive_db->delete_messages_by_ids(archive().last_segment_ids(room_id));
+    
+    const int segment_messages = std::max(64, archive_settings.segment_messages);
+    while (archive_running) {
+        auto begin = std::chrono::steady_clock::now();
+        int64_t after_seq = archive().last_archived_seq(room_id);
+        std::vector<Message> batch;
+        if (!archive_db->get_archivable_messages(room_id, archive_settings.after_days, after_seq,
+                                                 segment_messages, batch)) {
+            // Unreadable rows (or the DB): leave the room in Postgres, try the next one
+            skipped_rooms.inc();
+            std::cerr << "⚠️ Archive skipped room " << room_id << ": its rows could not be read" << std::endl;
+            return true;
+        }
+        if (batch.empty()) {
+            return true;
+        }
+        
+        // Tombstones are not worth keeping: they only leave Postgres
+        std::vector<Message> live;
+        std::vector<std::string> ids;
+        for (auto& msg : batch) {
+            ids.push_back(msg.id);
+            if (!msg.is_deleted) {
+                live.push_back(msg);
+            }
+        }
+        if (!live.empty() && !archive().write_segment(room_id, live)) {
+            return false;  // disk trouble: leave everything in Postgres
+        }
+        rows_removed.inc(archive_db->delete_messages_by_ids(ids));
+        for (const auto& msg : batch) {
+            search_index().remove(room_id, msg.seq);
+        }
+        hot_cache().drop_room_tail(room_id);
+        
+        if (static_cast<int>(batch.size()) < segment_messages) {
+            return true;
+        }
+        if (!duty_cycle_pause(std::chrono::steady_clock::now() - begin, archive_settings.duty_percent,
+                              archive_mutex, archive_cv, archive_running)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static void run_archive_pass() {
+    static auto& last_pass_seconds = metrics::gauge("caffis_archive_last_pass_seconds");
+    
+    if (!archive_db->try_maintenance_lock("archive")) {
+        return;  // another node is tiering
+    }
+    const auto pass_begin = std::chrono::steady_clock::now();
+    std::vector<std::string> rooms = archive_db->get_rooms_with_messages_before(
+        archive_settings.after_days, std::max(1, archive_settings.rooms_per_pass), archive_settings.skip_room_types);
+    
+    size_t archived_rooms = 0;
+    for (const auto& room_id : rooms) {
+        auto begin = std::chrono::steady_clock::now();
+        if (!ArchiveStore::valid_room_id(room_id) || !archive_room(room_id)) {
+            break;
+        }
+        archived_rooms++;
+        if (!duty_cycle_pause(std::chrono::steady_clock::now() - begin, archive_settings.duty_percent,
+                              archive_mutex, archive_cv, archive_running)) {
+            break;
+        }
+    }
+    
+    archive_db->release_maintenance_lock("archive");
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - pass_begin).count();
+    last_pass_seconds.set(elapsed);
+    if (archived_rooms > 0) {
+        std::cout << "🧊 Archive pass: " << archived_rooms << " rooms tiered in " << elapsed << "s" << std::endl;
+    }
+}
+
+void init_archive(const std::string& connection_string, const config::ArchiveConfig& archive_config) {
+    archive_settings = archive_config;
+    if (!archive().configure(archive_config)) {
+        return;
+    }
+    
+    archive_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!archive_db->connect()) {
+        std::cerr << "⚠️ Archive database unavailable - tiering disabled (archive stays readable)" << std::endl;
+        archive_db.reset();
+        return;
+    }
+    
+    archive_running = true;
+    archive_thread = std::thread([]() {
+        auto interval = std::chrono::minutes(std::max(1, archive_settings.interval_minutes));
+        auto wait = std::chrono::steady_clock::duration(std::chrono::minutes(2));
+        while (archive_running) {
+            {
+                std::unique_lock<std::mutex> lock(archive_mutex);
+                archive_cv.wait_for(lock, wait, []() { return !archive_running.load(); });
+            }
+            if (!archive_running) {
+                break;
+            }
+            run_archive_pass();
+            wait = interval;
+        }
+    });
+    
+    std::string skipped;
+    for (const auto& room_type : archive_settings.skip_room_types) {
+        skipped += (skipped.empty() ? "" : ", ") + room_type;
+    }
+    std::cout << "✅ Archive tiering: messages older than " << archive_settings.after_days << "d, every "
+              << archive_settings.interval_minutes << " min"
+              << (skipped.empty() ? std::string() : " (" + skipped + " rooms stay in Postgres for retention)") << std::endl;
+}
+
+static void stop_archive() {
+    if (archive_running.exchange(false)) {
+        archive_cv.notify_all();
+        if (archive_thread.joinable()) {
+            archive_thread.join();
+        }
+    }
+}
+
+// ================================================
+// MEMORY ACCOUNTING
+// ================================================
+// make_shared control block (vtable + use/weak counts) ahead of the object
+static constexpr size_t SHARED_CONTROL_BLOCK_BYTES = sizeof(void*) + 2 * sizeof(int);
+
+static size_t string_heap_bytes(const std::string& value) {
+    return value.capacity() > 15 ? value.capacity() + 1 : 0;
+}
+
+// Byte totals per subsystem. The websocket stream's internal state is not
+// visible from here, so it shows up in heap_unattributed.
+struct MemoryUsage {
+    size_t sessions = 0;
+    size_t session_hot = 0;
+    size_t session_cold = 0;
+    size_t websocket_streams = 0;
+    size_t read_buffers = 0;
+    size_t outbound_queues = 0;
+    size_t session_indexes = 0;
+    size_t intern_table = 0;
+    size_t hot_cache = 0;
+    size_t search_index = 0;
+    size_t geo_index = 0;
+    size_t delivery_tracker = 0;
+    size_t room_stats = 0;
+    size_t hot_rooms = 0;
+    size_t thread_stacks_reserved = 0;  // virtual, one stack per session thread
+    size_t heap_in_use = 0;
+    size_t rss = 0;
+    size_t threads = 0;
+    size_t open_fds = 0;
+    
+    size_t per_session() const {
+        size_t total = session_hot + session_cold + websocket_streams + read_buffers + outbound_queues + session_indexes;
+        return sessions == 0 ? 0 : total / sessions;
+    }
+    size_t heap_unattributed() const {
+        size_t attributed = session_hot + session_cold + websocket_streams + read_buffers
+                          + outbound_queues + session_indexes + intern_table + hot_cache + search_index + geo_index
+                          + delivery_tracker + room_stats + hot_rooms;
+        return heap_in_use > attributed ? heap_in_use - attributed : 0;
+    }
+};
+
+static size_t default_thread_stack_bytes() {
+    pthread_attr_t attr;
+    size_t stack_size = 0;
+    if (pthread_attr_init(&attr) == 0) {
+        pthread_attr_getstacksize(&attr, &stack_size);
+        pthread_attr_destroy(&attr);
+    }
+    return stack_size;
+}
+
+static size_t heap_in_use_bytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static size_t resident_set_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0, resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Threads and FDs are what a slow leak under connection churn shows up in first
+static size_t process_thread_count() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("Threads:", 0) == 0) {
+            return std::stoul(line.substr(8));
+        }
+    }
+    return 0;
+}
+
+static size_t open_fd_count() {
+    DIR* dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return 0;
+    }
+    size_t count = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count > 0 ? count - 1 : 0;  // minus the one opendir holds
+}
+
+static MemoryUsage collect_memory_usage() {
+    MemoryUsage usage;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        usage.sessions = active_sessions.size();
+        
+        for (const auto& [session_id, session] : active_sessions) {
+            usage.session_hot += sizeof(ClientSession) + SHARED_CONTROL_BLOCK_BYTES;
+            usage.websocket_streams += sizeof(websocket::stream<QueuedStream>) + SHARED_CONTROL_BLOCK_BYTES;
+            usage.session_indexes += sizeof(session_id) + sizeof(session) + 2 * sizeof(void*) + string_heap_bytes(session_id);
+            if (session->cold) {
+                const SessionColdState& cold = *session->cold;
+                usage.session_cold += sizeof(SessionColdState) + string_heap_bytes(cold.username)
+                                    + string_heap_bytes(cold.display_name) + string_heap_bytes(cold.client_endpoint)
+                                    + cold.filtered_senders.capacity() * sizeof(IdHandle);
+                usage.read_buffers += cold.read_buffer_capacity.load(std::memory_order_relaxed);
+            }
+            if (session->outbound) {
+                usage.outbound_queues += sizeof(OutboundQueue) + SHARED_CONTROL_BLOCK_BYTES + session->outbound->queued_bytes();
+            }
+        }
+        for (const auto& [room, members] : room_sessions) {
+            usage.session_indexes += sizeof(room) + sizeof(members) + 2 * sizeof(void*)
+                                   + members.capacity() * sizeof(std::shared_ptr<ClientSession>);
+        }
+        usage.session_indexes += local_user_sessions.size() * (sizeof(IdHandle) + sizeof(int) + 2 * sizeof(void*));
+    }
+    
+    usage.intern_table = interned_ids().memory_bytes();
+    usage.hot_cache = hot_cache().memory_bytes();
+    usage.search_index = search_index().memory_bytes();
+    usage.geo_index = geo_index().memory_bytes();
+    usage.delivery_tracker = delivery_tracker().memory_bytes();
+    usage.room_stats = room_stats().memory_bytes();
+    usage.hot_rooms = hot_rooms().memory_bytes();
+    usage.thread_stacks_reserved = usage.sessions * default_thread_stack_bytes();
+    usage.heap_in_use = heap_in_use_bytes();
+    usage.rss = resident_set_bytes();
+    usage.threads = process_thread_count();
+    usage.open_fds = open_fd_count();
+    return usage;
+}
+
+static void publish_memory_gauges(const MemoryUsage& usage) {
+    auto set = [](const char* subsystem, size_t bytes) {
+        metrics::gauge(std::string("caffis_memory_bytes{subsystem=\"") + subsystem + "\"}").set(static_cast<int64_t>(bytes));
+    };
+    set("session_hot", usage.session_hot);
+    set("session_cold", usage.session_cold);
+    set("websocket_streams", usage.websocket_streams);
+    set("read_buffers", usage.read_buffers);
+    set("outbound_queues", usage.outbound_queues);
+    set("session_indexes", usage.session_indexes);
+    set("intern_table", usage.intern_table);
+    set("hot_cache", usage.hot_cache);
+    set("search_index", usage.search_index);
+    set("geo_index", usage.geo_index);
+    set("delivery_tracker", usage.delivery_tracker);
+    set("room_stats", usage.room_stats);
+    set("hot_rooms", usage.hot_rooms);
+    set("heap_unattributed", usage.heap_unattributed());
+    metrics::gauge("caffis_memory_per_session_bytes").set(static_cast<int64_t>(usage.per_session()));
+    metrics::gauge("caffis_process_resident_bytes").set(static_cast<int64_t>(usage.rss));
+    metrics::gauge("caffis_process_threads").set(static_cast<int64_t>(usage.threads));
+    metrics::gauge("caffis_process_open_fds").set(static_cast<int64_t>(usage.open_fds));
+    metrics::gauge("caffis_sessions_active").set(static_cast<int64_t>(usage.sessions));
+}
+
+static std::string memory_report_json(const MemoryUsage& usage) {
+    pt::ptree report;
+    report.put("sessions", usage.sessions);
+    report.put("per_session_bytes", usage.per_session());
+    report.put("layout.client_session_bytes", sizeof(ClientSession));
+    report.put("layout.session_cold_bytes", sizeof(SessionColdState));
+    report.put("layout.websocket_stream_bytes", sizeof(websocket::stream<QueuedStream>));
+    report.put("subsystems.session_hot", usage.session_hot);
+    report.put("subsystems.session_cold", usage.session_cold);
+    report.put("subsystems.websocket_streams", usage.websocket_streams);
+    report.put("subsystems.read_buffers", usage.read_buffers);
+    report.put("subsystems.outbound_queues", usage.outbound_queues);
+    report.put("subsystems.session_indexes", usage.session_indexes);
+    report.put("subsystems.intern_table", usage.intern_table);
+    report.put("subsystems.hot_cache", usage.hot_cache);
+    report.put("subsystems.search_index", usage.search_index);
+    report.put("subsystems.geo_index", usage.geo_index);
+    report.put("subsystems.delivery_tracker", usage.delivery_tracker);
+    report.put("subsystems.room_stats", usage.room_stats);
+    report.put("subsystems.hot_rooms", usage.hot_rooms);
+    report.put("process.heap_in_use", usage.heap_in_use);
+    report.put("process.heap_unattributed", usage.heap_unattributed());
+    report.put("process.thread_stacks_reserved", usage.thread_stacks_reserved);
+    report.put("process.rss", usage.rss);
+    report.put("process.threads", usage.threads);
+    report.put("process.open_fds", usage.open_fds);
+    
+    std::ostringstream oss;
+    pt::write_json(oss, report);
+    return oss.str();
+}
+
+// ================================================
+// ADMIN ROUTES
+// ================================================
+void init_admin(const config::AdminConfig& admin_config) {
+    admin_settings = admin_config;
+    trace::configure(admin_settings.trace_sample_rate, static_cast<size_t>(std::max(1, admin_settings.trace_ring_capacity)));
+    
+    std::cout << "✅ Admin routes: " << (admin_settings.token.empty() ? "loopback only" : "bearer token")
+              << ", tracing " << (trace::enabled() ? "sampled at " + std::to_string(admin_settings.trace_sample_rate) : std::string("off"))
+              << std::endl;
+}
+
+static bool is_admin_request(const http::request<http::string_body>& request, const std::string& client_endpoint) {
+    if (admin_settings.token.empty()) {
+        return client_endpoint == "127.0.0.1" || client_endpoint == "::1" || client_endpoint == "::ffff:127.0.0.1";
+    }
+    auto auth = request.find(http::field::authorization);
+    return auth != request.end() && std::string(auth->value()) == "Bearer " + admin_settings.token;
+}
+
+// ================================================
+// REST HISTORY API
+// ================================================
+// Read-only, for clients that page history without a socket:
+//   GET /api/rooms                                      rooms of the caller
+//   GET /api/rooms/<room_id>/messages?limit=&before=    oldest first, keyset by seq
+// Authorization: Bearer <JWT>. next_before (present when the page is full)
+// is the before= of the page under it.
+//
+// Pages the room tail can answer carry an ETag built from the tail version:
+// local messages only get their seq once saved, so the tail's own change
+// counter stands in for "newest seq". Revalidating such a page is a 304
+// without touching the database. Everything else is served from the DB
+// with an ETag over the body.
+static config::HistoryApiConfig history_settings;
+static std::unique_ptr<DatabaseManager> history_db;  // own connection: page reads never queue behind sessions
+static std::mutex history_db_mutex;
+static const std::string history_boot_tag = std::to_string(metrics::now_us());  // tail versions restart with the process
+
+// Token -> user id, so a revalidation doesn't cost a main-DB lookup
+struct CachedBearer {
+    std::string user_id;
+    std::chrono::steady_clock::time_point expires;
+};
+static std::unordered_map<std::string, CachedBearer> bearer_cache;
+static std::mutex bearer_cache_mutex;
+static constexpr size_t BEARER_CACHE_CAPACITY = 10000;
+
+void init_history_api(const std::string& connection_string, const config::HistoryApiConfig& history_config) {
+    history_settings = history_config;
+    if (!history_settings.enabled) {
+        std::cout << "📚 History API: disabled" << std::endl;
+        return;
+    }
+    
+    history_db = std::make_unique<DatabaseManager>(connection_string);
+    if (!history_db->connect()) {
+        std::cerr << "⚠️ History database unavailable - REST history disabled" << std::endl;
+        history_db.reset();
+        return;
+    }
+    std::cout << "✅ History API: /api/rooms, pages of up to " << history_settings.max_page << " messages" << std::endl;
+}
+
+static uint64_t history_fnv1a(const std::string& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string body_etag(const std::string& body) {
+    char tag[24];
+    std::snprintf(tag, sizeof(tag), "\"b%016llx\"", static_cast<unsigned long long>(history_fnv1a(body)));
+    return tag;
+}
+
+static std::string tail_etag(uint64_t version, size_t limit, int64_t before_seq) {
+    return "\"m" + history_boot_tag + "-" + std::to_string(version) + "-" + std::to_string(limit) + "-" +
+           std::to_string(before_seq) + "\"";
+}
+
+static bool etag_matches(const http::request<http::string_body>& request, const std::string& etag) {
+    auto header = request.find(http::field::if_none_match);
+    return header != request.end() && std::string(header->value()).find(etag) != std::string::npos;
+}
+
+// Value of `name` in the query string of `target`, not percent-decoded (ids and numbers only)
+static std::string query_param(const std::string& target, const std::string& name) {
+    size_t query = target.find('?');
+    if (query == std::string::npos) {
+        return "";
+    }
+    std::vector<std::string> pairs;
+    boost::split(pairs, target.substr(query + 1), boost::is_any_of("&"));
+    for (const auto& pair : pairs) {
+        if (pair.size() > name.size() && pair.compare(0, name.size(), name) == 0 && pair[name.size()] == '=') {
+            return pair.substr(name.size() + 1);
+        }
+    }
+    return "";
+}
+
+static bool authenticate_bearer(const http::request<http::string_body>& request, std::string& user_id) {
+    auto auth = request.find(http::field::authorization);
+    if (auth == request.end()) {
+        return false;
+    }
+    std::string value(auth->value());
+    if (value.rfind("Bearer ", 0) != 0) {
+        return false;
+    }
+    std::string token = value.substr(7);
+    
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(bearer_cache_mutex);
+        auto cached = bearer_cache.find(token);
+        if (cached != bearer_cache.end() && cached->second.expires > now) {
+            user_id = cached->second.user_id;
+            return true;
+        }
+    }
+    
+    std::string username;
+    if (!verify_jwt_token(token, user_id, username)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(bearer_cache_mutex);
+    if (bearer_cache.size() >= BEARER_CACHE_CAPACITY) {
+        bearer_cache.clear();
+    }
+    bearer_cache[token] = {user_id, now + std::chrono::seconds(history_settings.token_cache_seconds)};
+    return true;
+}
+
+// Caller holds history_db_mutex
+// The cached member set only ever grows on this node (joins), so a room's
+// members are reloaded from the DB at most HISTORY_MEMBERS_TTL after the
+// last load: a user removed elsewhere loses access within that time.
+static constexpr auto HISTORY_MEMBERS_TTL = std::chrono::seconds(30);
+static std::unordered_map<IdHandle, std::chrono::steady_clock::time_point> history_members_loaded;
+
+static bool history_room_member(const std::string& room_id, const std::string& user_id) {
+    const auto now = std::chrono::steady_clock::now();
+    auto loaded = history_members_loaded.find(interned_ids().find(room_id));
+    bool fresh = loaded != history_members_loaded.end() && now - loaded->second < HISTORY_MEMBERS_TTL;
+    if (fresh && hot_cache().is_room_member(room_id, user_id)) {
+        return true;
+    }
+    std::vector<std::string> members = history_db->get_room_participants(room_id);
+    if (!members.empty()) {
+        hot_cache().set_room_members(room_id, members);
+        if (history_members_loaded.size() >= HotCache::MAX_ROOMS) {
+            history_members_loaded.clear();
+        }
+        history_members_loaded[interned_ids().find(room_id)] = now;
+    }
+    return std::find(members.begin(), members.end(), user_id) != members.end();
+}
+
+// Caller holds history_db_mutex
+static std::string history_sender_name(const std::string& user_id) {
+    CachedUser cached;
+    if (hot_cache().get_user(user_id, cached)) {
+        return cached.name();
+    }
+    if (history_db->get_user(user_id, cached.username, cached.display_name)) {
+        hot_cache().put_user(user_id, cached);
+    }
+    return cached.name();
+}
+
+// With a cluster transport, only tails of rooms this node is subscribed to
+// see every remote message; any other tail may be behind
+static bool room_tail_trusted(const std::string& room_id) {
+    if (!cluster_transport) {
+        return true;
+    }
+    IdHandle room = interned_ids().find(room_id);
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    auto it = room_sessions.find(room);
+    return it != room_sessions.end() && !it->second.empty();
+}
+
+// Caller holds history_db_mutex
+static std::string history_page_json(const std::string& room_id, const std::vector<Message>& messages, size_t limit) {
+    pt::ptree list;
+    for (const auto& msg : messages) {
+        pt::ptree entry;
+        entry.put("message_id", msg.id);
+        entry.put("sender_id", msg.sender_id);
+        entry.put("sender_name", history_sender_name(msg.sender_id));
+        entry.put("content", msg.content);
+        entry.put("timestamp", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+            msg.timestamp.time_since_epoch()).count()));
+        entry.put("message_type", message_type_to_string(msg.type));
+        if (!msg.file_url.empty()) {
+            entry.put("file_url", msg.file_url);
+            entry.put("file_name", msg.file_name);
+            entry.put("file_size", msg.file_size);
+            entry.put("file_type", msg.file_type);
+        }
+        if (msg.is_edited) {
+            entry.put("is_edited", true);
+        }
+        list.push_back(std::make_pair("", entry));
+    }
+    
+    pt::ptree page;
+    page.put("room_id", room_id);
+    page.add_child("messages", list);
+    if (messages.size() == limit) {
+        // Messages not saved yet have no seq: continue from the oldest saved one
+        auto oldest_saved = std::find_if(messages.begin(), messages.end(), [](const Message& msg) { return msg.seq > 0; });
+        if (oldest_saved != messages.end()) {
+            page.put("next_before", std::to_string(oldest_saved->seq));
+        }
+    }
+    std::ostringstream page_oss;
+    pt::write_json(page_oss, page);
+    return page_oss.str();
+}
+
+static void serve_room_history(const http::request<http::string_body>& request, const std::string& user_id,
+                               const std::string& room_id, http::response<http::string_body>& response) {
+    static auto& from_memory = metrics::counter("caffis_history_requests_total{source=\"memory\"}");
+    static auto& from_db = metrics::counter("caffis_history_requests_total{source=\"db\"}");
+    static auto& not_modified = metrics::counter("caffis_history_not_modified_total");
+    
+    std::string target(request.target());
+    size_t limit = static_cast<size_t>(history_settings.max_page);
+    int64_t before_seq = 0;
+    try {
+        std::string limit_param = query_param(target, "limit");
+        std::string before_param = query_param(target, "before");
+        if (!limit_param.empty()) {
+            limit = static_cast<size_t>(std::clamp(std::stoi(limit_param), 1, history_settings.max_page));
+        }
+        if (!before_param.empty()) {
+            before_seq = std::max<int64_t>(0, std::stoll(before_param));
+        }
+    } catch (const std::exception&) {
+        response.result(http::status::bad_request);
+        response.body() = "bad limit or before\n";
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(history_db_mutex);
+    if (!history_room_member(room_id, user_id)) {
+        response.result(http::status::forbidden);
+        response.body() = "not a member of this room\n";
+        return;
+    }
+    
+    response.set(http::field::cache_control, "private, no-cache");
+    response.set(http::field::content_type, "application/json");
+    
+    bool trusted = room_tail_trusted(room_id);
+    uint64_t version = 0;
+    if (trusted && hot_cache().get_room_tail_version(room_id, version)) {
+        std::string etag = tail_etag(version, limit, before_seq);
+        if (etag_matches(request, etag)) {
+            not_modified.inc();
+            response.result(http::status::not_modified);
+            response.set(http::field::etag, etag);
+            return;
+        }
+    }
+    
+    std::vector<Message> page;
+    if (trusted && hot_cache().get_room_page(room_id, limit, before_seq, page, version)) {
+        from_memory.inc();
+        response.set(http::field::etag, tail_etag(version, limit, before_seq));
+        response.body() = history_page_json(room_id, page, limit);
+        return;
+    }
+    
+    from_db.inc();
+    page = history_db->get_messages(room_id, static_cast<int>(limit), before_seq);
+    std::reverse(page.begin(), page.end());
+    if (trusted && before_seq == 0 && !hot_cache().get_room_tail_version(room_id, version)) {
+        // Seed the tail the same way a join does, so the next revalidation stays in memory
+        std::vector<Message> tail = history_db->get_room_messages(room_id, HotCache::ROOM_TAIL_CAPACITY);
+        std::reverse(tail.begin(), tail.end());
+        hot_cache().set_room_tail(room_id, tail, tail.size() < HotCache::ROOM_TAIL_CAPACITY);
+    }
+    
+    std::string body = history_page_json(room_id, page, limit);
+    std::string etag = body_etag(body);
+    response.set(http::field::etag, etag);
+    if (etag_matches(request, etag)) {
+        not_modified.inc();
+        response.result(http::status::not_modified);
+        return;
+    }
+    response.body() = std::move(body);
+}
+
+static void serve_room_list(const http::request<http::string_body>& request, const std::string& user_id,
+                            http::response<http::string_body>& response) {
+    std::vector<ChatRoom> rooms;
+    {
+        std::lock_guard<std::mutex> lock(history_db_mutex);
+        rooms = history_db->get_user_rooms(user_id);
+    }
+    
+    pt::ptree list;
+    for (const auto& room : rooms) {
+        pt::ptree entry;
+        entry.put("room_id", room.id);
+        entry.put("name", room.name);
+        entry.put("type", room.type);
+        entry.put("created_by", room.created_by);
+        if (!room.invite_id.empty()) {
+            entry.put("invite_id", room.invite_id);
+        }
+        list.push_back(std::make_pair("", entry));
+    }
+    pt::ptree body_tree;
+    body_tree.add_child("rooms", list);
+    std::ostringstream body_oss;
+    pt::write_json(body_oss, body_tree);
+    
+    std::string body = body_oss.str();
+    std::string etag = body_etag(body);
+    response.set(http::field::cache_control, "private, no-cache");
+    response.set(http::field::content_type, "application/json");
+    response.set(http::field::etag, etag);
+    if (etag_matches(request, etag)) {
+        response.result(http::status::not_modified);
+        return;
+    }
+    response.body() = std::move(body);
+}
+
+// "bytes=a-b", "bytes=a-" or "bytes=-n" against a file of `size` bytes.
+// Multi-range requests are answered with the whole file (allowed by RFC 9110).
+static bool parse_byte_range(const std::string& header, uint64_t size, uint64_t& first, uint64_t& last, bool& partial) {
+    partial = false;
+    if (header.rfind("bytes=", 0) != 0 || header.find(',') != std::string::npos) {
+        return true;
+    }
+    std::string spec = header.substr(6);
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos || size == 0) {
+        return false;
+    }
+    try {
+        if (dash == 0) {
+            uint64_t suffix = std::stoull(spec.substr(1));
+            if (suffix == 0) return false;
+            first = suffix >= size ? 0 : size - suffix;
+            last = size - 1;
+        } else {
+            first = std::stoull(spec.substr(0, dash));
+            last = dash + 1 < spec.size() ? std::min<uint64_t>(std::stoull(spec.substr(dash + 1)), size - 1) : size - 1;
+            if (first > last || first >= size) return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    partial = true;
+    return true;
+}
+
+// GET /files/<hash>: immutable attachment content. Headers go through Beast,
+// the body goes file -> socket with sendfile() and never enters user space.
+static unsigned serve_attachment(beast::tcp_stream& stream, const http::request<http::string_body>& request,
+                                 const std::string& hash) {
+    static auto& bytes_out = metrics::counter("caffis_attachment_download_bytes_total");
+    
+    auto reply = [&](http::status status, const std::string& body, const std::string& content_range = "") {
+        http::response<http::string_body> response{status, request.version()};
+        response.set(http::field::server, "caffis-chat");
+        response.set(http::field::content_type, "text/plain");
+        if (!content_range.empty()) {
+            response.set(http::field::content_range, content_range);
+        }
+        response.keep_alive(false);
+        response.body() = body;
+        response.prepare_payload();
+        http::write(stream, response);
+        return response.result_int();
+    };
+    
+    AttachmentInfo info;
+    if (!attachments().stat(hash, info)) {
+        return reply(http::status::not_found, "not found\n");
+    }
+    
+    std::string etag = "\"" + hash + "\"";
+    if (request[http::field::if_none_match] == etag) {
+        http::response<http::empty_body> response{http::status::not_modified, request.version()};
+        response.set(http::field::server, "caffis-chat");
+        response.set(http::field::etag, etag);
+        response.keep_alive(false);
+        http::write(stream, response);
+        return response.result_int();
+    }
+    
+    uint64_t first = 0, last = info.size == 0 ? 0 : info.size - 1;
+    bool partial = false;
+    if (!parse_byte_range(std::string(request[http::field::range]), info.size, first, last, partial)) {
+        return reply(http::status::range_not_satisfiable, "range not satisfiable\n",
+                     "bytes */" + std::to_string(info.size));
+    }
+    
+    int file_fd = ::open(attachments().object_path(hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_fd < 0) {
+        return reply(http::status::not_found, "not found\n");
+    }
+    uint64_t length = info.size == 0 ? 0 : last - first + 1;
+    
+    // Only raster images render inline. Anything that can carry script
+    // (SVG, HTML, XML...) is a download and runs sandboxed if opened anyway.
+    static const char* const INLINE_TYPES[] = {"image/png", "image/jpeg", "image/gif", "image/webp"};
+    bool is_inline = std::any_of(std::begin(INLINE_TYPES), std::end(INLINE_TYPES),
+                                 [&info](const char* type) { return boost::iequals(info.content_type, type); });
+    http::response<http::empty_body> response{partial ? http::status::partial_content : http::status::ok, request.version()};
+    response.set(http::field::server, "caffis-chat");
+    response.set(http::field::content_type, info.content_type);
+    response.set(http::field::content_disposition,
+                 std::string(is_inline ? "inline" : "attachment") + "; filename=\"" + info.file_name + "\"");
+    response.set("Content-Security-Policy", "sandbox; default-src 'none'");
+    response.set(http::field::accept_ranges, "bytes");
+    response.set(http::field::etag, etag);
+    response.set(http::field::cache_control, "private, max-age=31536000, immutable");
+    response.set("X-Content-Type-Options", "nosniff");
+    if (partial) {
+        response.set(http::field::content_range,
+                     "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(info.size));
+    }
+    response.content_length(length);
+    response.keep_alive(false);
+    
+    http::response_serializer<http::empty_body> serializer{response};
+    http::write_header(stream, serializer);
+    
+    // Non-blocking for the body, so a client that stops reading costs one
+    // poll timeout instead of parking this thread in sendfile()
+    beast::error_code mode_ec;
+    stream.socket().native_non_blocking(true, mode_ec);
+    int socket_fd = stream.socket().native_handle();
+    off_t offset = static_cast<off_t>(first);
+    uint64_t remaining = length;
+    while (remaining > 0) {
+        ssize_t sent = ::sendfile(socket_fd, file_fd, &offset, static_cast<size_t>(std::min<uint64_t>(remaining, 1 << 20)));
+        if (sent > 0) {
+            remaining -= static_cast<uint64_t>(sent);
+            bytes_out.inc(static_cast<uint64_t>(sent));
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && errno == EAGAIN) {
+            pollfd pfd{socket_fd, POLLOUT, 0};
+            if (::poll(&pfd, 1, 30000) <= 0) {
+                break;  // stalled client
+            }
+        } else {
+            break;  // peer went away
+        }
+    }
+    stream.socket().native_non_blocking(false, mode_ec);
+    ::close(file_fd);
+    return response.result_int();
+}
+
+// Plain HTTP on the WebSocket port: health check and admin dumps
+static void handle_http_request(beast::tcp_stream& stream, const http::request<http::string_body>& request,
+                                const std::string& client_endpoint) {
+    http::response<http::string_body> response{http::status::ok, request.version()};
+    response.set(http::field::server, "caffis-chat");
+    response.keep_alive(false);
+    
+    std::string target(request.target());
+    target = target.substr(0, target.find('?'));
+    
+    // Attachment URLs are capabilities: the SHA-256 in the path is the secret
+    if (request.method() == http::verb::get && target.rfind("/files/", 0) == 0) {
+        unsigned status = serve_attachment(stream, request, target.substr(7));
+        std::cout << "🌐 HTTP GET " << target.substr(0, 15) << "... -> " << status << " (" << client_endpoint << ")" << std::endl;
+        return;
+    }
+    
+    if (request.method() != http::verb::get) {
+        response.result(http::status::method_not_allowed);
+        response.body() = "method not allowed\n";
+    } else if (target == "/health") {
+        response.body() = "ok\n";
+    } else if (target.rfind("/api/", 0) == 0) {
+        std::string user_id;
+        const std::string rooms_prefix = "/api/rooms/";
+        const std::string messages_suffix = "/messages";
+        if (!history_db) {
+            response.result(http::status::service_unavailable);
+            response.body() = "history api disabled\n";
+        } else if (!authenticate_bearer(request, user_id)) {
+            response.result(http::status::unauthorized);
+            response.set(http::field::www_authenticate, "Bearer");
+            response.body() = "unauthorized\n";
+        } else if (target == "/api/rooms") {
+            serve_room_list(request, user_id, response);
+        } else if (target.rfind(rooms_prefix, 0) == 0 && target.size() > rooms_prefix.size() + messages_suffix.size() &&
+                   target.compare(target.size() - messages_suffix.size(), messages_suffix.size(), messages_suffix) == 0) {
+            std::string room_id = target.substr(rooms_prefix.size(),
+                                                target.size() - rooms_prefix.size() - messages_suffix.size());
+            serve_room_history(request, user_id, room_id, response);
+        } else {
+            response.result(http::status::not_found);
+            response.body() = "not found\n";
+        }
+    } else if (target.rfind("/admin/", 0) == 0 && !is_admin_request(request, client_endpoint)) {
+        response.result(http::status::forbidden);
+        response.body() = "forbidden\n";
+    } else if (target == "/admin/metrics") {
+        publish_memory_gauges(collect_memory_usage());
+        response.set(http::field::content_type, "text/plain; version=0.0.4");
+        response.body() = metrics::render() + room_stats().render_metrics();
+    } else if (target == "/admin/trace") {
+        response.set(http::field::content_type, "application/json");
+        response.set(http::field::content_disposition, "attachment; filename=\"caffis-trace.json\"");
+        response.body() = trace::export_chrome_json();
+    } else if (target == "/admin/memory") {
+        MemoryUsage usage = collect_memory_usage();
+        publish_memory_gauges(usage);
+        response.set(http::field::content_type, "application/json");
+        response.body() = memory_report_json(usage);
+    } else {
+        response.result(http::status::not_found);
+        response.body() = "not found\n";
+    }
+    
+    if (response.find(http::field::content_type) == response.end()) {
+        response.set(http::field::content_type, "text/plain");
+    }
+    response.prepare_payload();
+    http::write(stream, response);
+    
+    std::cout << "🌐 HTTP " << request.method_string() << " " << target << " -> " 
+              << response.result_int() << " (" << client_endpoint << ")" << std::endl;
+}
+
+// ================================================
+// CLUSTER FAN-OUT
+// ================================================
+void init_cluster_transport(const config::ClusterConfig& cluster_config) {
+    if (cluster_config.transport.empty() || cluster_config.transport == "none") {
+        std::cout << "🛰️ Cluster transport: disabled (single node)" << std::endl;
+        return;
+    }
+    
+    if (cluster_config.transport != "pg_notify") {
+        std::cerr << "⚠️ Unknown cluster transport '" << cluster_config.transport << "' - running single node" << std::endl;
+        return;
+    }
+    
+    if (!db_manager) {
+        std::cerr << "⚠️ Cluster transport requires the chat database - running single node" << std::endl;
+        return;
+    }
+    
+    // Reuse the chat database connection string for the LISTEN connection
+    cluster_transport = std::make_unique<PgNotifyTransport>(db_manager->get_connection_string(),
+                                                            cluster_config.node_id);
+    db_manager->enable_cluster_notify(cluster_config.node_id);
+    
+    cluster_transport->start(
+        [](const Message& msg, const std::string& sender_name) {
+            broadcast_chat_message(msg, sender_name);
+            hot_cache().append_message(msg);
+        },
+        [](const std::string& user_id, const std::string& frame) {
+            deliver_to_local_user(user_id, frame);
+        },
+        [](const std::string& room_id, const std::string& author_id, const std::string& frame) {
+            try {
+                apply_delta_to_cache(room_id, frame);
+            } catch (const std::exception& e) {
+                // Unparseable: the cached copy can't be trusted any more
+                std::cerr << "⚠️ Bad room frame from cluster: " << e.what() << std::endl;
+                hot_cache().drop_room_tail(room_id);
+            }
+            broadcast_to_room(room_id, frame, "", Lane::CHAT, 0, author_id);
+        });
+}
+
+// Sender display name, served from the user cache when possible
+static std::string lookup_sender_name(const std::string& user_id) {
+    CachedUser cached;
+    if (hot_cache().get_user(user_id, cached)) {
+        return cached.name();
+    }
+    
+    if (db_manager && db_manager->get_user(user_id, cached.username, cached.display_name)) {
+        hot_cache().put_user(user_id, cached);
+    }
+    return cached.name();
+}
+
+// Caller holds sessions_mutex
+static void leave_current_room(const std::shared_ptr<ClientSession>& session) {
+    if (cluster_transport && session->room != NO_ID) {
+        cluster_transport->unsubscribe_room(session->room_id());
+    }
+    index_session_room(session, NO_ID);
+}
+
+// ================================================
+// ATTACHMENT UPLOADS
+// ================================================
+static void send_upload_frame(const std::shared_ptr<ClientSession>& session, const std::string& type,
+                              const std::string& upload_id, const std::string& error = "", uint64_t offset = 0) {
+    pt::ptree frame;
+    frame.put("type", type);
+    frame.put("upload_id", upload_id);
+    if (!error.empty()) {
+        frame.put("error", error);
+    } else {
+        frame.put("offset", offset);
+    }
+    std::ostringstream frame_oss;
+    pt::write_json(frame_oss, frame);
+    send_frame(session, frame_oss.str());
+}
+
+// Binary frames carry chunks of the session's current upload, written from
+// the read buffer straight to the staging file
+static void handle_upload_chunk(const std::shared_ptr<ClientSession>& session, const void* data, size_t size) {
+    auto& upload = session->cold->upload;
+    if (!session->is_authenticated || !upload) {
+        send_upload_frame(session, "upload_error", "", "No upload in progress");
+        return;
+    }
+    
+    std::string error;
+    if (!attachments().append(*upload, data, size, error)) {
+        // The staging file keeps what was written; upload_begin again to resume
+        send_upload_frame(session, "upload_error", upload->upload_id, error);
+        upload.reset();
+        return;
+    }
+    if (upload->offset < upload->expected_size) {
+        send_upload_frame(session, "upload_progress", upload->upload_id, "", upload->offset);
+        return;
+    }
+    
+    AttachmentInfo info;
+    if (!attachments().finish(*upload, info, error)) {
+        send_upload_frame(session, "upload_error", upload->upload_id, error);
+        upload.reset();
+        return;
+    }
+    
+    pt::ptree complete;
+    complete.put("type", "upload_complete");
+    complete.put("upload_id", upload->upload_id);
+    complete.put("hash", info.hash);
+    complete.put("file_size", info.size);
+    complete.put("file_name", info.file_name);
+    complete.put("file_type", info.content_type);
+    complete.put("url", "/files/" + info.hash);
+    
+    std::ostringstream complete_oss;
+    pt::write_json(complete_oss, complete);
+    send_frame(session, complete_oss.str());
+    
+    std::cout << "📎 Upload stored: " << info.hash.substr(0, 12) << "... (" << info.size << " bytes) by "
+              << session->cold->username << std::endl;
+    upload.reset();
+}
+
+// ================================================
+// MESSAGE PROCESSING
+// ================================================
+void handle_message(std::shared_ptr<ClientSession> session, const std::string& raw_message) {
+    try {
+        std::istringstream iss(raw_message);
+        pt::ptree message_json;
+        {
+            trace::Span span("parse");
+            pt::read_json(iss, message_json);
+        }
+        
+        std::string type = message_json.get<std::string>("type", "");
+        
+        if (type == "auth") {
+            std::string token = message_json.get<std::string>("token", "");
+            
+            if (token.empty()) {
+                send_frame(session, R"({"type":"auth_error","error":"Token required"})");
+                return;
+            }
+            
+            std::string user_id, username;
+            bool verified;
+            {
+                trace::Span span("auth.verify");
+                verified = verify_jwt_token(token, user_id, username);
+            }
+            if (verified) {
+                session->user = interned_ids().intern(user_id);
+                session->cold->username = username;
+                session->is_authenticated = true;
+                session->last_activity = std::chrono::system_clock::now();
+                
+                // Get full user details
+                UserDetails user_details = get_user_details_from_main_db(user_id);
+                if (user_details.found) {
+                    session->cold->display_name = user_details.firstName + " " + user_details.lastName;
+                }
+                hot_cache().put_user(user_id, CachedUser{username, session->cold->display_name});
+                
+                // Blocked/muted senders, checked on every fan-out from here on
+                size_t filtered_count = refresh_sender_filters(user_id);
+                if (filtered_count > 0) {
+                    std::cout << "🚫 " << filtered_count << " blocked/muted senders loaded for " << username << std::endl;
+                }
+                
+                // Send success response
+                pt::ptree response;
+                response.put("type", "auth_success");
+                response.put("user_id", user_id);
+                response.put("username", username);
+                response.put("display_name", session->cold->display_name);
+                
+                std::ostringstream response_oss;
+                pt::write_json(response_oss, response);
+                
+                send_frame(session, response_oss.str());
+                
+                std::cout << "🔐 User authenticated: " << username << std::endl;
+                
+                // ================================================
+                // AUTO-CREATE DEFAULT ROOM AND AUTO-JOIN USER
+                // ================================================
+                if (db_manager) {
+                    try {
+                        // Ensure user is in default room (creates room if needed)
+                        bool auto_room_success = db_manager->ensure_user_in_default_room(session->user_id(), session->cold->username);
+                        
+                        if (auto_room_success) {
+                            std::cout << "✅ User " << session->cold->username << " auto-added to default room" << std::endl;
+                            
+                            // Send available rooms to user
+                            std::vector<ChatRoom> user_rooms = db_manager->get_user_rooms(session->user_id());
+                            
+                            pt::ptree rooms_response;
+                            rooms_response.put("type", "rooms_list");
+                            
+                            pt::ptree rooms_array;
+                            session->cold->rooms.clear();
+                            for (const auto& room : user_rooms) {
+                                session->cold->rooms.push_back(interned_ids().intern(room.id));
+                                pt::ptree room_obj;
+                                room_obj.put("id", room.id);
+                                room_obj.put("name", room.name);
+                                room_obj.put("type", room.type);
+                                room_obj.put("isOnline", true);
+                                rooms_array.push_back(std::make_pair("", room_obj));
+                            }
+                            
+                            rooms_response.add_child("rooms", rooms_array);
+                            
+                            std::ostringstream rooms_oss;
+                            pt::write_json(rooms_oss, rooms_response);
+                            
+                            send_frame(session, rooms_oss.str());
+                            
+                            std::cout << "📋 Sent " << user_rooms.size() << " available rooms to " << session->cold->username << std::endl;
+                        }
+                        
+                    } catch (const std::exception& e) {
+                        std::cerr << "❌ Auto-room setup failed: " << e.what() << std::endl;
+                    }
+                }
+                
+            } else {
+                send_frame(session, R"({"type":"auth_error","error":"Invalid token"})");
+            }
+            
+        } else if (type == "message") {
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string roomId = message_json.get<std::string>("roomId", "");
+            std::string content = message_json.get<std::string>("content", "");
+            std::string timestamp = message_json.get<std::string>("timestamp", "");
+            std::string attachment_hash = message_json.get<std::string>("attachment", "");
+            auto location = message_json.get_child_optional("location");
+            
+            if (roomId.empty() || (content.empty() && attachment_hash.empty() && !location)) {
+                send_frame(session, R"({"type":"error","error":"Room ID and content required"})");
+                return;
+            }
+            
+            // Shared places: {"location":{"lat":..,"lon":..}}, content is an optional label
+            double latitude = 0, longitude = 0;
+            if (location) {
+                latitude = location->get<double>("lat", 1000);
+                longitude = location->get<double>("lon", 1000);
+                if (!GeoIndex::valid_coordinates(latitude, longitude)) {
+                    send_frame(session, R"({"type":"error","error":"Invalid location"})");
+                    return;
+                }
+            }
+            
+            // Only active participants post (and so notify the room's members)
+            if (db_manager && !hot_cache().is_room_member(roomId, session->user_id())) {
+                if (!db_manager->is_active_participant(roomId, session->user_id())) {
+                    send_frame(session, R"({"type":"error","error":"Access denied to room"})");
+                    return;
+                }
+                hot_cache().add_room_member(roomId, session->user_id());
+            }
+            
+            // Attachments travel as a content hash from a finished upload
+            AttachmentInfo attachment;
+            if (!attachment_hash.empty() && !attachments().stat(attachment_hash, attachment)) {
+                send_frame(session, R"({"type":"error","error":"Unknown attachment"})");
+                return;
+            }
+            
+            // Generate message ID and timestamp
+            Message msg;
+            msg.id = DatabaseManager::generate_uuid();
+            msg.room_id = roomId;
+            msg.sender_id = session->user_id();
+            msg.content = content;
+            msg.type = MessageType::TEXT;
+            if (!attachment.hash.empty()) {
+                msg.type = attachment.content_type.rfind("image/", 0) == 0 ? MessageType::IMAGE : MessageType::FILE;
+                msg.file_url = "/files/" + attachment.hash;
+                msg.file_name = attachment.file_name;
+                msg.file_size = attachment.size;
+                msg.file_type = attachment.content_type;
+            } else if (location) {
+                char coordinates[96];
+                std::snprintf(coordinates, sizeof(coordinates), R"({"lat":%.7f,"lon":%.7f})", latitude, longitude);
+                msg.type = MessageType::LOCATION;
+                msg.metadata = coordinates;
+            }
+            msg.timestamp = std::chrono::system_clock::now();
+            msg.is_edited = false;
+            msg.is_deleted = false;
+            
+            std::string sender_name = session->cold->display_name.empty() ? session->cold->username : session->cold->display_name;
+            
+            std::cout << "💬 Message from " << session->cold->username << ": " << content << std::endl;
+            
+            // Broadcast to ALL users in room (including sender for confirmation)
+            {
+                trace::Span span("message.broadcast");
+                broadcast_chat_message(msg, sender_name);
+            }
+            hot_cache().append_message(msg);
+            room_stats().record_message(interned_ids().find(msg.room_id));
+            
+            if (cluster_transport) {
+                trace::Span span("message.publish");
+                cluster_transport->publish(msg, sender_name);
+            }
+            
+            // Save to database
+            if (db_manager) {
+                trace::Span span("message.persist");
+                try {
+                    std::string saved_id = db_manager->save_message(msg);
+                    if (!saved_id.empty()) {
+                        std::cout << "💾 Message saved: " << saved_id << std::endl;
+                        // Pages can start from the hot tail only once its messages have their seq
+                        hot_cache().set_seq(msg.room_id, msg.id, msg.seq);
+                        // Offline members are only told about messages that exist
+                        if (notification_queue) {
+                            notification_queue->enqueue(msg, sender_name);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "❌ Database save failed: " << e.what() << std::endl;
+                }
+            }
+            
+        } else if (type == "join_room") {
+            trace::TraceScope join_trace("join");
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string room_id = message_json.get<std::string>("room_id", "");
+            
+            if (room_id.empty()) {
+                send_frame(session, R"({"type":"error","error":"Room ID required"})");
+                return;
+            }
+            // Room ids are interned, indexed and LISTENed on: only real ones get that far
+            Uuid128 room_uuid;
+            if (!Uuid128::parse(room_id, room_uuid)) {
+                send_frame(session, R"({"type":"error","error":"Invalid room ID"})");
+                return;
+            }
+            room_id = room_uuid.to_string();
+            
+            std::cout << "🏠 User " << session->cold->username << " joining room: " << room_id << std::endl;
+            
+            // Check if user can join this room (is participant)
+            if (db_manager) {
+                try {
+                    bool can_join;
+                    {
+                        trace::Span span("join.access");
+                        can_join = db_manager->can_user_join_room(session->user_id(), room_id);
                     }
                     
-                    // Set user's current room
-                    session->room_id = room_id;
+                    if (!can_join) {
+                        send_frame(session, R"({"type":"error","error":"Access denied to room"})");
+                        return;
+                    }
+                    
+                    // Add user as participant if not already (fails for a room that doesn't exist)
+                    std::string user_id = session->user_id();
+                    if (!hot_cache().is_room_member(room_id, user_id)) {
+                        trace::Span span("join.add_participant");
+                        if (!db_manager->add_participant(room_id, user_id, "member")) {
+                            send_frame(session, R"({"type":"error","error":"Room not found"})");
+                            return;
+                        }
+                        hot_cache().add_room_member(room_id, user_id);
+                    }
                     
-                    // Add user as participant if not already
-                    db_manager->add_participant(room_id, session->user_id, "member");
+                    // Set user's current room
+                    IdHandle room = interned_ids().intern(room_id);
+                    auto& member_rooms = session->cold->rooms;
+                    if (std::find(member_rooms.begin(), member_rooms.end(), room) == member_rooms.end()) {
+                        member_rooms.push_back(room);
+                    }
+                    if (session->room != room) {
+                        IdHandle previous_room;
+                        {
+                            std::lock_guard<std::mutex> lock(sessions_mutex);
+                            previous_room = session->room;
+                            index_session_room(session, room);
+                        }
+                        if (cluster_transport) {
+                            if (previous_room != NO_ID) {
+                                cluster_transport->unsubscribe_room(interned_ids().to_string(previous_room));
+                            }
+                            cluster_transport->subscribe_room(room_id);
+                        }
+                    }
                     
                     // Send success response FIRST
                     pt::ptree join_response;
@@ -596,49 +2868,47 @@ void handle_message(std::shared_ptr<ClientSession> session, const std::string& r
                     std::ostringstream join_oss;
                     pt::write_json(join_oss, join_response);
 
-                    session->ws->text(true);
-                    session->ws->write(net::buffer(join_oss.str()));
+                    send_frame(session, join_oss.str());
 
-                    std::cout << "✅ User " << session->username << " joined room: " << room_id << std::endl;
+                    std::cout << "✅ User " << session->cold->username << " joined room: " << room_id << std::endl;
 
                     // Load and send message history (FIXED - separate transaction)
                     try {
-                        std::vector<Message> messages = db_manager->get_room_messages(room_id, 20);
+                        trace::Span span("join.history");
+                        const size_t history_limit = 20;
+                        std::vector<Message> messages;
                         
-                        // Send messages in chronological order (oldest first)  
-                        std::reverse(messages.begin(), messages.end());
-                        
-                        for (const auto& msg : messages) {
-                            // Get sender details
-                            std::string sender_username, sender_display_name;
-                            db_manager->get_user(msg.sender_id, sender_username, sender_display_name);
-                            
-                            pt::ptree history_msg;
-                            history_msg.put("type", "new_message");
-                            history_msg.put("message_id", msg.id);
-                            history_msg.put("room_id", msg.room_id);
-                            history_msg.put("sender_id", msg.sender_id);
-                            history_msg.put("sender_name", sender_display_name.empty() ? sender_username : sender_display_name);
-                            history_msg.put("content", msg.content);
-                            
-                            // Convert timestamp
-                            auto duration = msg.timestamp.time_since_epoch();
-                            auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-                            history_msg.put("timestamp", std::to_string(millis));
-                            history_msg.put("message_type", "text");
+                        if (!hot_cache().get_room_tail(room_id, history_limit, messages)) {
+                            messages = db_manager->get_room_messages(room_id, HotCache::ROOM_TAIL_CAPACITY);
                             
-                            std::ostringstream history_oss;
-                            pt::write_json(history_oss, history_msg);
+                            // Send messages in chronological order (oldest first)  
+                            std::reverse(messages.begin(), messages.end());
+                            hot_cache().set_room_tail(room_id, messages, messages.size() < HotCache::ROOM_TAIL_CAPACITY);
                             
-                            session->ws->text(true);
-                            session->ws->write(net::buffer(history_oss.str()));
-                            
-                            // Small delay for message ordering
-                            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                            if (messages.size() > history_limit) {
+                                messages.erase(messages.begin(), messages.end() - history_limit);
+                            }
+                        }
+                        
+                        std::vector<IdHandle> filtered_senders;
+                        {
+                            std::lock_guard<std::mutex> lock(sessions_mutex);
+                            filtered_senders = session->cold->filtered_senders;
+                        }
+                        
+                        // The queue keeps frames in order; corked, the replay leaves as one gathered write
+                        OutboundQueue::Cork cork(*session->outbound);
+                        for (const auto& msg : messages) {
+                            if (!filtered_senders.empty() &&
+                                std::binary_search(filtered_senders.begin(), filtered_senders.end(),
+                                                   interned_ids().find(msg.sender_id))) {
+                                continue;
+                            }
+                            send_frame(session, build_message_frame(msg, lookup_sender_name(msg.sender_id)), Lane::CHAT);
                         }
                         
                         if (messages.size() > 0) {
-                            std::cout << "📜 Sent " << messages.size() << " historical messages to " << session->username << std::endl;
+                            std::cout << "📜 Sent " << messages.size() << " historical messages to " << session->cold->username << std::endl;
                         }
                     } catch (const std::exception& e) {
                         std::cerr << "❌ Message history error: " << e.what() << std::endl;
@@ -646,14 +2916,343 @@ void handle_message(std::shared_ptr<ClientSession> session, const std::string& r
                     
                 } catch (const std::exception& e) {
                     std::cerr << "❌ Join room error: " << e.what() << std::endl;
-                    session->ws->text(true);
-                    session->ws->write(net::buffer(R"({"type":"error","error":"Failed to join room"})"));
+                    send_frame(session, R"({"type":"error","error":"Failed to join room"})");
                 }
             } else {
-                session->ws->text(true);
-                session->ws->write(net::buffer(R"({"type":"error","error":"Database not available"})"));
+                send_frame(session, R"({"type":"error","error":"Database not available"})");
+            }
+            
+        } else if (type == "edit_message" || type == "delete_message") {
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string message_id = message_json.get<std::string>("message_id", "");
+            std::string content = message_json.get<std::string>("content", "");
+            bool is_edit = type == "edit_message";
+            
+            if (message_id.empty() || (is_edit && content.empty())) {
+                send_frame(session, R"({"type":"error","error":"Message ID and content required"})");
+                return;
+            }
+            if (!db_manager) {
+                send_frame(session, R"({"type":"error","error":"Database not available"})");
+                return;
+            }
+            
+            // The UPDATE checks sender / moderator rights and hands back the room and sender
+            std::string room_id;
+            std::string author_id;
+            int64_t edited_at_ms = 0;
+            bool applied = is_edit
+                ? db_manager->edit_message(message_id, content, session->user_id(), room_id, author_id, edited_at_ms)
+                : db_manager->delete_message(message_id, session->user_id(), room_id, author_id);
+            if (!applied) {
+                send_frame(session, R"({"type":"error","error":"Message not found or not allowed"})");
+                return;
+            }
+            
+            std::string frame = is_edit
+                ? build_message_updated_frame(message_id, room_id, content, edited_at_ms)
+                : build_message_deleted_frame(message_id, room_id);
+            
+            if (is_edit) {
+                hot_cache().edit_cached_message(room_id, message_id, content);
+            } else {
+                hot_cache().remove_cached_message(room_id, message_id);
+            }
+            
+            std::cout << (is_edit ? "✏️ Message edited: " : "🗑️ Message deleted: ") << message_id
+                      << " by " << session->cold->username << std::endl;
+            
+            // Same lane as chat so a delta never overtakes the message it patches.
+            // Filtered like the message itself: whoever blocked its sender never saw it.
+            broadcast_to_room(room_id, frame, "", Lane::CHAT, 0, author_id);
+            if (cluster_transport) {
+                cluster_transport->publish_room_frame(room_id, author_id, frame,
+                    is_edit ? build_message_refetch_frame(message_id, room_id, edited_at_ms) : "");
+            }
+            
+        } else if (type == "block_user" || type == "unblock_user" || type == "mute_user" || type == "unmute_user") {
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string target_user_id = message_json.get<std::string>("target_user_id", "");
+            if (target_user_id.empty() || target_user_id == session->user_id()) {
+                send_frame(session, R"({"type":"error","error":"Valid target user ID required"})");
+                return;
+            }
+            if (!db_manager) {
+                send_frame(session, R"({"type":"error","error":"Database not available"})");
+                return;
+            }
+            
+            bool is_block = type == "block_user" || type == "unblock_user";
+            bool active = type == "block_user" || type == "mute_user";
+            bool updated = is_block
+                ? (active ? db_manager->block_user(session->user_id(), target_user_id)
+                          : db_manager->unblock_user(session->user_id(), target_user_id))
+                : (active ? db_manager->mute_user(session->user_id(), target_user_id)
+                          : db_manager->unmute_user(session->user_id(), target_user_id));
+            if (!updated) {
+                send_frame(session, R"({"type":"error","error":"Failed to update user relationship"})");
+                return;
+            }
+            
+            // Reloaded rather than patched: a user can be both blocked and muted
+            refresh_sender_filters(session->user_id());
+            
+            pt::ptree response;
+            response.put("type", "relationship_updated");
+            response.put("target_user_id", target_user_id);
+            response.put("relationship", is_block ? "blocked" : "muted");
+            response.put("active", active);
+            
+            std::ostringstream response_oss;
+            pt::write_json(response_oss, response);
+            send_frame(session, response_oss.str());
+            
+        } else if (type == "search") {
+            static auto& latency = metrics::histogram("caffis_search_latency_us");
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string query = message_json.get<std::string>("query", "");
+            std::string room_id = message_json.get<std::string>("room_id", "");
+            size_t limit = static_cast<size_t>(std::min(50, std::max(1, message_json.get<int>("limit", 20))));
+            
+            if (query.empty()) {
+                send_frame(session, R"({"type":"error","error":"Search query required"})");
+                return;
+            }
+            if (!search_db) {
+                send_frame(session, R"({"type":"error","error":"Search not available"})");
+                return;
+            }
+            
+            // Only rooms the user belongs to; optionally narrowed to one of them
+            std::vector<IdHandle> scope = session->cold->rooms;
+            if (!room_id.empty()) {
+                IdHandle room = interned_ids().find(room_id);
+                if (room == NO_ID || std::find(scope.begin(), scope.end(), room) == scope.end()) {
+                    send_frame(session, R"({"type":"error","error":"Access denied to room"})");
+                    return;
+                }
+                scope.assign(1, room);
+            }
+            
+            // Blocked and muted senders are left out of results like out of fan-out
+            std::vector<IdHandle> excluded_senders;
+            {
+                std::lock_guard<std::mutex> lock(sessions_mutex);
+                excluded_senders = session->cold->filtered_senders;
+            }
+            
+            auto search_begin = std::chrono::steady_clock::now();
+            std::vector<SearchHit> hits = search_index().search(scope, query, limit, excluded_senders);
+            auto took_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - search_begin).count();
+            latency.observe(static_cast<uint64_t>(took_us));
+            
+            // Bodies come from the search connection (replica when configured), by primary key
+            std::vector<std::string> hit_ids;
+            for (const auto& hit : hits) {
+                hit_ids.push_back(hit.message_id);
+            }
+            std::unordered_map<std::string, Message> bodies;
+            {
+                std::lock_guard<std::mutex> lock(search_db_mutex);
+                for (auto& msg : search_db->get_messages_by_ids(hit_ids)) {
+                    bodies.emplace(msg.id, std::move(msg));
+                }
+            }
+            
+            pt::ptree results;
+            for (const auto& hit : hits) {
+                auto body = bodies.find(hit.message_id);
+                if (body == bodies.end()) {
+                    continue;  // deleted since it was indexed
+                }
+                const Message& msg = body->second;
+                pt::ptree result;
+                result.put("message_id", msg.id);
+                result.put("room_id", msg.room_id);
+                result.put("sender_id", msg.sender_id);
+                result.put("sender_name", lookup_sender_name(msg.sender_id));
+                result.put("content", msg.content);
+                result.put("timestamp", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    msg.timestamp.time_since_epoch()).count()));
+                result.put("score", hit.score);
+                results.push_back(std::make_pair("", result));
+            }
+            
+            pt::ptree response;
+            response.put("type", "search_results");
+            response.put("query", query);
+            response.put("took_us", took_us);
+            response.add_child("results", results);
+            
+            std::ostringstream response_oss;
+            pt::write_json(response_oss, response);
+            send_frame(session, response_oss.str(), Lane::CHAT);
+            
+        } else if (type == "set_room_location") {
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            std::string room_id = message_json.get<std::string>("room_id", "");
+            double latitude = message_json.get<double>("lat", 1000);
+            double longitude = message_json.get<double>("lon", 1000);
+            if (room_id.empty() || !GeoIndex::valid_coordinates(latitude, longitude)) {
+                send_frame(session, R"({"type":"error","error":"Room ID and valid lat/lon required"})");
+                return;
+            }
+            
+            std::string room_name;
+            if (!db_manager || !db_manager->set_room_location(room_id, session->user_id(), latitude, longitude, room_name)) {
+                send_frame(session, R"({"type":"error","error":"Cannot place this room"})");
+                return;
+            }
+            // Visible here right away; other nodes pick it up from the feed
+            geo_index().upsert(room_id, room_name, latitude, longitude);
+            
+            pt::ptree response;
+            response.put("type", "room_location_updated");
+            response.put("room_id", room_id);
+            response.put("latitude", latitude);
+            response.put("longitude", longitude);
+            
+            std::ostringstream response_oss;
+            pt::write_json(response_oss, response);
+            send_frame(session, response_oss.str());
+            
+        } else if (type == "nearby_rooms") {
+            static auto& latency = metrics::histogram("caffis_geo_query_latency_us");
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            double latitude = message_json.get<double>("lat", 1000);
+            double longitude = message_json.get<double>("lon", 1000);
+            double radius_km = std::min(GeoIndex::MAX_RADIUS_KM, std::max(0.1, message_json.get<double>("radius_km", 5)));
+            size_t limit = static_cast<size_t>(std::min(100, std::max(1, message_json.get<int>("limit", 20))));
+            if (!GeoIndex::valid_coordinates(latitude, longitude)) {
+                send_frame(session, R"({"type":"error","error":"Valid lat/lon required"})");
+                return;
+            }
+            
+            auto query_begin = std::chrono::steady_clock::now();
+            std::vector<NearbyRoom> nearby = geo_index().nearby(latitude, longitude, radius_km, limit);
+            auto took_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - query_begin).count();
+            latency.observe(static_cast<uint64_t>(took_us));
+            
+            pt::ptree rooms;
+            for (const auto& room : nearby) {
+                pt::ptree entry;
+                entry.put("room_id", room.room_id);
+                entry.put("name", room.name);
+                entry.put("latitude", room.latitude);
+                entry.put("longitude", room.longitude);
+                entry.put("distance_km", room.distance_km);
+                rooms.push_back(std::make_pair("", entry));
+            }
+            
+            pt::ptree response;
+            response.put("type", "nearby_rooms");
+            response.put("radius_km", radius_km);
+            response.put("took_us", took_us);
+            response.add_child("rooms", rooms);
+            
+            std::ostringstream response_oss;
+            pt::write_json(response_oss, response);
+            send_frame(session, response_oss.str(), Lane::CHAT);
+            
+        } else if (type == "upload_begin") {
+            if (!session->is_authenticated) {
+                send_frame(session, R"({"type":"error","error":"Authentication required"})");
+                return;
+            }
+            
+            // Reusing an upload_id after a disconnect resumes from the stored offset
+            std::string upload_id = message_json.get<std::string>("upload_id", "");
+            if (upload_id.empty()) {
+                upload_id = DatabaseManager::generate_uuid();
+            }
+            
+            auto upload = std::make_unique<AttachmentUpload>();
+            std::string error;
+            if (!attachments().begin_upload(session->user_id(), upload_id,
+                                            message_json.get<uint64_t>("file_size", 0),
+                                            message_json.get<std::string>("file_name", ""),
+                                            message_json.get<std::string>("file_type", ""),
+                                            *upload, error)) {
+                send_upload_frame(session, "upload_error", upload_id, error);
+                return;
+            }
+            
+            uint64_t offset = upload->offset;
+            session->cold->upload = std::move(upload);
+            send_upload_frame(session, "upload_ready", upload_id, "", offset);
+            
+        } else if (type == "upload_cancel") {
+            if (session->cold->upload) {
+                attachments().cancel(*session->cold->upload);
+                session->cold->upload.reset();
+            }
+            
+        } else if (type == "delivered") {
+            // {"room_id":..,"message_ids":[..]}: batched, in the order the frames arrived
+            std::string room_id = message_json.get<std::string>("room_id", "");
+            IdHandle room = interned_ids().find(room_id);
+            auto ids = message_json.get_child_optional("message_ids");
+            if (!session->is_authenticated || room == NO_ID || session->room != room || !ids) {
+                return;
+            }
+            
+            std::vector<std::string> message_ids;
+            for (const auto& id : *ids) {
+                if (message_ids.size() >= 256) {
+                    break;
+                }
+                message_ids.push_back(id.second.get_value<std::string>());
+            }
+            delivery_tracker().acknowledge(room, session->user, message_ids);
+            
+        } else if (type == "typing") {
+            // Ephemeral: never persisted, coalesced per (room, user) in each recipient's queue
+            static auto& typing_sampled_out = metrics::counter("caffis_typing_sampled_out_total");
+            std::string room_id = message_json.get<std::string>("room_id", "");
+            IdHandle room = interned_ids().find(room_id);
+            if (!session->is_authenticated || room == NO_ID || session->room != room) {
+                return;
+            }
+            
+            pt::ptree typing;
+            typing.put("type", "typing");
+            typing.put("room_id", room_id);
+            typing.put("user_id", session->user_id());
+            typing.put("user_name", session->cold->display_name.empty() ? session->cold->username : session->cold->display_name);
+            bool is_typing = message_json.get<bool>("is_typing", true);
+            typing.put("is_typing", is_typing);
+            if (!hot_rooms().sample_typing(room, session->user, is_typing)) {
+                typing_sampled_out.inc();
+                return;
             }
             
+            std::ostringstream typing_oss;
+            pt::write_json(typing_oss, typing);
+            broadcast_to_room(room_id, typing_oss.str(), session->user_id(), Lane::EPHEMERAL,
+                              ephemeral_key(room, session->user), session->user_id());
+            
         } else {
             std::cerr << "❓ Unknown message type: " << type << std::endl;
         }
@@ -669,8 +3268,7 @@ void handle_message(std::shared_ptr<ClientSession> session, const std::string& r
         pt::write_json(error_oss, error_response);
         
         try {
-            session->ws->text(true);
-            session->ws->write(net::buffer(error_oss.str()));
+            send_frame(session, error_oss.str());
         } catch (const std::exception& send_error) {
             std::cerr << "❌ Failed to send error response" << std::endl;
         }
@@ -695,38 +3293,101 @@ void WebSocketServer::start() {
     std::cout << "✅ Starting production WebSocket server on port " << port_ << std::endl;
     
     try {
-        tcp::acceptor acceptor{io_context_, {tcp::v4(), static_cast<unsigned short>(port_)}};
+        const int shards = placement::acceptor_shards();
+        const tcp::endpoint endpoint{tcp::v4(), static_cast<unsigned short>(port_)};
+        
+        // With several shards each listener gets its own SO_REUSEPORT socket and the
+        // kernel spreads incoming connections across them
+        for (int shard = 0; shard < shards; ++shard) {
+            auto acceptor = std::make_unique<tcp::acceptor>(io_context_);
+            acceptor->open(endpoint.protocol());
+            acceptor->set_option(net::socket_base::reuse_address(true));
+            if (shards > 1) {
+                acceptor->set_option(net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+            }
+            acceptor->bind(endpoint);
+            acceptor->listen(net::socket_base::max_listen_connections);
+            acceptors_.push_back(std::move(acceptor));
+        }
         
-        std::cout << "🔗 Server ready for connections..." << std::endl;
+        std::cout << "🔗 Server ready for connections (" << shards << " acceptor shard(s))..." << std::endl;
         std::cout << "📡 Real-time messaging enabled!" << std::endl;
         
-        for (;;) {
-            tcp::socket socket{io_context_};
-            acceptor.accept(socket);
-            
-            std::string client_endpoint = socket.remote_endpoint().address().to_string();
-            std::cout << "📱 New connection from: " << client_endpoint << std::endl;
-            
-            std::thread([this, socket = std::move(socket), client_endpoint]() mutable {
-                handle_session(beast::tcp_stream(std::move(socket)), client_endpoint);
-            }).detach();
+        for (int shard = 1; shard < shards; ++shard) {
+            thread_pool_.emplace_back([this, shard]() {
+                try {
+                    accept_loop(static_cast<size_t>(shard));
+                } catch (const std::exception& e) {
+                    if (!stopping_) {
+                        std::cerr << "❌ Acceptor shard " << shard << " stopped: " << e.what() << std::endl;
+                    }
+                }
+            });
         }
+        accept_loop(0);
         
     } catch (const std::exception& e) {
+        if (stopping_) {
+            return;
+        }
         std::cerr << "❌ Server startup error: " << e.what() << std::endl;
         throw;
     }
 }
 
+void WebSocketServer::accept_loop(size_t shard) {
+    tcp::acceptor& acceptor = *acceptors_[shard];
+    const int node = placement::node_for_shard(static_cast<int>(shard));
+    placement::place_current_thread(node);
+    
+    while (!stopping_) {
+        tcp::socket socket{io_context_};
+        acceptor.accept(socket);
+        
+        std::string client_endpoint = socket.remote_endpoint().address().to_string();
+        std::cout << "📱 New connection from: " << client_endpoint << std::endl;
+        
+        // Sessions stay on their shard's NUMA node
+        {
+            std::lock_guard<std::mutex> lock(session_threads_mutex_);
+            session_threads_++;
+        }
+        std::thread([this, node, socket = std::move(socket), client_endpoint]() mutable {
+            placement::place_current_thread(node);
+            try {
+                handle_session(beast::tcp_stream(std::move(socket)), client_endpoint);
+            } catch (...) {
+                std::cerr << "❌ Session thread ended with a non-standard exception" << std::endl;
+            }
+            std::lock_guard<std::mutex> lock(session_threads_mutex_);
+            if (--session_threads_ == 0) {
+                session_threads_cv_.notify_all();
+            }
+        }).detach();
+    }
+}
+
 void WebSocketServer::stop() {
     std::cout << "🛑 Stopping WebSocket server..." << std::endl;
+    stopping_ = true;
+    
+    {
+        std::lock_guard<std::mutex> lock(maintenance_mutex_);
+        maintenance_cv_.notify_all();
+    }
+    if (maintenance_thread_.joinable()) {
+        maintenance_thread_.join();
+    }
     
     {
         std::lock_guard<std::mutex> lock(sessions_mutex);
         for (auto& [session_id, session] : active_sessions) {
+            if (session->outbound) {
+                session->outbound->shutdown();
+            }
             if (session->ws && session->ws->is_open()) {
                 if (db_manager && session->is_authenticated) {
-                    db_manager->update_user_status(session->user_id, false);
+                    db_manager->update_user_status(session->user_id(), false);
                 }
                 session->ws->close(websocket::close_code::going_away);
             }
@@ -734,6 +3395,51 @@ void WebSocketServer::stop() {
         active_sessions.clear();
     }
     
+    // Session threads still touch the caches and background queues on their way out
+    {
+        std::unique_lock<std::mutex> lock(session_threads_mutex_);
+        if (!session_threads_cv_.wait_for(lock, SESSION_DRAIN_TIMEOUT, [this]() { return session_threads_ == 0; })) {
+            std::cerr << "⚠️ " << session_threads_ << " session threads still running after "
+                      << SESSION_DRAIN_TIMEOUT.count() << "s" << std::endl;
+        }
+    }
+    
+    stop_search();
+    stop_geo();
+    stop_retention();
+    stop_archive();
+    stop_delivery_receipts();
+    stop_notifications();
+    stop_room_stats();
+    stop_hot_rooms();
+    traffic_capture().stop();
+    
+    // Final snapshot on graceful shutdown (sessions are gone, caches are not)
+    if (snapshot_running.exchange(false)) {
+        snapshot_cv.notify_all();
+        if (snapshot_thread.joinable()) {
+            snapshot_thread.join();
+        }
+        save_state_snapshot(snapshot_settings.path, *snapshot_db);
+        snapshot_db.reset();
+    }
+    
+    if (lease_running.exchange(false)) {
+        lease_cv.notify_all();
+        if (lease_thread.joinable()) {
+            lease_thread.join();
+        }
+    }
+    
+    if (cluster_transport) {
+        cluster_transport->stop();
+    }
+    
+    // Wake acceptors blocked in accept() so the shard threads can be joined
+    for (auto& acceptor : acceptors_) {
+        ::shutdown(acceptor->native_handle(), SHUT_RDWR);
+    }
+    
     io_context_.stop();
     
     for (auto& thread : thread_pool_) {
@@ -748,55 +3454,119 @@ void WebSocketServer::stop() {
 void WebSocketServer::handle_session(beast::tcp_stream stream, const std::string& client_endpoint) {
     std::string session_id = "session_" + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count());
+    std::shared_ptr<OutboundQueue> outbound;
+    uint32_t capture_session = 0;
     
     try {
         beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
         
-        auto ws = std::make_shared<websocket::stream<beast::tcp_stream>>(std::move(stream));
-        ws->accept();
+        // Same port serves plain HTTP (health, admin) and WebSocket upgrades
+        beast::flat_buffer handshake_buffer;
+        http::request<http::string_body> request;
+        http::read(stream, handshake_buffer, request);
+        
+        if (!websocket::is_upgrade(request)) {
+            handle_http_request(stream, request, client_endpoint);
+            beast::error_code ec;
+            stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+            return;
+        }
+        
+        auto ws = std::make_shared<websocket::stream<QueuedStream>>(std::move(stream));
+        ws->accept(request);
         
         std::cout << "🤝 WebSocket handshake completed: " << session_id << std::endl;
         
         auto session = std::make_shared<ClientSession>(ws);
+        session->cold->client_endpoint = client_endpoint;
+        
+        // ws://host/?delivery=bulk opts into batched delivery (bridges, bots, dashboards)
+        std::string target(request.target());
+        SessionClass session_class = target.find("delivery=bulk") != std::string::npos
+            ? SessionClass::BULK : SessionClass::INTERACTIVE;
+        outbound = std::make_shared<OutboundQueue>(ws->next_layer().next_layer().socket().native_handle(), session_class);
+        ws->next_layer().attach(outbound);
+        session->outbound = outbound;
+        capture_session = traffic_capture().open_session(target);
         
+        size_t session_count = 0;
         {
             std::lock_guard<std::mutex> lock(sessions_mutex);
             active_sessions[session_id] = session;
+            session_count = active_sessions.size();
         }
         
-        std::cout << "📊 Active sessions: " << active_sessions.size() << std::endl;
+        std::cout << "📊 Active sessions: " << session_count << std::endl;
         
         // Main message loop
         for (;;) {
-            beast::flat_buffer buffer;
+            beast::flat_buffer& buffer = session->cold->read_buffer;
             ws->read(buffer);
             
+            if (!ws->got_text()) {
+                traffic_capture().record_binary(capture_session, buffer.size());
+                handle_upload_chunk(session, buffer.data().data(), buffer.size());
+                buffer.consume(buffer.size());
+                session->last_activity = std::chrono::system_clock::now();
+                continue;
+            }
+            
+            trace::TraceScope frame_trace("ws.frame");
+            
             std::string message = beast::buffers_to_string(buffer.data());
+            buffer.consume(buffer.size());
+            if (buffer.capacity() > READ_BUFFER_RETAIN_BYTES) {
+                buffer.shrink_to_fit();  // don't pin a large frame's buffer on an idle connection
+            }
+            session->cold->read_buffer_capacity.store(buffer.capacity(), std::memory_order_relaxed);
             session->last_activity = std::chrono::system_clock::now();
             
             std::cout << "📨 [" << session_id << "] Received: " 
                      << message.substr(0, 100) << (message.length() > 100 ? "..." : "") << std::endl;
             
+            traffic_capture().record_text(capture_session, message);
+            bool was_authenticated = session->is_authenticated;
             handle_message(session, message);
+            
+            if (!was_authenticated && session->is_authenticated) {
+                register_local_user(session->user);
+                traffic_capture().record_user(capture_session, session->user_id());
+            }
         }
         
     } catch (const std::exception& e) {
-        std::cout << "👋 Session disconnected: " << session_id << std::endl;
-        if (active_sessions.count(session_id) && active_sessions[session_id]->is_authenticated) {
-            std::cout << "🧹 Cleaning up: " << session_id << " (User: " << active_sessions[session_id]->username << ")";
-            if (db_manager) {
-                db_manager->update_user_status(active_sessions[session_id]->user_id, false);
-            }
-        } else {
-            std::cout << "🧹 Cleaning up: " << session_id;
+        // No more writes to this socket once it is torn down
+        if (outbound) {
+            outbound->shutdown();
         }
+        traffic_capture().close_session(capture_session);
+        std::cout << "👋 Session disconnected: " << session_id << std::endl;
         
+        // Everything read from the map under the lock; the DB update happens outside it
+        std::shared_ptr<ClientSession> session;
+        size_t session_count = 0;
         {
             std::lock_guard<std::mutex> lock(sessions_mutex);
-            active_sessions.erase(session_id);
+            auto it = active_sessions.find(session_id);
+            if (it != active_sessions.end()) {
+                session = it->second;
+                leave_current_room(session);
+                active_sessions.erase(it);
+            }
+            session_count = active_sessions.size();
+        }
+        
+        if (session && session->is_authenticated) {
+            std::cout << "🧹 Cleaning up: " << session_id << " (User: " << session->cold->username << ")" << std::endl;
+            if (db_manager) {
+                db_manager->update_user_status(session->user_id(), false);
+            }
+            unregister_local_user(session->user);
+        } else {
+            std::cout << "🧹 Cleaning up: " << session_id << std::endl;
         }
         
-        std::cout << std::endl << "📊 Active sessions: " << active_sessions.size() << std::endl;
+        std::cout << "📊 Active sessions: " << session_count << std::endl;
     }
 }
 
@@ -819,57 +3589,109 @@ std::string WebSocketServer::get_server_stats() const {
     stats << "📊 Server Stats:\n";
     stats << "   • Total connections: " << active_sessions.size() << "\n";
     stats << "   • Authenticated users: " << authenticated_users << "\n";
+    stats << "   • Active rooms: " << room_sessions.size() << "\n";
+    stats << "   • Interned ids: " << interned_ids().size() << " (~" << interned_ids().memory_bytes() / 1024 << " KB)\n";
     stats << "   • Server port: " << port_;
     
     return stats.str();
 }
 
 void WebSocketServer::cleanup_inactive_sessions() {
-    std::lock_guard<std::mutex> lock(sessions_mutex);
-    
-    auto now = std::chrono::system_clock::now();
-    auto it = active_sessions.begin();
-    
-    while (it != active_sessions.end()) {
-        auto session = it->second;
-        auto inactive_time = std::chrono::duration_cast<std::chrono::minutes>(now - session->last_activity);
+    std::vector<IdHandle> expired_users;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
         
-        if (inactive_time.count() > 30) { // 30 minutes timeout
-            std::cout << "🧹 Cleaning up inactive session: " << it->first << std::endl;
-            
-            if (db_manager && session->is_authenticated) {
-                db_manager->update_user_status(session->user_id, false);
-            }
+        auto now = std::chrono::system_clock::now();
+        auto it = active_sessions.begin();
+        
+        while (it != active_sessions.end()) {
+            auto session = it->second;
+            auto inactive_time = std::chrono::duration_cast<std::chrono::minutes>(now - session->last_activity);
             
-            try {
-                if (session->ws && session->ws->is_open()) {
-                    session->ws->close(websocket::close_code::going_away);
+            if (inactive_time.count() > 30) { // 30 minutes timeout
+                std::cout << "🧹 Cleaning up inactive session: " << it->first << std::endl;
+                
+                if (db_manager && session->is_authenticated) {
+                    db_manager->update_user_status(session->user_id(), false);
                 }
-            } catch (const std::exception& e) {
-                // Ignore cleanup errors
+                
+                try {
+                    if (session->outbound) {
+                        session->outbound->shutdown();
+                    }
+                    if (session->ws && session->ws->is_open()) {
+                        session->ws->close(websocket::close_code::going_away);
+                    }
+                } catch (const std::exception& e) {
+                    // Ignore cleanup errors
+                }
+                
+                if (session->is_authenticated) {
+                    expired_users.push_back(session->user);
+                }
+                leave_current_room(session);
+                it = active_sessions.erase(it);
+            } else {
+                ++it;
             }
-            
-            it = active_sessions.erase(it);
-        } else {
-            ++it;
         }
     }
+    
+    for (IdHandle user : expired_users) {
+        unregister_local_user(user);
+    }
 }
 
 void WebSocketServer::start_maintenance_tasks() {
     std::cout << "🔧 Maintenance tasks started" << std::endl;
     
-    std::thread([this]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::minutes(5));
+    maintenance_thread_ = std::thread([this]() {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(maintenance_mutex_);
+                if (maintenance_cv_.wait_for(lock, std::chrono::minutes(5), [this]() { return stopping_.load(); })) {
+                    return;
+                }
+            }
             cleanup_inactive_sessions();
             
             // FIXED: Use correct method name
             if (db_manager) {
                 db_manager->cleanup_expired_typing_indicators();
             }
+            
+            size_t abandoned_uploads = attachments().sweep_staging();
+            if (abandoned_uploads > 0) {
+                std::cout << "📎 Removed " << abandoned_uploads << " abandoned partial uploads" << std::endl;
+            }
+            
+            if (cluster_transport) {
+                std::string latency_name = std::string("caffis_cluster_delivery_latency_us{transport=\"")
+                    + cluster_transport->name() + "\"}";
+                auto& latency = metrics::histogram(latency_name);
+                std::cout << "🛰️ Cross-node latency (" << cluster_transport->name() << "): p50 <= "
+                          << latency.percentile(0.50) << "us, p99 <= " << latency.percentile(0.99)
+                          << "us over " << latency.count() << " messages" << std::endl;
+            }
+            
+            auto& frames = metrics::counter("caffis_outbound_frames_total");
+            auto& syscalls = metrics::counter("caffis_outbound_write_syscalls_total");
+            if (frames.value() > 0) {
+                std::cout << "📤 Outbound: " << frames.value() << " frames in " << syscalls.value()
+                          << " write syscalls (" << static_cast<double>(syscalls.value()) / frames.value()
+                          << " per frame), queued control/chat/ephemeral: "
+                          << metrics::gauge("caffis_outbound_queue_depth{lane=\"control\"}").value() << "/"
+                          << metrics::gauge("caffis_outbound_queue_depth{lane=\"chat\"}").value() << "/"
+                          << metrics::gauge("caffis_outbound_queue_depth{lane=\"ephemeral\"}").value() << std::endl;
+            }
+            
+            MemoryUsage usage = collect_memory_usage();
+            publish_memory_gauges(usage);
+            std::cout << "🧠 Memory: " << usage.sessions << " sessions, ~" << usage.per_session()
+                      << " B/session, RSS " << usage.rss / (1024 * 1024) << " MB, " << usage.threads << " threads, "
+                      << usage.open_fds << " open FDs" << std::endl;
         }
-    }).detach();
+    });
 }
 
 void WebSocketServer::set_database_manager(std::shared_ptr<DatabaseManager> db) {
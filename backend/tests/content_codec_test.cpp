@@ -0,0 +1,126 @@
+#include "../include/content_codec.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace caffis;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "❌ " << what << std::endl;
+        failures++;
+    }
+}
+
+std::string chat_line(int i) {
+    return "{\"user\":\"u" + std::to_string(i % 37) + "\",\"text\":\"meeting moved to room " + std::to_string(i % 11)
+         + ", bring the quarterly numbers and the slides from last week\",\"seq\":" + std::to_string(i) + "}";
+}
+
+std::string large_body(int seed) {
+    std::string body;
+    for (int i = 0; body.size() < 2048; ++i) {
+        body += chat_line(seed + i);
+    }
+    return body;
+}
+
+config::ContentCodecConfig codec_settings() {
+    config::ContentCodecConfig settings;
+    settings.enabled = true;
+    settings.min_bytes = 256;
+    return settings;
+}
+
+void test_plain_round_trip() {
+    ContentCodec codec;
+    codec.configure(codec_settings());
+
+    const std::string body = large_body(0);
+    std::string packed;
+    bool was_packed = codec.encode(body, packed);
+    check(was_packed == ContentCodec::available(), "large bodies are packed exactly when zstd is built in");
+
+    std::string short_packed;
+    check(!codec.encode("hi", short_packed), "bodies under min_bytes are stored as is");
+
+    if (was_packed) {
+        check(packed[0] == static_cast<char>(ContentCodec::FORMAT_ZSTD), "no dictionary: plain zstd format");
+        check(packed.size() < body.size(), "packed body is smaller");
+        std::string decoded;
+        check(codec.decode(packed, decoded), "packed row decodes");
+        check(decoded == body, "packed row round-trips byte for byte");
+
+        std::string truncated = packed.substr(0, packed.size() / 2);
+        check(!codec.decode(truncated, decoded), "truncated frame is an error");
+    }
+}
+
+void test_dictionary_round_trip() {
+    if (!ContentCodec::available()) {
+        return;
+    }
+    std::vector<std::string> samples;
+    for (int i = 0; i < 2000; ++i) {
+        samples.push_back(chat_line(i));
+    }
+    std::string dictionary = ContentCodec::train_dictionary(samples, 4096);
+    check(!dictionary.empty(), "dictionary trains from samples");
+    if (dictionary.empty()) {
+        return;
+    }
+
+    ContentCodec codec;
+    codec.configure(codec_settings());
+    codec.add_dictionary(7, dictionary);
+
+    const std::string body = large_body(100);
+    std::string packed;
+    check(codec.encode(body, packed), "dictionary encode packs");
+    check(packed[0] == static_cast<char>(ContentCodec::FORMAT_ZSTD_DICT), "newest dictionary encodes");
+    std::string decoded;
+    check(codec.decode(packed, decoded) && decoded == body, "dictionary row round-trips");
+
+    // Another node that never saw dictionary #7 and can't load it
+    ContentCodec other;
+    other.configure(codec_settings());
+    check(!other.decode(packed, decoded), "missing dictionary is an error, not an empty body");
+
+    // ... and one that fetches it through the loader
+    ContentCodec loading;
+    loading.configure(codec_settings());
+    loading.set_dictionary_loader([&dictionary](uint32_t id, std::string& bytes) {
+        bytes = dictionary;
+        return id == 7;
+    });
+    check(loading.decode(packed, decoded) && decoded == body, "dictionary fetched through the loader decodes");
+}
+
+void test_garbage_is_an_error() {
+    ContentCodec codec;
+    codec.configure(codec_settings());
+    std::string decoded;
+    check(!codec.decode("", decoded), "empty packed value is an error");
+    check(!codec.decode(std::string("\x09garbage", 8), decoded), "unknown format is an error");
+    check(!codec.decode(std::string("\x01not a zstd frame", 17), decoded), "corrupt frame is an error");
+}
+
+} // namespace
+
+int main() {
+    test_plain_round_trip();
+    test_dictionary_round_trip();
+    test_garbage_is_an_error();
+
+    if (failures > 0) {
+        std::cerr << failures << " content codec check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "✅ content codec tests passed (zstd " << (ContentCodec::available() ? "on" : "off") << ")" << std::endl;
+    return EXIT_SUCCESS;
+}
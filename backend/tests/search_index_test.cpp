@@ -0,0 +1,127 @@
+#include "../include/search_index.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace caffis;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "❌ " << what << std::endl;
+        failures++;
+    }
+}
+
+const char* const ROOM = "00000000-0000-4000-8000-000000000001";
+const char* const ALICE = "00000000-0000-4000-8000-0000000000a1";
+const char* const BOB = "00000000-0000-4000-8000-0000000000b0";
+
+std::string message_id(int n) {
+    char id[37];
+    std::snprintf(id, sizeof(id), "10000000-0000-4000-8000-%012d", n);
+    return id;
+}
+
+IdHandle room_handle() {
+    return interned_ids().intern(ROOM);
+}
+
+void test_varint_round_trip() {
+    const uint32_t values[] = {0, 1, 127, 128, 255, 16383, 16384, 2097151, 2097152, 0x0FFFFFFF, 0xFFFFFFFF};
+    std::string bytes;
+    for (uint32_t value : values) {
+        SearchIndex::put_varint(bytes, value);
+    }
+    check(bytes.size() == 1 + 1 + 1 + 2 + 2 + 2 + 3 + 3 + 4 + 4 + 5, "varints take 7 bits per byte");
+
+    size_t pos = 0;
+    for (uint32_t value : values) {
+        check(SearchIndex::get_varint(bytes, pos) == value, "varint decodes to what was encoded");
+    }
+    check(pos == bytes.size(), "decoding consumes every byte");
+
+    // A list cut off mid-value stops at the end instead of reading past it
+    std::string truncated = bytes.substr(0, bytes.size() - 1);
+    pos = truncated.size() - 4;
+    SearchIndex::get_varint(truncated, pos);
+    check(pos == truncated.size(), "truncated varint stops at the end");
+}
+
+void test_bm25_ranking() {
+    SearchIndex index;
+    index.upsert(ROOM, message_id(1), 1, ALICE, "lunch at noon near the station");
+    index.upsert(ROOM, message_id(2), 2, ALICE, "coffee coffee coffee, anyone up for coffee");
+    index.upsert(ROOM, message_id(3), 3, BOB, "coffee after the meeting, the long meeting about the roadmap and budget");
+    index.upsert(ROOM, message_id(4), 4, BOB, "Coffee?");
+
+    std::vector<SearchHit> hits = index.search({room_handle()}, "coffee", 10);
+    check(hits.size() == 3, "every document with the term matches, no others");
+    if (hits.size() == 3) {
+        check(hits[0].seq == 2, "highest term frequency ranks first");
+        check(hits[1].seq == 4, "short document beats a long one at equal frequency");
+        check(hits[2].seq == 3, "long document ranks last");
+        check(hits[0].score > hits[1].score && hits[1].score > hits[2].score, "scores descend");
+        check(hits[0].message_id == message_id(2), "hits carry the message id");
+    }
+
+    hits = index.search({room_handle()}, "coffee meeting", 10);
+    check(!hits.empty() && hits[0].seq == 3, "matching more (and rarer) terms ranks first");
+
+    check(index.search({room_handle()}, "coffee", 1).size() == 1, "limit caps the results");
+    check(index.search({room_handle()}, "tea", 10).empty(), "unknown term matches nothing");
+    check(index.search({}, "coffee", 10).empty(), "no rooms, no results");
+
+    std::vector<IdHandle> excluded = {interned_ids().intern(BOB)};
+    hits = index.search({room_handle()}, "coffee", 10, excluded);
+    check(hits.size() == 1 && hits[0].seq == 2, "excluded senders are left out");
+}
+
+void test_edits_and_compaction() {
+    SearchIndex index;
+    // Spread doc ids past one varint byte so deltas take several
+    for (int seq = 1; seq <= 300; ++seq) {
+        index.upsert(ROOM, message_id(seq), seq, ALICE, "filler message number " + std::to_string(seq));
+    }
+    for (int round = 0; round < 3; ++round) {
+        for (int seq = 1; seq <= 300; ++seq) {
+            index.upsert(ROOM, message_id(seq), seq, ALICE, "edited filler round " + std::to_string(round));
+        }
+    }
+    index.upsert(ROOM, message_id(301), 301, BOB, "the needle");
+    index.remove(ROOM, 150);
+
+    check(index.document_count() == 300, "edits replace, removes retire");
+    check(index.retired_count() <= 300, "retired documents get compacted");
+    check(index.search({room_handle()}, "number", 10).empty(), "replaced content no longer matches");
+
+    std::vector<SearchHit> hits = index.search({room_handle()}, "round 2", 500);
+    check(hits.size() == 299, "latest edit of every live message matches");
+    hits = index.search({room_handle()}, "needle", 10);
+    check(hits.size() == 1 && hits[0].seq == 301 && hits[0].message_id == message_id(301),
+          "document ids stay right after compaction");
+
+    index.upsert(ROOM, message_id(150), 150, ALICE, "back again");
+    hits = index.search({room_handle()}, "back", 10);
+    check(hits.size() == 1 && hits[0].seq == 150, "a removed seq can be indexed again after compaction");
+}
+
+} // namespace
+
+int main() {
+    test_varint_round_trip();
+    test_bm25_ranking();
+    test_edits_and_compaction();
+
+    if (failures > 0) {
+        std::cerr << failures << " search index check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "✅ search index tests passed" << std::endl;
+    return EXIT_SUCCESS;
+}
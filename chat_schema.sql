@@ -34,14 +34,19 @@ CREATE TABLE chat_rooms (
     description TEXT,
     type VARCHAR(20) NOT NULL DEFAULT 'private',  -- 'private', 'group', 'meetup'
     invite_id UUID,                               -- Link to meetup invite
+    event_at TIMESTAMP WITH TIME ZONE,            -- Meetup time (retention counts from here)
     created_by UUID NOT NULL,
     is_active BOOLEAN DEFAULT true,
+    latitude DOUBLE PRECISION,                    -- Meetup place (nearby-rooms discovery)
+    longitude DOUBLE PRECISION,
     last_activity TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
     created_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
     updated_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
     
     FOREIGN KEY (created_by) REFERENCES chat_users(id),
-    CONSTRAINT valid_room_type CHECK (type IN ('private', 'group', 'meetup'))
+    CONSTRAINT valid_room_type CHECK (type IN ('private', 'group', 'meetup')),
+    CONSTRAINT valid_room_location CHECK ((latitude IS NULL) = (longitude IS NULL)
+        AND (latitude IS NULL OR (latitude BETWEEN -90 AND 90 AND longitude BETWEEN -180 AND 180)))
 );
 
 -- ================================================
@@ -71,6 +76,7 @@ CREATE TABLE messages (
     room_id UUID NOT NULL,
     sender_id UUID NOT NULL,
     content TEXT,
+    content_packed BYTEA,                        -- large bodies, compressed by the storage codec (content is NULL then)
     message_type VARCHAR(20) DEFAULT 'text',      -- 'text', 'image', 'file', 'location', 'system'
     file_url TEXT,                               -- MinIO file URL
     file_name VARCHAR(255),
@@ -81,12 +87,42 @@ CREATE TABLE messages (
     is_deleted BOOLEAN DEFAULT false,
     edited_at TIMESTAMP WITH TIME ZONE,
     created_at TIMESTAMP WITH TIME ZONE DEFAULT NOW(),
+    seq BIGSERIAL NOT NULL,                      -- Monotonic insert order (cluster fan-out, cursors)
     
     FOREIGN KEY (room_id) REFERENCES chat_rooms(id) ON DELETE CASCADE,
     FOREIGN KEY (sender_id) REFERENCES chat_users(id),
     CONSTRAINT valid_message_type CHECK (message_type IN ('text', 'image', 'file', 'location', 'system'))
 );
 
+-- Retention drops whole partitions when messages is range-partitioned on
+-- created_at (e.g. monthly), and batch-deletes otherwise. Partitioning an
+-- existing table needs a migration and is left to the operator.
+
+-- ================================================
+-- CONTENT DICTIONARIES (storage codec)
+-- ================================================
+-- zstd dictionaries trained from message bodies (caffis_chat
+-- --train-content-dictionary). Rows are never updated or deleted while any
+-- content_packed value still names them; the newest one encodes.
+CREATE TABLE content_dictionaries (
+    id SERIAL PRIMARY KEY,
+    dictionary BYTEA NOT NULL,
+    sample_count INTEGER NOT NULL,
+    created_at TIMESTAMP WITH TIME ZONE DEFAULT NOW()
+);
+
+-- ================================================
+-- ROOM ACTIVITY (capacity planning)
+-- ================================================
+-- Totals flushed by every node from its in-memory room counters; each
+-- node adds the messages sent through it, peaks are per node.
+CREATE TABLE room_activity (
+    room_id UUID PRIMARY KEY REFERENCES chat_rooms(id) ON DELETE CASCADE,
+    messages_total BIGINT NOT NULL DEFAULT 0,
+    peak_members INTEGER NOT NULL DEFAULT 0,
+    updated_at TIMESTAMP WITH TIME ZONE DEFAULT NOW()
+);
+
 -- ================================================
 -- MESSAGE READ STATUS
 -- ================================================
@@ -142,6 +178,9 @@ CREATE INDEX idx_messages_room_created ON messages(room_id, created_at DESC);
 CREATE INDEX idx_messages_sender ON messages(sender_id);
 CREATE INDEX idx_messages_type ON messages(message_type);
 CREATE INDEX idx_messages_created ON messages(created_at DESC);
+CREATE UNIQUE INDEX idx_messages_seq ON messages(seq);
+CREATE INDEX idx_messages_room_seq ON messages(room_id, seq DESC);  -- history pages by seq cursor
+CREATE INDEX idx_messages_edited_at ON messages(edited_at) WHERE edited_at IS NOT NULL;  -- search index feed
 
 -- Room participants indexes
 CREATE INDEX idx_room_participants_room ON room_participants(room_id);
@@ -154,6 +193,7 @@ CREATE INDEX idx_chat_rooms_type ON chat_rooms(type);
 CREATE INDEX idx_chat_rooms_active ON chat_rooms(is_active);
 CREATE INDEX idx_chat_rooms_invite ON chat_rooms(invite_id);
 CREATE INDEX idx_chat_rooms_activity ON chat_rooms(last_activity DESC);
+CREATE INDEX idx_chat_rooms_updated ON chat_rooms(updated_at);  -- nearby-rooms feed
 
 -- Read status indexes
 CREATE INDEX idx_message_read_status_message ON message_read_status(message_id);